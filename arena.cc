@@ -0,0 +1,153 @@
+/* File: arena.cc
+ * --------------
+ * Implementation of the Arena bump allocator.
+ */
+
+#include "arena.h"
+#include "ast.h"
+#include <string.h>
+#include <stdio.h>
+
+static const size_t Alignment = sizeof(void *);
+
+thread_local Arena *Arena::current = NULL;
+
+Arena::Arena(size_t size)
+{
+    chunkSize = size;
+    chunks = NULL;
+    next = limit = NULL;
+    bytesUsed = bytesReserved = 0;
+    trackNodes = false;
+}
+
+Arena::~Arena()
+{
+    FreeChunks(chunks);
+}
+
+void Arena::FreeChunks(Chunk *c)
+{
+    while (c != NULL) {
+        Chunk *n = c->next;
+        free(c);
+        c = n;
+    }
+}
+
+/* Arena::NewChunk
+ * ---------------
+ * Grabs a fresh chunk from malloc big enough for at least minSize bytes.
+ * Oversized requests get a chunk all of their own.
+ */
+void Arena::NewChunk(size_t minSize)
+{
+    size_t header = (sizeof(Chunk) + Alignment - 1) & ~(Alignment - 1);
+    size_t size = minSize > chunkSize ? minSize : chunkSize;
+    Chunk *c = (Chunk *)malloc(header + size);
+    if (c == NULL)
+        Failure("Out of memory allocating %lu byte arena chunk", (unsigned long)size);
+    c->size = size;
+    c->next = chunks;
+    chunks = c;
+    next = (char *)c + header;
+    limit = next + size;
+    bytesReserved += header + size;
+}
+
+void *Arena::Alloc(size_t size)
+{
+    size = (size + Alignment - 1) & ~(Alignment - 1);
+    if (size > (size_t)(limit - next))
+        NewChunk(size);
+    void *result = next;
+    next += size;
+    bytesUsed += size;
+    return result;
+}
+
+char *Arena::StrNDup(const char *str, size_t len)
+{
+    char *copy = (char *)Alloc(len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char *Arena::StrDup(const char *str)
+{
+    return StrNDup(str, strlen(str));
+}
+
+/* Arena::Reset
+ * ------------
+ * Frees everything at once. The most recently allocated chunk is kept
+ * so that the next round of allocations doesn't go back to malloc.
+ */
+void Arena::Reset()
+{
+    nodes.clear();
+    bytesUsed = 0;
+    if (chunks == NULL)
+        return;
+    FreeChunks(chunks->next);
+    chunks->next = NULL;
+    size_t header = (sizeof(Chunk) + Alignment - 1) & ~(Alignment - 1);
+    next = (char *)chunks + header;
+    limit = next + chunks->size;
+    bytesReserved = header + chunks->size;
+}
+
+void Arena::NoteNode(Node *node, size_t size)
+{
+    if (trackNodes) {
+        NodeRecord r = {node, size};
+        nodes.push_back(r);
+    }
+}
+
+/* Arena::PrintStats
+ * -----------------
+ * Prints the arena totals and, if node tracking was on, the number of
+ * nodes and bytes used for each kind of node. Output goes through the
+ * "arena" debug key.
+ */
+void Arena::PrintStats()
+{
+    PrintDebug("arena", "%lu bytes used, %lu bytes reserved",
+               (unsigned long)bytesUsed, (unsigned long)bytesReserved);
+
+    size_t count[NumNodeKinds] = {0}, bytes[NumNodeKinds] = {0};
+    for (size_t i = 0; i < nodes.size(); i++) {
+        NodeKind kind = nodes[i].node->GetKind();
+        count[kind]++;
+        bytes[kind] += nodes[i].size;
+    }
+    for (int k = 0; k < NumNodeKinds; k++) {
+        if (count[k] > 0)
+            PrintDebug("arena", "%-16s %8lu nodes %10lu bytes", NodeKindNames[k],
+                       (unsigned long)count[k], (unsigned long)bytes[k]);
+    }
+}
+
+/* Arena::Current
+ * --------------
+ * Returns the arena new nodes should be allocated from. Until a compilation
+ * sets up its arena, this is the permanent arena, which is created
+ * on first use so it is ready even during static initialization.
+ */
+Arena *Arena::Current()
+{
+    return current ? current : Permanent();
+}
+
+Arena *Arena::Permanent()
+{
+    static Arena *permanent = new Arena;
+    return permanent;
+}
+
+void Arena::SetCurrent(Arena *arena)
+{
+    current = arena;
+}
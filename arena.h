@@ -0,0 +1,133 @@
+/* File: arena.h
+ * -------------
+ * This file defines a simple bump-pointer allocator that owns the memory
+ * for all the ast nodes, lists, tables and strings created during a
+ * compilation. Rather than making millions of tiny malloc calls, the
+ * arena carves allocations out of large chunks and gives all of them
+ * back in one operation when the arena is destroyed (or Reset).
+ *
+ * Individual objects are never freed, and their destructors are never
+ * run, so only objects that don't own any non-arena memory should be
+ * placed here. Node, List and Hashtable all redefine operator new to
+ * allocate from the current arena, and the STL containers they wrap
+ * use the ArenaAllocator below so their storage lands there as well.
+ *
+ * There is always a current arena. Until a compilation installs one of
+ * its own with SetCurrent, allocations go to a permanent arena that
+ * is never released, which is where the static Type constants and other
+ * process-wide objects live.
+ *
+ * An arena itself is not thread-safe. The current arena is kept per
+ * thread, so each thread doing work in parallel (see pool.h) allocates
+ * from an arena of its own.
+ */
+
+#ifndef _H_arena
+#define _H_arena
+
+#include <stddef.h>
+#include <vector>
+#include "utility.h"
+
+class Node;
+
+class Arena
+{
+  public:
+    static const size_t DefaultChunkSize = 64*1024;
+
+           // Creates an empty arena, no memory is reserved until the
+           // first allocation
+    Arena(size_t chunkSize = DefaultChunkSize);
+
+           // Releases all chunks, which frees everything allocated
+           // from this arena in one go
+    ~Arena();
+
+           // Returns size bytes of suitably aligned memory
+    void *Alloc(size_t size);
+
+           // Returns a copy of the string (or the first len characters
+           // of it) allocated in the arena
+    char *StrDup(const char *str);
+    char *StrNDup(const char *str, size_t len);
+
+           // Frees all allocations at once, keeping the first chunk
+           // around for reuse
+    void Reset();
+
+           // Bytes handed out to callers and bytes reserved from malloc
+    size_t BytesUsed() const     { return bytesUsed; }
+    size_t BytesReserved() const { return bytesReserved; }
+
+           // When tracking is on, every node allocation is recorded so
+           // PrintStats can report the bytes used for each node kind
+    void SetTrackNodes(bool track) { trackNodes = track; }
+    void NoteNode(Node *node, size_t size);
+    void PrintStats();
+
+           // The nodes recorded while tracking, in the order they were
+           // made
+    size_t NumNodes() const       { return nodes.size(); }
+    Node *GetNode(size_t i) const { return nodes[i].node; }
+
+           // The arena used by operator new for nodes, lists and tables
+           // on the calling thread
+    static Arena *Current();
+    static void SetCurrent(Arena *arena);
+
+           // The arena for objects that live as long as the process
+    static Arena *Permanent();
+
+  private:
+    struct Chunk {
+        Chunk *next;
+        size_t size;
+    };
+    struct NodeRecord {
+        Node *node;
+        size_t size;
+    };
+
+    size_t chunkSize;
+    Chunk *chunks;
+    char *next, *limit;
+    size_t bytesUsed, bytesReserved;
+    bool trackNodes;
+    std::vector<NodeRecord> nodes;
+
+    void NewChunk(size_t minSize);
+    void FreeChunks(Chunk *c);
+
+    static thread_local Arena *current;
+};
+
+
+/* Class: ArenaAllocator
+ * ---------------------
+ * An STL allocator that hands out memory from the arena that was current
+ * when it was constructed. Deallocation is a no-op, the memory comes back
+ * when the whole arena is released. This is used by List and Hashtable so
+ * the storage behind their deque and map also lives in the arena.
+ */
+template <class T> class ArenaAllocator
+{
+  public:
+    typedef T value_type;
+
+    Arena *arena;
+
+    ArenaAllocator() : arena(Arena::Current()) {}
+    template <class U> ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T *allocate(size_t n)
+        { return (T *)arena->Alloc(n * sizeof(T)); }
+    void deallocate(T *, size_t) {}
+
+    template <class U> bool operator==(const ArenaAllocator<U>& other) const
+        { return arena == other.arena; }
+    template <class U> bool operator!=(const ArenaAllocator<U>& other) const
+        { return arena != other.arena; }
+};
+
+#endif
@@ -5,44 +5,69 @@
 #include "ast.h"
 #include "ast_type.h"
 #include "ast_decl.h"
-#include <string.h> // strdup
+#include <string.h>
 #include <stdio.h>  // printf
 
+#define AST_KIND_NAME(cls, super) #cls,
+const char *const NodeKindNames[NumNodeKinds] = {
+    AST_NODE_TABLE(AST_KIND_NAME, AST_IGNORE, AST_KIND_NAME, AST_IGNORE)
+};
+#undef AST_KIND_NAME
+
 Node::Node(yyltype loc) {
-    location = new yyltype(loc);
+    location = MakeSpan(loc);
+    parent = NULL;
+    scope = NULL;
+}
+
+Node::Node(SourceSpan loc) {
+    location = loc;
     parent = NULL;
-    symbolTable = NULL;
+    scope = NULL;
 }
 
 Node::Node() {
-    location = NULL;
+    location = NoSpan();
     parent = NULL;
+    scope = NULL;
 }
 
-Decl *Node::FindDecl(const char *name)
+void *Node::operator new(size_t size)
 {
-    Decl *result = NULL;
-    Hashtable<Decl*> *currentScope;
-    Node *p = this;
-
-    while (p != NULL)
-    {
-        currentScope = p->symbolTable;
-        if (currentScope == NULL)
-        {
-            p = p->parent;
-            continue;
-        }
-        result = currentScope->Lookup(name);
-        if (result != NULL)
-            return result;
-        
-        p = p->parent;
-    }
-    return NULL;
+    Arena *arena = Arena::Current();
+    void *mem = arena->Alloc(size);
+    arena->NoteNode((Node *)mem, size);
+    return mem;
+}
+
+/* Node::GetScope
+ * --------------
+ * Returns the innermost scope enclosing this node. Nodes that open a
+ * scope set it up in their constructor, every other node gets it from its
+ * parent the first time it's asked for and keeps it from then on.
+ */
+Scope *Node::GetScope()
+{
+    if (scope == NULL && parent != NULL)
+        scope = parent->GetScope();
+    return scope;
+}
+
+Decl *Node::FindDecl(Symbol name)
+{
+    Scope *s = GetScope();
+    return (s != NULL ? s->Lookup(name) : NULL);
+}
+
+Identifier::Identifier(yyltype loc, Symbol sym) : Node(loc) {
+    kind = Kind_Identifier;
+    symbol = sym;
+    name = SymbolName(sym);
 }
 
-Identifier::Identifier(yyltype loc, const char *n) : Node(loc) {
-    name = strdup(n);
+Identifier::Identifier(SourceSpan loc, Symbol sym) : Node(loc) {
+    kind = Kind_Identifier;
+    symbol = sym;
+    name = SymbolName(sym);
 } 
 
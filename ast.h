@@ -6,10 +6,12 @@
  * more correctly, of instances of concrete subclassses such as VarDecl,
  * ForStmt, and AssignExpr).
  * 
- * Location: Each node maintains its lexical location (line and columns in 
- * file), that location can be NULL for those nodes that don't care/use 
- * locations. The location is typcially set by the node constructor.  The 
- * location is used to provide the context when reporting semantic errors.
+ * Location: Each node maintains its lexical location as a SourceSpan (byte
+ * offset and length in the file) stored inline in the node. That span is
+ * invalid for those nodes that don't care/use locations. The location is
+ * typcially set by the node constructor.  The location is used to provide
+ * the context when reporting semantic errors, which is when the line and
+ * columns get decoded from the span.
  *
  * Parent: Each node has a pointer to its parent. For a Program node, the 
  * parent is NULL, for all other nodes it is the pointer to the node one level
@@ -19,6 +21,16 @@
  * set up links in both directions. The parent link is typically not used 
  * during parsing, but is more important in later phases.
  *
+ * Scope: The nodes that open a new scope of declarations (the program,
+ * classes, interfaces, functions and blocks) each create a Scope for their
+ * symbol table. Every other node links straight to the scope of the
+ * nearest such node above it, found once via the parent links the first
+ * time it is asked for, so identifier lookup never repeats that walk.
+ *
+ * Memory: Nodes are allocated from the current Arena (see arena.h) and
+ * are never deleted individually. The whole tree is released at once
+ * when the compilation's arena goes away.
+ *
  * Semantic analysis: For pp3 you are adding "Check" behavior to the ast
  * node classes. Your semantic analyzer should do an inorder walk on the
  * parse tree, and when visiting each node, verify the particular
@@ -32,6 +44,10 @@
 #include <stdlib.h>   // for NULL
 #include "location.h"
 #include "hashtable.h"
+#include "scope.h"
+#include "arena.h"
+#include "source.h"
+#include "ast_kinds.h"
 #include <iostream>
 
 class Decl;
@@ -39,26 +55,57 @@ class Decl;
 class Node 
 {
   protected:
-    yyltype *location;
+    NodeKind kind;       // set by the constructor of each class
+    SourceSpan location;
+    Scope *scope;
 
   public:
     Node *parent;
     Node(yyltype loc);
-    Decl* FindDecl(const char *name);
+    Node(SourceSpan loc);
+    Decl* FindDecl(Symbol name);
     Node();
-    Hashtable<Decl*> *symbolTable;
-    yyltype *GetLocation()   { return location; }
+    virtual ~Node() {}   // keeps Node at the start of every node object
+    Scope *GetScope();
+    SourceSpan GetLocation() { return location; }
+    void MoveLocation(int delta) { if (location.IsValid()) location.offset += delta; }
     void SetParent(Node *p)  { parent = p; }
     Node *GetParent()        { return parent; }
+    NodeKind GetKind()       { return kind; }
+    const char *GetPrintNameForNode() { return NodeKindNames[kind]; }
+
+    // Nodes live in the current arena and are freed along with it
+    static void *operator new(size_t size);
+    static void operator delete(void *) {}
 };
 
 
+/* Functions: IsA, DynCast
+ * ------------------------
+ * IsA<T>(n) tests whether n is an instance of the node class T (or a
+ * subclass), using only its kind tag. DynCast<T>(n) returns n as a T if
+ * it is one, and NULL otherwise (including when n is NULL), so it can
+ * stand in for dynamic_cast on nodes.
+ */
+template <class T> inline bool IsA(Node *n)
+{
+    return NodeKindRange<T>::First <= n->GetKind() && n->GetKind() <= NodeKindRange<T>::Last;
+}
+
+template <class T> inline T *DynCast(Node *n)
+{
+    return (n != NULL && IsA<T>(n)) ? static_cast<T*>(n) : NULL;
+}
+
+
 class Identifier : public Node 
 {
    
   public:
-    char *name;
-    Identifier(yyltype loc, const char *name);
+    Symbol symbol;
+    const char *name;     // the symbol's name, owned by the intern table
+    Identifier(yyltype loc, Symbol sym);
+    Identifier(SourceSpan loc, Symbol sym);
     friend std::ostream& operator<<(std::ostream& out, Identifier *id) { return out << id->name; }
 };
 
@@ -71,7 +118,7 @@ class Identifier : public Node
 class Error : public Node
 {
   public:
-    Error() : Node() {}
+    Error() : Node() { kind = Kind_Error; }
 };
 
 
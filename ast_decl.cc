@@ -6,71 +6,145 @@
 #include "ast_type.h"
 #include "ast_stmt.h"
 #include "errors.h"
+#include "pool.h"
+#include "context.h"
 #include <iostream>
 using namespace std;
         
          
-Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
+Decl::Decl(Identifier *n) : Node(n->GetLocation()) {
     Assert(n != NULL);
     this->checked = false;
     (id=n)->SetParent(this); 
 }
 
 VarDecl::VarDecl(Identifier *n, Type *t) : Decl(n) {
+    kind = Kind_VarDecl;
     Assert(n != NULL && t != NULL);
     this->checked = false;
+    this->offset = -1;
     (type=t)->SetParent(this);
 }
 void VarDecl::Declare(Hashtable<Decl*> *symbolTable)
 {
     this->type->Check();
-    Decl* previousDeclare = symbolTable->Lookup(this->id->name);
+    Decl* previousDeclare = symbolTable->Lookup(this->id->symbol);
     if (previousDeclare != NULL)
     {
         ReportError::DeclConflict(this, previousDeclare);
     }
     else
     {
-        symbolTable->Enter(this->id->name, this);
+        symbolTable->Enter(this->id->symbol, this);
     }
 }
 void VarDecl::Check()
 {
     // Do nothing
 }
+void VarDecl::SkipCheck()
+{
+    this->checked = true;
+}
 
 
 ClassDecl::ClassDecl(Identifier *n, NamedType *ex, List<NamedType*> *imp, List<Decl*> *m) : Decl(n) {
+    kind = Kind_ClassDecl;
     // extends can be NULL, impl & mem may be empty lists but cannot be NULL
     Assert(n != NULL && imp != NULL && m != NULL);     
     this->checked = false;
+    this->linked = false;
+    this->superclass = this->inheritsFrom = NULL;
+    this->layout = NULL;
+    this->hierarchy = NULL;
+    this->classIndex = -1;
     extends = ex;
-    this->symbolTable = new Hashtable<Decl*>;
+    this->scope = new Scope(this, new Hashtable<Decl*>);
     if (extends) extends->SetParent(this);
     (implements=imp)->SetParentAll(this);
     (members=m)->SetParentAll(this);
 }
 void ClassDecl::Declare(Hashtable<Decl*> *symbolTable)
 {
-    Decl *previousDeclare = symbolTable->Lookup(this->id->name);
+    Decl *previousDeclare = symbolTable->Lookup(this->id->symbol);
     if (previousDeclare != NULL)
     {
         ReportError::DeclConflict(this, previousDeclare);
     }
     else
     {
-        symbolTable->Enter(this->id->name, this);
+        symbolTable->Enter(this->id->symbol, this);
+    }
+}
+/* ClassDecl::GetSuperclass
+ * ------------------------
+ * Returns the class named in the extends clause, or NULL if there isn't
+ * one or it doesn't name a class. The name is looked up from the
+ * enclosing scope, since this class's own can't be searched until it is
+ * linked to the superclass.
+ */
+ClassDecl *ClassDecl::GetSuperclass()
+{
+    if (this->extends != NULL && this->superclass == NULL)
+        this->superclass = DynCast<ClassDecl>(this->GetParent()->FindDecl(this->extends->id->symbol));
+    return this->superclass;
+}
+
+/* ClassDecl::LinkToSuperclass
+ * ---------------------------
+ * Makes the superclass's members visible in this class's scope, then
+ * links the superclass in turn. This must happen before anything is
+ * looked up in the class. If the extends clauses form a cycle, the link
+ * that would close it is left out, so the first class of the cycle to be
+ * linked inherits from the next one and the last inherits nothing.
+ */
+void ClassDecl::LinkToSuperclass()
+{
+    if (this->linked)
+        return;
+    this->linked = true;
+    ClassDecl *super = this->GetSuperclass();
+    if (super == NULL)
+        return;
+    for (ClassDecl *c = super; c != this; c = c->inheritsFrom)
+    {
+        if (c == NULL)
+        {
+            this->inheritsFrom = super;
+            this->scope->SetInherited(super->scope);
+            break;
+        }
     }
+    super->LinkToSuperclass();
 }
+
+/* ClassDecl::GetLayout
+ * --------------------
+ * Returns the layout of the class's objects, computing it after that of
+ * the superclass the first time it is asked for. The members of the class
+ * must already have been declared.
+ */
+ClassLayout *ClassDecl::GetLayout()
+{
+    if (this->layout == NULL)
+    {
+        this->LinkToSuperclass();
+        ClassLayout *super = (this->inheritsFrom ? this->inheritsFrom->GetLayout() : NULL);
+        this->layout = new ClassLayout(this, super);
+    }
+    return this->layout;
+}
+
 void ClassDecl::Check()
 {
     if (this->checked)
         return;
     this->checked = true;
+    this->LinkToSuperclass();
 
     for (int i = 0; i < this->members->NumElements(); i++)
     {
-        this->members->Nth(i)->Declare(this->symbolTable);
+        this->members->Nth(i)->Declare(this->scope->GetTable());
     }
 
     for (int i = 0; i < this->members->NumElements(); i++)
@@ -78,95 +152,168 @@ void ClassDecl::Check()
         this->members->Nth(i)->Check();
     }
 
-    // Super class member checks
+    // Super class checks
     if (this->extends != NULL)
     {
-        NamedType *classType = this->extends;
-        ClassDecl *classDecl = dynamic_cast<ClassDecl*>(this->FindDecl(classType->id->name));
+        ClassDecl *classDecl = this->GetSuperclass();
 
         if (classDecl == NULL)
         {
-            ReportError::IdentifierNotDeclared(classType->id, LookingForClass);
+            ReportError::IdentifierNotDeclared(this->extends->id, LookingForClass);
         }
         else
         {
             classDecl->Check();
-            Decl* val;
-            Iterator<Decl*> iter = classDecl->symbolTable->GetIterator();
-            while ((val=iter.GetNextValue()) != NULL)
+        }
+    }
+
+    // Each of our own members, in the order they're declared, against
+    // the member it overrides and the interface members it implements,
+    // so a member is reported at most once, where it's declared
+    int numInterfaces = this->implements->NumElements();
+    InterfaceDecl **interfaces = new InterfaceDecl*[numInterfaces];
+    bool *incomplete = new bool[numInterfaces];
+    for (int i = 0; i < numInterfaces; i++)
+    {
+        interfaces[i] = DynCast<InterfaceDecl>(this->FindDecl(this->implements->Nth(i)->id->symbol));
+        incomplete[i] = false;
+        if (interfaces[i] != NULL)
+        {
+            interfaces[i]->Check();
+            if (this->hierarchy != NULL && this->hierarchy->Conforms(this, interfaces[i]))
+                interfaces[i] = NULL;
+        }
+    }
+
+    ClassLayout *inherited = this->GetLayout()->GetSuper();
+    for (int i = 0; i < this->members->NumElements(); i++)
+    {
+        Decl *localDecl = this->members->Nth(i);
+        if (this->scope->GetTable()->Lookup(localDecl->id->symbol) != localDecl)
+            continue;
+        FnDecl* localImpl = DynCast<FnDecl>(localDecl);
+        Decl *superDecl = inherited == NULL ? NULL : inherited->Lookup(localDecl->id->symbol);
+        bool mismatched = false;
+        if (superDecl != NULL)
+        {
+            FnDecl* superImpl = DynCast<FnDecl>(superDecl);
+            if (localImpl == NULL || superImpl == NULL)
+            {
+                ReportError::DeclConflict(localDecl, superDecl);
+            }
+            else if (FnDecl::Compare(superImpl, localImpl) == false)
             {
-                FnDecl* localImpl = dynamic_cast<FnDecl *>(this->symbolTable->Lookup(val->id->name));
-                FnDecl* superImpl = dynamic_cast<FnDecl*>(val);
-                if (localImpl == NULL || superImpl == NULL)
-                {
-                    if (this->symbolTable->Lookup(val->id->name) != NULL)
-                    {
-                        ReportError::DeclConflict(this->symbolTable->Lookup(val->id->name), val);
-                    }
-                }
-                else if (FnDecl::Compare(superImpl, localImpl) == false)
-                {
+                ReportError::OverrideMismatch(localImpl);
+                mismatched = true;
+            }
+        }
+
+        for (int j = 0; j < numInterfaces; j++)
+        {
+            if (interfaces[j] == NULL)
+                continue;
+            FnDecl* intefImpl = DynCast<FnDecl>(interfaces[j]->GetMembers()->Lookup(localDecl->id->symbol));
+            if (intefImpl == NULL)
+                continue;
+            if (localImpl == NULL || FnDecl::Compare(localImpl, intefImpl) == false)
+            {
+                if (localImpl != NULL && !mismatched)
                     ReportError::OverrideMismatch(localImpl);
-                }
-                this->symbolTable->Enter(val->id->name, val);
+                mismatched = true;
+                incomplete[j] = true;
             }
         }
     }
 
-    // Interface member checks
-    for (int i = 0; i < this->implements->NumElements(); i++)
+    // Then each interface, in the order they're listed, if it isn't
+    // declared or we're missing or mismatching any of its members
+    for (int i = 0; i < numInterfaces; i++)
     {
         NamedType *interfaceType = this->implements->Nth(i);
-
-        InterfaceDecl *interfaceDecl = dynamic_cast<InterfaceDecl*>(this->FindDecl(interfaceType->id->name));
+        InterfaceDecl *interfaceDecl = DynCast<InterfaceDecl>(this->FindDecl(interfaceType->id->symbol));
         if (interfaceDecl == NULL)
         {
             ReportError::IdentifierNotDeclared(interfaceType->id, LookingForInterface);
             continue;
         }
-        bool missingTerms = false;
-        interfaceDecl->Check();
+        if (interfaces[i] == NULL)
+            continue;
 
         Decl *val;
-        Iterator<Decl*> iter = interfaceDecl->symbolTable->GetIterator();
-        while ((val=iter.GetNextValue()) != NULL)
+        Iterator<Decl*> iter = interfaceDecl->GetMembers()->GetIterator();
+        while (!incomplete[i] && (val=iter.GetNextValue()) != NULL)
         {
-            FnDecl* classImpl = dynamic_cast<FnDecl *>(this->symbolTable->Lookup(val->id->name));
-            FnDecl* intefImpl = dynamic_cast<FnDecl*>(val);
-            if (classImpl == NULL || interfaceDecl == NULL)
-            {
-                missingTerms = true;
-                continue;
-            }
-
-            if (FnDecl::Compare(classImpl, intefImpl) == false)
+            FnDecl* classImpl = DynCast<FnDecl>(this->scope->LookupMember(val->id->symbol));
+            FnDecl* intefImpl = DynCast<FnDecl>(val);
+            if (classImpl == NULL || FnDecl::Compare(classImpl, intefImpl) == false)
             {
-                ReportError::OverrideMismatch(classImpl);
+                incomplete[i] = true;
             }
         }
-        if (missingTerms)
+        if (incomplete[i])
         {
-            ReportError::InterfaceNotImplemented(this, this->implements->Nth(i));
+            ReportError::InterfaceNotImplemented(this, interfaceType);
         }
     }
+    delete[] interfaces;
+    delete[] incomplete;
+}
+
+/* ClassDecl::SkipCheck
+ * --------------------
+ * Later checks look members up in the class and lay it out, and expect
+ * the superclass and interfaces to have been checked along with it, so
+ * all of that is done just as Check does, only without a word.
+ */
+void ClassDecl::SkipCheck()
+{
+    if (this->checked)
+        return;
+    this->checked = true;
+    this->LinkToSuperclass();
+
+    ReportError::SetQuiet(true);
+    for (int i = 0; i < this->members->NumElements(); i++)
+    {
+        this->members->Nth(i)->Declare(this->scope->GetTable());
+    }
+    ReportError::SetQuiet(false);
+
+    for (int i = 0; i < this->members->NumElements(); i++)
+    {
+        this->members->Nth(i)->SkipCheck();
+    }
+    if (this->GetSuperclass() != NULL)
+    {
+        this->GetSuperclass()->SkipCheck();
+    }
+    this->GetLayout();
+    for (int i = 0; i < this->implements->NumElements(); i++)
+    {
+        InterfaceDecl *interfaceDecl = DynCast<InterfaceDecl>(this->FindDecl(this->implements->Nth(i)->id->symbol));
+        if (interfaceDecl != NULL)
+            interfaceDecl->SkipCheck();
+    }
 }
 
 InterfaceDecl::InterfaceDecl(Identifier *n, List<Decl*> *m) : Decl(n) {
+    kind = Kind_InterfaceDecl;
     Assert(n != NULL && m != NULL);
     this->checked = false;
-    this->symbolTable = new Hashtable<Decl*>;
+    this->interfaceIndex = -1;
+    this->scope = new Scope(this, new Hashtable<Decl*>);
     (members=m)->SetParentAll(this);
 }
 void InterfaceDecl::Declare(Hashtable<Decl*> *symbolTable)
 {
-    Decl *previousDeclare = symbolTable->Lookup(this->id->name);
+    Decl *previousDeclare = symbolTable->Lookup(this->id->symbol);
     if (previousDeclare != NULL)
     {
         ReportError::DeclConflict(this, previousDeclare);
     }
     else
     {
-        symbolTable->Enter(this->id->name, this);
+        symbolTable->Enter(this->id->symbol, this);
     }
 }
 void InterfaceDecl::Check()
@@ -177,7 +324,7 @@ void InterfaceDecl::Check()
 
     for (int i = 0; i < this->members->NumElements(); i++)
     {
-        this->members->Nth(i)->Declare(this->symbolTable);
+        this->members->Nth(i)->Declare(this->scope->GetTable());
     }
 
     for (int i = 0; i < this->members->NumElements(); i++)
@@ -185,44 +332,132 @@ void InterfaceDecl::Check()
         this->members->Nth(i)->Check();
     }
 }
+void InterfaceDecl::SkipCheck()
+{
+    if (this->checked)
+        return;
+    this->checked = true;
+
+    ReportError::SetQuiet(true);
+    for (int i = 0; i < this->members->NumElements(); i++)
+    {
+        this->members->Nth(i)->Declare(this->scope->GetTable());
+    }
+    ReportError::SetQuiet(false);
+
+    for (int i = 0; i < this->members->NumElements(); i++)
+    {
+        this->members->Nth(i)->SkipCheck();
+    }
+}
 	
 FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(n) {
+    kind = Kind_FnDecl;
     Assert(n != NULL && r!= NULL && d != NULL);
-    this->symbolTable = new Hashtable<Decl*>;
+    this->scope = new Scope(this, new Hashtable<Decl*>);
     this->checked = false;
     (returnType=r)->SetParent(this);
     (formals=d)->SetParentAll(this);
     body = NULL;
+    bodyArena = NULL;
+    slot = -1;
 }
-void FnDecl::SetFunctionBody(Stmt *b) { 
+void FnDecl::SetFunctionBody(Stmt *b, Arena *arena) { 
     (body=b)->SetParent(this);
+    bodyArena = arena;
 }
 void FnDecl::Declare(Hashtable<Decl*> *symbolTable)
 {
     this->returnType->Check();
-    Decl* previousDeclare = symbolTable->Lookup(this->id->name);
+    Decl* previousDeclare = symbolTable->Lookup(this->id->symbol);
     if (previousDeclare != NULL)
     {
         ReportError::DeclConflict(this, previousDeclare);
     }
     else
     {
-        symbolTable->Enter(this->id->name, this);
+        symbolTable->Enter(this->id->symbol, this);
+        this->scope->GetTable()->Clear(); // declared before, if kept (see incremental.h)
         for (int i = 0; i < this->formals->NumElements(); i++)
         {
-            this->formals->Nth(i)->Declare(this->symbolTable);
+            this->formals->Nth(i)->Declare(this->scope->GetTable());
         }
     }
 }
+/* Class: BodyCheck
+ * ----------------
+ * A task that checks one function body on a worker thread, reporting
+ * its errors into the segment reserved for them. The worker takes on the
+ * body's compilation context while it runs.
+ */
+class BodyCheck : public Task
+{
+  public:
+    BodyCheck(FnDecl *f, ErrorSegment *s)
+      : fn(f), errors(s), context(CompilationContext::Current()) {}
+    void Run()
+    {
+        CompilationContext::SetCurrent(this->context);
+        ReportError::StartSegment(this->errors);
+        this->fn->CheckBody();
+        ReportError::FinishSegment();
+        CompilationContext::SetCurrent(NULL);
+    }
+
+  private:
+    FnDecl *fn;
+    ErrorSegment *errors;
+    CompilationContext *context;
+};
+
+/* FnDecl::Check
+ * -------------
+ * With a pool of workers, the body is checked on one of them while the
+ * rest of the program carries on. By now everything a body can see
+ * outside itself (its formals and the globals) has been declared and is
+ * only read from here on, so the body can be checked at any time.
+ */
 void FnDecl::Check()
 {
     if (this->checked)
         return;
     this->checked = true;
-    if (this->body != NULL)
+    if (this->body == NULL)
+        return;
+    this->scope->Freeze();
+    WorkPool *pool = CompilationContext::Current()->GetWorkPool();
+    if (pool == NULL)
+        this->CheckBody();
+    else
+        pool->Submit(new BodyCheck(this, ReportError::Defer()));
+}
+
+/* FnDecl::CheckBody
+ * -----------------
+ * A body with an arena of its own is checked in that arena, so whatever
+ * the check allocates goes with the body, and the arena is handed back
+ * as soon as the check is done since nothing refers to the body after
+ * that. The function's own scope was frozen beforehand, so its chain is
+ * not among what goes.
+ */
+void FnDecl::CheckBody()
+{
+    if (this->bodyArena == NULL)
     {
         this->body->Check();
+        return;
     }
+    Arena *saved = Arena::Current();
+    Arena::SetCurrent(this->bodyArena);
+    this->body->Check();
+    Arena::SetCurrent(saved);
+    CompilationContext::Current()->ReleaseBody(this->bodyArena);
+    this->body = NULL;
+    this->bodyArena = NULL;
+}
+void FnDecl::SkipCheck()
+{
+    this->checked = true;
 }
 bool FnDecl::Compare(FnDecl* a, FnDecl* b)
 {
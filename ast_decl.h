@@ -16,6 +16,8 @@
 #include "ast.h"
 #include "list.h"
 #include "hashtable.h"
+#include "layout.h"
+#include "hierarchy.h"
 
 class Type;
 class NamedType;
@@ -32,56 +34,100 @@ class Decl : public Node
     Decl(Identifier *name);
     virtual void Declare(Hashtable<Decl*> *symbolTable) = 0;
     virtual void Check() = 0;
+    
+           // Marks the declaration checked without checking it, for when
+           // its errors are known from before (see incremental.h). What
+           // checking it sets up for checking the rest is set up quietly.
+    virtual void SkipCheck() = 0;
+    bool IsChecked() { return checked; }
     friend std::ostream& operator<<(std::ostream& out, Decl *d) { return out << d->id; }
 };
 
 class VarDecl : public Decl 
 {    
+    int offset;          // byte offset in the object, if a field
+
   public:
     Type *type;
     void Declare(Hashtable<Decl*> *symbolTable);
     void Check();
+    void SkipCheck();
     VarDecl(Identifier *name, Type *type);
+    int GetOffset() { return offset; }
+    void SetOffset(int off) { offset = off; }
 };
 
 class ClassDecl : public Decl 
 {
+    friend class ClassLayout;
+    friend class ClassHierarchy;
+    friend class DeclStream;
+    friend class IncrementalSession;
+    friend class DeclSnapshot;
+    friend class Lowering;
+
   protected:
     List<Decl*> *members;
     NamedType *extends;
     List<NamedType*> *implements;
+    bool linked;
+    ClassDecl *superclass;   // the class extends names, if it is one
+    ClassDecl *inheritsFrom; // the same, unless extends is cyclic
+    ClassLayout *layout;
+    ClassHierarchy *hierarchy;
+    int classIndex;          // this class's number in the hierarchy
 
   public:
     void Declare(Hashtable<Decl*> *symbolTable);
     void Check();
+    void SkipCheck();
     ClassDecl(Identifier *name, NamedType *extends, 
               List<NamedType*> *implements, List<Decl*> *members);
+    Hashtable<Decl*> *GetMembers() { return scope->GetTable(); }
+    ClassDecl *GetSuperclass();
+    void LinkToSuperclass();
+    ClassLayout *GetLayout();
 };
 
 class InterfaceDecl : public Decl 
 {
+    friend class ClassHierarchy;
+    friend class DeclSnapshot;
+
   protected:
     List<Decl*> *members;
+    int interfaceIndex;      // this interface's number in the hierarchy
     
   public:
     void Declare(Hashtable<Decl*> *symbolTable);
     void Check();
+    void SkipCheck();
     InterfaceDecl(Identifier *name, List<Decl*> *members);
+    Hashtable<Decl*> *GetMembers() { return scope->GetTable(); }
 };
 
 class FnDecl : public Decl 
 {
+    friend class DeclSnapshot;
+    friend class Lowering;
+
   protected:
     List<VarDecl*> *formals;
     Type *returnType;
     Stmt *body;
+    Arena *bodyArena;    // the arena of its own the body is in, if any
+    int slot;            // method table slot, if a method
     
   public:
     FnDecl(Identifier *name, Type *returnType, List<VarDecl*> *formals);
     static bool Compare(FnDecl *a, FnDecl* b);
     void Declare(Hashtable<Decl*> *symbolTable);
     void Check();
-    void SetFunctionBody(Stmt *b);
+    void SkipCheck();
+    void CheckBody();
+    void SetFunctionBody(Stmt *b, Arena *arena = NULL);
+    int GetSlot() { return slot; }
+    void SetSlot(int s) { slot = s; }
 };
 
 #endif
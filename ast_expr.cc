@@ -8,30 +8,33 @@
 #include <string.h>
 
 
-void Expr::Check()
-{
-
-}
-
-
 IntConstant::IntConstant(yyltype loc, int val) : Expr(loc) {
+    kind = Kind_IntConstant;
     value = val;
 }
 
 DoubleConstant::DoubleConstant(yyltype loc, double val) : Expr(loc) {
+    kind = Kind_DoubleConstant;
     value = val;
 }
 
 BoolConstant::BoolConstant(yyltype loc, bool val) : Expr(loc) {
+    kind = Kind_BoolConstant;
+    value = val;
+}
+
+StringConstant::StringConstant(yyltype loc, Lexeme val) : Expr(loc) {
+    kind = Kind_StringConstant;
+    Assert(val.text != NULL);
     value = val;
 }
 
-StringConstant::StringConstant(yyltype loc, const char *val) : Expr(loc) {
-    Assert(val != NULL);
-    value = strdup(val);
+void StringConstant::SetSource(SourceFile *source) {
+    value = source->GetLexeme(location.offset, value.length);
 }
 
 Operator::Operator(yyltype loc, const char *tok) : Node(loc) {
+    kind = Kind_Operator;
     Assert(tok != NULL);
     strncpy(tokenString, tok, sizeof(tokenString));
 }
@@ -53,12 +56,14 @@ CompoundExpr::CompoundExpr(Operator *o, Expr *r)
 
   
 ArrayAccess::ArrayAccess(yyltype loc, Expr *b, Expr *s) : LValue(loc) {
+    kind = Kind_ArrayAccess;
     (base=b)->SetParent(this); 
     (subscript=s)->SetParent(this);
 }
      
 FieldAccess::FieldAccess(Expr *b, Identifier *f) 
-  : LValue(b? Join(b->GetLocation(), f->GetLocation()) : *f->GetLocation()) {
+  : LValue(b? Join(b->GetLocation(), f->GetLocation()) : f->GetLocation()) {
+    kind = Kind_FieldAccess;
     Assert(f != NULL); // b can be be NULL (just means no explicit base)
     base = b; 
     if (base) base->SetParent(this); 
@@ -67,6 +72,7 @@ FieldAccess::FieldAccess(Expr *b, Identifier *f)
 
 
 Call::Call(yyltype loc, Expr *b, Identifier *f, List<Expr*> *a) : Expr(loc)  {
+    kind = Kind_Call;
     Assert(f != NULL && a != NULL); // b can be be NULL (just means no explicit base)
     base = b;
     if (base) base->SetParent(this);
@@ -76,12 +82,14 @@ Call::Call(yyltype loc, Expr *b, Identifier *f, List<Expr*> *a) : Expr(loc)  {
  
 
 NewExpr::NewExpr(yyltype loc, NamedType *c) : Expr(loc) { 
+  kind = Kind_NewExpr;
   Assert(c != NULL);
   (cType=c)->SetParent(this);
 }
 
 
 NewArrayExpr::NewArrayExpr(yyltype loc, Expr *sz, Type *et) : Expr(loc) {
+    kind = Kind_NewArrayExpr;
     Assert(sz != NULL && et != NULL);
     (size=sz)->SetParent(this); 
     (elemType=et)->SetParent(this);
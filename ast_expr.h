@@ -25,8 +25,8 @@ class Expr : public Stmt
 {
   public:
     Expr(yyltype loc) : Stmt(loc) {}
+    Expr(SourceSpan loc) : Stmt(loc) {}
     Expr() : Stmt() {}
-    void Check();
 };
 
 /* This node type is used for those places where an expression is optional.
@@ -35,10 +35,13 @@ class Expr : public Stmt
 class EmptyExpr : public Expr
 {
   public:
+    EmptyExpr() : Expr() { kind = Kind_EmptyExpr; }
 };
 
 class IntConstant : public Expr 
 {
+    friend class Lowering;
+
   protected:
     int value;
   
@@ -48,6 +51,8 @@ class IntConstant : public Expr
 
 class DoubleConstant : public Expr 
 {
+    friend class Lowering;
+
   protected:
     double value;
     
@@ -57,6 +62,8 @@ class DoubleConstant : public Expr
 
 class BoolConstant : public Expr 
 {
+    friend class Lowering;
+
   protected:
     bool value;
     
@@ -66,21 +73,30 @@ class BoolConstant : public Expr
 
 class StringConstant : public Expr 
 { 
+    friend class Lowering;
+
   protected:
-    char *value;
+    Lexeme value;   // view of the constant (with quotes) in the source
     
   public:
-    StringConstant(yyltype loc, const char *val);
+    StringConstant(yyltype loc, Lexeme val);
+
+           // Views the constant in source instead, where it is at the
+           // same place, for a tree kept from an earlier version of the
+           // program (see incremental.h)
+    void SetSource(SourceFile *source);
 };
 
 class NullConstant: public Expr 
 {
   public: 
-    NullConstant(yyltype loc) : Expr(loc) {}
+    NullConstant(yyltype loc) : Expr(loc) { kind = Kind_NullConstant; }
 };
 
 class Operator : public Node 
 {
+    friend class Lowering;
+
   protected:
     char tokenString[4];
     
@@ -91,6 +107,8 @@ class Operator : public Node
  
 class CompoundExpr : public Expr
 {
+    friend class Lowering;
+
   protected:
     Operator *op;
     Expr *left, *right; // left will be NULL if unary
@@ -103,52 +121,52 @@ class CompoundExpr : public Expr
 class ArithmeticExpr : public CompoundExpr 
 {
   public:
-    ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
-    ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
+    ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) { kind = Kind_ArithmeticExpr; }
+    ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) { kind = Kind_ArithmeticExpr; }
 };
 
 class RelationalExpr : public CompoundExpr 
 {
   public:
-    RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
+    RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) { kind = Kind_RelationalExpr; }
 };
 
 class EqualityExpr : public CompoundExpr 
 {
   public:
-    EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
-    const char *GetPrintNameForNode() { return "EqualityExpr"; }
+    EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) { kind = Kind_EqualityExpr; }
 };
 
 class LogicalExpr : public CompoundExpr 
 {
   public:
-    LogicalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
-    LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
-    const char *GetPrintNameForNode() { return "LogicalExpr"; }
+    LogicalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) { kind = Kind_LogicalExpr; }
+    LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) { kind = Kind_LogicalExpr; }
 };
 
 class AssignExpr : public CompoundExpr 
 {
   public:
-    AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
-    const char *GetPrintNameForNode() { return "AssignExpr"; }
+    AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) { kind = Kind_AssignExpr; }
 };
 
 class LValue : public Expr 
 {
   public:
     LValue(yyltype loc) : Expr(loc) {}
+    LValue(SourceSpan loc) : Expr(loc) {}
 };
 
 class This : public Expr 
 {
   public:
-    This(yyltype loc) : Expr(loc) {}
+    This(yyltype loc) : Expr(loc) { kind = Kind_This; }
 };
 
 class ArrayAccess : public LValue 
 {
+    friend class Lowering;
+
   protected:
     Expr *base, *subscript;
     
@@ -163,6 +181,8 @@ class ArrayAccess : public LValue
  * and sort it out later. */
 class FieldAccess : public LValue 
 {
+    friend class Lowering;
+
   protected:
     Expr *base;	// will be NULL if no explicit base
     Identifier *field;
@@ -177,6 +197,8 @@ class FieldAccess : public LValue
  * and sort it out later. */
 class Call : public Expr 
 {
+    friend class Lowering;
+
   protected:
     Expr *base;	// will be NULL if no explicit base
     Identifier *field;
@@ -188,6 +210,8 @@ class Call : public Expr
 
 class NewExpr : public Expr
 {
+    friend class Lowering;
+
   protected:
     NamedType *cType;
     
@@ -197,6 +221,8 @@ class NewExpr : public Expr
 
 class NewArrayExpr : public Expr
 {
+    friend class Lowering;
+
   protected:
     Expr *size;
     Type *elemType;
@@ -208,13 +234,13 @@ class NewArrayExpr : public Expr
 class ReadIntegerExpr : public Expr
 {
   public:
-    ReadIntegerExpr(yyltype loc) : Expr(loc) {}
+    ReadIntegerExpr(yyltype loc) : Expr(loc) { kind = Kind_ReadIntegerExpr; }
 };
 
 class ReadLineExpr : public Expr
 {
   public:
-    ReadLineExpr(yyltype loc) : Expr (loc) {}
+    ReadLineExpr(yyltype loc) : Expr (loc) { kind = Kind_ReadLineExpr; }
 };
 
     
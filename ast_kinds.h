@@ -0,0 +1,119 @@
+/* File: ast_kinds.h
+ * -----------------
+ * This is the one table of all the ast node classes. Everything that
+ * needs to know the full set of node classes (the kind tags, the print
+ * names, the IsA/DynCast tests and the visitor in ast_visitor.h) is
+ * generated from it, so adding a node class means adding one line here.
+ *
+ * A class with subclasses is bracketed by BEGIN and END, and is listed
+ * with SELF inside its own brackets if it can have instances too. The
+ * table is in depth-first order, so the kinds of a class and all its
+ * subclasses form one contiguous range, and testing whether a node is
+ * an instance of a class is just a comparison against that range. Each
+ * entry names the class's superclass, so a visitor can fall back from a
+ * class to its superclass.
+ */
+
+#ifndef _H_ast_kinds
+#define _H_ast_kinds
+
+#define AST_NODE_TABLE(LEAF, BEGIN, SELF, END)      \
+    LEAF(Identifier, Node)                          \
+    LEAF(Error, Node)                               \
+    LEAF(Program, Node)                             \
+    LEAF(Operator, Node)                            \
+    BEGIN(Decl, Node)                               \
+        LEAF(VarDecl, Decl)                         \
+        LEAF(ClassDecl, Decl)                       \
+        LEAF(InterfaceDecl, Decl)                   \
+        LEAF(FnDecl, Decl)                          \
+    END(Decl, Node)                                 \
+    BEGIN(Type, Node)                               \
+        SELF(Type, Node)                            \
+        LEAF(NamedType, Type)                       \
+        LEAF(ArrayType, Type)                       \
+    END(Type, Node)                                 \
+    BEGIN(Stmt, Node)                               \
+        LEAF(StmtBlock, Stmt)                       \
+        BEGIN(ConditionalStmt, Stmt)                \
+            BEGIN(LoopStmt, ConditionalStmt)        \
+                LEAF(ForStmt, LoopStmt)             \
+                LEAF(WhileStmt, LoopStmt)           \
+            END(LoopStmt, ConditionalStmt)          \
+            LEAF(IfStmt, ConditionalStmt)           \
+        END(ConditionalStmt, Stmt)                  \
+        LEAF(BreakStmt, Stmt)                       \
+        LEAF(ReturnStmt, Stmt)                      \
+        LEAF(PrintStmt, Stmt)                       \
+        BEGIN(Expr, Stmt)                           \
+            LEAF(EmptyExpr, Expr)                   \
+            LEAF(IntConstant, Expr)                 \
+            LEAF(DoubleConstant, Expr)              \
+            LEAF(BoolConstant, Expr)                \
+            LEAF(StringConstant, Expr)              \
+            LEAF(NullConstant, Expr)                \
+            BEGIN(CompoundExpr, Expr)               \
+                LEAF(ArithmeticExpr, CompoundExpr)  \
+                LEAF(RelationalExpr, CompoundExpr)  \
+                LEAF(EqualityExpr, CompoundExpr)    \
+                LEAF(LogicalExpr, CompoundExpr)     \
+                LEAF(AssignExpr, CompoundExpr)      \
+            END(CompoundExpr, Expr)                 \
+            BEGIN(LValue, Expr)                     \
+                LEAF(ArrayAccess, LValue)           \
+                LEAF(FieldAccess, LValue)           \
+            END(LValue, Expr)                       \
+            LEAF(This, Expr)                        \
+            LEAF(Call, Expr)                        \
+            LEAF(NewExpr, Expr)                     \
+            LEAF(NewArrayExpr, Expr)                \
+            LEAF(ReadIntegerExpr, Expr)             \
+            LEAF(ReadLineExpr, Expr)                \
+        END(Expr, Stmt)                             \
+    END(Stmt, Node)
+
+#define AST_IGNORE(cls, super)
+
+class Node;
+#define AST_DECLARE_CLASS(cls, super) class cls;
+AST_NODE_TABLE(AST_DECLARE_CLASS, AST_DECLARE_CLASS, AST_IGNORE, AST_IGNORE)
+#undef AST_DECLARE_CLASS
+
+
+/* Type: NodeKind
+ * --------------
+ * The kind tag carried by every node, one for each class that can have
+ * instances. Each class with subclasses also gets Kind_First_ and
+ * Kind_Last_ names for the range of its subclasses' kinds. Those don't
+ * take up values of their own: each is declared, then the next value is
+ * set back by one.
+ */
+#define AST_KIND(cls, super) Kind_##cls,
+#define AST_BEGIN_KINDS(cls, super) Kind_First_##cls, Kind_Unused_First_##cls = Kind_First_##cls - 1,
+#define AST_END_KINDS(cls, super) Kind_After_##cls, Kind_Last_##cls = Kind_After_##cls - 1,
+typedef enum {
+    AST_NODE_TABLE(AST_KIND, AST_BEGIN_KINDS, AST_KIND, AST_END_KINDS)
+    NumNodeKinds
+} NodeKind;
+#undef AST_KIND
+#undef AST_BEGIN_KINDS
+#undef AST_END_KINDS
+
+extern const char *const NodeKindNames[NumNodeKinds];
+
+
+/* Template: NodeKindRange
+ * -----------------------
+ * Gives the range of kinds that are instances of the class T, which is
+ * what IsA and DynCast test against.
+ */
+template <class T> struct NodeKindRange;
+#define AST_LEAF_RANGE(cls, super) \
+    template <> struct NodeKindRange<cls> { static const int First = Kind_##cls, Last = Kind_##cls; };
+#define AST_GROUP_RANGE(cls, super) \
+    template <> struct NodeKindRange<cls> { static const int First = Kind_First_##cls, Last = Kind_Last_##cls; };
+AST_NODE_TABLE(AST_LEAF_RANGE, AST_GROUP_RANGE, AST_IGNORE, AST_IGNORE)
+#undef AST_LEAF_RANGE
+#undef AST_GROUP_RANGE
+
+#endif
@@ -6,13 +6,92 @@
 #include "ast_type.h"
 #include "ast_decl.h"
 #include "ast_expr.h"
+#include "errors.h"
+#include "pool.h"
+#include "context.h"
+#include "ast_visitor.h"
 
 Program::Program(List<Decl*> *d) {
+    kind = Kind_Program;
     Assert(d != NULL);
-    this->symbolTable = new Hashtable<Decl*>;
+    this->scope = new Scope(this, new Hashtable<Decl*>);
+    this->hierarchy = NULL;
+    this->imported = new List<Decl*>;
     (decls=d)->SetParentAll(this);
 }
 
+void Program::AddDecl(Decl *d) {
+    this->decls->Append(d);
+    d->SetParent(this);
+}
+
+/* Program::Import
+ * ---------------
+ * Imported declarations have been checked already, along with their
+ * members (see DeclSnapshot::MakeDecls), so they are only entered in the
+ * global scope, and never checked again.
+ */
+void Program::Import(List<Decl*> *d) {
+    for (int i = 0; i < d->NumElements(); i++)
+    {
+        this->imported->Append(d->Nth(i));
+        d->Nth(i)->SetParent(this);
+    }
+}
+
+void Program::DeclareImported() {
+    for (int i = 0; i < this->imported->NumElements(); i++)
+    {
+        Decl *d = this->imported->Nth(i);
+        this->scope->GetTable()->Enter(d->id->symbol, d);
+    }
+}
+
+/* Program::ClearDecls
+ * -------------------
+ * Starts the program over with no declarations, and nothing declared
+ * globally, for the next version of it to be built up from declarations
+ * kept from the last one (see incremental.h). The program's scope stays
+ * the same, since the scopes in those declarations lead to it. What was
+ * imported stays imported, and is declared again along with the rest.
+ */
+void Program::ClearDecls() {
+    this->decls = new List<Decl*>;
+    this->scope->GetTable()->Clear();
+    this->hierarchy = NULL;
+}
+
+/* Program::BuildHierarchy
+ * -----------------------
+ * Once every declaration has been declared, indexes the classes and
+ * interfaces among them (see hierarchy.h), imported ones included.
+ */
+void Program::BuildHierarchy() {
+    List<Decl*> *all = this->decls;
+    if (this->imported->NumElements() > 0)
+    {
+        all = new List<Decl*>;
+        for (int i = 0; i < this->imported->NumElements(); i++)
+            all->Append(this->imported->Nth(i));
+        for (int i = 0; i < this->decls->NumElements(); i++)
+            all->Append(this->decls->Nth(i));
+    }
+    this->hierarchy = new ClassHierarchy(all, this->scope->GetTable());
+}
+
+/* Program::Declare
+ * ----------------
+ * Enters every declaration in the global scope, in order, after those
+ * imported. Along with BuildHierarchy, this is the first half of Check.
+ */
+void Program::Declare() {
+    this->DeclareImported();
+    for (int i = 0; i < this->decls->NumElements(); i++)
+    {
+        this->decls->Nth(i)->Declare(this->scope->GetTable());
+    }
+}
+
 void Program::Check() {
     /* pp3: here is where the semantic analyzer is kicked off.
      *      The general idea is perform a tree traversal of the
@@ -21,132 +100,156 @@ void Program::Check() {
      *      checking itself, which makes for a great use of inheritance
      *      and polymorphism in the node classes.
      */
+    WorkPool *workPool = CompilationContext::Current()->GetWorkPool();
+    if (workPool != NULL)
+        ReportError::BeginOrdered();
+
+    this->Declare();
+    this->BuildHierarchy();
+
     for (int i = 0; i < this->decls->NumElements(); i++)
     {
-        this->decls->Nth(i)->Declare(this->symbolTable);
+        this->decls->Nth(i)->Check();
     }
 
-    for (int i = 0; i < this->decls->NumElements(); i++)
+    if (workPool != NULL)
     {
-        this->decls->Nth(i)->Check();
+        workPool->Wait();
+        ReportError::EndOrdered();
     }
 }
 
 StmtBlock::StmtBlock(List<VarDecl*> *d, List<Stmt*> *s) {
+    kind = Kind_StmtBlock;
     Assert(d != NULL && s != NULL);
-    this->symbolTable = new Hashtable<Decl*>;
+    this->scope = new Scope(this, new Hashtable<Decl*>);
     this->checked = false;
     (decls=d)->SetParentAll(this);
     (stmts=s)->SetParentAll(this);
 }
-void StmtBlock::Check()
-{
-    if (this->checked)
-        return;
-    this->checked = true;
-    for (int i = 0; i < this->decls->NumElements(); i++)
-    {
-        this->decls->Nth(i)->Declare(this->symbolTable);
-    }
-
-    for (int i = 0; i < this->decls->NumElements(); i++)
-    {
-        this->decls->Nth(i)->Check();
-    }
-
-    for (int i = 0; i < this->stmts->NumElements(); i++)
-    {
-        this->stmts->Nth(i)->Check();
-    }
-}
-
 ConditionalStmt::ConditionalStmt(Expr *t, Stmt *b) { 
     Assert(t != NULL && b != NULL);
     this->checked = false;
     (test=t)->SetParent(this); 
     (body=b)->SetParent(this);
 }
-void ConditionalStmt::Check()
-{
-
-}
-
 ForStmt::ForStmt(Expr *i, Expr *t, Expr *s, Stmt *b): LoopStmt(t, b) { 
+    kind = Kind_ForStmt;
     Assert(i != NULL && t != NULL && s != NULL && b != NULL);
     this->checked = false;
     (init=i)->SetParent(this);
     (step=s)->SetParent(this);
 }
-void ForStmt::Check()
-{
-    if (this->checked)
-        return;
-    this->checked = true;
-    this->init->Check();
-    this->test->Check();
-    this->step->Check();
-    this->body->Check();
+IfStmt::IfStmt(Expr *t, Stmt *tb, Stmt *eb): ConditionalStmt(t, tb) { 
+    kind = Kind_IfStmt;
+    Assert(t != NULL && tb != NULL); // else can be NULL
+    this->checked = false;
+    elseBody = eb;
+    if (elseBody) elseBody->SetParent(this);
+}
+ReturnStmt::ReturnStmt(yyltype loc, Expr *e) : Stmt(loc) { 
+    kind = Kind_ReturnStmt;
+    Assert(e != NULL);
+    this->checked = false;
+    (expr=e)->SetParent(this);
+}
+  
+PrintStmt::PrintStmt(List<Expr*> *a) {    
+    kind = Kind_PrintStmt;
+    Assert(a != NULL);
+    this->checked = false;
+    (args=a)->SetParentAll(this);
 }
 
-void LoopStmt::Check()
-{
 
+/* Class: StmtChecker
+ * ------------------
+ * Checks a statement and the statements and expressions in it. Each
+ * node it visits decides which of its children to check, and a class
+ * without a VisitX here has nothing of its own to check, like the
+ * expressions, for which the visitor's defaults do nothing.
+ */
+class StmtChecker : public NodeVisitor<StmtChecker>
+{
+  public:
+    void VisitStmtBlock(StmtBlock *s);
+    void VisitForStmt(ForStmt *s);
+    void VisitWhileStmt(WhileStmt *s);
+    void VisitIfStmt(IfStmt *s);
+    void VisitReturnStmt(ReturnStmt *s);
+    void VisitPrintStmt(PrintStmt *s);
+};
+
+void Stmt::Check()
+{
+    StmtChecker().Visit(this);
 }
 
-void BreakStmt::Check()
+void StmtChecker::VisitStmtBlock(StmtBlock *s)
 {
+    if (s->checked)
+        return;
+    s->checked = true;
+    for (int i = 0; i < s->decls->NumElements(); i++)
+    {
+        s->decls->Nth(i)->Declare(s->scope->GetTable());
+    }
 
+    for (int i = 0; i < s->decls->NumElements(); i++)
+    {
+        s->decls->Nth(i)->Check();
+    }
+
+    for (int i = 0; i < s->stmts->NumElements(); i++)
+    {
+        this->Visit(s->stmts->Nth(i));
+    }
 }
 
-void WhileStmt::Check()
+void StmtChecker::VisitForStmt(ForStmt *s)
 {
-    if (this->checked)
+    if (s->checked)
         return;
-    this->checked = true;
-    this->test->Check();
-    this->body->Check();
+    s->checked = true;
+    this->Visit(s->init);
+    this->Visit(s->test);
+    this->Visit(s->step);
+    this->Visit(s->body);
 }
 
-IfStmt::IfStmt(Expr *t, Stmt *tb, Stmt *eb): ConditionalStmt(t, tb) { 
-    Assert(t != NULL && tb != NULL); // else can be NULL
-    this->checked = false;
-    elseBody = eb;
-    if (elseBody) elseBody->SetParent(this);
+void StmtChecker::VisitWhileStmt(WhileStmt *s)
+{
+    if (s->checked)
+        return;
+    s->checked = true;
+    this->Visit(s->test);
+    this->Visit(s->body);
 }
-void IfStmt::Check()
+
+void StmtChecker::VisitIfStmt(IfStmt *s)
 {
-    this->test->Check();
-    this->body->Check();
+    this->Visit(s->test);
+    this->Visit(s->body);
 
-    if(this->elseBody)
-        this->elseBody->Check();
+    if(s->elseBody)
+        this->Visit(s->elseBody);
 }
 
-ReturnStmt::ReturnStmt(yyltype loc, Expr *e) : Stmt(loc) { 
-    Assert(e != NULL);
-    this->checked = false;
-    (expr=e)->SetParent(this);
-}
-void ReturnStmt::Check()
+void StmtChecker::VisitReturnStmt(ReturnStmt *s)
 {
-    if (this->checked)
+    if (s->checked)
         return;
-    this->checked = true;
-    this->expr->Check();
-}
-  
-PrintStmt::PrintStmt(List<Expr*> *a) {    
-    Assert(a != NULL);
-    this->checked = false;
-    (args=a)->SetParentAll(this);
+    s->checked = true;
+    this->Visit(s->expr);
 }
-void PrintStmt::Check()
+
+void StmtChecker::VisitPrintStmt(PrintStmt *s)
 {
-    if (this->checked)
+    if (s->checked)
         return;
-    this->checked = true;
-    for (int i = 0; i < this->args->NumElements(); i++)
+    s->checked = true;
+    for (int i = 0; i < s->args->NumElements(); i++)
     {
-        this->args->Nth(i)->Check();
+        this->Visit(s->args->Nth(i));
     }
 }
@@ -15,6 +15,7 @@
 
 #include "list.h"
 #include "ast.h"
+#include "hierarchy.h"
 
 class Decl;
 class VarDecl;
@@ -22,107 +23,138 @@ class Expr;
   
 class Program : public Node
 {
+    friend class DeclSnapshot;
+    friend class Lowering;
+
   protected:
      List<Decl*> *decls;
+     List<Decl*> *imported;  // made from a snapshot, see snapshot.h
+     ClassHierarchy *hierarchy;
      
   public:
      Program(List<Decl*> *declList);
+
+     void AddDecl(Decl *decl);
+
+           // Adds declarations that were checked along with another
+           // program, to be declared ahead of this one's own
+     void Import(List<Decl*> *decls);
+     void DeclareImported();
+     void ClearDecls();
+     ClassHierarchy *GetHierarchy() { return hierarchy; }
+     void BuildHierarchy();
+     void Declare();
      void Check();
 };
 
 class Stmt : public Node
 {
+    friend class StmtChecker;
+
   protected:
     bool checked;
 
   public:
      Stmt() : Node() {}
      Stmt(yyltype loc) : Node(loc) {}
-     virtual void Check() = 0;
+     Stmt(SourceSpan loc) : Node(loc) {}
+
+           // Checks the statement and everything in it, dispatching on
+           // the kind of each node through StmtChecker
+     void Check();
 };
 
 class StmtBlock : public Stmt 
 {
+    friend class Lowering;
+    friend class StmtChecker;
+
   protected:
     List<VarDecl*> *decls;
     List<Stmt*> *stmts;
     
   public:
-    void Check();
     StmtBlock(List<VarDecl*> *variableDeclarations, List<Stmt*> *statements);
 };
 
   
 class ConditionalStmt : public Stmt
 {
+    friend class Lowering;
+    friend class StmtChecker;
+
   protected:
     Expr *test;
     Stmt *body;
   
   public:
-    void Check();
     ConditionalStmt(Expr *testExpr, Stmt *body);
 };
 
 class LoopStmt : public ConditionalStmt 
 {
   public:
-    void Check();
     LoopStmt(Expr *testExpr, Stmt *body)
             : ConditionalStmt(testExpr, body) {}
 };
 
 class ForStmt : public LoopStmt 
 {
+    friend class Lowering;
+    friend class StmtChecker;
+
   protected:
     Expr *init, *step;
   
   public:
-    void Check();
     ForStmt(Expr *init, Expr *test, Expr *step, Stmt *body);
 };
 
 class WhileStmt : public LoopStmt 
 {
   public:
-    void Check();
-    WhileStmt(Expr *test, Stmt *body) : LoopStmt(test, body) {}
+    WhileStmt(Expr *test, Stmt *body) : LoopStmt(test, body) { kind = Kind_WhileStmt; }
 };
 
 class IfStmt : public ConditionalStmt 
 {
+    friend class Lowering;
+    friend class StmtChecker;
+
   protected:
     Stmt *elseBody;
   
   public:
-    void Check();
     IfStmt(Expr *test, Stmt *thenBody, Stmt *elseBody);
 };
 
 class BreakStmt : public Stmt 
 {
   public:
-    void Check();
-    BreakStmt(yyltype loc) : Stmt(loc) {}
+    BreakStmt(yyltype loc) : Stmt(loc) { kind = Kind_BreakStmt; }
 };
 
 class ReturnStmt : public Stmt  
 {
+    friend class Lowering;
+    friend class StmtChecker;
+
   protected:
     Expr *expr;
   
   public:
-    void Check();
     ReturnStmt(yyltype loc, Expr *expr);
 };
 
 class PrintStmt : public Stmt
 {
+    friend class Lowering;
+    friend class StmtChecker;
+
   protected:
     List<Expr*> *args;
     
   public:
-    void Check();
     PrintStmt(List<Expr*> *arguments);
 };
 
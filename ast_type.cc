@@ -6,6 +6,7 @@
 #include "ast_decl.h"
 #include "errors.h"
 #include <string.h>
+#include <mutex>
 
  
 /* Class constants
@@ -24,9 +25,35 @@ Type *Type::nullType   = new Type("null");
 Type *Type::stringType = new Type("string");
 Type *Type::errorType  = new Type("error"); 
 
+/* The canonical types are shared by all the files being compiled, this
+ * guards creating them and the permanent arena they are created in.
+ */
+static std::mutex canonicalLock;
+
 Type::Type(const char *n) {
+    kind = Kind_Type;
     Assert(n);
-    typeName = strdup(n);
+    typeName = Arena::Current()->StrDup(n);
+    canonical = this;
+    arrayOf = NULL;
+}
+
+/* Type::GetArrayOf
+ * ----------------
+ * Returns the canonical array of this canonical type, creating it in the
+ * permanent arena the first time it is asked for.
+ */
+Type *Type::GetArrayOf()
+{
+    Assert(IsCanonical());
+    std::lock_guard<std::mutex> guard(canonicalLock);
+    if (arrayOf == NULL) {
+        Arena *saved = Arena::Current();
+        Arena::SetCurrent(Arena::Permanent());
+        arrayOf = new ArrayType(this);
+        Arena::SetCurrent(saved);
+    }
+    return arrayOf;
 }
 void Type::Check()
 {
@@ -34,23 +61,73 @@ void Type::Check()
 }
 
 
-NamedType::NamedType(Identifier *i) : Type(*i->GetLocation()) {
+NamedType::NamedType(Identifier *i) : Type(i->GetLocation()) {
+    kind = Kind_NamedType;
     Assert(i != NULL);
     (id=i)->SetParent(this);
+    canonical = Canonical(i->symbol);
 }
+
+NamedType::NamedType(Symbol name) : Type(NoSpan()) {
+    kind = Kind_NamedType;
+    (id=new Identifier(NoSpan(), name))->SetParent(this);
+    canonical = this;
+}
+
+/* NamedType::Canonical
+ * --------------------
+ * Returns the one canonical NamedType for name. These are kept in a
+ * table keyed by the name's symbol in the permanent arena.
+ */
+NamedType *NamedType::Canonical(Symbol name)
+{
+    static Hashtable<NamedType*> *table = NULL;
+    std::lock_guard<std::mutex> guard(canonicalLock);
+    Arena *saved = Arena::Current();
+    Arena::SetCurrent(Arena::Permanent());
+    if (table == NULL)
+        table = new Hashtable<NamedType*>;
+    NamedType *type = table->Lookup(name);
+    if (type == NULL)
+        table->Enter(name, type = new NamedType(name));
+    Arena::SetCurrent(saved);
+    return type;
+}
+/* NamedType::Check
+ * ----------------
+ * Classes and interfaces can only be declared at the top level, so the
+ * name is only looked for among the globals, and only a class or an
+ * interface will do. Nothing declared inside a class or function can hide
+ * a type name.
+ */
 void NamedType::Check()
 {
-    Decl* typeDeclare = this->FindDecl(this->id->name);
+    Decl* typeDeclare = this->GetScope()->LookupGlobal(this->id->symbol);
 
-    if (typeDeclare == NULL)
+    if (DynCast<ClassDecl>(typeDeclare) == NULL && DynCast<InterfaceDecl>(typeDeclare) == NULL)
     {
         ReportError::IdentifierNotDeclared(this->id, LookingForType);
     }
 }
 
 ArrayType::ArrayType(yyltype loc, Type *et) : Type(loc) {
+    kind = Kind_ArrayType;
     Assert(et != NULL);
     (elemType=et)->SetParent(this);
+    canonical = et->GetCanonical()->GetArrayOf();
+}
+
+ArrayType::ArrayType(Type *et) : Type(NoSpan()) {
+    kind = Kind_ArrayType;
+    elemType = et;
+    canonical = this;
+}
+
+Type *ArrayType::Of(yyltype loc, Type *et)
+{
+    if (et->IsCanonical())
+        return et->GetArrayOf();
+    return new ArrayType(loc, et);
 }
 void ArrayType::Check()
 {
@@ -7,6 +7,16 @@
  *
  * pp3: You will need to extend the Type classes to implement
  * the type system and rules for type equivalency and compatibility.
+ *
+ * Every distinct type has exactly one canonical Type object: the
+ * built-in constants below, one NamedType per name and one ArrayType
+ * per element type. The NamedType and ArrayType nodes made by the parser
+ * for each place a type is written just record where it was written and
+ * point at their canonical type, so two types are equivalent exactly
+ * when their canonical pointers are the same. Arrays of canonical types
+ * (e.g. int[][]) need no location of their own to report errors
+ * against, so the parser uses the canonical object for them directly.
+ * Canonical types live in the permanent arena.
  */
  
 #ifndef _H_ast_type
@@ -19,57 +29,58 @@
 
 class Type : public Node 
 {
+  protected:
+    Type *canonical;     // the one shared object for this type
+    Type *arrayOf;       // canonical array of this type, made on demand
 
   public:
     char *typeName;
     static Type *intType, *doubleType, *boolType, *voidType,
                 *nullType, *stringType, *errorType;
 
-    Type(yyltype loc) : Node(loc) {}
+    Type(yyltype loc) : Node(loc) { kind = Kind_Type; canonical = arrayOf = NULL; }
+    Type(SourceSpan loc) : Node(loc) { kind = Kind_Type; canonical = arrayOf = NULL; }
     Type(const char *str);
     virtual void Check();
     virtual void PrintToStream(std::ostream& out) { out << typeName; }
     friend std::ostream& operator<<(std::ostream& out, Type *t) { t->PrintToStream(out); return out; }
-    virtual bool IsEquivalentTo(Type *other) { return this == other; }
+    Type *GetCanonical() { return canonical; }
+    bool IsCanonical() { return canonical == this; }
+    bool IsEquivalentTo(Type *other) { return canonical == other->canonical; }
+    Type *GetArrayOf();
+
+           // Canonical types are shared by every tree being compiled, so
+           // none of them gets to be any one node's child
+    void SetParent(Node *p) { if (!IsCanonical()) Node::SetParent(p); }
 };
 
 class NamedType : public Type 
 {
     
+    NamedType(Symbol name); // makes the canonical type for name
+
   public:
     Identifier *id;
     NamedType(Identifier *i);
     void Check();
     void PrintToStream(std::ostream& out) { out << id; }
-    bool IsEquivalentTo(Type *other)
-    {
-      NamedType* n = dynamic_cast<NamedType*>(other);
-      if (n == NULL)
-        return false;
-
-      if (strcmp(n->id->name, this->id->name) == 0)
-      {
-        return true;
-      }
-      return false;
-    }
+    static NamedType *Canonical(Symbol name);
 };
 
 class ArrayType : public Type 
 {
+    friend class Type;
+    ArrayType(Type *elemType); // makes the canonical array of elemType
+
   public:
     Type *elemType;
     ArrayType(yyltype loc, Type *elemType);
     void Check();
     void PrintToStream(std::ostream& out) { out << elemType << "[]"; }
-    bool IsEquivalentTo(Type *other) 
-    {
-      ArrayType *o = dynamic_cast<ArrayType*>(other);
-      if (o == NULL)
-        return false;
 
-      return this->elemType->IsEquivalentTo(o->elemType);
-    }
+           // Returns the type for an array of elemType written at loc,
+           // which is the canonical array type if elemType is canonical
+    static Type *Of(yyltype loc, Type *elemType);
 };
 
  
@@ -0,0 +1,56 @@
+/* File: ast_visitor.h
+ * -------------------
+ * NodeVisitor is the base for passes over the tree that dispatch on the
+ * class of each node. Visit switches on the node's kind tag to call the
+ * VisitX method for its class, so no virtual call or RTTI is involved.
+ * A pass derives from NodeVisitor<ThePass, ResultType> and defines
+ * VisitX only for the classes it cares about. The default for each class
+ * calls the one for its superclass, ending at VisitNode, which does
+ * nothing and returns a default-constructed result. The switch and the
+ * defaults are both generated from the table in ast_kinds.h.
+ *
+ * The visitor only dispatches, it doesn't descend into a node's children
+ * on its own: each VisitX decides which children to Visit, and when.
+ *
+ *       class CountCalls : public NodeVisitor<CountCalls, int>
+ *       {
+ *         public:
+ *           int VisitCall(Call *c) { return 1 + ...; }
+ *       };
+ */
+
+#ifndef _H_ast_visitor
+#define _H_ast_visitor
+
+#include "ast.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_stmt.h"
+#include "ast_type.h"
+
+template <class Pass, class Result = void> class NodeVisitor
+{
+  public:
+    Result Visit(Node *n)
+    {
+        Pass *pass = static_cast<Pass*>(this);
+        switch (n->GetKind()) {
+#define AST_VISIT_CASE(cls, super) \
+          case Kind_##cls: return pass->Visit##cls(static_cast<cls*>(n));
+            AST_NODE_TABLE(AST_VISIT_CASE, AST_IGNORE, AST_VISIT_CASE, AST_IGNORE)
+#undef AST_VISIT_CASE
+          default:
+            Failure("Visiting node with unknown kind %d", n->GetKind());
+            return Result();
+        }
+    }
+
+    Result VisitNode(Node *) { return Result(); }
+
+#define AST_VISIT_DEFAULT(cls, super) \
+    Result Visit##cls(cls *n) { return static_cast<Pass*>(this)->Visit##super(n); }
+    AST_NODE_TABLE(AST_VISIT_DEFAULT, AST_VISIT_DEFAULT, AST_IGNORE, AST_IGNORE)
+#undef AST_VISIT_DEFAULT
+};
+
+#endif
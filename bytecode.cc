@@ -0,0 +1,472 @@
+/* File: bytecode.cc
+ * -----------------
+ * Implementation of the BytecodeProgram and its compiler.
+ */
+
+#include "bytecode.h"
+#include "utility.h"
+
+#define BC_OPCODE_INFO(name, text, n) { text, n },
+const BcOpcodeInfo BcOpcodes[NumBcOpcodes] = {
+    BC_OPCODE_TABLE(BC_OPCODE_INFO)
+};
+#undef BC_OPCODE_INFO
+
+  // For each of Lt, Le, Eq and Ne, the jump taken when the comparison
+  // holds and the one taken when it doesn't, then the same two with the
+  // operands the other way around. Those taking an immediate come the
+  // same distance after each of these in the table.
+static const BcOpcode CompareJumps[4][4] = {
+    { BcJumpLt, BcJumpGe, BcJumpGt, BcJumpLe },
+    { BcJumpLe, BcJumpGt, BcJumpGe, BcJumpLt },
+    { BcJumpEq, BcJumpNe, BcJumpEq, BcJumpNe },
+    { BcJumpNe, BcJumpEq, BcJumpNe, BcJumpEq },
+};
+static const int ImmediateJump = BcJumpLtI - BcJumpLt;
+
+
+BytecodeCompiler::BytecodeCompiler(IRProgram *i, BytecodeProgram *p)
+{
+    this->ir = i;
+    this->program = p;
+    this->fn = NULL;
+    this->code = NULL;
+}
+
+/* BytecodeCompiler::Compile
+ * -------------------------
+ * The pool has the program's doubles and then its strings, each where
+ * the IR numbers it, so a constant's index in the pool is known without
+ * a table.
+ */
+BytecodeProgram *BytecodeCompiler::Compile(IRProgram *ir)
+{
+    BytecodeProgram *program = new BytecodeProgram;
+    program->numGlobals = ir->NumGlobals();
+    program->main = ir->GetMain();
+    for (int n = 0; n < ir->NumStrings(); n++)
+        program->strings.push_back(ir->GetString(n));
+    for (int n = 0; n < ir->NumDoubles(); n++) {
+        Value v;
+        v.d = ir->GetDouble(n);
+        program->pool.push_back(v);
+    }
+    for (int n = 0; n < ir->NumStrings(); n++) {
+        Value v;
+        v.s = program->strings[n].c_str();
+        program->pool.push_back(v);
+    }
+    if (program->pool.empty())
+        program->pool.resize(1);       // so there's something to point at
+
+    for (int n = 0; n < ir->NumClasses(); n++) {
+        IRClass *cls = ir->GetClass(n);
+        BytecodeClass compiled;
+        compiled.numWords = cls->objectSize / 8;
+        compiled.methods = cls->methods;
+        compiled.interfaceMethods = cls->interfaceMethods;
+        program->classes.push_back(compiled);
+    }
+
+    BytecodeCompiler compiler(ir, program);
+    program->functions.resize(ir->NumFunctions());
+    for (int n = 0; n < ir->NumFunctions(); n++)
+        compiler.CompileFunction(n);
+    return program;
+}
+
+/* BytecodeCompiler::CompileFunction
+ * ---------------------------------
+ * Instructions are compiled in the order they're laid out in, and the
+ * jumps patched at the end, once where each block starts is known.
+ */
+void BytecodeCompiler::CompileFunction(int n)
+{
+    this->fn = this->ir->GetFunction(n);
+    BytecodeFunction *compiled = &this->program->functions[n];
+    compiled->name = this->fn->GetName();
+    compiled->numParams = this->fn->NumParams();
+    compiled->numRegs = this->fn->NumRegs();
+    if (!this->fn->HasCode())
+        return;
+    this->code = &compiled->code;
+    this->blockAt.assign(this->fn->NumInstrs(), IRNone);
+    for (IRBlock b = 0; b < (IRBlock)this->fn->NumBlocks(); b++) {
+        if (this->fn->BlockStart(b) != IRNone)
+            this->blockAt[this->fn->BlockStart(b)] = b;
+    }
+    this->blockOffset.assign(this->fn->NumBlocks(), 0);
+    this->jumps.clear();
+    this->FindConstants();
+
+    for (IRInstr i = 0; i < (IRInstr)this->fn->NumInstrs(); i++) {
+        if (this->blockAt[i] != IRNone)
+            this->blockOffset[this->blockAt[i]] = this->code->size();
+        if (this->Fuses(i)) {
+            IRInstr next = this->Next(i);
+            for (IRInstr j = i + 1; j < next; j++)
+                this->CompileInstr(j);      // constants, loaded early if at all
+            this->CompileFused(i);
+            i = next;
+        } else {
+            this->CompileInstr(i);
+        }
+    }
+    for (size_t j = 0; j < this->jumps.size(); j++)
+        (*this->code)[this->jumps[j].first] = this->blockOffset[this->jumps[j].second];
+}
+
+/* BytecodeCompiler::FindConstants
+ * -------------------------------
+ * A register written only once, with an int constant, is a constant. It
+ * is only loaded into its register if something reads it that can't take
+ * it as an immediate.
+ */
+void BytecodeCompiler::FindConstants()
+{
+    int numRegs = this->fn->NumRegs();
+    std::vector<int> numWrites(numRegs, 0);
+    this->numReads.assign(numRegs, 0);
+    this->definition.assign(numRegs, IRNone);
+    std::vector<IRReg> reads;
+    for (IRInstr i = 0; i < (IRInstr)this->fn->NumInstrs(); i++) {
+        IRReg dest = this->fn->GetDest(i);
+        if (dest != IRNone) {
+            numWrites[dest]++;
+            this->definition[dest] = i;
+        }
+        reads.clear();
+        this->fn->GetReads(i, &reads);
+        for (size_t j = 0; j < reads.size(); j++)
+            this->numReads[reads[j]]++;
+    }
+    this->constant.assign(numRegs, false);
+    for (IRReg r = this->fn->NumParams(); r < (IRReg)numRegs; r++)
+        this->constant[r] = (numWrites[r] == 1 && this->fn->GetOp(this->definition[r]) == OpConst &&
+                             this->fn->GetRegKind(r) == IRInt);
+
+    this->needed.assign(numRegs, false);
+    for (IRInstr i = 0; i < (IRInstr)this->fn->NumInstrs(); i++) {
+        IROpcode op = this->fn->GetOp(i);
+        int immediate = this->ImmediateOperand(i);
+        uint32_t values[3] = { this->fn->GetA(i), this->fn->GetB(i), this->fn->GetC(i) };
+        for (int j = 0; j < 3; j++) {
+            if (IROpcodes[op].operands[j] == OperandReg && values[j] != IRNone && j != immediate)
+                this->needed[values[j]] = true;
+        }
+        if (IROpcodes[op].operands[1] == OperandArgs) {
+            for (uint32_t k = 0; k < this->fn->GetC(i); k++)
+                this->needed[this->fn->GetArg(i, k)] = true;
+        }
+    }
+}
+
+/* BytecodeCompiler::Next
+ * ----------------------
+ * The instruction after i in its block, past any that write constants
+ * (which can as well be loaded before i, if they are at all), or its
+ * block's end if there's none.
+ */
+IRInstr BytecodeCompiler::Next(IRInstr i)
+{
+    IRInstr next = i + 1;
+    while (next < (IRInstr)this->fn->NumInstrs() && this->blockAt[next] == IRNone &&
+           this->fn->GetOp(next) == OpConst && this->constant[this->fn->GetDest(next)])
+        next++;
+    return next;
+}
+
+/* BytecodeCompiler::Fuses
+ * -----------------------
+ * Whether instruction i and the next (see above) are done by one
+ * superinstruction: an int comparison whose result only the branch
+ * after it tests, or a load of a field that only the add after it
+ * reads. Neither result is ever put in its register.
+ */
+bool BytecodeCompiler::Fuses(IRInstr i)
+{
+    IRInstr next = this->Next(i);
+    if (next >= (IRInstr)this->fn->NumInstrs() || this->blockAt[next] != IRNone)
+        return false;
+    IROpcode op = this->fn->GetOp(i), nextOp = this->fn->GetOp(next);
+    IRReg dest = this->fn->GetDest(i);
+    if (dest == IRNone || this->numReads[dest] != 1)
+        return false;
+    if (op == OpLt || op == OpLe || op == OpEq || op == OpNe)
+        return (nextOp == OpBranch && this->fn->GetA(next) == dest && this->fn->GetRegKind(this->fn->GetA(i)) == IRInt);
+    if (op == OpLoadField)
+        return (nextOp == OpAdd && (this->fn->GetA(next) == dest || this->fn->GetB(next) == dest));
+    return false;
+}
+
+/* BytecodeCompiler::ImmediateOperand
+ * ----------------------------------
+ * Which operand of instruction i, 0 or 1, is a constant it takes as an
+ * immediate, or -1 if none is. An add, a multiply and a comparison that
+ * is fused with its branch take either (the last as the comparison the
+ * other way around), a subtract only its second.
+ */
+int BytecodeCompiler::ImmediateOperand(IRInstr i)
+{
+    IROpcode op = this->fn->GetOp(i);
+    IRReg a = this->fn->GetA(i), b = this->fn->GetB(i);
+    switch (op) {
+      case OpLt: case OpLe: case OpEq: case OpNe:
+        if (!this->Fuses(i))
+            return -1;
+        // fall through
+      case OpAdd: case OpMul:
+        return (this->constant[b] ? 1 : this->constant[a] ? 0 : -1);
+      case OpSub:
+        return (this->constant[b] ? 1 : -1);
+      default:
+        return -1;
+    }
+}
+
+void BytecodeCompiler::PutJump(IRBlock b)
+{
+    this->jumps.push_back(std::make_pair(this->code->size(), b));
+    this->Put(0);
+}
+
+/* BytecodeCompiler::Jump
+ * ----------------------
+ * Jumps to b, unless b is laid out right after instruction after.
+ */
+void BytecodeCompiler::Jump(IRBlock b, IRInstr after)
+{
+    if (after + 1 < (IRInstr)this->fn->NumInstrs() && this->blockAt[after + 1] == b)
+        return;
+    this->Put(BcJump);
+    this->PutJump(b);
+}
+
+/* BytecodeCompiler::CompileBranch
+ * -------------------------------
+ * Compiles the branch at instruction branch as a jump with the operands
+ * given that goes to its first block, falling through to the second if
+ * that's next, or else as the inverse going to the second.
+ */
+void BytecodeCompiler::CompileBranch(BcOpcode jump, BcOpcode inverse, const std::vector<uint32_t> &operands, IRInstr branch)
+{
+    IRBlock taken = this->fn->GetB(branch), notTaken = this->fn->GetC(branch);
+    bool takenNext = (branch + 1 < (IRInstr)this->fn->NumInstrs() && this->blockAt[branch + 1] == taken);
+    this->Put(takenNext ? inverse : jump);
+    for (size_t j = 0; j < operands.size(); j++)
+        this->Put(operands[j]);
+    this->PutJump(takenNext ? notTaken : taken);
+    if (!takenNext)
+        this->Jump(notTaken, branch);
+}
+
+void BytecodeCompiler::CompileFused(IRInstr i)
+{
+    IROpcode op = this->fn->GetOp(i);
+    IRReg a = this->fn->GetA(i), b = this->fn->GetB(i);
+    IRInstr next = this->Next(i);
+    if (op == OpLoadField) {
+        IRInstr add = next;
+        IRReg other = (this->fn->GetA(add) == this->fn->GetDest(i) ? this->fn->GetB(add) : this->fn->GetA(add));
+        bool immediate = this->constant[other];
+        this->Put(immediate ? BcLoadFieldAddI : BcLoadFieldAdd);
+        this->Put(this->fn->GetDest(add));
+        this->Put(a);
+        this->Put(b / 8);
+        this->Put(immediate ? (uint32_t)this->Immediate(other) : other);
+        return;
+    }
+
+    const BcOpcode *jumps = CompareJumps[op == OpLt ? 0 : op == OpLe ? 1 : op == OpEq ? 2 : 3];
+    std::vector<uint32_t> operands;
+    switch (this->ImmediateOperand(i)) {
+      case 1:
+        operands.push_back(a);
+        operands.push_back(this->Immediate(b));
+        this->CompileBranch((BcOpcode)(jumps[0] + ImmediateJump), (BcOpcode)(jumps[1] + ImmediateJump), operands, next);
+        break;
+      case 0:
+        operands.push_back(b);
+        operands.push_back(this->Immediate(a));
+        this->CompileBranch((BcOpcode)(jumps[2] + ImmediateJump), (BcOpcode)(jumps[3] + ImmediateJump), operands, next);
+        break;
+      default:
+        operands.push_back(a);
+        operands.push_back(b);
+        this->CompileBranch(jumps[0], jumps[1], operands, next);
+        break;
+    }
+}
+
+/* BytecodeCompiler::CompileInstr
+ * ------------------------------
+ * Most instructions have one just like them, with their result first.
+ * A field's offset becomes the index of its word in the object, and an
+ * interface call's selector its color.
+ */
+void BytecodeCompiler::CompileInstr(IRInstr i)
+{
+    IROpcode op = this->fn->GetOp(i);
+    IRReg dest = this->fn->GetDest(i), a = this->fn->GetA(i), b = this->fn->GetB(i), c = this->fn->GetC(i);
+    BcOpcode simple;
+
+    switch (op) {
+      case OpConst:
+        if (this->constant[dest] && !this->needed[dest])
+            return;
+        this->Put(BcLoadInt);
+        this->Put(dest);
+        this->Put(a);
+        return;
+      case OpDConst:
+        this->Put(BcLoadConst);
+        this->Put(dest);
+        this->Put(a);
+        return;
+      case OpSConst:
+        this->Put(BcLoadConst);
+        this->Put(dest);
+        this->Put(this->ir->NumDoubles() + a);
+        return;
+
+      case OpAdd: case OpSub: case OpMul: {
+        int immediate = this->ImmediateOperand(i);
+        if (immediate < 0) {
+            simple = (op == OpAdd ? BcAdd : op == OpSub ? BcSub : BcMul);
+            break;
+        }
+        this->Put(op == OpAdd ? BcAddI : op == OpSub ? BcSubI : BcMulI);
+        this->Put(dest);
+        this->Put(immediate == 1 ? a : b);
+        this->Put(this->Immediate(immediate == 1 ? b : a));
+        return;
+      }
+      case OpEq: case OpNe:
+        if (this->fn->GetRegKind(a) == IRRef)
+            simple = (op == OpEq ? BcRefEq : BcRefNe);
+        else
+            simple = (op == OpEq ? BcEq : BcNe);
+        break;
+
+      case OpMove:   simple = BcMove;   break;
+      case OpDiv:    simple = BcDiv;    break;
+      case OpMod:    simple = BcMod;    break;
+      case OpNeg:    simple = BcNeg;    break;
+      case OpDAdd:   simple = BcDAdd;   break;
+      case OpDSub:   simple = BcDSub;   break;
+      case OpDMul:   simple = BcDMul;   break;
+      case OpDDiv:   simple = BcDDiv;   break;
+      case OpDNeg:   simple = BcDNeg;   break;
+      case OpLt:     simple = BcLt;     break;
+      case OpLe:     simple = BcLe;     break;
+      case OpDLt:    simple = BcDLt;    break;
+      case OpDLe:    simple = BcDLe;    break;
+      case OpDEq:    simple = BcDEq;    break;
+      case OpDNe:    simple = BcDNe;    break;
+      case OpSEq:    simple = BcSEq;    break;
+      case OpAnd:    simple = BcAnd;    break;
+      case OpOr:     simple = BcOr;     break;
+      case OpNot:    simple = BcNot;    break;
+      case OpLoadElem:   simple = BcLoadElem;   break;
+      case OpLength:     simple = BcLength;     break;
+      case OpLoadGlobal: simple = BcLoadGlobal; break;
+      case OpNew:        simple = BcNew;        break;
+      case OpNewArray:   simple = BcNewArray;   break;
+      case OpReadInteger: simple = BcReadInteger; break;
+      case OpReadLine:   simple = BcReadLine;   break;
+
+      case OpLoadField:
+        this->Put(BcLoadField);
+        this->Put(dest);
+        this->Put(a);
+        this->Put(b / 8);
+        return;
+      case OpStoreField:
+        this->Put(BcStoreField);
+        this->Put(a);
+        this->Put(b / 8);
+        this->Put(c);
+        return;
+      case OpStoreElem:
+        this->Put(BcStoreElem);
+        this->Put(a);
+        this->Put(b);
+        this->Put(c);
+        return;
+      case OpStoreGlobal:
+        this->Put(BcStoreGlobal);
+        this->Put(a);
+        this->Put(b);
+        return;
+      case OpPrintInt: case OpPrintBool: case OpPrintString:
+        this->Put(op == OpPrintInt ? BcPrintInt : op == OpPrintBool ? BcPrintBool : BcPrintString);
+        this->Put(a);
+        return;
+
+      case OpCall: case OpCallVirtual: case OpCallInterface:
+        this->Put(op == OpCall ? BcCall : op == OpCallVirtual ? BcCallVirtual : BcCallInterface);
+        this->Put(dest);
+        this->Put(op == OpCallInterface ? this->ir->GetSelectorColor(a) : a);
+        this->Put(c);
+        for (uint32_t k = 0; k < c; k++)
+            this->Put(this->fn->GetArg(i, k));
+        return;
+
+      case OpJump:
+        this->Jump(a, i);
+        return;
+      case OpBranch:
+        this->CompileBranch(BcJumpIfTrue, BcJumpIfFalse, std::vector<uint32_t>(1, a), i);
+        return;
+      case OpReturn:
+        if (a == IRNone) {
+            this->Put(BcReturnVoid);
+        } else {
+            this->Put(BcReturn);
+            this->Put(a);
+        }
+        return;
+      default:
+        return;
+    }
+
+    this->Put(simple);
+    this->Put(dest);
+    for (int j = 0; j < 2; j++) {
+        if (IROpcodes[op].operands[j] != OperandNone)
+            this->Put(j == 0 ? a : b);
+    }
+}
+
+/* BytecodeProgram::Print
+ * ----------------------
+ * Each instruction is printed with where it is in its function's code
+ * and its operands as numbers, a call's arguments with them.
+ */
+void BytecodeProgram::Print()
+{
+    if (!IsDebugOn("bytecode"))
+        return;
+    for (size_t n = 0; n < this->functions.size(); n++) {
+        BytecodeFunction *fn = &this->functions[n];
+        if (fn->code.empty())
+            continue;
+        PrintDebug("bytecode", "function %s, %d params, %d registers, %d words", fn->name.c_str(),
+                   fn->numParams, fn->numRegs, (int)fn->code.size());
+        for (size_t pc = 0; pc < fn->code.size(); ) {
+            BcOpcode op = (BcOpcode)fn->code[pc];
+            int length = 1 + BcOpcodes[op].numOperands;
+            if (op == BcCall || op == BcCallVirtual || op == BcCallInterface)
+                length += fn->code[pc + 3];
+            char line[64];
+            snprintf(line, sizeof(line), "  %5d  %-14s", (int)pc, BcOpcodes[op].name);
+            std::string text = line;
+            for (int j = 1; j < length; j++) {
+                snprintf(line, sizeof(line), "%s%d", (j > 1 ? ", " : " "), (int)fn->code[pc + j]);
+                text += line;
+            }
+            PrintDebug("bytecode", "%.2000s", text.c_str());
+            pc += length;
+        }
+    }
+}
@@ -0,0 +1,219 @@
+/* File: bytecode.h
+ * ----------------
+ * The bytecode that dcc --run compiles a program's IR (see ir.h) to, for
+ * the virtual machine in vm.h to run. It is register-based like the IR:
+ * each function has a frame of registers, numbered as in its IR, and
+ * each instruction names the registers it reads and writes, so there is
+ * none of the pushing and popping of a stack machine.
+ *
+ * Each function has one instruction stream of its own, a run of 32-bit
+ * words where an instruction is its opcode followed by its operands, as
+ * many as the table below gives it (a call also has its arguments after
+ * them). A jump's operand is the index in the stream it goes to. Blocks
+ * are laid out as they are in the IR, so a branch only jumps when it has
+ * to, and falls through otherwise.
+ *
+ * The doubles and strings of the program are in its constant pool. An
+ * int constant is put in the instructions that read it, where they have
+ * a form that takes an immediate, and only loaded into its register if
+ * one of them doesn't. A few common runs of instructions are done by one
+ * superinstruction: a comparison followed by the branch on its result,
+ * and a load of a field followed by an add of the value loaded.
+ */
+
+#ifndef _H_bytecode
+#define _H_bytecode
+
+#include "ir.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/* Type: Value
+ * -----------
+ * What a register, a field, an element or a global holds.
+ */
+union Value
+{
+    int32_t i;                       // an int or a bool
+    double d;
+    void *p;                         // an object or array, or null
+    const char *s;
+};
+
+#define BC_OPCODE_TABLE(OP)                                     \
+    OP(Move,          "move",          2)  /* d, a */           \
+    OP(LoadInt,       "loadint",       2)  /* d, imm */         \
+    OP(LoadConst,     "loadconst",     2)  /* d, pool index */  \
+    OP(Add,           "add",           3)  /* d, a, b */        \
+    OP(Sub,           "sub",           3)                       \
+    OP(Mul,           "mul",           3)                       \
+    OP(Div,           "div",           3)                       \
+    OP(Mod,           "mod",           3)                       \
+    OP(AddI,          "addi",          3)  /* d, a, imm */      \
+    OP(SubI,          "subi",          3)                       \
+    OP(MulI,          "muli",          3)                       \
+    OP(Neg,           "neg",           2)                       \
+    OP(DAdd,          "dadd",          3)                       \
+    OP(DSub,          "dsub",          3)                       \
+    OP(DMul,          "dmul",          3)                       \
+    OP(DDiv,          "ddiv",          3)                       \
+    OP(DNeg,          "dneg",          2)                       \
+    OP(Lt,            "lt",            3)                       \
+    OP(Le,            "le",            3)                       \
+    OP(Eq,            "eq",            3)                       \
+    OP(Ne,            "ne",            3)                       \
+    OP(RefEq,         "refeq",         3)                       \
+    OP(RefNe,         "refne",         3)                       \
+    OP(DLt,           "dlt",           3)                       \
+    OP(DLe,           "dle",           3)                       \
+    OP(DEq,           "deq",           3)                       \
+    OP(DNe,           "dne",           3)                       \
+    OP(SEq,           "seq",           3)                       \
+    OP(And,           "and",           3)                       \
+    OP(Or,            "or",            3)                       \
+    OP(Not,           "not",           2)                       \
+    OP(LoadField,     "loadfield",     3)  /* d, obj, word */   \
+    OP(LoadFieldAdd,  "loadfieldadd",  4)  /* d, obj, word, b */   \
+    OP(LoadFieldAddI, "loadfieldaddi", 4)  /* d, obj, word, imm */ \
+    OP(StoreField,    "storefield",    3)  /* obj, word, a */   \
+    OP(LoadElem,      "loadelem",      3)  /* d, arr, index */  \
+    OP(StoreElem,     "storeelem",     3)  /* arr, index, a */  \
+    OP(Length,        "length",        2)                       \
+    OP(LoadGlobal,    "loadglobal",    2)  /* d, global */      \
+    OP(StoreGlobal,   "storeglobal",   2)  /* global, a */      \
+    OP(New,           "new",           2)  /* d, class */       \
+    OP(NewArray,      "newarray",      2)  /* d, length */      \
+    OP(Call,          "call",          3)  /* d, fn, count */   \
+    OP(CallVirtual,   "callvirtual",   3)  /* d, slot, count */ \
+    OP(CallInterface, "callinterface", 3)  /* d, color, count */ \
+    OP(PrintInt,      "printint",      1)                       \
+    OP(PrintBool,     "printbool",     1)                       \
+    OP(PrintString,   "printstring",   1)                       \
+    OP(ReadInteger,   "readinteger",   1)                       \
+    OP(ReadLine,      "readline",      1)                       \
+    OP(Jump,          "jump",          1)  /* target */         \
+    OP(JumpIfTrue,    "jumpiftrue",    2)  /* a, target */      \
+    OP(JumpIfFalse,   "jumpiffalse",   2)                       \
+    OP(JumpLt,        "jumplt",        3)  /* a, b, target */   \
+    OP(JumpLe,        "jumple",        3)                       \
+    OP(JumpGt,        "jumpgt",        3)                       \
+    OP(JumpGe,        "jumpge",        3)                       \
+    OP(JumpEq,        "jumpeq",        3)                       \
+    OP(JumpNe,        "jumpne",        3)                       \
+    OP(JumpLtI,       "jumplti",       3)  /* a, imm, target */ \
+    OP(JumpLeI,       "jumplei",       3)                       \
+    OP(JumpGtI,       "jumpgti",       3)                       \
+    OP(JumpGeI,       "jumpgei",       3)                       \
+    OP(JumpEqI,       "jumpeqi",       3)                       \
+    OP(JumpNeI,       "jumpnei",       3)                       \
+    OP(Return,        "return",        1)                       \
+    OP(ReturnVoid,    "returnvoid",    0)
+
+#define BC_OPCODE(name, text, n) Bc##name,
+typedef enum {
+    BC_OPCODE_TABLE(BC_OPCODE)
+    NumBcOpcodes
+} BcOpcode;
+#undef BC_OPCODE
+
+struct BcOpcodeInfo
+{
+    const char *name;
+    int numOperands;
+};
+
+extern const BcOpcodeInfo BcOpcodes[NumBcOpcodes];
+
+struct BytecodeFunction
+{
+    std::string name;
+    int numParams;
+    int numRegs;
+    std::vector<uint32_t> code;      // empty if it's defined in another module
+};
+
+           // A class's objects are a pointer to it, then a Value for
+           // each field
+struct BytecodeClass
+{
+    int numWords;
+    std::vector<uint32_t> methods;   // the functions, by slot
+    std::vector<uint32_t> interfaceMethods;   // by color (see ir.h), or IRNone
+};
+
+
+/* Class: BytecodeProgram
+ * ----------------------
+ * A program compiled to bytecode, with everything the VM needs to run it
+ * and nothing of the IR it was compiled from.
+ */
+class BytecodeProgram
+{
+  public:
+    static BytecodeProgram *Compile(IRProgram *ir);
+
+    int NumFunctions()                    { return functions.size(); }
+    BytecodeFunction *GetFunction(int n)  { return &functions[n]; }
+    BytecodeClass *GetClass(int n)        { return &classes[n]; }
+    const Value *GetPool()                { return &pool[0]; }
+    int NumGlobals()                      { return numGlobals; }
+    uint32_t GetMain()                    { return main; }
+
+           // Prints the code of each function through the "bytecode"
+           // debug key
+    void Print();
+
+  private:
+    std::vector<BytecodeFunction> functions;
+    std::vector<BytecodeClass> classes;
+    std::vector<Value> pool;           // the doubles, then the strings
+    std::vector<std::string> strings;  // that the pool points into
+    int numGlobals;
+    uint32_t main;
+
+    friend class BytecodeCompiler;
+    BytecodeProgram() {}
+};
+
+
+/* Class: BytecodeCompiler
+ * -----------------------
+ * Compiles the IR of a program to bytecode, one function at a time.
+ */
+class BytecodeCompiler
+{
+  public:
+    static BytecodeProgram *Compile(IRProgram *ir);
+
+  private:
+    IRProgram *ir;
+    BytecodeProgram *program;
+    IRFunction *fn;                  // being compiled
+    std::vector<uint32_t> *code;     // of fn
+    std::vector<IRBlock> blockAt;    // starting at each instruction, or IRNone
+    std::vector<uint32_t> blockOffset;             // in the code, of each block
+    std::vector<std::pair<size_t, IRBlock> > jumps; // to patch once they're known
+    std::vector<int> numReads;       // of each register
+    std::vector<bool> constant;      // registers only ever written an int constant
+    std::vector<IRInstr> definition; // of each register written once
+    std::vector<bool> needed;        // constants read somewhere not as an immediate
+
+    BytecodeCompiler(IRProgram *ir, BytecodeProgram *program);
+
+    void CompileFunction(int n);
+    void FindConstants();
+    int ImmediateOperand(IRInstr i);
+    IRInstr Next(IRInstr i);
+    bool Fuses(IRInstr i);
+    void CompileInstr(IRInstr i);
+    void CompileFused(IRInstr i);
+    void CompileBranch(BcOpcode jump, BcOpcode inverse, const std::vector<uint32_t> &operands, IRInstr branch);
+
+    int32_t Immediate(IRReg r)       { return (int32_t)this->fn->GetA(this->definition[r]); }
+    void Put(uint32_t word)          { this->code->push_back(word); }
+    void PutJump(IRBlock b);
+    void Jump(IRBlock b, IRInstr after);
+};
+
+#endif
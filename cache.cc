@@ -0,0 +1,193 @@
+/* File: cache.cc
+ * --------------
+ * Implementation of the CompileCache class.
+ */
+
+#include "cache.h"
+#include "utility.h"
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+  // Changes whenever the format of an entry does
+static const char *CacheFormat = "dcc-cache 1";
+
+  // Temporary files older than this were left by a dcc that died
+static const time_t StaleSeconds = 60*60;
+
+static bool ReadFully(int fd, char *buf, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = read(fd, buf, size);
+        if (n <= 0)
+            return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool WriteFully(int fd, const char *buf, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = write(fd, buf, size);
+        if (n <= 0)
+            return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+/* CompileCache::CompileCache
+ * --------------------------
+ * The executable is identified by its size and modification time, so
+ * rebuilding dcc starts over with a cache of its own.
+ */
+CompileCache::CompileCache(const char *d, size_t max)
+  : dir(d), maxBytes(max)
+{
+    mkdir(d, 0777);
+    struct stat info;
+    char buf[128];
+    if (stat("/proc/self/exe", &info) == 0)
+        snprintf(buf, sizeof(buf), "%s %lld %lld.%09ld", CacheFormat, (long long)info.st_size,
+                 (long long)info.st_mtim.tv_sec, info.st_mtim.tv_nsec);
+    else
+        snprintf(buf, sizeof(buf), "%s %s %s", CacheFormat, __DATE__, __TIME__);
+    identity = buf;
+}
+
+/* CompileCache::Key
+ * -----------------
+ * Two hashes (see utility.h) with different starting values give the
+ * 128 bits of a key.
+ */
+std::string CompileCache::Key(const char *text, size_t length, const std::string &flags)
+{
+    uint64_t h[2] = { HashStart, 0x84222325cbf29ce4ULL };
+    for (int i = 0; i < 2; i++) {
+        h[i] = Hash(identity.c_str(), identity.size() + 1, h[i]);
+        h[i] = Hash(flags.c_str(), flags.size() + 1, h[i]);
+        h[i] = MixHash(Hash(text, length, h[i]));
+    }
+    char key[33];
+    snprintf(key, sizeof(key), "%016llx%016llx", (unsigned long long)h[0], (unsigned long long)h[1]);
+    return key;
+}
+
+/* CompileCache::Lookup
+ * --------------------
+ * An entry is a header line "<errors> <errlen> <outlen>" after the format
+ * name, then the text of the errors and of the output. Anything that
+ * doesn't look like that is taken for a miss.
+ */
+bool CompileCache::Lookup(const std::string &key, CacheEntry *entry)
+{
+    std::string path = dir + "/" + key;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    std::string contents;
+    if (fstat(fd, &info) == 0) {
+        contents.resize(info.st_size);
+        if (!ReadFully(fd, &contents[0], contents.size()))
+            contents.clear();
+    }
+    close(fd);
+
+    size_t format = strlen(CacheFormat);
+    size_t end = contents.find('\n');
+    int numErrors;
+    unsigned long errLength, outLength;
+    if (end == std::string::npos || contents.compare(0, format, CacheFormat) != 0 ||
+        sscanf(contents.c_str() + format, " %d %lu %lu", &numErrors, &errLength, &outLength) != 3 ||
+        contents.size() != end + 1 + errLength + outLength)
+        return false;
+
+    entry->numErrors = numErrors;
+    entry->errors = contents.substr(end + 1, errLength);
+    entry->output = contents.substr(end + 1 + errLength);
+    utimensat(AT_FDCWD, path.c_str(), NULL, 0); // it's been used now
+    return true;
+}
+
+void CompileCache::Store(const std::string &key, const CacheEntry &entry)
+{
+    std::string temp = dir + "/tmp.XXXXXX";
+    int fd = mkstemp(&temp[0]);
+    if (fd < 0)
+        return;
+    char header[128];
+    int length = snprintf(header, sizeof(header), "%s %d %lu %lu\n", CacheFormat, entry.numErrors,
+                          (unsigned long)entry.errors.size(), (unsigned long)entry.output.size());
+    bool written = WriteFully(fd, header, length) &&
+                   WriteFully(fd, entry.errors.data(), entry.errors.size()) &&
+                   WriteFully(fd, entry.output.data(), entry.output.size());
+    if (close(fd) != 0 || !written || rename(temp.c_str(), (dir + "/" + key).c_str()) != 0) {
+        unlink(temp.c_str());
+        return;
+    }
+    Evict();
+}
+
+/* CompileCache::Evict
+ * -------------------
+ * Once the cache is over its limit, the entries used least recently are
+ * removed until it's down to three quarters of it, so that eviction
+ * doesn't happen again on the very next store. Another dcc may be
+ * evicting at the same time, so an entry that is already gone is no
+ * matter.
+ */
+void CompileCache::Evict()
+{
+    struct Entry {
+        struct timespec used;
+        size_t size;
+        std::string path;
+        bool operator<(const Entry &other) const {
+            return used.tv_sec != other.used.tv_sec ? used.tv_sec < other.used.tv_sec
+                                                    : used.tv_nsec < other.used.tv_nsec;
+        }
+    };
+    DIR *d = opendir(dir.c_str());
+    if (d == NULL)
+        return;
+    std::vector<Entry> entries;
+    size_t total = 0;
+    time_t now = time(NULL);
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        Entry entry;
+        entry.path = dir + "/" + e->d_name;
+        struct stat info;
+        if (e->d_name[0] == '.' || stat(entry.path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+            continue;
+        if (strncmp(e->d_name, "tmp.", 4) == 0) {
+            if (now - info.st_mtime > StaleSeconds)
+                unlink(entry.path.c_str());
+            continue;
+        }
+        entry.used = info.st_mtim;
+        entry.size = info.st_size;
+        total += entry.size;
+        entries.push_back(entry);
+    }
+    closedir(d);
+
+    if (total <= maxBytes)
+        return;
+    std::sort(entries.begin(), entries.end());
+    for (size_t i = 0; i < entries.size() && total > maxBytes / 4 * 3; i++) {
+        unlink(entries[i].path.c_str());
+        total -= entries[i].size;
+    }
+}
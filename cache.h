@@ -0,0 +1,60 @@
+/* File: cache.h
+ * -------------
+ * This file defines the CompileCache class, a cache on disk of what
+ * compiling a program printed, so that a program compiled before (by
+ * the same build of dcc, with the same flags) isn't compiled again. An
+ * entry is keyed by a hash of the source text together with the identity
+ * of the dcc executable and the flags that can change what is printed.
+ * It holds the errors reported, the debug output and the number of
+ * errors, which is what the exit status follows from.
+ *
+ * Each entry is a file in the cache directory named by its key, so any
+ * number of dcc processes can share a directory. An entry is written to
+ * a temporary file and renamed into place, so a reader sees all of it or
+ * none of it. A hit touches its entry, and when the entries take up more
+ * than the cache's limit the ones used least recently are removed.
+ */
+
+#ifndef _H_cache
+#define _H_cache
+
+#include <stddef.h>
+#include <string>
+
+struct CacheEntry
+{
+    int numErrors;
+    std::string errors;      // as printed on stderr
+    std::string output;      // debug output, as printed on stdout
+};
+
+class CompileCache
+{
+  public:
+    static const size_t DefaultMaxBytes = 256*1024*1024;
+
+           // A cache in the directory dir, which is created if need be,
+           // holding no more than maxBytes of entries
+    CompileCache(const char *dir, size_t maxBytes = DefaultMaxBytes);
+
+           // Returns the key for compiling text with flags, which are
+           // whatever else can change what the compilation prints
+    std::string Key(const char *text, size_t length, const std::string &flags);
+
+           // Fills in entry and returns true if there is one for key
+    bool Lookup(const std::string &key, CacheEntry *entry);
+
+           // Stores entry under key, replacing any there, then removes
+           // old entries if the cache has grown past its limit. A cache
+           // that can't be written to is simply not written to.
+    void Store(const std::string &key, const CacheEntry &entry);
+
+  private:
+    std::string dir;
+    size_t maxBytes;
+    std::string identity;    // of this dcc executable
+
+    void Evict();
+};
+
+#endif
@@ -0,0 +1,357 @@
+/* File: context.cc
+ * ----------------
+ * Implementation of the CompilationContext class.
+ */
+
+#include "context.h"
+#include "errors.h"
+#include "parser.h"
+#include "utility.h"
+#include "ast_stmt.h"
+#include "stream.h"
+#include "cache.h"
+#include "incremental.h"
+#include "snapshot.h"
+#include "hashtable.h"
+#include "lower.h"
+#include "optimize.h"
+#include "x86.h"
+#include "vm.h"
+#include <chrono>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+thread_local CompilationContext *CompilationContext::current = NULL;
+
+CompilationContext::CompilationContext(const char *name)
+  : filename(name), source(NULL), arena(&ownArena), program(NULL),
+    workPool(NULL), cache(NULL), savePath(NULL), outputPath(NULL),
+    running(false), runStatus(0), streaming(false), stream(NULL), incremental(NULL),
+    lowering(false), numErrors(0), numOrderedErrors(0), holdErrors(false), errorCopy(NULL),
+    firstSegment(NULL)
+{
+    arena->SetTrackNodes(IsDebugOn("arena"));
+}
+
+CompilationContext::CompilationContext(const char *name, const char *text, int length,
+                                       Arena *a)
+  : filename(name), source(new SourceFile(text, length)),
+    arena(a != NULL ? a : &ownArena), program(NULL),
+    workPool(NULL), cache(NULL), savePath(NULL), outputPath(NULL),
+    running(false), runStatus(0), streaming(false), stream(NULL), incremental(NULL),
+    lowering(false), numErrors(0), numOrderedErrors(0), holdErrors(false), errorCopy(NULL),
+    firstSegment(NULL)
+{
+    arena->SetTrackNodes(IsDebugOn("arena"));
+}
+
+CompilationContext::~CompilationContext()
+{
+    for (size_t i = 0; i < bodyArenas.size(); i++)
+        delete bodyArenas[i];
+    delete source;
+}
+
+/* CompilationContext::Compile
+ * ---------------------------
+ * The file is only opened here, so when files are compiled in parallel
+ * they are also read in parallel. Everything built along the way is
+ * allocated in the context's arena, which is released along with the
+ * context unless it belongs to the caller.
+ *
+ * With a cache, a program that has been compiled before isn't even
+ * scanned (see CompileCached).
+ */
+void CompilationContext::Compile()
+{
+    CompilationContext *savedContext = current;
+    Arena *savedArena = Arena::Current();
+    current = this;
+    Arena::SetCurrent(arena);
+
+    if (source == NULL) {
+        int fd = (filename != NULL ? open(filename, O_RDONLY) : STDIN_FILENO);
+        if (fd >= 0) {
+            source = new SourceFile(fd);
+            if (filename != NULL)
+                close(fd);
+        }
+    }
+    if (source == NULL) {
+        ReportError::Formatted(NULL, "Unable to open %s", filename);
+        arena->PrintStats();
+    } else if (!CheckImports()) {
+        arena->PrintStats();
+    } else if (cache != NULL) {
+        CompileCached();
+    } else {
+        ParseAndCheck();
+    }
+
+    Arena::SetCurrent(savedArena);
+    current = savedContext;
+}
+
+/* CompilationContext::ParseAndCheck
+ * ---------------------------------
+ * A program that doesn't parse isn't checked at all, so when streaming,
+ * whatever was checked before the parse failed is thrown away along with
+ * the errors it found. What is imported is in place before the parse
+ * starts, since streaming declares as it goes. A program that checks
+ * without errors is then lowered to IR (see lower.h) if that is wanted.
+ */
+void CompilationContext::ParseAndCheck()
+{
+    if (incremental != NULL) {
+        incremental->Compile(this);
+        arena->PrintStats();
+        return;
+    }
+    lowering = IsDebugOn("ir") || OptimizationLevel() >= 1 || outputPath != NULL || running;
+    program = new Program(new List<Decl*>);
+    for (size_t i = 0; i < imports.size(); i++)
+        program->Import(imports[i]->MakeDecls());
+    if (streaming)
+        stream = new DeclStream(program);
+    yyscan_t scanner = InitScanner(source);
+    InitParser();
+    yyparse(scanner, this);
+    FreeScanner(scanner);
+    Arena::SetCurrent(arena); // the parse may have stopped in a body
+    // if no errors, advance to next phase
+    if (numErrors == numOrderedErrors) {
+        if (stream != NULL)
+            stream->Finish();
+        else
+            program->Check();
+    } else {
+        ReportError::DiscardOrdered();
+    }
+    delete stream;
+    stream = NULL;
+    if (lowering && numErrors == 0)
+        Lower();
+    if (savePath != NULL && numErrors == 0 && !DeclSnapshot::Write(savePath, program, imports))
+        ReportError::Formatted(NULL, "Unable to write declarations to %s", savePath);
+    arena->PrintStats();
+}
+
+/* CompilationContext::Lower
+ * -------------------------
+ * The IR is optimized with -O1, then printed, then made into x86-64 code
+ * if there is somewhere to write it, and into bytecode and run if the
+ * program is to be run.
+ */
+void CompilationContext::Lower()
+{
+    IRProgram *ir = Lowering::Lower(program);
+    if (ir == NULL)
+        return;
+    if (OptimizationLevel() >= 1)
+        Optimizer::Optimize(ir);
+    ir->Print();
+    if (outputPath != NULL && !X86Generator::Generate(ir, outputPath))
+        ReportError::Formatted(NULL, "Unable to write code to %s", outputPath);
+    if (running)
+        Run(ir);
+    delete ir;
+}
+
+/* CompilationContext::Run
+ * -----------------------
+ * How long the bytecode took to compile and the program to run, which
+ * is most of the time it takes to start, is given with the "run" debug
+ * key.
+ */
+void CompilationContext::Run(IRProgram *ir)
+{
+    if (ir->GetMain() == IRNone) {
+        ReportError::Formatted(NULL, "There is no main function to run");
+        return;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BytecodeProgram *bytecode = BytecodeCompiler::Compile(ir);
+    std::chrono::steady_clock::time_point compiled = std::chrono::steady_clock::now();
+    bytecode->Print();
+    runStatus = VM::Run(bytecode);
+    std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+    PrintDebug("run", "Compiled to bytecode in %ld us, ran in %ld us",
+               (long)std::chrono::duration_cast<std::chrono::microseconds>(compiled - start).count(),
+               (long)std::chrono::duration_cast<std::chrono::microseconds>(finished - compiled).count());
+    delete bytecode;
+}
+
+/* CompilationContext::CompileCached
+ * ---------------------------------
+ * The key covers the debug keys, whose output is part of the entry,
+ * streaming, which changes what the arena reports, the optimization
+ * level, which changes what the IR printed looks like, and the snapshot
+ * imported, if any. The scanner's own trace goes straight to stderr
+ * where it can't be kept, a snapshot or code to be saved has to be made
+ * from the program, and a program to be run has to be run, so with any
+ * of those the cache is left alone.
+ */
+void CompilationContext::CompileCached()
+{
+    if (IsDebugOn("lex") || savePath != NULL || outputPath != NULL || running) {
+        ParseAndCheck();
+        return;
+    }
+    std::string flags = DebugKeyList() + (streaming ? " -s" : "");
+    if (OptimizationLevel() >= 1)
+        flags += " -O1";
+    for (size_t i = 0; i < imports.size(); i++) {
+        char hash[32];
+        snprintf(hash, sizeof(hash), " --use-decls %016llx", (unsigned long long)imports[i]->GetHash());
+        flags += hash;
+    }
+    std::string key = cache->Key(source->GetText(), source->GetLength(), flags);
+    CacheEntry entry;
+    if (cache->Lookup(key, &entry)) {
+        PrintDebugOutput(entry.output);
+        ReportError::Replay(entry.errors, entry.numErrors);
+        return;
+    }
+
+    errorCopy = &entry.errors;
+    CopyDebugOutput(&entry.output);
+    ParseAndCheck();
+    CopyDebugOutput(NULL);
+    errorCopy = NULL;
+    entry.numErrors = numErrors;
+    cache->Store(key, entry);
+}
+
+/* CompilationContext::CheckImports
+ * --------------------------------
+ * Reports why the snapshots imported can't be used together, if they
+ * can't, and returns whether they can: each must be readable, no module
+ * can be imported twice, each module a snapshot was compiled against
+ * must be imported too, in the same version, and no two modules can
+ * declare the same name.
+ */
+bool CompilationContext::CheckImports()
+{
+    int numErrorsBefore = numErrors;
+    for (size_t i = 0; i < imports.size(); i++) {
+        if (!imports[i]->IsValid()) {
+            ReportError::Formatted(NULL, "Unable to read declarations from %s", imports[i]->GetPath());
+            return false;
+        }
+    }
+    Hashtable<DeclSnapshot*> modules;
+    for (size_t i = 0; i < imports.size(); i++) {
+        const char *module = imports[i]->GetModule();
+        if (modules.Lookup(Intern(module)) != NULL)
+            ReportError::Formatted(NULL, "Module %s is imported more than once", module);
+        modules.Enter(Intern(module), imports[i]);
+    }
+    if (numErrors != numErrorsBefore)
+        return false;
+    for (size_t i = 0; i < imports.size(); i++) {
+        for (int j = 0; j < imports[i]->NumDependencies(); j++) {
+            const char *dep = imports[i]->GetDependency(j);
+            DeclSnapshot *found = modules.Lookup(Intern(dep));
+            if (found == NULL)
+                ReportError::Formatted(NULL, "Module %s uses module %s, which is not imported",
+                                       imports[i]->GetModule(), dep);
+            else if (found->GetHash() != imports[i]->GetDependencyHash(j))
+                ReportError::Formatted(NULL, "Module %s was compiled against another version of module %s",
+                                       imports[i]->GetModule(), dep);
+        }
+    }
+    Hashtable<DeclSnapshot*> declaredBy;
+    for (size_t i = 0; i < imports.size(); i++) {
+        for (int j = 0; j < imports[i]->NumDecls(); j++) {
+            Symbol name = imports[i]->GetDeclName(j);
+            DeclSnapshot *other = declaredBy.Lookup(name);
+            if (other != NULL && other != imports[i])
+                ReportError::Formatted(NULL, "Declaration of '%s' in module %s conflicts with declaration in module %s",
+                                       SymbolName(name), imports[i]->GetModule(), other->GetModule());
+            else
+                declaredBy.Enter(name, imports[i]);
+        }
+    }
+    return numErrors == numErrorsBefore;
+}
+
+/* CompilationContext::AddDecl
+ * ---------------------------
+ * With an incremental session, what is parsed belongs to the session
+ * rather than to the context.
+ */
+void CompilationContext::AddDecl(Decl *decl, SourceSpan span)
+{
+    if (incremental != NULL) {
+        incremental->AddDecl(decl, span);
+        return;
+    }
+    program->AddDecl(decl);
+    if (stream != NULL)
+        stream->Add(decl);
+}
+
+void CompilationContext::NoteTypeName(Symbol name)
+{
+    if (stream != NULL)
+        stream->NoteTypeName(name);
+    if (incremental != NULL)
+        incremental->NoteTypeName(name);
+}
+
+/* CompilationContext::StartBody
+ * -----------------------------
+ * Body arenas start out small, since most bodies are, and more than a
+ * few of them can be waiting to be checked at once. A program that is
+ * to be lowered needs its bodies after they are checked, so they go in
+ * the context's arena then.
+ */
+void CompilationContext::StartBody()
+{
+    if (stream == NULL || lowering)
+        return;
+    Arena *bodyArena;
+    {
+        std::lock_guard<std::mutex> guard(bodyArenaLock);
+        if (freeBodyArenas.empty()) {
+            bodyArena = new Arena(BodyArenaChunkSize);
+            bodyArenas.push_back(bodyArena);
+        } else {
+            bodyArena = freeBodyArenas.back();
+            freeBodyArenas.pop_back();
+        }
+    }
+    Arena::SetCurrent(bodyArena);
+}
+
+Arena *CompilationContext::FinishBody()
+{
+    if (stream == NULL || lowering)
+        return NULL;
+    Arena *bodyArena = Arena::Current();
+    Arena::SetCurrent(arena);
+    return bodyArena;
+}
+
+/* CompilationContext::ReleaseBody
+ * -------------------------------
+ * Bodies are checked on the workers too, so the free list is locked.
+ */
+void CompilationContext::ReleaseBody(Arena *bodyArena)
+{
+    bodyArena->Reset();
+    std::lock_guard<std::mutex> guard(bodyArenaLock);
+    freeBodyArenas.push_back(bodyArena);
+}
+
+CompilationContext *CompilationContext::Current()
+{
+    Assert(current != NULL);
+    return current;
+}
+
+void CompilationContext::SetCurrent(CompilationContext *context)
+{
+    current = context;
+}
@@ -0,0 +1,173 @@
+/* File: context.h
+ * ---------------
+ * This file defines the CompilationContext class, which holds everything
+ * that belongs to the compilation of one source file: its text, the
+ * arena its tree is built in, the errors reported against it and the
+ * program that was parsed. Several contexts can be compiled at once on
+ * different threads, nothing in one is shared with another.
+ *
+ * The context being compiled is kept per thread, in the same way as the
+ * current arena. Compile installs it while it works, and a thread that
+ * does part of a compilation for it (see BodyCheck in ast_decl.cc)
+ * installs it for as long as that part runs.
+ *
+ * This is also the interface for a program that embeds the compiler:
+ * make a context for each program, Compile it (from as many threads as
+ * you like) and look at its errors.
+ */
+
+#ifndef _H_context
+#define _H_context
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "arena.h"
+#include "source.h"
+#include "symbol.h"
+
+class Program;
+class Decl;
+class DeclStream;
+class WorkPool;
+class CompileCache;
+class DeclSnapshot;
+class IncrementalSession;
+class IRProgram;
+struct ErrorSegment;
+
+class CompilationContext
+{
+  public:
+           // A context to compile the named file, or standard input if
+           // the name is NULL. Nothing is read until Compile.
+    CompilationContext(const char *filename);
+
+           // A context to compile a program that is already in memory,
+           // for a tool that has dcc built in. The text is copied, the
+           // name is only for the tool's own use. If an arena is given,
+           // everything is built there rather than in an arena of the
+           // context's own, so the caller can recycle it (see server.cc).
+    CompilationContext(const char *name, const char *text, int length,
+                       Arena *arena = NULL);
+    ~CompilationContext();
+
+           // Parses the source and, if it parsed without errors, checks
+           // the program. With the "ir" debug key, -O1 or an output
+           // path, a program that checks without errors is also lowered
+           // (and optimized with -O1), its IR printed and its code
+           // generated.
+    void Compile();
+
+           // When errors are held, they are kept in the context rather
+           // than printed as they are reported, for whoever is running
+           // the compilation to print when it's done
+    void SetHoldErrors(bool hold) { holdErrors = hold; }
+    const std::string& GetHeldErrors() { return heldErrors; }
+
+           // With a pool of workers, function bodies are checked in
+           // parallel on it
+    void SetWorkPool(WorkPool *pool) { workPool = pool; }
+    WorkPool *GetWorkPool() { return workPool; }
+
+           // With a cache, the result of compiling a program is looked
+           // up there first, and stored there if it wasn't found
+    void SetCache(CompileCache *c) { cache = c; }
+
+           // The program is compiled against the declarations in each
+           // snapshot imported, see snapshot.h. Not for incremental
+           // compiles.
+    void AddImport(DeclSnapshot *snapshot) { imports.push_back(snapshot); }
+
+           // With a path to save to, the declarations of a program that
+           // compiles without errors are written there as a snapshot
+    void SetSavePath(const char *path) { savePath = path; }
+
+           // With an output path, the x86-64 code of a program that
+           // compiles without errors is written there, see x86.h
+    void SetOutputPath(const char *path) { outputPath = path; }
+
+           // When running, a program that compiles without errors is
+           // compiled to bytecode and run, see vm.h, and its exit status
+           // kept: 0, or 1 if it stopped with a runtime error
+    void SetRunning(bool run) { running = run; }
+    int RunStatus()           { return runStatus; }
+
+           // When streaming, declarations are checked while the rest of
+           // the file is still being parsed, see stream.h
+    void SetStreaming(bool stream) { streaming = stream; }
+
+           // With an incremental session, the program is compiled as the
+           // next version of the one the session compiled last, and only
+           // what changed is parsed and checked again, see incremental.h.
+           // Streaming and the pool are left out of such a compile.
+    void SetIncremental(IncrementalSession *session) { incremental = session; }
+
+    const char *GetFilename() { return filename; }
+    SourceFile *GetSource()   { return source; }
+    Arena *GetArena()         { return arena; }
+    int NumErrors()           { return numErrors; }
+
+           // Called by the parser with each top-level declaration as it
+           // is reduced, along with its span, and with each type name
+           // before the declaration it's in
+    void AddDecl(Decl *decl, SourceSpan span);
+    void NoteTypeName(Symbol name);
+
+           // Called by the parser around each function body. While
+           // streaming, a body is built in an arena of its own, which
+           // FinishBody returns and ReleaseBody takes back for reuse once
+           // the body is no longer needed. Otherwise bodies are built in
+           // the context's arena, and FinishBody returns NULL.
+    void StartBody();
+    Arena *FinishBody();
+    void ReleaseBody(Arena *bodyArena);
+
+           // The context being compiled on the calling thread
+    static CompilationContext *Current();
+    static void SetCurrent(CompilationContext *context);
+
+  private:
+    friend class ReportError;
+
+    static const size_t BodyArenaChunkSize = 4*1024;
+
+    const char *filename;
+    SourceFile *source;        // NULL until the file is opened
+    Arena ownArena;
+    Arena *arena;              // ownArena unless one was given
+    Program *program;
+    WorkPool *workPool;
+    CompileCache *cache;
+    std::vector<DeclSnapshot*> imports;
+    const char *savePath;
+    const char *outputPath;
+    bool running;
+    int runStatus;
+    bool streaming;
+    DeclStream *stream;        // only during the parse of a streaming compile
+    IncrementalSession *incremental;
+    bool lowering;             // whether the checked program is lowered to IR
+
+    std::vector<Arena*> bodyArenas;      // every one made, to delete
+    std::vector<Arena*> freeBodyArenas;  // those ready for reuse
+    std::mutex bodyArenaLock;
+
+    std::atomic<int> numErrors;
+    std::atomic<int> numOrderedErrors;   // of numErrors, those held back
+    bool holdErrors;
+    std::string heldErrors;
+    std::string *errorCopy;      // where errors are recorded for the cache
+    ErrorSegment *firstSegment;  // see ReportError::BeginOrdered
+
+    void ParseAndCheck();
+    bool CheckImports();
+    void CompileCached();
+    void Lower();
+    void Run(IRProgram *ir);
+
+    static thread_local CompilationContext *current;
+};
+
+#endif
@@ -10,33 +10,200 @@
 #include <stdio.h>
 using namespace std;
 
-#include "scanner.h" // for GetLineNumbered
+#include "context.h"
+#include "scanner.h" // for yyscan_t
 #include "ast_type.h"
 #include "ast_expr.h"
 #include "ast_stmt.h"
 #include "ast_decl.h"
 
-int ReportError::numErrors = 0;
 
-void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
+/* Type: ErrorSegment
+ * ------------------
+ * The text of the errors reported by one stretch of work while errors
+ * are being ordered. The segments form a list in the order the errors
+ * are to be printed, kept by the context they were reported against.
+ */
+struct ErrorSegment
+{
+    string text;
+    ErrorSegment *next;
+};
+
+static thread_local ErrorSegment *currentSegment = NULL;
+static thread_local std::vector<LoggedError> *errorLog = NULL;
+static thread_local bool quiet = false;
+
+ErrorSegment *ReportError::InsertSegment(ErrorSegment *after)
+{
+    CompilationContext *context = CompilationContext::Current();
+    ErrorSegment *segment = new ErrorSegment;
+    if (after != NULL) {
+        segment->next = after->next;
+        after->next = segment;
+    } else {
+        segment->next = context->firstSegment;
+        context->firstSegment = segment;
+    }
+    return segment;
+}
+
+/* ReportError::Emit
+ * -----------------
+ * Errors go out on stderr as soon as they are ready, unless the context
+ * is holding on to them. A copy is kept too while the context is
+ * recording them for the cache.
+ */
+void ReportError::Emit(const string& text)
+{
+    CompilationContext *context = CompilationContext::Current();
+    if (context->errorCopy != NULL)
+        context->errorCopy->append(text);
+    if (context->holdErrors) {
+        context->heldErrors += text;
+    } else {
+        fflush(stdout); // make sure any buffered text has been output
+        cerr << text;
+    }
+}
+
+int ReportError::NumErrors() {
+    return CompilationContext::Current()->NumErrors();
+}
+
+void ReportError::Replay(const string& text, int numErrors) {
+    CompilationContext::Current()->numErrors += numErrors;
+    Emit(text);
+}
+
+void ReportError::UnderlineErrorInLine(std::ostream& out, const char *line, yyltype *pos) {
     if (!line) return;
-    cerr << line << endl;
+    out << line << endl;
     for (int i = 1; i <= pos->last_column; i++)
-        cerr << (i >= pos->first_column ? '^' : ' ');
-    cerr << endl;
+        out << (i >= pos->first_column ? '^' : ' ');
+    out << endl;
 }
 
  
  
 void ReportError::OutputError(yyltype *loc, string msg) {
-    numErrors++;
-    fflush(stdout); // make sure any buffered text has been output
+    if (quiet)
+        return;
+    CompilationContext *context = CompilationContext::Current();
+    context->numErrors++;
+    stringstream out;
     if (loc) {
-        cerr << endl << "*** Error line " << loc->first_line << "." << endl;
-        UnderlineErrorInLine(GetLineNumbered(loc->first_line), loc);
+        out << endl << "*** Error line " << loc->first_line << "." << endl;
+        UnderlineErrorInLine(out, context->GetSource()->GetLineNumbered(loc->first_line), loc);
     } else
-        cerr << endl << "*** Error." << endl;
-    cerr << "*** " << msg << endl << endl;
+        out << endl << "*** Error." << endl;
+    out << "*** " << msg << endl << endl;
+
+    if (currentSegment != NULL) {
+        context->numOrderedErrors++;
+        currentSegment->text += out.str();
+    } else
+        Emit(out.str());
+}
+
+void ReportError::BeginOrdered() {
+    Assert(CompilationContext::Current()->firstSegment == NULL);
+    currentSegment = InsertSegment(NULL);
+}
+
+/* ReportError::Defer
+ * ------------------
+ * The deferred work's segment goes right after the one this thread is
+ * reporting into, and a new segment after it picks up what this thread
+ * reports next. Since segments are inserted rather than appended, work
+ * reporting into a segment in the middle of the list (see DeclStream)
+ * can defer too.
+ */
+ErrorSegment *ReportError::Defer() {
+    ErrorSegment *deferred = InsertSegment(currentSegment);
+    currentSegment = InsertSegment(deferred);
+    return deferred;
+}
+
+void ReportError::StartSegment(ErrorSegment *segment) {
+    currentSegment = segment;
+}
+
+ErrorSegment *ReportError::FinishSegment() {
+    ErrorSegment *last = currentSegment;
+    currentSegment = NULL;
+    return last;
+}
+
+void ReportError::EndOrdered() {
+    ClearSegments(true);
+}
+
+/* ReportError::DiscardOrdered
+ * ---------------------------
+ * Throws away the errors held back since BeginOrdered, and no longer
+ * counts them, as if the work that reported them had never been done.
+ */
+void ReportError::DiscardOrdered() {
+    CompilationContext *context = CompilationContext::Current();
+    ClearSegments(false);
+    context->numErrors -= context->numOrderedErrors;
+    context->numOrderedErrors = 0;
+}
+
+void ReportError::ClearSegments(bool emit) {
+    CompilationContext *context = CompilationContext::Current();
+    currentSegment = NULL;
+    while (context->firstSegment != NULL) {
+        ErrorSegment *next = context->firstSegment->next;
+        if (emit)
+            Emit(context->firstSegment->text);
+        delete context->firstSegment;
+        context->firstSegment = next;
+    }
+}
+
+/* ReportError::OutputError
+ * ------------------------
+ * Ast nodes only keep a packed span, the line and columns for the
+ * message are decoded from the source here when they are needed. So is
+ * the line of lineOf, if the message ends with one, so that the logged
+ * error can still give the right line once the program has moved.
+ */
+void ReportError::OutputError(SourceSpan span, string msg, SourceSpan lineOf) {
+    if (quiet)
+        return;
+    if (errorLog != NULL) {
+        LoggedError logged = {span, msg, lineOf};
+        errorLog->push_back(logged);
+    }
+    SourceFile *source = CompilationContext::Current()->GetSource();
+    if (lineOf.IsValid()) {
+        stringstream s;
+        s << msg << source->GetLocation(lineOf).first_line;
+        msg = s.str();
+    }
+    if (!span.IsValid()) {
+        OutputError(NULL, msg);
+        return;
+    }
+    yyltype loc = source->GetLocation(span);
+    OutputError(&loc, msg);
+}
+
+void ReportError::LogErrors(std::vector<LoggedError> *log) {
+    errorLog = log;
+}
+
+void ReportError::SetQuiet(bool q) {
+    quiet = q;
+}
+
+void ReportError::Reissue(const LoggedError &error) {
+    std::vector<LoggedError> *saved = errorLog;
+    errorLog = NULL;
+    OutputError(error.span, error.message, error.lineOf);
+    errorLog = saved;
 }
 
 
@@ -79,9 +246,14 @@ void ReportError::UnrecogChar(yyltype *loc, char ch) {
 
 void ReportError::DeclConflict(Decl *decl, Decl *prevDecl) {
     stringstream s;
-    s << "Declaration of '" << decl << "' here conflicts with declaration on line " 
-      << prevDecl->GetLocation()->first_line;
-    OutputError(decl->GetLocation(), s.str());
+    s << "Declaration of '" << decl << "' here conflicts with ";
+    if (!prevDecl->GetLocation().IsValid()) { // imported, see snapshot.h
+        s << "imported declaration";
+        OutputError(decl->GetLocation(), s.str());
+        return;
+    }
+    s << "declaration on line ";
+    OutputError(decl->GetLocation(), s.str(), prevDecl->GetLocation());
 }
   
 void ReportError::OverrideMismatch(Decl *fnDecl) {
@@ -182,11 +354,11 @@ void ReportError::BreakOutsideLoop(BreakStmt *bStmt) {
  * -------------------
  * Standard error-reporting function expected by yacc. Our version merely
  * just calls into the error reporter above, passing the location of
- * the last token read. If you want to suppress the ordinary "parse error"
+ * the last token read, which the pure parser hands to us. If you want to suppress the ordinary "parse error"
  * message from yacc, you can implement yyerror to do nothing and
  * then call ReportError::Formatted yourself with a more descriptive 
  * message.
  */
-void yyerror(const char *msg) {
-    ReportError::Formatted(&yylloc, "%s", msg);
+void yyerror(yyltype *loc, yyscan_t scanner, CompilationContext *context, const char *msg) {
+    ReportError::Formatted(loc, "%s", msg);
 }
@@ -13,6 +13,7 @@
 #define _H_errors
 
 #include <string>
+#include <vector>
 using std::string;
 #include "location.h"
 class Type;
@@ -23,6 +24,22 @@ class ReturnStmt;
 class This;
 class Decl;
 class Operator;
+struct ErrorSegment;
+
+
+/* Type: LoggedError
+ * -----------------
+ * An error as it was reported against the spans of the program, kept so
+ * that it can be reported again after the program has been edited and
+ * the spans have moved (see incremental.h). If lineOf is valid, the
+ * message ends with the number of the line it starts on.
+ */
+struct LoggedError
+{
+    SourceSpan span;
+    string message;
+    SourceSpan lineOf;
+};
 
 /* General notes on using this class
  * ----------------------------------
@@ -33,7 +50,7 @@ class Operator;
  * on this class are static, thus you can invoke methods directly via
  * the class name, e.g.
  *
- *    if (missingEnd) ReportError::UntermString(&yylloc, str);
+ *    if (missingEnd) ReportError::UntermString(yylloc, str);
  *
  * For some methods, the first argument is the pointer to the location
  * structure that identifies where the problem is (usually this is the
@@ -104,14 +121,50 @@ class ReportError
   static void Formatted(yyltype *loc, const char *format, ...);
 
 
-  // Returns number of error messages printed
-  static int NumErrors() { return numErrors; }
+  // Returns number of error messages reported against the context
+  // being compiled (see context.h)
+  static int NumErrors();
+
+
+  // Prints the text of numErrors errors that were reported by an earlier
+  // compilation of the same program (see cache.h) as if reported now
+  static void Replay(const string& text, int numErrors);
+
+
+  // Ordering errors from work done in parallel: between BeginOrdered
+  // and EndOrdered, errors are held back rather than printed. Defer
+  // reserves a segment for the errors of a piece of work that will run
+  // later on another thread, which reports into it between
+  // StartSegment and FinishSegment. EndOrdered, called once all that
+  // work is done, prints all the errors in the order they would have
+  // come out if the deferred work had been done right where it was
+  // deferred. FinishSegment returns the segment the thread ended up
+  // reporting into, which is a later one if it deferred work itself.
+  // DiscardOrdered drops the held errors instead of printing them.
+  static void BeginOrdered();
+  static ErrorSegment *Defer();
+  static void StartSegment(ErrorSegment *segment);
+  static ErrorSegment *FinishSegment();
+  static void EndOrdered();
+  static void DiscardOrdered();
+
+
+  // Reusing errors (see incremental.h): while a log is given, each error
+  // reported against a span is also added to it. While quiet, errors
+  // aren't reported at all. Reissue reports a logged error again, with
+  // its spans moved to wherever they are now.
+  static void LogErrors(std::vector<LoggedError> *log);
+  static void SetQuiet(bool quiet);
+  static void Reissue(const LoggedError &error);
   
  private:
 
-  static void UnderlineErrorInLine(const char *line, yyltype *pos);
+  static void UnderlineErrorInLine(std::ostream& out, const char *line, yyltype *pos);
   static void OutputError(yyltype *loc, string msg);
-  static int numErrors;
+  static void OutputError(SourceSpan span, string msg, SourceSpan lineOf = NoSpan());
+  static void Emit(const string& text);
+  static ErrorSegment *InsertSegment(ErrorSegment *after);
+  static void ClearSegments(bool emit);
   
 };
 
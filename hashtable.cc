@@ -2,21 +2,97 @@
  * ------------------
  * Implementation of Hashtable class.
  */
-   
+
+
+/* Function: SymbolHash
+ * --------------------
+ * Symbols are small dense ints, so Fibonacci hashing of the symbol number
+ * spreads them over the table without having to look at the name.
+ */
+inline unsigned int SymbolHash(Symbol key)
+{
+  return (unsigned int)key * 2654435769u;
+}
+
+template <class Value> Hashtable<Value>::Hashtable()
+{
+  slots = NULL;
+  numSlots = numKeys = 0;
+  entries = NULL;
+  numEntries = maxEntries = numRemoved = 0;
+}
+
+
+/* Hashtable::FindSlot
+ * -------------------
+ * Probes linearly from the key's hash to find the slot for key, or the
+ * empty slot where it would go. Slots are never emptied once they hold
+ * a key, so probe sequences don't need tombstones.
+ */
+template <class Value> typename Hashtable<Value>::Slot *Hashtable<Value>::FindSlot(Symbol key)
+{
+  unsigned int mask = numSlots - 1;
+  unsigned int hash = SymbolHash(key);
+  unsigned int i = (hash ^ hash >> 16) & mask;
+  while (slots[i].key != key && slots[i].key != NoSymbol)
+    i = (i + 1) & mask;
+  return &slots[i];
+}
+
+
+/* Hashtable::Grow
+ * ---------------
+ * Makes room for one more entry, and one more key if need be. The slots
+ * are kept no more than half full. The new arrays come from the current
+ * arena, the old ones are simply abandoned there.
+ */
+template <class Value> void Hashtable<Value>::Grow()
+{
+  if (numEntries == maxEntries) {
+    maxEntries = maxEntries ? 2*maxEntries : 4;
+    Entry *grown = (Entry *)Arena::Current()->Alloc(maxEntries * sizeof(Entry));
+    for (int i = 0; i < numEntries; i++)
+      grown[i] = entries[i];
+    entries = grown;
+  }
+  if (2*(numKeys + 1) > numSlots) {
+    Slot *old = slots;
+    int oldSize = numSlots;
+    numSlots = numSlots ? 2*numSlots : 8;
+    slots = (Slot *)Arena::Current()->Alloc(numSlots * sizeof(Slot));
+    for (int i = 0; i < numSlots; i++) {
+      slots[i].key = NoSymbol;
+      slots[i].newest = -1;
+    }
+    for (int i = 0; i < oldSize; i++)
+      if (old[i].key != NoSymbol)
+        *FindSlot(old[i].key) = old[i];
+  }
+}
+
 
 /* Hashtable::Enter
  * ----------------
  * Stores new value for given identifier. If the key already
  * has an entry and flag is to overwrite, will remove previous entry first,
- * otherwise it just adds another entry under same key. Copies the
- * key, so you don't have to worry about its allocation.
+ * otherwise it just adds another entry under same key.
  */
-template <class Value> void Hashtable<Value>::Enter(const char *key, Value val, bool overwrite)
+template <class Value> void Hashtable<Value>::Enter(Symbol key, Value val, bool overwrite)
 {
-  Value prev;
-  if (overwrite && (prev = Lookup(key)))
-    Remove(key, prev);
-  mmap.insert(std::make_pair(strdup(key), val));
+  Grow();
+  Slot *slot = FindSlot(key);
+  if (slot->key == NoSymbol) {
+    slot->key = key;
+    numKeys++;
+  }
+  if (overwrite && slot->newest != -1) {
+    entries[slot->newest].removed = true;
+    slot->newest = entries[slot->newest].shadowed;
+    numRemoved++;
+  }
+  Entry e = {key, val, slot->newest, false};
+  entries[numEntries] = e;
+  slot->newest = numEntries++;
 }
 
  
@@ -25,45 +101,50 @@ template <class Value> void Hashtable<Value>::Enter(const char *key, Value val,
  * Removes a given key-value pair from table. If no such pair, no
  * changes are made.  Does not affect any other entries under that key.
  */
-template <class Value> void Hashtable<Value>::Remove(const char *key, Value val)
+template <class Value> void Hashtable<Value>::Remove(Symbol key, Value val)
 {
-  if (mmap.count(key) == 0) // no matches at all
+  if (numSlots == 0)
     return;
 
-  typename std::multimap<const char *, Value>::iterator itr;
-  itr = mmap.find(key); // start at first occurrence
-  while (itr != mmap.upper_bound(key)) {
-    if (itr->second == val) { // iterate to find matching pair
-	mmap.erase(itr);
-	break;
+  Slot *slot = FindSlot(key);
+  for (int *link = &slot->newest; *link != -1; link = &entries[*link].shadowed) {
+    if (entries[*link].value == val) { // unlink matching entry from chain
+      entries[*link].removed = true;
+      *link = entries[*link].shadowed;
+      numRemoved++;
+      break;
     }
-    ++itr;
   }
 } 
 
 
+/* Hashtable::Clear
+ * ----------------
+ * Empties the table. The slots and entries are kept for reuse, so a
+ * table filled to about the same size again doesn't grow.
+ */
+template <class Value> void Hashtable<Value>::Clear()
+{
+  for (int i = 0; i < numSlots; i++) {
+    slots[i].key = NoSymbol;
+    slots[i].newest = -1;
+  }
+  numKeys = numEntries = numRemoved = 0;
+}
+
+
 /* Hashtable::Lookup
  * -----------------
  * Returns the value earlier stored under key or NULL
  *if there is no matching entry
  */
-template <class Value> Value Hashtable<Value>::Lookup(const char *key) 
+template <class Value> Value Hashtable<Value>::Lookup(Symbol key) 
 {
-  Value found = NULL;
-  
-  if (mmap.count(key) > 0) {
-    typename std::multimap<const char *, Value>::iterator cur, last, prev;
-    cur = mmap.find(key); // start at first occurrence
-    last = mmap.upper_bound(key);
-    while (cur != last) { // iterate to find last entered
-	prev = cur; 
-	if (++cur == mmap.upper_bound(key)) { // have to go one too far
-	  found = prev->second; // one before last was it
-	  break;
-	}
-    }
-  }
-  return found;
+  if (numSlots == 0)
+    return NULL;
+
+  Slot *slot = FindSlot(key);
+  return slot->newest == -1 ? NULL : entries[slot->newest].value;
 }
 
 
@@ -72,7 +153,7 @@ template <class Value> Value Hashtable<Value>::Lookup(const char *key)
  */
 template <class Value> int Hashtable<Value>::NumEntries() const
 {
-  return mmap.size();
+  return numEntries - numRemoved;
 }
 
 
@@ -83,10 +164,35 @@ template <class Value> int Hashtable<Value>::NumEntries() const
  */
 template <class Value> Iterator<Value> Hashtable<Value>::GetIterator() 
 {
-  return Iterator<Value>(mmap);
+  return Iterator<Value>(this);
 }
 
 
+/* Iterator::Iterator
+ * ------------------
+ * Entries are kept in the order they were entered, but diagnostics that
+ * walk a table depend on seeing them in alphabetical order, so the
+ * iterator takes a copy of the values sorted by the names of their keys.
+ * The sort is stable, so shadowed values for a key keep the order they
+ * were entered.
+ */
+template <class Value> struct LessByKeyName {
+  bool operator()(const std::pair<Symbol, Value>& a, const std::pair<Symbol, Value>& b) const
+  { return a.first != b.first && strcmp(SymbolName(a.first), SymbolName(b.first)) < 0; }
+};
+
+template <class Value> Iterator<Value>::Iterator(Hashtable<Value> *t)
+  : cur(0)
+{
+  std::vector<std::pair<Symbol, Value> > live;
+  for (int i = 0; i < t->numEntries; i++)
+    if (!t->entries[i].removed)
+      live.push_back(std::make_pair(t->entries[i].key, t->entries[i].value));
+  std::stable_sort(live.begin(), live.end(), LessByKeyName<Value>());
+  for (size_t i = 0; i < live.size(); i++)
+    values.push_back(live[i].second);
+}
+
 /* Iterator::GetNextValue
  * ----------------------
  * Iterator method used to return current value and advance iterator
@@ -94,6 +200,5 @@ template <class Value> Iterator<Value> Hashtable<Value>::GetIterator()
  */
 template <class Value> Value Iterator<Value>::GetNextValue()
 {
-  return (cur == end ? NULL : (*cur++).second);
+  return (cur == values.size() ? NULL : values[cur++]);
 }
-
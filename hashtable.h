@@ -1,12 +1,14 @@
 /* File: hashtable.h
  * -----------------
- * This is a simple table for storing values associated with a string
- * key, supporting simple operations for Enter and Lookup.  It is not
- * much more than a thin cover over the STL associative map container,
- * but hides the awkward C++ template syntax and provides a more
- * familiar interface.
+ * This is a simple table for storing values associated with a symbol
+ * key, supporting simple operations for Enter and Lookup. Symbol tables
+ * are searched on every identifier lookup, so rather than a tree-based
+ * STL map it uses a flat open-addressed table of slots, one per key.
+ * Each slot points at the newest entry for its key, and entries are
+ * chained to the older ones they shadow.
  *
- * The keys are always strings, but the values can be of any type
+ * The keys are always interned symbols (see symbol.h), so finding a key
+ * only compares ints, but the values can be of any type
  * (ok, that's actually kind of a fib, it expects the type to be
  * some sort of pointer to conform to using NULL for "not found").
  * The typename for a Hashtable includes the value type in angle
@@ -18,7 +20,7 @@
  *
  * An iterator is provided for iterating over the entries in a table. 
  * The iterator walks through the values, one by one, in alphabetical
- * order by the key. Sample iteration usage:
+ * order by the name of the key. Sample iteration usage:
  *
  *       void PrintNames(Hashtable<Decl*> *table)
  *       {
@@ -33,25 +35,48 @@
 #ifndef _H_hashtable
 #define _H_hashtable
 
-#include <map>
+#include <vector>
+#include <algorithm>
 #include <string.h>
-
-struct ltstr {
-  bool operator()(const char* s1, const char* s2) const
-  { return strcmp(s1, s2) < 0; }
-};
+#include "arena.h"
+#include "symbol.h"
 
 
 template <class Value> class Iterator;
 
 template<class Value> class Hashtable {
+  friend class Iterator<Value>;
 
   private: 
-     std::multimap<const char*, Value, ltstr> mmap;
+     struct Slot {
+        Symbol key;          // NoSymbol if the slot is empty
+        int newest;          // index of newest entry for key, -1 if none
+     };
+     struct Entry {
+        Symbol key;
+        Value value;
+        int shadowed;        // index of the older entry for key, or -1
+        bool removed;
+     };
+
+     Slot *slots;            // numSlots is always a power of 2
+     int numSlots, numKeys;
+     Entry *entries;         // in the order they were entered
+     int numEntries, maxEntries, numRemoved;
+
+     Slot *FindSlot(Symbol key);
+     void Grow();
  
    public:
             // ctor creates a new empty hashtable
-     Hashtable() {}
+     Hashtable();
+
+            // Tables live in the arena that was current when they were
+            // created, their slots and entries in the one current when
+            // they grow
+     static void *operator new(size_t size)
+        { return Arena::Current()->Alloc(size); }
+     static void operator delete(void *) {}
 
            // Returns number of entries currently in table
      int NumEntries() const;
@@ -62,19 +87,22 @@ template<class Value> class Hashtable {
            // from the table entirely) or just shadows it (keeps previous
            // and adds additional entry). The lastmost entered one for an
            // key will be the one returned by Lookup.
-     void Enter(const char *key, Value value,
+     void Enter(Symbol key, Value value,
 		    bool overwriteInsteadOfShadow = true);
 
            // Removes a given key->value pair.  Any other values
            // for that key are not affected. If this is the last
            // remaining value for that key, the key is removed
            // entirely.
-     void Remove(const char *key, Value value);
+     void Remove(Symbol key, Value value);
+
+           // Removes every entry, keeping the memory for those to come
+     void Clear();
 
           // Returns value stored under key or NULL if no match.
           // If more than one value for key (ie shadow feature was
           // used during Enter), returns the lastmost entered one.
-     Value Lookup(const char *key);
+     Value Lookup(Symbol key);
 
           // Returns an Iterator object (see below) that can be used to
           // visit each value in the table in alphabetical order.
@@ -91,9 +119,9 @@ template<class Value> class Iterator {
   friend class Hashtable<Value>;
 
   private:
-    typename std::multimap<const char*, Value , ltstr>::iterator cur, end;
-    Iterator(std::multimap<const char*, Value, ltstr>& t)
-      : cur(t.begin()), end(t.end()) {}
+    std::vector<Value> values;
+    size_t cur;
+    Iterator(Hashtable<Value> *t);
 
   public:
          // Returns current value and advances iterator to next.
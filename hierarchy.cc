@@ -0,0 +1,172 @@
+/* File: hierarchy.cc
+ * ------------------
+ * Implementation of the ClassHierarchy class.
+ */
+
+#include "hierarchy.h"
+#include "ast_decl.h"
+#include "ast_type.h"
+#include <string.h>
+
+static const int BitsPerWord = 8 * sizeof(unsigned);
+
+ClassHierarchy::ClassHierarchy(List<Decl*> *decls, Hashtable<Decl*> *g)
+{
+    globals = g;
+    numClasses = numInterfaces = 0;
+    List<ClassDecl*> *found = new List<ClassDecl*>;
+    for (int i = 0; i < decls->NumElements(); i++) {
+        Decl *d = decls->Nth(i);
+        ClassDecl *cls = DynCast<ClassDecl>(d);
+        InterfaceDecl *intf = DynCast<InterfaceDecl>(d);
+        if (globals->Lookup(d->id->symbol) != d) {
+            // lost out to an earlier declaration of the name, and may
+            // have been numbered in an earlier version of the program
+            if (cls != NULL) {
+                cls->hierarchy = NULL;
+                cls->classIndex = -1;
+            } else if (intf != NULL) {
+                intf->interfaceIndex = -1;
+            }
+            continue;
+        }
+        if (cls != NULL) {
+            cls->hierarchy = this;
+            cls->classIndex = numClasses++;
+            found->Append(cls);
+        } else if (intf != NULL) {
+            intf->interfaceIndex = numInterfaces++;
+        }
+    }
+
+    // Group each class under the one it inherits from, then number them
+    // with a depth-first walk from each class that doesn't inherit
+    Arena *arena = Arena::Current();
+    List<ClassDecl*> **subclasses = (List<ClassDecl*> **)arena->Alloc(numClasses * sizeof(subclasses[0]));
+    for (int i = 0; i < numClasses; i++)
+        subclasses[i] = new List<ClassDecl*>;
+    for (int i = 0; i < numClasses; i++) {
+        ClassDecl *cls = found->Nth(i);
+        cls->LinkToSuperclass();
+        if (cls->inheritsFrom != NULL)
+            subclasses[cls->inheritsFrom->classIndex]->Append(cls);
+    }
+
+    wordsPerSet = (numInterfaces + BitsPerWord - 1) / BitsPerWord;
+    classes = (ClassDecl **)arena->Alloc(numClasses * sizeof(classes[0]));
+    last = (int *)arena->Alloc(numClasses * sizeof(last[0]));
+    interfaceSets = (unsigned *)arena->Alloc(numClasses * wordsPerSet * sizeof(interfaceSets[0]));
+    conforms = (signed char *)arena->Alloc(numClasses * numInterfaces);
+    memset(interfaceSets, 0, numClasses * wordsPerSet * sizeof(interfaceSets[0]));
+    memset(conforms, -1, numClasses * numInterfaces);
+
+    int next = 0;
+    for (int i = 0; i < numClasses; i++) {
+        if (found->Nth(i)->inheritsFrom == NULL)
+            next = Number(found->Nth(i), next, subclasses, NULL);
+    }
+    Assert(next == numClasses);
+}
+
+/* ClassHierarchy::Number
+ * ----------------------
+ * Gives cls the number next and its subclasses the numbers after it,
+ * returning the first number not used. Each class's interface set is
+ * the one it inherits plus the interfaces it names itself.
+ */
+int ClassHierarchy::Number(ClassDecl *cls, int next, List<ClassDecl*> **subclasses, unsigned *inheritedSet)
+{
+    List<ClassDecl*> *subs = subclasses[cls->classIndex];
+    int index = next++;
+    cls->classIndex = index;
+    classes[index] = cls;
+
+    unsigned *set = interfaceSets + index * wordsPerSet;
+    for (int i = 0; inheritedSet != NULL && i < wordsPerSet; i++)
+        set[i] = inheritedSet[i];
+    for (int i = 0; i < cls->implements->NumElements(); i++) {
+        Decl *d = globals->Lookup(cls->implements->Nth(i)->id->symbol);
+        InterfaceDecl *intf = DynCast<InterfaceDecl>(d);
+        if (intf != NULL && intf->interfaceIndex >= 0)
+            set[intf->interfaceIndex / BitsPerWord] |= 1u << (intf->interfaceIndex % BitsPerWord);
+    }
+
+    for (int i = 0; i < subs->NumElements(); i++)
+        next = Number(subs->Nth(i), next, subclasses, set);
+    last[index] = next - 1;
+    return next;
+}
+
+bool ClassHierarchy::IsSubclass(ClassDecl *sub, ClassDecl *cls)
+{
+    if (sub == cls)
+        return true;
+    if (sub->hierarchy != this || cls->hierarchy != this)
+        return false;
+    return cls->classIndex <= sub->classIndex && sub->classIndex <= last[cls->classIndex];
+}
+
+bool ClassHierarchy::Implements(ClassDecl *cls, InterfaceDecl *intf)
+{
+    if (cls->hierarchy != this || intf->interfaceIndex < 0)
+        return false;
+    int bit = intf->interfaceIndex;
+    return (interfaceSets[cls->classIndex * wordsPerSet + bit / BitsPerWord] >> (bit % BitsPerWord)) & 1;
+}
+
+/* ClassHierarchy::IsSubtype
+ * -------------------------
+ * Types are compared by their canonical objects. Besides a type being a
+ * subtype of itself, null is a subtype of every class and interface,
+ * and a class is a subtype of its superclasses and of the interfaces it
+ * implements. The error type is compatible with anything, so an error
+ * isn't reported again for each use of something that was wrong.
+ */
+bool ClassHierarchy::IsSubtype(Type *sub, Type *super)
+{
+    sub = sub->GetCanonical();
+    super = super->GetCanonical();
+    if (sub == super || sub == Type::errorType || super == Type::errorType)
+        return true;
+    NamedType *superName = DynCast<NamedType>(super);
+    if (superName == NULL)
+        return false;
+    if (sub == Type::nullType)
+        return true;
+    NamedType *subName = DynCast<NamedType>(sub);
+    if (subName == NULL)
+        return false;
+
+    ClassDecl *subClass = DynCast<ClassDecl>(globals->Lookup(subName->id->symbol));
+    Decl *superDecl = globals->Lookup(superName->id->symbol);
+    if (subClass == NULL || superDecl == NULL)
+        return false;
+    ClassDecl *superClass = DynCast<ClassDecl>(superDecl);
+    InterfaceDecl *superIntf = DynCast<InterfaceDecl>(superDecl);
+    if (superClass != NULL)
+        return IsSubclass(subClass, superClass);
+    return superIntf != NULL && Implements(subClass, superIntf);
+}
+
+bool ClassHierarchy::Conforms(ClassDecl *cls, InterfaceDecl *intf)
+{
+    if (cls->hierarchy != this || intf->interfaceIndex < 0)
+        return ComputeConforms(cls, intf);
+    signed char *known = &conforms[cls->classIndex * numInterfaces + intf->interfaceIndex];
+    if (*known < 0)
+        *known = ComputeConforms(cls, intf);
+    return *known;
+}
+
+bool ClassHierarchy::ComputeConforms(ClassDecl *cls, InterfaceDecl *intf)
+{
+    Decl *val;
+    Iterator<Decl*> iter = intf->GetMembers()->GetIterator();
+    while ((val=iter.GetNextValue()) != NULL) {
+        FnDecl *classImpl = DynCast<FnDecl>(cls->GetScope()->LookupMember(val->id->symbol));
+        FnDecl *intfImpl = DynCast<FnDecl>(val);
+        if (classImpl == NULL || intfImpl == NULL || !FnDecl::Compare(classImpl, intfImpl))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+/* File: hierarchy.h
+ * -----------------
+ * The ClassHierarchy indexes the classes and interfaces of a program so
+ * that subtype questions can be answered in constant time, without
+ * walking up extends clauses or scanning implements lists.
+ *
+ * Classes are numbered by a depth-first walk of the tree formed by their
+ * extends clauses. Each class records the number it was given on the way
+ * down and the last number given out below it, so class A is a subclass
+ * of B exactly when A's number falls within B's interval. Interfaces are
+ * numbered too, and each class has a bitset of the interfaces it or any
+ * of its superclasses implements.
+ *
+ * Whether a class actually provides every method of an interface, with
+ * matching signatures, is computed the first time it is asked for each
+ * (class, interface) pair and remembered from then on.
+ */
+
+#ifndef _H_hierarchy
+#define _H_hierarchy
+
+#include "list.h"
+#include "hashtable.h"
+
+class Decl;
+class ClassDecl;
+class InterfaceDecl;
+class Type;
+
+class ClassHierarchy
+{
+  public:
+           // Indexes the classes and interfaces among decls, which must
+           // already have been declared in globals
+    ClassHierarchy(List<Decl*> *decls, Hashtable<Decl*> *globals);
+
+           // Returns whether sub is cls or one of its subclasses
+    bool IsSubclass(ClassDecl *sub, ClassDecl *cls);
+
+           // Returns whether cls or one of its superclasses declares that
+           // it implements intf
+    bool Implements(ClassDecl *cls, InterfaceDecl *intf);
+
+           // Returns whether a value of type sub can be used where one of
+           // type super is expected
+    bool IsSubtype(Type *sub, Type *super);
+
+           // Returns whether cls (along with what it inherits) has a
+           // method matching each of intf's. The members of both must
+           // already have been declared.
+    bool Conforms(ClassDecl *cls, InterfaceDecl *intf);
+
+    static void *operator new(size_t size)
+        { return Arena::Current()->Alloc(size); }
+    static void operator delete(void *) {}
+
+  private:
+    Hashtable<Decl*> *globals;
+    int numClasses, numInterfaces;
+    int wordsPerSet;
+    ClassDecl **classes;     // in depth-first order
+    int *last;               // last index of each class's subtree
+    unsigned *interfaceSets; // wordsPerSet words for each class
+    signed char *conforms;   // -1 until known, numInterfaces per class
+
+    int Number(ClassDecl *cls, int next, List<ClassDecl*> **subclasses, unsigned *inheritedSet);
+    static bool ComputeConforms(ClassDecl *cls, InterfaceDecl *intf);
+};
+
+#endif
@@ -0,0 +1,712 @@
+/* File: incremental.cc
+ * --------------------
+ * Implementation of the IncrementalSession class.
+ */
+
+#include "incremental.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_stmt.h"
+#include "ast_type.h"
+#include "context.h"
+#include "errors.h"
+#include "parser.h"
+#include "source.h"
+#include "utility.h"
+#include <algorithm>
+#include <string.h>
+
+IncrementalSession::IncrementalSession()
+{
+    this->context = NULL;
+    this->arena = NULL;
+    this->program = NULL;
+    this->source = NULL;
+    this->parsing = NULL;
+    this->liveBytes = 0;
+    this->nextNode = 0;
+}
+
+IncrementalSession::~IncrementalSession()
+{
+    delete this->arena;
+    delete this->source;
+}
+
+/* IncrementalSession::Compile
+ * ---------------------------
+ * The trees are parsed whole again once what earlier versions left
+ * behind in their arena outweighs them, as well as whenever the edit
+ * can't be parsed on its own. The session keeps its own copy of the text,
+ * since the string constants in the trees are views into it.
+ */
+void IncrementalSession::Compile(CompilationContext *c)
+{
+    this->context = c;
+    WorkPool *pool = c->GetWorkPool();
+    c->SetWorkPool(NULL);   // errors are logged on this thread
+    Arena *saved = Arena::Current();
+
+    SourceFile *text = new SourceFile(c->GetSource()->GetText(), c->GetSource()->GetLength());
+    this->tokens.Update(text);
+    if (this->arena == NULL || this->arena->BytesUsed() > 2*this->liveBytes + ArenaSlack ||
+        !this->TryEdit(text))
+        this->ParseWhole(text);
+
+    Arena::SetCurrent(saved);
+    c->SetWorkPool(pool);
+    this->context = NULL;
+}
+
+void IncrementalSession::NoteTypeName(Symbol name)
+{
+    this->names.push_back(name);
+}
+
+void IncrementalSession::AddDecl(Decl *decl, SourceSpan span)
+{
+    Arena *a = Arena::Current();
+    this->parsed.push_back(TopDecl());
+    TopDecl *t = &this->parsed.back();
+    t->decl = decl;
+    t->span = span;
+    t->fingerprint = MixHash(Hash(this->parsing->GetText() + span.offset, span.length));
+    t->names.swap(this->names);
+    std::sort(t->names.begin(), t->names.end());
+    t->names.erase(std::unique(t->names.begin(), t->names.end()), t->names.end());
+    t->firstNode = this->nextNode;
+    t->endNode = this->nextNode = a->NumNodes();
+    for (size_t i = t->firstNode; i < t->endNode; i++)
+    {
+        StringConstant *s = DynCast<StringConstant>(a->GetNode(i));
+        if (s != NULL)
+            t->strings.push_back(s);
+    }
+    t->key = 0;
+    t->kept = false;
+}
+
+/* IncrementalSession::Parse
+ * -------------------------
+ * Parses the declarations from start up to end of text into the current
+ * arena, adding them to parsed. Returns whether they parsed without an
+ * error. Quietly, the errors are thrown away rather than reported. The
+ * tokens come from the line cache, which can't say where a token starts
+ * on a line with errors, but then the stretch wouldn't parse anyway.
+ */
+bool IncrementalSession::Parse(SourceFile *text, int start, int end, bool quietly)
+{
+    if (!this->tokens.IsTokenBoundary(start) || !this->tokens.IsTokenBoundary(end))
+        return false;
+    int numErrors = this->context->NumErrors();
+    if (quietly)
+        ReportError::BeginOrdered();
+    this->parsing = text;
+    this->nextNode = Arena::Current()->NumNodes();
+    this->names.clear();
+    TokenReader reader(&this->tokens, text, start, end);
+    yyscan_t scanner = InitScanner(&reader);
+    InitParser();
+    int result = yyparse(scanner, this->context);
+    FreeScanner(scanner);
+    bool parsedOK = (result == 0 && this->context->NumErrors() == numErrors);
+    if (quietly)
+        ReportError::DiscardOrdered();
+    return parsedOK;
+}
+
+/* IncrementalSession::IsGap
+ * -------------------------
+ * Returns whether there is nothing between start and end of text but
+ * what the scanner skips. A // comment has to end before end does, or
+ * it would run on into what follows, unless that is the end of the text.
+ */
+bool IncrementalSession::IsGap(SourceFile *text, int start, int end)
+{
+    const char *s = text->GetText();
+    int i = start;
+    while (i < end)
+    {
+        if (s[i] == ' ' || s[i] == '\t' || s[i] == '\n')
+        {
+            i++;
+        }
+        else if (i + 1 < end && s[i] == '/' && s[i+1] == '*')
+        {
+            for (i += 2; i + 1 < end && !(s[i] == '*' && s[i+1] == '/'); i++)
+                ;
+            if (i + 1 >= end)
+                return false;
+            i += 2;
+        }
+        else if (i + 1 < end && s[i] == '/' && s[i+1] == '/')
+        {
+            const char *newline = (const char *)memchr(s + i, '\n', end - i);
+            if (newline == NULL)
+                return end == text->GetLength();
+            i = newline - s;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* IncrementalSession::TryEdit
+ * ---------------------------
+ * Takes text as the next version of the one the trees were parsed from,
+ * if the stretch of it that changed parses on its own, and returns
+ * whether it did. Nothing is changed unless it parses. The stretch runs
+ * from the end of the last declaration entirely before the edit to the
+ * start of the first entirely after it, so it is made up of whole
+ * declarations and what lies between them.
+ */
+bool IncrementalSession::TryEdit(SourceFile *text)
+{
+    const char *oldText = this->source->GetText(), *newText = text->GetText();
+    int oldLength = this->source->GetLength(), newLength = text->GetLength();
+    int limit = std::min(oldLength, newLength);
+    int prefix = CommonPrefix(oldText, newText, limit);
+    int suffix = CommonSuffix(oldText + oldLength, newText + newLength, limit - prefix);
+    int changeEnd = oldLength - suffix;
+    int delta = newLength - oldLength;
+
+    size_t lo = 0, hi = this->decls.size();
+    while (lo < hi)     // the first that reaches the change
+    {
+        size_t mid = (lo + hi) / 2;
+        if ((int)(this->decls[mid].span.offset + this->decls[mid].span.length) < prefix)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    hi = this->decls.size();
+    for (size_t l = lo; l < hi; )    // the first after it
+    {
+        size_t mid = (l + hi) / 2;
+        if ((int)this->decls[mid].span.offset <= changeEnd)
+            l = mid + 1;
+        else
+            hi = mid;
+    }
+    int start = (lo > 0 ? this->decls[lo-1].span.offset + this->decls[lo-1].span.length : 0);
+    int end = (hi < this->decls.size() ? this->decls[hi].span.offset : oldLength) + delta;
+
+    Arena::SetCurrent(this->arena);
+    this->parsed.clear();
+    if (!this->IsGap(text, start, end))
+    {
+        if (!this->Parse(text, start, end, true))
+            return false;
+        SourceSpan tail = this->parsed.back().span;
+        if (!this->IsGap(text, tail.offset + tail.length, end))
+            return false;
+    }
+    if (this->decls.size() - (hi - lo) + this->parsed.size() == 0)
+        return false;   // an empty program doesn't parse
+
+    // From here on the trees are changed, so anything that goes wrong
+    // leaves nothing to go on
+    std::vector<TopDecl> old;
+    old.swap(this->decls);
+    this->decls.reserve(old.size() - (hi - lo) + this->parsed.size());
+    for (size_t i = 0; i < lo; i++)
+        this->decls.push_back(std::move(old[i]));
+    for (size_t i = 0; i < this->parsed.size(); i++)
+        this->decls.push_back(std::move(this->parsed[i]));
+    for (size_t i = hi; i < old.size(); i++)
+    {
+        TopDecl *t = &old[i];
+        t->span.offset += delta;
+        for (size_t n = t->firstNode; n < t->endNode && delta != 0; n++)
+            this->arena->GetNode(n)->MoveLocation(delta);
+        this->decls.push_back(std::move(*t));
+    }
+
+    this->Prepare();
+    if (!this->FindCycles())
+    {
+        this->ComputeKeys();
+        this->FindFresh();
+        if (this->Reparse(text))
+        {
+            for (size_t i = 0; i < this->decls.size(); i++)
+            {
+                for (size_t j = 0; this->decls[i].kept && j < this->decls[i].strings.size(); j++)
+                    this->decls[i].strings[j]->SetSource(text);
+            }
+            delete this->source;
+            this->source = text;
+            this->Check(true);
+            return true;
+        }
+    }
+    this->Reset();
+    return false;
+}
+
+/* IncrementalSession::ParseWhole
+ * ------------------------------
+ * Parses all of text into an arena of its own, reporting any errors,
+ * and if it parses, checks it in place of the trees there were. If it
+ * doesn't, they are kept for the next version.
+ */
+void IncrementalSession::ParseWhole(SourceFile *text)
+{
+    Arena *fresh = new Arena;
+    fresh->SetTrackNodes(true);
+    Arena::SetCurrent(fresh);
+    Program *p = new Program(new List<Decl*>);
+    this->parsed.clear();
+    if (!this->Parse(text, 0, text->GetLength(), false))
+    {
+        Arena::SetCurrent(this->arena);
+        delete fresh;
+        delete text;
+        return;
+    }
+
+    delete this->arena;
+    delete this->source;
+    this->arena = fresh;
+    this->program = p;
+    this->source = text;
+    this->decls.swap(this->parsed);
+    this->parsed.clear();
+    this->liveBytes = fresh->BytesUsed();
+
+    this->Prepare();
+    bool keyed = !this->FindCycles();
+    if (keyed)
+        this->ComputeKeys();
+    this->Check(keyed);
+}
+
+/* IncrementalSession::Reset
+ * -------------------------
+ * Forgets everything, as if nothing had been compiled yet.
+ */
+void IncrementalSession::Reset()
+{
+    delete this->arena;
+    delete this->source;
+    this->arena = NULL;
+    this->source = NULL;
+    this->program = NULL;
+    this->decls.clear();
+    this->last.clear();
+}
+
+/* IncrementalSession::Prepare
+ * ---------------------------
+ * Finds what each global name will be declared as, which is always the
+ * first declaration of the name, and what each declaration's key covers:
+ * the declaration itself and, for a class, the superclasses and
+ * interfaces it can check along with it. Looking the interfaces up among
+ * the globals rather than in the class finds the same ones, unless a
+ * member hides one, and the members are in the key anyway.
+ */
+void IncrementalSession::Prepare()
+{
+    this->declaredAs.assign(NumSymbols(), -1);
+    for (size_t i = 0; i < this->decls.size(); i++)
+    {
+        int *d = &this->declaredAs[this->decls[i].decl->id->symbol];
+        if (*d < 0)
+            *d = i;
+    }
+
+    this->reachedStart.resize(this->decls.size() + 1);
+    this->reached.clear();
+    for (size_t i = 0; i < this->decls.size(); i++)
+    {
+        size_t first = this->reached.size();
+        this->reachedStart[i] = first;
+        this->reached.push_back(i);
+        for (size_t next = first; next < this->reached.size(); next++)
+        {
+            ClassDecl *cls = DynCast<ClassDecl>(this->decls[this->reached[next]].decl);
+            if (cls == NULL)
+                continue;
+            for (int j = -1; j < cls->implements->NumElements(); j++)
+            {
+                int k = this->SuperOf(this->reached[next]);
+                if (j >= 0)
+                {
+                    k = this->IndexOf(cls->implements->Nth(j)->id->symbol);
+                    if (k >= 0 && !IsA<InterfaceDecl>(this->decls[k].decl))
+                        k = -1;
+                }
+                if (k >= 0 && std::find(this->reached.begin() + first, this->reached.end(), k) == this->reached.end())
+                    this->reached.push_back(k);
+            }
+        }
+    }
+    this->reachedStart[this->decls.size()] = this->reached.size();
+}
+
+int IncrementalSession::IndexOf(Symbol name)
+{
+    return (name < (int)this->declaredAs.size() ? this->declaredAs[name] : -1);
+}
+
+Decl *IncrementalSession::Lookup(Symbol name)
+{
+    int i = this->IndexOf(name);
+    return (i >= 0 ? this->decls[i].decl : NULL);
+}
+
+/* IncrementalSession::SuperOf
+ * ---------------------------
+ * Returns the index of the class the i'th declaration extends, or -1 if
+ * it isn't a class or doesn't extend one (see ClassDecl::GetSuperclass).
+ */
+int IncrementalSession::SuperOf(int i)
+{
+    ClassDecl *cls = DynCast<ClassDecl>(this->decls[i].decl);
+    if (cls == NULL || cls->extends == NULL)
+        return -1;
+    int k = this->IndexOf(cls->extends->id->symbol);
+    return (k >= 0 && IsA<ClassDecl>(this->decls[k].decl) ? k : -1);
+}
+
+/* IncrementalSession::FindCycles
+ * ------------------------------
+ * Returns whether the extends clauses form a cycle. How a cycle is
+ * broken depends on the order the classes in it are checked in, so a
+ * program with one is checked whole, without keys.
+ */
+bool IncrementalSession::FindCycles()
+{
+    enum { Unseen, OnPath, Done };
+    std::vector<char> state(this->decls.size(), Unseen);
+    std::vector<int> path;
+    for (size_t i = 0; i < this->decls.size(); i++)
+    {
+        int j = i;
+        path.clear();
+        while (j >= 0 && state[j] == Unseen)
+        {
+            state[j] = OnPath;
+            path.push_back(j);
+            j = this->SuperOf(j);
+        }
+        if (j >= 0 && state[j] == OnPath)
+            return true;
+        for (size_t k = 0; k < path.size(); k++)
+            state[path[k]] = Done;
+    }
+    return false;
+}
+
+/* IncrementalSession::ComputeKeys
+ * -------------------------------
+ * Works out the key of each declaration as it will be at its turn in
+ * Check, going through the declarations in order just as Program::Check
+ * does, so whatever checking one checks along with it counts as checked
+ * by the time its own turn comes. Identical declarations with identical
+ * surroundings get the same key, so each key is told apart by the
+ * number of times it came up before.
+ */
+void IncrementalSession::ComputeKeys()
+{
+    size_t n = this->decls.size();
+    std::vector<char> checked(n, false);
+    std::unordered_map<uint64_t, int> occurrences;
+    this->keys.resize(n);
+    this->owner.assign(n, -1);
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t h = this->HashNames(i, this->decls[i].fingerprint, checked);
+        for (int r = this->reachedStart[i] + 1; r < this->reachedStart[i+1]; r++)
+            h = this->HashNames(this->reached[r], h, checked);
+        uint64_t key = MixHash(h);
+        this->keys[i] = MixHash(key + occurrences[key]++);
+        if (!checked[i])
+            this->Cascade(i, i, &checked);
+    }
+}
+
+/* IncrementalSession::Cascade
+ * ---------------------------
+ * Marks what checking the i'th declaration checks along with it as
+ * checked by the by'th (see ClassDecl::Check).
+ */
+void IncrementalSession::Cascade(int i, int by, std::vector<char> *checked)
+{
+    (*checked)[i] = true;
+    this->owner[i] = by;
+    ClassDecl *cls = DynCast<ClassDecl>(this->decls[i].decl);
+    if (cls == NULL)
+        return;
+    int super = this->SuperOf(i);
+    if (super >= 0 && !(*checked)[super])
+        this->Cascade(super, by, checked);
+    for (int j = 0; j < cls->implements->NumElements(); j++)
+    {
+        Symbol name = cls->implements->Nth(j)->id->symbol;
+        int k = this->IndexOf(name);
+        if (k >= 0 && IsA<InterfaceDecl>(this->decls[k].decl) && !(*checked)[k] && !this->IsHidden(i, name))
+        {
+            (*checked)[k] = true;
+            this->owner[k] = by;
+        }
+    }
+}
+
+/* IncrementalSession::IsHidden
+ * ----------------------------
+ * Returns whether a member of the i'th declaration, a class, or of one
+ * of its superclasses hides the global name.
+ */
+bool IncrementalSession::IsHidden(int i, Symbol name)
+{
+    for (int c = i; c >= 0; c = this->SuperOf(c))
+    {
+        List<Decl*> *members = static_cast<ClassDecl*>(this->decls[c].decl)->members;
+        for (int j = 0; j < members->NumElements(); j++)
+        {
+            if (members->Nth(j)->id->symbol == name)
+                return true;
+        }
+    }
+    return false;
+}
+
+/* IncrementalSession::HashNames
+ * -----------------------------
+ * Adds the i'th declaration to the hash: its text, whether it is the one
+ * its name is declared as, whether it has been checked already, and what
+ * kind of declaration each of its type names is declared as, since that
+ * is all a type name is checked for (see NamedType::Check).
+ */
+uint64_t IncrementalSession::HashNames(int i, uint64_t h, const std::vector<char> &checked)
+{
+    TopDecl *t = &this->decls[i];
+    uint64_t state[3] = { t->fingerprint,
+                          this->IndexOf(t->decl->id->symbol) == i,
+                          (uint64_t)checked[i] };
+    h = Hash((const char *)state, sizeof(state), h);
+    for (size_t j = 0; j < t->names.size(); j++)
+    {
+        Decl *d = this->Lookup(t->names[j]);
+        int named[2] = { t->names[j], d == NULL ? 0 : IsA<ClassDecl>(d) ? 1 : IsA<InterfaceDecl>(d) ? 2 : 3 };
+        h = Hash((const char *)named, sizeof(named), h);
+    }
+    return h;
+}
+
+/* IncrementalSession::FindFresh
+ * -----------------------------
+ * Finds the declarations that need a tree that hasn't been checked: the
+ * new ones, the kept ones whose errors from last time won't do, and then
+ * any kept one that something fresh is checked along with, or that is
+ * checked along with something fresh.
+ */
+void IncrementalSession::FindFresh()
+{
+    size_t n = this->decls.size();
+    this->fresh.assign(n, false);
+    for (size_t i = 0; i < n; i++)
+    {
+        TopDecl *t = &this->decls[i];
+        std::unordered_map<uint64_t, ErrorList>::iterator found = this->last.find(this->keys[i]);
+        this->fresh[i] = !t->kept || t->key != this->keys[i] || found == this->last.end() ||
+                         !this->CanReplay(found->second);
+    }
+    for (bool changed = true; changed; )
+    {
+        changed = false;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (this->fresh[i])
+                continue;
+            bool f = this->fresh[this->owner[i]];
+            for (int r = this->reachedStart[i] + 1; !f && r < this->reachedStart[i+1]; r++)
+                f = this->fresh[this->reached[r]];
+            if (f)
+                this->fresh[i] = changed = true;
+        }
+    }
+}
+
+/* IncrementalSession::Reparse
+ * ---------------------------
+ * Gives each kept declaration that is fresh a new tree, parsed from the
+ * same text where it is now. Returns false if one fails to parse, which
+ * text that parsed before shouldn't.
+ */
+bool IncrementalSession::Reparse(SourceFile *text)
+{
+    for (size_t i = 0; i < this->decls.size(); i++)
+    {
+        TopDecl *t = &this->decls[i];
+        if (!t->kept || !this->fresh[i])
+            continue;
+        this->parsed.clear();
+        if (!this->Parse(text, t->span.offset, t->span.offset + t->span.length, true) ||
+            this->parsed.size() != 1)
+            return false;
+        *t = std::move(this->parsed[0]);
+    }
+    this->parsed.clear();
+    return true;
+}
+
+/* IncrementalSession::Check
+ * -------------------------
+ * Declares the declarations and goes through them in order as
+ * Program::Check does. With keys, a kept tree only has its errors
+ * reported again, and so does a new one whose key was seen before. The
+ * declaration list and the hierarchy are made anew each time, so they go
+ * in the scratch arena. The classes are linked first, in the order the
+ * hierarchy would link them, since that resolves scopes the trees keep.
+ */
+void IncrementalSession::Check(bool keyed)
+{
+    Arena::SetCurrent(&this->scratch);
+    this->scratch.Reset();
+    this->program->ClearDecls();
+    for (size_t i = 0; i < this->decls.size(); i++)
+        this->program->AddDecl(this->decls[i].decl);
+    Arena::SetCurrent(this->arena);
+    this->program->Declare();
+    for (size_t i = 0; i < this->decls.size(); i++)
+    {
+        ClassDecl *cls = DynCast<ClassDecl>(this->decls[i].decl);
+        if (cls != NULL && this->IndexOf(cls->id->symbol) == (int)i)
+            cls->LinkToSuperclass();
+    }
+    Arena::SetCurrent(&this->scratch);
+    this->program->BuildHierarchy();
+    Arena::SetCurrent(this->arena);
+
+    std::unordered_map<uint64_t, ErrorList> current;
+    std::vector<LoggedError> log;
+    int numParsed = 0, numChecked = 0;
+    for (size_t i = 0; i < this->decls.size(); i++)
+    {
+        TopDecl *t = &this->decls[i];
+        if (!t->kept)
+            numParsed++;
+        if (keyed)
+        {
+            uint64_t key = t->key = this->keys[i];
+            std::unordered_map<uint64_t, ErrorList>::iterator found = this->last.find(key);
+            if (found != this->last.end() && (t->kept || this->CanReplay(found->second)))
+            {
+                this->Replay(i, found->second);
+                t->decl->SkipCheck();
+                current[key].swap(found->second);
+                t->kept = true;
+                continue;
+            }
+        }
+        if (!t->decl->IsChecked())
+            numChecked++;
+        log.clear();
+        ReportError::LogErrors(&log);
+        t->decl->Check();
+        ReportError::LogErrors(NULL);
+        if (keyed && !this->Record(i, log, &current[t->key]))
+            current.erase(t->key);
+        t->kept = true;
+    }
+    this->last.swap(current);
+    PrintDebug("incremental", "Parsed %d and checked %d of %d declarations",
+               numParsed, numChecked, (int)this->decls.size());
+}
+
+/* IncrementalSession::Record
+ * --------------------------
+ * Keeps the errors the i'th declaration's check reported, each relative
+ * to the top-level declaration it points into. Returns false if one of
+ * them can't be placed, in which case the declaration will simply be
+ * checked again next time.
+ */
+bool IncrementalSession::Record(size_t i, const std::vector<LoggedError> &log, ErrorList *errors)
+{
+    errors->resize(log.size());
+    for (size_t j = 0; j < log.size(); j++)
+    {
+        ReusedError *e = &(*errors)[j];
+        e->message = log[j].message;
+        if (!this->Locate(i, log[j].span, &e->at) || !this->Locate(i, log[j].lineOf, &e->lineOf))
+            return false;
+    }
+    return true;
+}
+
+/* IncrementalSession::Locate
+ * --------------------------
+ * A span outside the declaration checked can only be in one that was
+ * checked along with it, which is found again by its name next time.
+ */
+bool IncrementalSession::Locate(size_t i, SourceSpan span, Place *place)
+{
+    place->owner = NoSymbol;
+    place->span = span;
+    if (!span.IsValid())
+        return true;
+
+    size_t lo = 0, hi = this->decls.size();
+    while (hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (this->decls[mid].span.offset <= span.offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    TopDecl *t = &this->decls[lo];
+    if (span.offset < t->span.offset || span.offset + span.length > t->span.offset + t->span.length)
+        return false;
+    if (lo != i)
+    {
+        place->owner = t->decl->id->symbol;
+        if (this->IndexOf(place->owner) != (int)lo)
+            return false;
+    }
+    place->span.offset -= t->span.offset;
+    return true;
+}
+
+bool IncrementalSession::CanReplay(const ErrorList &errors)
+{
+    for (size_t j = 0; j < errors.size(); j++)
+    {
+        if ((errors[j].at.owner != NoSymbol && this->IndexOf(errors[j].at.owner) < 0) ||
+            (errors[j].lineOf.owner != NoSymbol && this->IndexOf(errors[j].lineOf.owner) < 0))
+            return false;
+    }
+    return true;
+}
+
+/* IncrementalSession::Replay
+ * --------------------------
+ * Reports the errors again where they are now. The lines they quote are
+ * only needed until the next version, so they go in the scratch arena.
+ */
+void IncrementalSession::Replay(size_t i, const ErrorList &errors)
+{
+    Arena::SetCurrent(&this->scratch);
+    for (size_t j = 0; j < errors.size(); j++)
+    {
+        const Place *places[2] = { &errors[j].at, &errors[j].lineOf };
+        SourceSpan spans[2];
+        for (int k = 0; k < 2; k++)
+        {
+            spans[k] = places[k]->span;
+            if (spans[k].IsValid())
+            {
+                int o = (places[k]->owner == NoSymbol ? i : this->IndexOf(places[k]->owner));
+                spans[k].offset += this->decls[o].span.offset;
+            }
+        }
+        LoggedError moved = { spans[0], errors[j].message, spans[1] };
+        ReportError::Reissue(moved);
+    }
+    Arena::SetCurrent(this->arena);
+}
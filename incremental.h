@@ -0,0 +1,144 @@
+/* File: incremental.h
+ * -------------------
+ * This file defines the IncrementalSession class, which compiles the
+ * same program over and over as it is edited, the way an editor has it
+ * compiled on every keystroke, and only parses and checks again what an
+ * edit can have changed.
+ *
+ * The session keeps the tree of the last version that parsed, in an
+ * arena of its own. The next version is compared with it: the text both
+ * start and end with is left alone, and only the top-level declarations
+ * the rest of the text touches are parsed again, from the end of the
+ * declaration before them to the start of the one after them. The
+ * declarations after the edit are kept too, their nodes moved along by
+ * however much the text grew or shrank. If that stretch doesn't parse on
+ * its own, the whole program is parsed as usual, which reports its
+ * errors. Either way the parser reads the tokens from a line cache (see
+ * lexcache.h), so only the lines the edit touched are scanned again.
+ *
+ * Each top-level declaration is fingerprinted by the text of its span,
+ * so one that only moved is still the same declaration. Its key adds to
+ * the fingerprint everything else its check depends on: what each type
+ * name it mentions is declared as and, for a class, the fingerprints of
+ * the superclasses and interfaces checked along with it and whether
+ * each of them had already been checked. A declaration whose key was
+ * seen in the last compilation isn't checked again. The errors its check
+ * reported last time are reported again, moved to wherever the spans
+ * they point at are now. If its tree was kept, that is all; a new tree
+ * is only marked checked (see Decl::SkipCheck). A kept declaration that
+ * has to be checked again, or that one checked again would check along
+ * with itself, is parsed again first, since a tree is only checked once.
+ *
+ * Everything is declared again for each version, which is cheap next to
+ * checking it. The errors come out exactly as they would from compiling
+ * the program afresh.
+ */
+
+#ifndef _H_incremental
+#define _H_incremental
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
+#include "lexcache.h"
+#include "location.h"
+#include "symbol.h"
+
+class Decl;
+class Program;
+class SourceFile;
+class StringConstant;
+class CompilationContext;
+struct LoggedError;
+
+class IncrementalSession
+{
+  public:
+    IncrementalSession();
+    ~IncrementalSession();
+
+           // Compiles the context's program as the next version of the
+           // one compiled last (see CompilationContext::Compile)
+    void Compile(CompilationContext *context);
+
+           // Called by the parser (through the context) with each type
+           // name and top-level declaration as for DeclStream
+    void NoteTypeName(Symbol name);
+    void AddDecl(Decl *decl, SourceSpan span);
+
+  private:
+    struct TopDecl {
+        Decl *decl;
+        SourceSpan span;
+        uint64_t fingerprint;         // of the text of span
+        std::vector<Symbol> names;    // the type names it mentions
+        size_t firstNode, endNode;    // its nodes, as the arena has them
+        std::vector<StringConstant*> strings;
+        uint64_t key;                 // as of the last compile
+        bool kept;                    // its tree is from an earlier version
+    };
+
+    struct Place {                    // a span within a top-level declaration
+        Symbol owner;                 // its name, NoSymbol if the one checked
+        SourceSpan span;              // offset from the start of the owner
+    };
+
+    struct ReusedError {
+        Place at, lineOf;
+        std::string message;
+    };
+
+    typedef std::vector<ReusedError> ErrorList;
+
+    static const size_t ArenaSlack = 4*1024*1024;
+
+    CompilationContext *context;
+    Arena *arena;                     // the trees, NULL until one parses
+    Arena scratch;                    // what is built anew for each version
+    Program *program;
+    SourceFile *source;               // the text the trees were parsed from
+    LexCache tokens;                  // of the text compiled last
+    size_t liveBytes;                 // used by the trees when last parsed whole
+    std::vector<TopDecl> decls;       // in order
+    std::unordered_map<uint64_t, ErrorList> last; // by key, from the last compile
+
+    SourceFile *parsing;              // the text of the parse under way
+    std::vector<TopDecl> parsed;      // by that parse
+    std::vector<Symbol> names;        // noted since the last AddDecl
+    size_t nextNode;
+
+    std::vector<int> declaredAs;      // by symbol, index into decls, or -1
+    std::vector<int> reachedStart;    // into reached, for each of decls
+    std::vector<int> reached;         // what each one's key covers
+    std::vector<uint64_t> keys;       // for each of decls
+    std::vector<int> owner;           // whose check checks each one
+    std::vector<char> fresh;          // needs a tree that isn't checked
+
+    bool TryEdit(SourceFile *text);
+    void ParseWhole(SourceFile *text);
+    void Reset();
+    bool Parse(SourceFile *text, int start, int end, bool quietly);
+    bool IsGap(SourceFile *text, int start, int end);
+
+    void Prepare();
+    int IndexOf(Symbol name);
+    Decl *Lookup(Symbol name);
+    int SuperOf(int i);
+    bool FindCycles();
+    void ComputeKeys();
+    void Cascade(int i, int by, std::vector<char> *checked);
+    bool IsHidden(int i, Symbol name);
+    uint64_t HashNames(int i, uint64_t h, const std::vector<char> &checked);
+    void FindFresh();
+    bool Reparse(SourceFile *text);
+    void Check(bool keyed);
+
+    bool Record(size_t i, const std::vector<LoggedError> &log, ErrorList *errors);
+    bool Locate(size_t i, SourceSpan span, Place *place);
+    bool CanReplay(const ErrorList &errors);
+    void Replay(size_t i, const ErrorList &errors);
+};
+
+#endif
@@ -0,0 +1,259 @@
+/* File: ir.cc
+ * -----------
+ * Implementation of the IRFunction and IRProgram classes.
+ */
+
+#include "ir.h"
+#include "utility.h"
+#include <algorithm>
+#include <string.h>
+
+#define IR_OPCODE_INFO(name, text, a, b, c) { text, { a, b, c } },
+const IROpcodeInfo IROpcodes[NumOpcodes] = {
+    IR_OPCODE_TABLE(IR_OPCODE_INFO)
+};
+#undef IR_OPCODE_INFO
+
+
+IRFunction::IRFunction(const std::string &n, int params, IRKind kind)
+{
+    this->name = n;
+    this->numParams = params;
+    this->returnKind = kind;
+    this->current = IRNone;
+}
+
+IRReg IRFunction::NewReg(IRKind kind)
+{
+    this->regKinds.push_back(kind);
+    return this->regKinds.size() - 1;
+}
+
+IRBlock IRFunction::NewBlock()
+{
+    this->blockFirst.push_back(IRNone);
+    this->blockCount.push_back(0);
+    return this->blockFirst.size() - 1;
+}
+
+void IRFunction::StartBlock(IRBlock b)
+{
+    Assert(this->blockFirst[b] == IRNone);
+    if (this->current != IRNone)
+        this->Emit(OpJump, IRNone, b);
+    this->blockFirst[b] = this->ops.size();
+    this->current = b;
+}
+
+/* IRFunction::Emit
+ * ----------------
+ * A jump, branch or return ends the block. The first instruction of a
+ * function starts its entry block, which is block 0.
+ */
+IRInstr IRFunction::Emit(IROpcode op, IRReg dest, uint32_t a, uint32_t b, uint32_t c)
+{
+    if (this->current == IRNone)
+        this->StartBlock(this->NewBlock());
+    IRInstr i = this->ops.size();
+    this->ops.push_back(op);
+    this->dests.push_back(dest);
+    this->as.push_back(a);
+    this->bs.push_back(b);
+    this->cs.push_back(c);
+    this->blockCount[this->current]++;
+    if (op == OpJump || op == OpBranch || op == OpReturn)
+        this->current = IRNone;
+    return i;
+}
+
+IRInstr IRFunction::EmitCall(IROpcode op, IRReg dest, uint32_t callee, const std::vector<IRReg> &actuals)
+{
+    uint32_t first = this->args.size();
+    this->args.insert(this->args.end(), actuals.begin(), actuals.end());
+    return this->Emit(op, dest, callee, first, actuals.size());
+}
+
+void IRFunction::GetReads(IRInstr i, std::vector<IRReg> *regs)
+{
+    const IROpcodeInfo *info = &IROpcodes[this->ops[i]];
+    uint32_t fields[3] = { this->as[i], this->bs[i], this->cs[i] };
+    for (int j = 0; j < 3; j++) {
+        if (info->operands[j] == OperandReg && fields[j] != IRNone)
+            regs->push_back(fields[j]);
+        else if (info->operands[j] == OperandArgs)
+            regs->insert(regs->end(), this->args.begin() + fields[j], this->args.begin() + fields[j] + this->cs[i]);
+    }
+}
+
+
+IRProgram::IRProgram()
+{
+    this->main = IRNone;
+}
+
+IRProgram::~IRProgram()
+{
+    for (size_t i = 0; i < this->functions.size(); i++)
+        delete this->functions[i];
+}
+
+uint32_t IRProgram::AddFunction(IRFunction *fn)
+{
+    this->functions.push_back(fn);
+    return this->functions.size() - 1;
+}
+
+void IRProgram::SetFunction(int n, IRFunction *fn)
+{
+    delete this->functions[n];
+    this->functions[n] = fn;
+}
+
+uint32_t IRProgram::AddClass(const IRClass &cls)
+{
+    this->classes.push_back(cls);
+    return this->classes.size() - 1;
+}
+
+uint32_t IRProgram::AddGlobal(Symbol name, IRKind kind)
+{
+    IRGlobal g = { name, kind };
+    this->globals.push_back(g);
+    return this->globals.size() - 1;
+}
+
+uint32_t IRProgram::AddString(const std::string &s)
+{
+    std::unordered_map<std::string, uint32_t>::iterator found = this->stringIndex.find(s);
+    if (found != this->stringIndex.end())
+        return found->second;
+    this->strings.push_back(s);
+    return this->stringIndex[s] = this->strings.size() - 1;
+}
+
+uint32_t IRProgram::AddDouble(double d)
+{
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    std::unordered_map<uint64_t, uint32_t>::iterator found = this->doubleIndex.find(bits);
+    if (found != this->doubleIndex.end())
+        return found->second;
+    this->doubles.push_back(d);
+    return this->doubleIndex[bits] = this->doubles.size() - 1;
+}
+
+uint32_t IRProgram::AddSelector(Symbol name)
+{
+    std::unordered_map<Symbol, uint32_t>::iterator found = this->selectorIndex.find(name);
+    if (found != this->selectorIndex.end())
+        return found->second;
+    this->selectors.push_back(name);
+    this->selectorColors.push_back(IRNone);
+    return this->selectorIndex[name] = this->selectors.size() - 1;
+}
+
+/* IRProgram::Operand
+ * ------------------
+ * The text of one operand of instruction i, as its opcode gives its kind.
+ * A call's arguments are printed together, in place of the index of the
+ * first of them.
+ */
+std::string IRProgram::Operand(IRFunction *fn, IRInstr i, IROperand kind, uint32_t value)
+{
+    char buf[64];
+    switch (kind) {
+      case OperandReg:
+        snprintf(buf, sizeof(buf), "r%u", value);
+        return buf;
+      case OperandImm:
+        snprintf(buf, sizeof(buf), "%d", (int)value);
+        return buf;
+      case OperandDouble:
+        snprintf(buf, sizeof(buf), "%g", this->doubles[value]);
+        return buf;
+      case OperandString: {
+        std::string text = "\"";
+        for (size_t n = 0; n < this->strings[value].size(); n++) {
+            char c = this->strings[value][n];
+            text += (c == '\n' ? "\\n" : c == '\t' ? "\\t" : c == '\\' ? "\\\\" : std::string(1, c));
+        }
+        return text + "\"";
+      }
+      case OperandBlock:
+        snprintf(buf, sizeof(buf), "B%u", value);
+        return buf;
+      case OperandFunction:
+        return this->functions[value]->GetName();
+      case OperandGlobal:
+        return SymbolName(this->globals[value].name);
+      case OperandClass:
+        return SymbolName(this->classes[value].name);
+      case OperandSelector:
+        return SymbolName(this->selectors[value]);
+      case OperandArgs: {
+        std::string list = "(";
+        for (uint32_t n = 0; n < fn->GetC(i); n++)
+            list += (n > 0 ? ", " : "") + this->Operand(fn, i, OperandReg, fn->GetArg(i, n));
+        return list + ")";
+      }
+      default:
+        return "";
+    }
+}
+
+/* IRProgram::Print
+ * ----------------
+ * Each class is printed with its method table and what's in its interface
+ * table, then each function with its blocks in the order their code is
+ * laid out in.
+ */
+void IRProgram::Print()
+{
+    for (size_t n = 0; n < this->classes.size(); n++) {
+        IRClass *cls = &this->classes[n];
+        std::string line = std::string("class ") + SymbolName(cls->name);
+        if (cls->superclass != IRNone)
+            line += std::string(" extends ") + SymbolName(this->classes[cls->superclass].name);
+        char size[32];
+        snprintf(size, sizeof(size), ", %d bytes", cls->objectSize);
+        PrintDebug("ir", "%s%s", line.c_str(), size);
+        for (size_t slot = 0; slot < cls->methods.size(); slot++)
+            PrintDebug("ir", "    [%d] %s", (int)slot, this->functions[cls->methods[slot]]->GetName().c_str());
+        for (size_t color = 0; color < cls->interfaceMethods.size(); color++) {
+            if (cls->interfaceMethods[color] != IRNone)
+                PrintDebug("ir", "    <%d> %s", (int)color, this->functions[cls->interfaceMethods[color]]->GetName().c_str());
+        }
+    }
+    for (size_t n = 0; n < this->functions.size(); n++) {
+        IRFunction *fn = this->functions[n];
+        if (!fn->HasCode())
+            continue;
+        PrintDebug("ir", "function %s, %d params, %d registers", fn->GetName().c_str(),
+                   fn->NumParams(), fn->NumRegs());
+        std::vector<std::pair<IRInstr, IRBlock> > order;
+        for (int b = 0; b < fn->NumBlocks(); b++)
+            order.push_back(std::make_pair(fn->BlockStart(b), (IRBlock)b));
+        std::sort(order.begin(), order.end());
+        for (size_t k = 0; k < order.size(); k++) {
+            IRBlock b = order[k].second;
+            PrintDebug("ir", "  B%u:", b);
+            for (IRInstr i = fn->BlockStart(b); i < fn->BlockEnd(b); i++) {
+                const IROpcodeInfo *info = &IROpcodes[fn->GetOp(i)];
+                std::string line = "    ";
+                if (fn->GetDest(i) != IRNone)
+                    line += this->Operand(fn, i, OperandReg, fn->GetDest(i)) + " = ";
+                line += info->name;
+                uint32_t values[3] = { fn->GetA(i), fn->GetB(i), fn->GetC(i) };
+                const char *separator = " ";
+                for (int j = 0; j < 3; j++) {
+                    IROperand kind = info->operands[j];
+                    if (kind == OperandNone || kind == OperandCount || (kind == OperandReg && values[j] == IRNone))
+                        continue;
+                    line += (kind == OperandArgs ? "" : separator) + this->Operand(fn, i, kind, values[j]);
+                    separator = ", ";
+                }
+                PrintDebug("ir", "%.2000s", line.c_str());   // as much as fits
+            }
+        }
+    }
+}
@@ -0,0 +1,309 @@
+/* File: ir.h
+ * ----------
+ * This file defines the intermediate representation that checked
+ * programs are lowered to (see lower.h), for the optimizer and the code
+ * generators to work from. It is a linear three-address code: each
+ * instruction does one thing to at most three operands and puts what it
+ * computes in a register of its own, and control only ever leaves a
+ * basic block through the jump, branch or return at its end.
+ *
+ * A function's registers are numbered from 0, its parameters first (for
+ * a method, the object it is called on, then the formals), and every
+ * local variable and every intermediate value gets one. Each register
+ * holds values of one kind: an int (which includes a bool), a double or
+ * a reference (to a string, an object or an array, or null).
+ *
+ * Instructions aren't objects of their own. A function keeps one array
+ * for each of their fields, the opcode, the register written and the
+ * three operands, and an instruction is just its index in them. The
+ * instructions of a basic block are consecutive, so a block is just its
+ * first instruction and how many there are. Registers, instructions,
+ * blocks, functions, classes and constants are all numbered with 32-bit
+ * indexes rather than linked by pointers, so the whole thing is compact
+ * and walking it touches memory in order.
+ *
+ * What an operand means depends on the opcode, as the table below gives
+ * it: a register, an immediate int, a block, or an index into one of the
+ * program's tables. A call's arguments don't fit in the operands, so
+ * they are kept in an array of registers of their own, and the call has
+ * the index of the first of them and how many there are.
+ */
+
+#ifndef _H_ir
+#define _H_ir
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "symbol.h"
+
+typedef uint32_t IRReg;
+typedef uint32_t IRBlock;
+typedef uint32_t IRInstr;
+
+static const uint32_t IRNone = 0xffffffff;   // no register, or no index
+
+typedef enum { IRInt, IRDouble, IRRef, IRVoid } IRKind;
+
+typedef enum {
+    OperandNone,
+    OperandReg,
+    OperandImm,        // an int (for a field, its offset in the object)
+    OperandDouble,     // in the program's doubles
+    OperandString,     // in the program's strings
+    OperandBlock,
+    OperandFunction,   // in the program's functions
+    OperandGlobal,     // in the program's globals
+    OperandClass,      // in the program's classes
+    OperandSelector,   // in the program's selectors
+    OperandArgs,       // the first of the call's arguments
+    OperandCount       // how many arguments there are
+} IROperand;
+
+
+/* Table: IR_OPCODE_TABLE
+ * ----------------------
+ * Each opcode, with the name it is printed as and what each of its three
+ * operands is. Whether it writes a register is up to the instruction:
+ * the register is IRNone if it doesn't, as for a call whose value isn't
+ * wanted. Comparisons give an int, 1 or 0, and there are only those for
+ * less than and less or equal, a greater than comparison having its
+ * operands the other way around. The loads and stores of array elements
+ * check the subscript, and NewArray checks the size, stopping the program
+ * with an error if either is out of bounds.
+ */
+#define IR_OPCODE_TABLE(OP)                                                    \
+    OP(Const,         "const",         OperandImm,      OperandNone,  OperandNone)  \
+    OP(DConst,        "dconst",        OperandDouble,   OperandNone,  OperandNone)  \
+    OP(SConst,        "sconst",        OperandString,   OperandNone,  OperandNone)  \
+    OP(Move,          "move",          OperandReg,      OperandNone,  OperandNone)  \
+    OP(Add,           "add",           OperandReg,      OperandReg,   OperandNone)  \
+    OP(Sub,           "sub",           OperandReg,      OperandReg,   OperandNone)  \
+    OP(Mul,           "mul",           OperandReg,      OperandReg,   OperandNone)  \
+    OP(Div,           "div",           OperandReg,      OperandReg,   OperandNone)  \
+    OP(Mod,           "mod",           OperandReg,      OperandReg,   OperandNone)  \
+    OP(Neg,           "neg",           OperandReg,      OperandNone,  OperandNone)  \
+    OP(DAdd,          "dadd",          OperandReg,      OperandReg,   OperandNone)  \
+    OP(DSub,          "dsub",          OperandReg,      OperandReg,   OperandNone)  \
+    OP(DMul,          "dmul",          OperandReg,      OperandReg,   OperandNone)  \
+    OP(DDiv,          "ddiv",          OperandReg,      OperandReg,   OperandNone)  \
+    OP(DNeg,          "dneg",          OperandReg,      OperandNone,  OperandNone)  \
+    OP(Lt,            "lt",            OperandReg,      OperandReg,   OperandNone)  \
+    OP(Le,            "le",            OperandReg,      OperandReg,   OperandNone)  \
+    OP(Eq,            "eq",            OperandReg,      OperandReg,   OperandNone)  \
+    OP(Ne,            "ne",            OperandReg,      OperandReg,   OperandNone)  \
+    OP(DLt,           "dlt",           OperandReg,      OperandReg,   OperandNone)  \
+    OP(DLe,           "dle",           OperandReg,      OperandReg,   OperandNone)  \
+    OP(DEq,           "deq",           OperandReg,      OperandReg,   OperandNone)  \
+    OP(DNe,           "dne",           OperandReg,      OperandReg,   OperandNone)  \
+    OP(SEq,           "seq",           OperandReg,      OperandReg,   OperandNone)  \
+    OP(And,           "and",           OperandReg,      OperandReg,   OperandNone)  \
+    OP(Or,            "or",            OperandReg,      OperandReg,   OperandNone)  \
+    OP(Not,           "not",           OperandReg,      OperandNone,  OperandNone)  \
+    OP(LoadField,     "loadfield",     OperandReg,      OperandImm,   OperandNone)  \
+    OP(StoreField,    "storefield",    OperandReg,      OperandImm,   OperandReg)   \
+    OP(LoadElem,      "loadelem",      OperandReg,      OperandReg,   OperandNone)  \
+    OP(StoreElem,     "storeelem",     OperandReg,      OperandReg,   OperandReg)   \
+    OP(Length,        "length",        OperandReg,      OperandNone,  OperandNone)  \
+    OP(LoadGlobal,    "loadglobal",    OperandGlobal,   OperandNone,  OperandNone)  \
+    OP(StoreGlobal,   "storeglobal",   OperandGlobal,   OperandReg,   OperandNone)  \
+    OP(New,           "new",           OperandClass,    OperandNone,  OperandNone)  \
+    OP(NewArray,      "newarray",      OperandReg,      OperandNone,  OperandNone)  \
+    OP(Call,          "call",          OperandFunction, OperandArgs,  OperandCount) \
+    OP(CallVirtual,   "callvirtual",   OperandImm,      OperandArgs,  OperandCount) \
+    OP(CallInterface, "callinterface", OperandSelector, OperandArgs,  OperandCount) \
+    OP(PrintInt,      "printint",      OperandReg,      OperandNone,  OperandNone)  \
+    OP(PrintBool,     "printbool",     OperandReg,      OperandNone,  OperandNone)  \
+    OP(PrintString,   "printstring",   OperandReg,      OperandNone,  OperandNone)  \
+    OP(ReadInteger,   "readinteger",   OperandNone,     OperandNone,  OperandNone)  \
+    OP(ReadLine,      "readline",      OperandNone,     OperandNone,  OperandNone)  \
+    OP(Jump,          "jump",          OperandBlock,    OperandNone,  OperandNone)  \
+    OP(Branch,        "branch",        OperandReg,      OperandBlock, OperandBlock) \
+    OP(Return,        "return",        OperandReg,      OperandNone,  OperandNone)
+
+#define IR_OPCODE(name, text, a, b, c) Op##name,
+typedef enum {
+    IR_OPCODE_TABLE(IR_OPCODE)
+    NumOpcodes
+} IROpcode;
+#undef IR_OPCODE
+
+struct IROpcodeInfo
+{
+    const char *name;
+    IROperand operands[3];
+};
+
+extern const IROpcodeInfo IROpcodes[NumOpcodes];
+
+
+/* Class: IRFunction
+ * -----------------
+ * The code of one function or method. Its instructions are appended to
+ * the block being built, and a block is started once the one before it
+ * is finished, so the instructions of each block come out consecutive.
+ * Blocks are numbered as they are made, which needn't be the order they
+ * are built in, so a jump can go to a block that hasn't been started.
+ *
+ * A function declared in a snapshot (see snapshot.h) has no code here,
+ * only its name and signature, and is found by name where it's defined.
+ */
+class IRFunction
+{
+  public:
+    IRFunction(const std::string &name, int numParams, IRKind returnKind);
+
+    const std::string &GetName() { return name; }
+    int NumParams()              { return numParams; }
+    IRKind GetReturnKind()       { return returnKind; }
+    bool HasCode()               { return !ops.empty(); }
+
+    int NumRegs()                { return regKinds.size(); }
+    IRKind GetRegKind(IRReg r)   { return (IRKind)regKinds[r]; }
+    IRReg NewReg(IRKind kind);
+
+    int NumInstrs()              { return ops.size(); }
+    IROpcode GetOp(IRInstr i)    { return (IROpcode)ops[i]; }
+    IRReg GetDest(IRInstr i)     { return dests[i]; }
+    uint32_t GetA(IRInstr i)     { return as[i]; }
+    uint32_t GetB(IRInstr i)     { return bs[i]; }
+    uint32_t GetC(IRInstr i)     { return cs[i]; }
+    IRReg GetArg(IRInstr i, int n) { return args[bs[i] + n]; }
+
+           // Appends the registers instruction i reads to regs, in the
+           // order of its operands and then its arguments
+    void GetReads(IRInstr i, std::vector<IRReg> *regs);
+
+    int NumBlocks()              { return blockFirst.size(); }
+    IRInstr BlockStart(IRBlock b) { return blockFirst[b]; }
+    IRInstr BlockEnd(IRBlock b)  { return blockFirst[b] + blockCount[b]; }
+
+           // NewBlock numbers a block to be built later. StartBlock
+           // starts building it, first ending the one being built with a
+           // jump to it if that isn't ended already.
+    IRBlock NewBlock();
+    void StartBlock(IRBlock b);
+
+           // Returns whether the block being built has been ended with a
+           // jump, branch or return
+    bool IsBlockEnded()          { return current == IRNone; }
+
+           // Appends an instruction to the block being built. Code after
+           // the end of a block (after a return, say) can't be reached,
+           // and goes in a block of its own that nothing jumps to.
+    IRInstr Emit(IROpcode op, IRReg dest, uint32_t a = IRNone, uint32_t b = IRNone, uint32_t c = IRNone);
+    IRInstr EmitCall(IROpcode op, IRReg dest, uint32_t callee, const std::vector<IRReg> &actuals);
+
+  private:
+    std::string name;
+    int numParams;
+    IRKind returnKind;
+    std::vector<uint8_t> regKinds;
+
+    std::vector<uint8_t> ops;        // the instructions, one field each
+    std::vector<IRReg> dests;
+    std::vector<uint32_t> as, bs, cs;
+    std::vector<IRReg> args;         // of the calls, in runs
+
+    std::vector<IRInstr> blockFirst; // the blocks, by number
+    std::vector<uint32_t> blockCount;
+    IRBlock current;                 // being built, or IRNone
+};
+
+
+/* Type: IRClass
+ * -------------
+ * A class, as its objects are laid out (see layout.h): how big they are,
+ * the method in each slot of its method table and its name, and the
+ * method for each selector's color in its interface table (see
+ * IRProgram).
+ */
+struct IRClass
+{
+    Symbol name;
+    uint32_t superclass;             // in the classes, or IRNone
+    int objectSize;
+    std::vector<uint32_t> methods;   // in the functions, by slot
+    std::vector<Symbol> methodNames; // by slot
+    std::vector<uint32_t> interfaceMethods;   // by color, or IRNone
+};
+
+struct IRGlobal
+{
+    Symbol name;
+    IRKind kind;
+};
+
+
+/* Class: IRProgram
+ * ----------------
+ * The functions of a program, with the tables they refer to: its classes,
+ * its global variables, and the constants too big for an operand. The
+ * selectors are the names of the methods called through interfaces.
+ *
+ * Each selector has a color, its place in the interface tables, and no
+ * two selectors that a class has methods for share one, so a method is
+ * found in constant time, at its selector's place in the table of the
+ * object's class, while the tables stay as short as the coloring makes
+ * them. Every class's table has a place for every color.
+ */
+class IRProgram
+{
+  public:
+    IRProgram();
+    ~IRProgram();
+
+    uint32_t AddFunction(IRFunction *fn);
+    int NumFunctions()               { return functions.size(); }
+    IRFunction *GetFunction(int n)   { return functions[n]; }
+    void SetFunction(int n, IRFunction *fn);   // deletes the one replaced
+
+           // The function the program starts at, or IRNone if there is
+           // none called main
+    uint32_t GetMain()               { return main; }
+    void SetMain(uint32_t n)         { main = n; }
+
+    uint32_t AddClass(const IRClass &cls);
+    int NumClasses()                 { return classes.size(); }
+    IRClass *GetClass(int n)         { return &classes[n]; }
+
+    uint32_t AddGlobal(Symbol name, IRKind kind);
+    int NumGlobals()                 { return globals.size(); }
+    IRGlobal *GetGlobal(int n)       { return &globals[n]; }
+
+           // Each of these returns the index of the one entry for its
+           // value, adding it the first time
+    uint32_t AddString(const std::string &s);
+    uint32_t AddDouble(double d);
+    uint32_t AddSelector(Symbol name);
+
+    const std::string &GetString(int n) { return strings[n]; }
+    double GetDouble(int n)          { return doubles[n]; }
+    Symbol GetSelector(int n)        { return selectors[n]; }
+    uint32_t GetSelectorColor(int n) { return selectorColors[n]; }
+    void SetSelectorColor(int n, uint32_t color) { selectorColors[n] = color; }
+    int NumStrings()                 { return strings.size(); }
+    int NumDoubles()                 { return doubles.size(); }
+    int NumSelectors()               { return selectors.size(); }
+
+           // Prints the whole program through the "ir" debug key
+    void Print();
+
+  private:
+    std::vector<IRFunction*> functions;
+    uint32_t main;
+    std::vector<IRClass> classes;
+    std::vector<IRGlobal> globals;
+    std::vector<std::string> strings;
+    std::vector<double> doubles;
+    std::vector<Symbol> selectors;
+    std::vector<uint32_t> selectorColors;
+    std::unordered_map<std::string, uint32_t> stringIndex;
+    std::unordered_map<uint64_t, uint32_t> doubleIndex;   // by their bits
+    std::unordered_map<Symbol, uint32_t> selectorIndex;
+
+    std::string Operand(IRFunction *fn, IRInstr i, IROperand kind, uint32_t value);
+};
+
+#endif
@@ -0,0 +1,53 @@
+/* File: layout.cc
+ * ---------------
+ * Implementation of the ClassLayout class.
+ */
+
+#include "layout.h"
+#include "ast_decl.h"
+
+ClassLayout::ClassLayout(ClassDecl *c, ClassLayout *s)
+{
+    Assert(c != NULL);
+    cls = c;
+    super = s;
+    int maxFields = (super ? super->numFields : 0) + c->members->NumElements();
+    int maxMethods = (super ? super->numMethods : 0) + c->members->NumElements();
+    fields = (VarDecl **)Arena::Current()->Alloc(maxFields * sizeof(fields[0]));
+    methods = (FnDecl **)Arena::Current()->Alloc(maxMethods * sizeof(methods[0]));
+    numFields = numMethods = 0;
+    if (super != NULL) {
+        for (int i = 0; i < super->numFields; i++)
+            fields[numFields++] = super->fields[i];
+        for (int i = 0; i < super->numMethods; i++)
+            methods[numMethods++] = super->methods[i];
+    }
+
+    // Own members that conflict with each other or with an inherited
+    // member (other than by overriding a method) are left out
+    Hashtable<Decl*> *own = c->GetMembers();
+    for (int i = 0; i < c->members->NumElements(); i++) {
+        Decl *member = c->members->Nth(i);
+        if (own->Lookup(member->id->symbol) != member)
+            continue;
+        Decl *prev = (super ? super->Lookup(member->id->symbol) : NULL);
+        VarDecl *field = DynCast<VarDecl>(member);
+        FnDecl *method = DynCast<FnDecl>(member);
+        if (field != NULL && prev == NULL) {
+            field->SetOffset(GetFieldOffset(numFields));
+            fields[numFields++] = field;
+        } else if (method != NULL && prev == NULL) {
+            method->SetSlot(numMethods);
+            methods[numMethods++] = method;
+        } else if (method != NULL && DynCast<FnDecl>(prev) != NULL) {
+            int slot = DynCast<FnDecl>(prev)->GetSlot();
+            method->SetSlot(slot);
+            methods[slot] = method;
+        }
+    }
+}
+
+Decl *ClassLayout::Lookup(Symbol name)
+{
+    return cls->GetScope()->LookupMember(name);
+}
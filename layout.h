@@ -0,0 +1,63 @@
+/* File: layout.h
+ * --------------
+ * A ClassLayout is the flattened, fixed shape of the objects of a class:
+ * the offset of each field, inherited ones first, and the method table
+ * with one slot per method, where an overriding method takes over the
+ * slot of the method it overrides. Each class's layout is computed once,
+ * from its superclass's layout and its own members, and never changes
+ * after that, so subclasses and later phases can all share it.
+ *
+ * An object starts with a pointer to its class's method table, followed
+ * by one word for each field.
+ */
+
+#ifndef _H_layout
+#define _H_layout
+
+#include "symbol.h"
+#include "arena.h"
+
+class Decl;
+class VarDecl;
+class FnDecl;
+class ClassDecl;
+
+class ClassLayout
+{
+  public:
+    static const int WordSize = 8;
+
+           // Lays out the members of cls after those of super (which
+           // is NULL if cls doesn't extend another class). cls's own
+           // members must already have been declared.
+    ClassLayout(ClassDecl *cls, ClassLayout *super);
+
+    ClassDecl *GetClass()    { return cls; }
+    ClassLayout *GetSuper()  { return super; }
+
+           // Returns the member of the class (own or inherited) with the
+           // given name, or NULL if there is none
+    Decl *Lookup(Symbol name);
+
+    int NumFields()          { return numFields; }
+    VarDecl *GetField(int i) { return fields[i]; }
+    int GetFieldOffset(int i) { return (i + 1) * WordSize; }
+    int GetObjectSize()      { return (numFields + 1) * WordSize; }
+
+    int NumMethods()           { return numMethods; }
+    FnDecl *GetMethod(int slot) { return methods[slot]; }
+
+    static void *operator new(size_t size)
+        { return Arena::Current()->Alloc(size); }
+    static void operator delete(void *) {}
+
+  private:
+    ClassDecl *cls;
+    ClassLayout *super;
+    VarDecl **fields;
+    int numFields;
+    FnDecl **methods;
+    int numMethods;
+};
+
+#endif
@@ -0,0 +1,231 @@
+/* File: lexcache.cc
+ * -----------------
+ * Implementation of the LexCache and TokenReader classes.
+ */
+
+#include "lexcache.h"
+#include "context.h"
+#include "errors.h"
+#include "utility.h"
+#include <algorithm>
+
+  // Defined in the generated lex.yy.c file
+int yylex(YYSTYPE *yylval, yyltype *yylloc, yyscan_t scanner);
+
+LexCache::LexCache()
+{
+}
+
+/* LexCache::Update
+ * ----------------
+ * Scans from the start of the line the edit begins on, a line at a time,
+ * until a line is reached in the text both versions end with that starts
+ * where one did before, give or take the change in length, and in the
+ * same mode. The errors the scan reports are only noted against their
+ * lines, the reader reports them.
+ */
+void LexCache::Update(SourceFile *source)
+{
+    const char *newText = source->GetText();
+    int oldLength = this->text.length(), newLength = source->GetLength();
+    int limit = std::min(oldLength, newLength);
+    int prefix = CommonPrefix(this->text.data(), newText, limit);
+    int suffix = CommonSuffix(this->text.data() + oldLength, newText + newLength, limit - prefix);
+    int delta = newLength - oldLength;
+    if (!this->lines.empty() && prefix == oldLength && prefix == newLength)
+        return;
+
+    size_t first = (this->lines.empty() ? 0 : this->LineOf(prefix));
+    Line current;
+    current.start = (first < this->lines.size() ? this->lines[first].start : 0);
+    current.mode = (first < this->lines.size() ? this->lines[first].mode : ScanNormal);
+    current.hasErrors = false;
+
+    CompilationContext *context = CompilationContext::Current();
+    ReportError::BeginOrdered();
+    yyscan_t scanner = InitLineScanner(source, current.start, newLength, first + 1, current.mode);
+    std::vector<Line> scanned;
+    size_t kept = this->lines.size(), k = first + 1;
+    for (;;)
+    {
+        YYSTYPE lval;
+        yyltype lloc;
+        int numErrors = context->NumErrors();
+        int code = yylex(&lval, &lloc, scanner);
+        if (context->NumErrors() != numErrors)
+            current.hasErrors = true;
+        if (code == 0)
+            break;
+        if (code != '\n')
+        {
+            CachedToken t = { code, lloc.offset - current.start, lloc.length,
+                              lloc.first_column, lloc.last_column, lval };
+            current.tokens.push_back(t);
+            continue;
+        }
+        scanned.push_back(std::move(current));
+        current = Line();
+        current.start = lloc.offset + 1;
+        current.mode = GetScanMode(scanner);
+        current.hasErrors = false;
+        if (current.start < newLength - suffix)
+            continue;
+        while (k < this->lines.size() && this->lines[k].start < current.start - delta)
+            k++;
+        if (k < this->lines.size() && this->lines[k].start == current.start - delta &&
+            this->lines[k].mode == current.mode)
+        {
+            kept = k;
+            break;
+        }
+    }
+    if (kept == this->lines.size())
+        scanned.push_back(std::move(current));
+    FreeScanner(scanner);
+    ReportError::DiscardOrdered();
+
+    this->lines.erase(this->lines.begin() + std::min(first, this->lines.size()), this->lines.begin() + kept);
+    this->lines.insert(this->lines.begin() + first, std::make_move_iterator(scanned.begin()),
+                       std::make_move_iterator(scanned.end()));
+    for (size_t i = first + scanned.size(); i < this->lines.size() && delta != 0; i++)
+        this->lines[i].start += delta;
+    this->text.replace(prefix, oldLength - prefix - suffix, newText + prefix, newLength - prefix - suffix);
+
+    PrintDebug("incremental", "Scanned %d of %d lines", (int)scanned.size(), (int)this->lines.size());
+}
+
+/* LexCache::IsTokenBoundary
+ * -------------------------
+ * Nothing is known of the lines with errors, which are never kept.
+ */
+bool LexCache::IsTokenBoundary(int offset)
+{
+    if (offset == 0 || offset == (int)this->text.length())
+        return true;
+    Line *line = &this->lines[this->LineOf(offset)];
+    if (line->hasErrors)
+        return false;
+    offset -= line->start;
+    for (size_t i = 0; i < line->tokens.size() && line->tokens[i].offset <= offset; i++)
+    {
+        if (line->tokens[i].offset == offset || line->tokens[i].offset + line->tokens[i].length == offset)
+            return true;
+    }
+    return false;
+}
+
+int LexCache::LineOf(int offset)
+{
+    size_t lo = 0, hi = this->lines.size() - 1;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi + 1) / 2;
+        if (this->lines[mid].start <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+
+TokenReader::TokenReader(LexCache *c, SourceFile *t, int s, int e)
+{
+    this->cache = c;
+    this->text = t;
+    this->start = s;
+    this->end = e;
+    this->line = (c->lines.empty() ? 0 : c->LineOf(s));
+    this->token = 0;
+    this->scanner = NULL;
+}
+
+TokenReader::~TokenReader()
+{
+    if (this->scanner != NULL)
+        FreeScanner(this->scanner);
+}
+
+/* TokenReader::NextToken
+ * ----------------------
+ * A line with errors is scanned again from where the reading starts, if
+ * that is partway along it, to where it stops, if that comes first.
+ * String constants are views into the text, so theirs are made anew.
+ */
+int TokenReader::NextToken(YYSTYPE *lval, yyltype *lloc)
+{
+    std::vector<LexCache::Line> &lines = this->cache->lines;
+    while (this->line < lines.size())
+    {
+        LexCache::Line *l = &lines[this->line];
+        if (l->start > this->end || (l->start == this->end && !l->hasErrors))
+            break;      // an empty last line can still end in a comment
+        if (this->scanner != NULL)
+        {
+            int code = yylex(lval, lloc, this->scanner);
+            if (code != 0 && code != '\n')
+                return code;
+            FreeScanner(this->scanner);
+            this->scanner = NULL;
+            this->line++;
+            this->token = 0;
+        }
+        else if (l->hasErrors)
+        {
+            int from = std::max(l->start, this->start);
+            int to = (this->line + 1 < lines.size() ? lines[this->line + 1].start : this->text->GetLength());
+            this->scanner = InitLineScanner(this->text, from, std::min(to, this->end), this->line + 1,
+                                            from == l->start ? l->mode : ScanNormal);
+        }
+        else if (this->token < l->tokens.size())
+        {
+            LexCache::CachedToken *t = &l->tokens[this->token++];
+            int offset = l->start + t->offset;
+            if (offset < this->start)
+                continue;
+            if (offset >= this->end)
+                break;
+            *lval = t->value;
+            if (t->code == T_StringConstant)
+                lval->stringConstant = this->text->GetLexeme(offset, t->length);
+            lloc->first_line = this->line + 1;
+            lloc->first_column = t->firstColumn;
+            lloc->last_column = t->lastColumn;
+            lloc->offset = offset;
+            lloc->length = t->length;
+            return t->code;
+        }
+        else
+        {
+            this->line++;
+            this->token = 0;
+        }
+    }
+    return this->Finish(lloc);
+}
+
+/* TokenReader::Finish
+ * -------------------
+ * At the end of the input the scanner leaves the location of whatever it
+ * matched last, token or not, and a syntax error there points at it, so
+ * the last line is scanned again, quietly, to find it.
+ */
+int TokenReader::Finish(yyltype *lloc)
+{
+    int last = std::min(this->end, this->text->GetLength()) - 1;
+    if (last < this->start)
+        return 0;
+    size_t i = this->cache->LineOf(last);
+    LexCache::Line *l = &this->cache->lines[i];
+    int from = std::max(l->start, this->start);
+    ReportError::SetQuiet(true);
+    yyscan_t lineScanner = InitLineScanner(this->text, from, last + 1, i + 1,
+                                           from == l->start ? l->mode : ScanNormal);
+    YYSTYPE lval;
+    int code;
+    while ((code = yylex(&lval, lloc, lineScanner)) != 0 && code != '\n')
+        ;
+    FreeScanner(lineScanner);
+    ReportError::SetQuiet(false);
+    return 0;
+}
@@ -0,0 +1,87 @@
+/* File: lexcache.h
+ * ----------------
+ * This file defines the LexCache class, which keeps the tokens of a
+ * program line by line so that as it is edited, only the lines an edit
+ * changed are scanned again, and the TokenReader class, which hands the
+ * kept tokens to the parser in place of the scanner.
+ *
+ * Along with the tokens of each line, the cache keeps the mode the
+ * scanner was in at its start (see ScanMode). After an edit, lines are
+ * scanned again from the first one that changed until one is reached
+ * that the edit didn't touch and that starts in the same mode as it did
+ * before. That line and every one after it would scan just as they did,
+ * so their tokens are kept, moved along by however much the text grew or
+ * shrank.
+ *
+ * A line whose scan reported an error is scanned again whenever it is
+ * read, so that the error is reported just where the scanner would have
+ * reported it among the parser's own.
+ */
+
+#ifndef _H_lexcache
+#define _H_lexcache
+
+#include <string>
+#include <vector>
+#include "parser.h"   // for YYSTYPE and yyscan_t
+
+class LexCache
+{
+  public:
+    LexCache();
+
+           // Brings the tokens up to date with text, the next version
+           // of the program
+    void Update(SourceFile *text);
+
+           // Returns whether a token is known to start or end at offset,
+           // so that a scan starting or stopping there cuts none short
+    bool IsTokenBoundary(int offset);
+
+  private:
+    friend class TokenReader;
+
+    struct CachedToken {
+        int code;                    // as yylex returns it
+        int offset, length;          // offset from the start of the line
+        int firstColumn, lastColumn;
+        YYSTYPE value;               // but for string constants
+    };
+
+    struct Line {
+        int start;
+        ScanMode mode;               // the scanner's, at the start
+        bool hasErrors;              // is scanned again when read
+        std::vector<CachedToken> tokens;
+    };
+
+    std::string text;                // what the lines were scanned from
+    std::vector<Line> lines;
+
+    int LineOf(int offset);
+};
+
+
+class TokenReader
+{
+  public:
+           // Reads the tokens of text, which the cache must be up to
+           // date with, from start up to end. Both must be token
+           // boundaries (see LexCache::IsTokenBoundary).
+    TokenReader(LexCache *cache, SourceFile *text, int start, int end);
+    ~TokenReader();
+
+           // Called by yylex for a scanner made for the reader
+    int NextToken(YYSTYPE *lval, yyltype *lloc);
+
+  private:
+    LexCache *cache;
+    SourceFile *text;
+    int start, end;
+    size_t line, token;              // the next token to read
+    yyscan_t scanner;                // scanning a line again, or NULL
+
+    int Finish(yyltype *lloc);
+};
+
+#endif
@@ -30,18 +30,25 @@
 
 #include <deque>
 #include "utility.h"  // for Assert()
+#include "arena.h"
   
 class Node;
 
 template<class Element> class List {
 
  private:
-    std::deque<Element> elems;
+    std::deque<Element, ArenaAllocator<Element> > elems;
 
  public:
            // Create a new empty list
     List() {}
 
+           // Lists (and their elements' storage) live in the arena
+           // that was current when they were created
+    static void *operator new(size_t size)
+        { return Arena::Current()->Alloc(size); }
+    static void operator delete(void *) {}
+
            // Returns count of elements currently in list
     int NumElements() const
 	{ return elems.size(); }
@@ -2,9 +2,10 @@
  * ----------------
  * This file just contains features relative to the location structure
  * used to record the lexical position of a token or symbol.  This file
- * establishes the cmoon definition for the yyltype structure, the global
- * variable yylloc, and a utility function to join locations you might
- * find handy at times.
+ * establishes the cmoon definition for the yyltype structure and a
+ * utility function to join locations you might
+ * find handy at times. It also defines SourceSpan, the packed location
+ * kept in each ast node.
  */
 
 #ifndef YYLTYPE
@@ -12,7 +13,9 @@
 /* Typedef: yyltype
  * ----------------
  * Defines the struct type that is used by the scanner to store
- * position information about each lexeme scanned.
+ * position information about each lexeme scanned. Besides the line
+ * and columns, the scanner records the byte offset and length of the
+ * lexeme in the source, which is what the ast nodes keep (see SourceSpan).
  */
 typedef struct yyltype
 {
@@ -20,17 +23,38 @@ typedef struct yyltype
     int first_line, first_column;
     int last_line, last_column;      
     char *text;                    // you can also ignore this field
+    int offset, length;            // byte range in the source
 } yyltype;
 
 #define YYLTYPE yyltype
 
 
-/* Global variable: yylloc
- * ------------------------
- * The global variable holding the position information about the
- * lexeme just scanned.
+/* Type: SourceSpan
+ * ----------------
+ * The compact form of a location that is stored inline in each ast node.
+ * A span is just the byte offset of its first character and its length.
+ * Lines and columns are only needed to report an error, so they are
+ * decoded from the source on demand (see SourceFile::GetLocation).
  */
-extern struct yyltype yylloc;
+struct SourceSpan
+{
+    unsigned int offset, length;
+    
+    static const unsigned int NoOffset = ~0u;
+    bool IsValid() const { return offset != NoOffset; }
+};
+
+inline SourceSpan MakeSpan(const yyltype& loc)
+{
+  SourceSpan span = {(unsigned int)loc.offset, (unsigned int)loc.length};
+  return span;
+}
+
+inline SourceSpan NoSpan()
+{
+  SourceSpan span = {SourceSpan::NoOffset, 0};
+  return span;
+}
 
 
 /* Function: Join
@@ -45,6 +69,8 @@ inline yyltype Join(yyltype first, yyltype last)
   combined.first_line = first.first_line;
   combined.last_column = last.last_column;
   combined.last_line = last.last_line;
+  combined.offset = first.offset;
+  combined.length = last.offset + last.length - first.offset;
   return combined;
 }
 
@@ -54,6 +80,35 @@ inline yyltype Join(yyltype *firstPtr, yyltype *lastPtr)
   return Join(*firstPtr, *lastPtr);
 }
 
+/* Same as above, for the spans stored in ast nodes */
+inline SourceSpan Join(SourceSpan first, SourceSpan last)
+{
+  SourceSpan combined = {first.offset, last.offset + last.length - first.offset};
+  return combined;
+}
+
+
+/* Macro: YYLLOC_DEFAULT
+ * ---------------------
+ * Used by the parser to compute the location of a rule from the locations
+ * of its symbols. This does the same as yacc's default, but also carries
+ * along the byte offsets. An empty rule gets an empty range positioned
+ * at the end of the preceding symbol.
+ */
+#define YYLLOC_DEFAULT(Current, Rhs, N)                                 \
+  do {                                                                  \
+    if (N)                                                              \
+      (Current) = Join(YYRHSLOC(Rhs, 1), YYRHSLOC(Rhs, N));             \
+    else {                                                              \
+      (Current).first_line = (Current).last_line =                      \
+        YYRHSLOC(Rhs, 0).last_line;                                     \
+      (Current).first_column = (Current).last_column =                  \
+        YYRHSLOC(Rhs, 0).last_column;                                   \
+      (Current).offset = YYRHSLOC(Rhs, 0).offset + YYRHSLOC(Rhs, 0).length; \
+      (Current).length = 0;                                             \
+    }                                                                   \
+  } while (0)
+
 
 #endif
 
@@ -0,0 +1,797 @@
+/* File: lower.cc
+ * --------------
+ * Implementation of the Lowering pass.
+ */
+
+#include "lower.h"
+#include "errors.h"
+#include <algorithm>
+#include <string.h>
+
+
+Lowering::Lowering(Program *p)
+{
+    this->program = p;
+    this->globals = p->GetScope()->GetTable();
+    this->hierarchy = p->GetHierarchy();
+    this->ir = new IRProgram;
+    this->fnDecl = NULL;
+    this->fn = NULL;
+    this->cls = NULL;
+    this->thisReg = IRNone;
+}
+
+/* Lowering::Lower
+ * ---------------
+ * Everything the code can refer to is numbered first: the globals, the
+ * functions and methods (imported ones included, without code) and the
+ * classes with their method tables. Then each body is lowered in turn,
+ * and last the interface tables are made for the selectors called.
+ */
+IRProgram *Lowering::Lower(Program *program)
+{
+    int numErrorsBefore = ReportError::NumErrors();
+    Lowering lowering(program);
+    lowering.AddDecls(program->imported);
+    lowering.AddDecls(program->decls);
+    for (int i = 0; i < program->decls->NumElements(); i++) {
+        Decl *d = program->decls->Nth(i);
+        ClassDecl *c = DynCast<ClassDecl>(d);
+        if (DynCast<FnDecl>(d) != NULL) {
+            lowering.LowerFunction(static_cast<FnDecl*>(d), NULL);
+        } else if (c != NULL) {
+            for (int j = 0; j < c->members->NumElements(); j++) {
+                FnDecl *method = DynCast<FnDecl>(c->members->Nth(j));
+                if (method != NULL)
+                    lowering.LowerFunction(method, c);
+            }
+        }
+    }
+    Decl *main = lowering.globals->Lookup(Intern("main"));
+    if (DynCast<FnDecl>(main) != NULL)
+        lowering.ir->SetMain(lowering.functionIndex[static_cast<FnDecl*>(main)]);
+    lowering.ColorSelectors();
+
+    if (ReportError::NumErrors() != numErrorsBefore) {
+        delete lowering.ir;
+        return NULL;
+    }
+    return lowering.ir;
+}
+
+/* Lowering::AddDecls
+ * ------------------
+ * Only declarations that made it into the global scope are numbered.
+ * The methods of every class get their functions before any class gets
+ * its method table, since a table lists inherited methods too.
+ */
+void Lowering::AddDecls(List<Decl*> *decls)
+{
+    for (int i = 0; i < decls->NumElements(); i++) {
+        Decl *d = decls->Nth(i);
+        if (this->globals->Lookup(d->id->symbol) != d)
+            continue;
+        VarDecl *var = DynCast<VarDecl>(d);
+        FnDecl *f = DynCast<FnDecl>(d);
+        ClassDecl *c = DynCast<ClassDecl>(d);
+        if (var != NULL) {
+            this->globalIndex[var] = this->ir->AddGlobal(d->id->symbol, KindOf(var->type));
+        } else if (f != NULL) {
+            IRFunction *irFn = new IRFunction(d->id->name, f->formals->NumElements(), KindOf(f->returnType));
+            this->functionIndex[f] = this->ir->AddFunction(irFn);
+        } else if (c != NULL) {
+            for (int j = 0; j < c->members->NumElements(); j++) {
+                FnDecl *method = DynCast<FnDecl>(c->members->Nth(j));
+                if (method == NULL || c->GetMembers()->Lookup(method->id->symbol) != method)
+                    continue;
+                std::string name = std::string(c->id->name) + "." + method->id->name;
+                IRFunction *irFn = new IRFunction(name, method->formals->NumElements() + 1,
+                                                  KindOf(method->returnType));
+                this->functionIndex[method] = this->ir->AddFunction(irFn);
+            }
+        }
+    }
+    for (int i = 0; i < decls->NumElements(); i++) {
+        ClassDecl *c = DynCast<ClassDecl>(decls->Nth(i));
+        if (c != NULL && this->globals->Lookup(c->id->symbol) == c)
+            this->AddClass(c);
+    }
+}
+
+/* Lowering::AddClass
+ * ------------------
+ * A class is added after its superclass, so its superclass's number is
+ * known by then.
+ */
+void Lowering::AddClass(ClassDecl *c)
+{
+    if (this->classIndex.count(c) > 0)
+        return;
+    ClassLayout *layout = c->GetLayout();
+    IRClass irClass;
+    irClass.name = c->id->symbol;
+    irClass.superclass = IRNone;
+    if (layout->GetSuper() != NULL) {
+        this->AddClass(layout->GetSuper()->GetClass());
+        irClass.superclass = this->classIndex[layout->GetSuper()->GetClass()];
+    }
+    irClass.objectSize = layout->GetObjectSize();
+    for (int slot = 0; slot < layout->NumMethods(); slot++) {
+        irClass.methods.push_back(this->functionIndex[layout->GetMethod(slot)]);
+        irClass.methodNames.push_back(layout->GetMethod(slot)->id->symbol);
+    }
+    this->classIndex[c] = this->ir->AddClass(irClass);
+}
+
+/* Lowering::ColorSelectors
+ * ------------------------
+ * A class has a method for a selector if it has a member by that name,
+ * its own or inherited, as its layout finds them. Each selector in turn
+ * gets the lowest color that none of the classes with a method for it
+ * has given another, those most classes have going first, since they
+ * are the hardest to fit.
+ */
+void Lowering::ColorSelectors()
+{
+    int numSelectors = this->ir->NumSelectors();
+    std::vector<ClassDecl*> decls(this->ir->NumClasses());
+    for (std::unordered_map<ClassDecl*, uint32_t>::iterator c = this->classIndex.begin(); c != this->classIndex.end(); ++c)
+        decls[c->second] = c->first;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t> > > implementors(numSelectors);  // class, method
+    for (size_t n = 0; n < decls.size(); n++) {
+        ClassLayout *layout = decls[n]->GetLayout();
+        for (int sel = 0; sel < numSelectors; sel++) {
+            FnDecl *method = DynCast<FnDecl>(layout->Lookup(this->ir->GetSelector(sel)));
+            if (method != NULL)
+                implementors[sel].push_back(std::make_pair((uint32_t)n, this->ir->GetClass(n)->methods[method->GetSlot()]));
+        }
+    }
+
+    std::vector<std::pair<int, int> > order;     // by how many classes have each
+    for (int sel = 0; sel < numSelectors; sel++)
+        order.push_back(std::make_pair(-(int)implementors[sel].size(), sel));
+    std::sort(order.begin(), order.end());
+    std::vector<std::vector<bool> > taken(decls.size());   // each class's colors
+    uint32_t numColors = 0;
+    for (size_t k = 0; k < order.size(); k++) {
+        int sel = order[k].second;
+        uint32_t color = 0;
+        for (size_t j = 0; j < implementors[sel].size(); ) {
+            const std::vector<bool> &colors = taken[implementors[sel][j].first];
+            if (color < colors.size() && colors[color]) {
+                color++;
+                j = 0;                    // and check them all again
+            } else {
+                j++;
+            }
+        }
+        for (size_t j = 0; j < implementors[sel].size(); j++) {
+            std::vector<bool> &colors = taken[implementors[sel][j].first];
+            if (colors.size() <= color)
+                colors.resize(color + 1, false);
+            colors[color] = true;
+        }
+        this->ir->SetSelectorColor(sel, color);
+        numColors = std::max(numColors, color + 1);
+    }
+
+    for (size_t n = 0; n < decls.size(); n++)
+        this->ir->GetClass(n)->interfaceMethods.assign(numColors, IRNone);
+    for (int sel = 0; sel < numSelectors; sel++) {
+        for (size_t j = 0; j < implementors[sel].size(); j++)
+            this->ir->GetClass(implementors[sel][j].first)->interfaceMethods[this->ir->GetSelectorColor(sel)] =
+                implementors[sel][j].second;
+    }
+}
+
+/* Lowering::LowerFunction
+ * -----------------------
+ * The entry block is started before anything else, so a loop at the top
+ * of the body gets a block of its own rather than being the entry. A body
+ * that can run off its end returns there, with zero if it has a value to
+ * return (as a method meant to be overridden may, with an empty body).
+ */
+void Lowering::LowerFunction(FnDecl *f, ClassDecl *c)
+{
+    if (f->body == NULL)
+        return;
+    this->fnDecl = f;
+    this->fn = this->ir->GetFunction(this->functionIndex[f]);
+    this->cls = c;
+    this->locals.clear();
+    this->thisReg = (c != NULL ? this->fn->NewReg(IRRef) : IRNone);
+    for (int i = 0; i < f->formals->NumElements(); i++) {
+        VarDecl *formal = f->formals->Nth(i);
+        this->locals[formal] = this->fn->NewReg(KindOf(formal->type));
+    }
+    this->fn->StartBlock(this->fn->NewBlock());
+    this->Visit(f->body);
+    if (!this->fn->IsBlockEnded()) {
+        Type *returnType = f->returnType->GetCanonical();
+        IRReg value = (returnType == Type::voidType ? IRNone : this->Zero(returnType));
+        this->fn->Emit(OpReturn, IRNone, value);
+    }
+    this->fnDecl = NULL;
+    this->fn = NULL;
+    this->cls = NULL;
+}
+
+IRKind Lowering::KindOf(Type *type)
+{
+    type = type->GetCanonical();
+    if (type == Type::intType || type == Type::boolType)
+        return IRInt;
+    if (type == Type::doubleType)
+        return IRDouble;
+    if (type == Type::voidType)
+        return IRVoid;
+    return IRRef;
+}
+
+/* Lowering::ClassOf
+ * -----------------
+ * Returns the class a type names, or NULL if it isn't a class type.
+ */
+ClassDecl *Lowering::ClassOf(Type *type)
+{
+    NamedType *named = DynCast<NamedType>(type->GetCanonical());
+    return (named != NULL ? DynCast<ClassDecl>(this->globals->Lookup(named->id->symbol)) : NULL);
+}
+
+IRReg Lowering::Zero(Type *type)
+{
+    if (KindOf(type) == IRDouble)
+        return this->Emit(OpDConst, type, this->ir->AddDouble(0.0));
+    return this->Emit(OpConst, type, 0);
+}
+
+/* Lowering::Emit
+ * --------------
+ * Appends an instruction whose value is of the given type to a register
+ * of its own, which is returned (IRNone for void).
+ */
+IRReg Lowering::Emit(IROpcode op, Type *type, uint32_t a, uint32_t b)
+{
+    IRKind kind = KindOf(type);
+    IRReg dest = (kind == IRVoid ? IRNone : this->fn->NewReg(kind));
+    this->fn->Emit(op, dest, a, b);
+    return dest;
+}
+
+IRReg Lowering::Condition(Expr *test)
+{
+    LoweredValue value = this->Visit(test);
+    if (!value.type->IsEquivalentTo(Type::boolType) && value.type != Type::errorType)
+        ReportError::TestNotBoolean(test);
+    return value.reg;
+}
+
+/* Lowering::PlaceOf
+ * -----------------
+ * The object or array and the subscript are computed here, once, so an
+ * assignment computes them before the value it stores, left to right.
+ */
+Lowering::Place Lowering::PlaceOf(Expr *lvalue)
+{
+    Place place;
+    place.kind = Place::Nowhere;
+    place.reg = place.index = IRNone;
+    place.type = Type::errorType;
+
+    ArrayAccess *access = DynCast<ArrayAccess>(lvalue);
+    if (access != NULL) {
+        LoweredValue base = this->Visit(access->base);
+        LoweredValue subscript = this->Visit(access->subscript);
+        ArrayType *array = DynCast<ArrayType>(base.type->GetCanonical());
+        if (array == NULL && base.type != Type::errorType)
+            ReportError::BracketsOnNonArray(access->base);
+        if (!subscript.type->IsEquivalentTo(Type::intType) && subscript.type != Type::errorType)
+            ReportError::SubscriptNotInteger(access->subscript);
+        if (array != NULL) {
+            place.kind = Place::Element;
+            place.reg = base.reg;
+            place.index = subscript.reg;
+            place.type = array->elemType->GetCanonical();
+        }
+        return place;
+    }
+
+    FieldAccess *field = DynCast<FieldAccess>(lvalue);
+    Assert(field != NULL);
+    VarDecl *var = NULL;
+    IRReg object = this->thisReg;
+    if (field->base == NULL) {
+        var = DynCast<VarDecl>(field->FindDecl(field->field->symbol));
+        if (var == NULL) {
+            ReportError::IdentifierNotDeclared(field->field, LookingForVariable);
+            return place;
+        }
+    } else {
+        LoweredValue base = this->Visit(field->base);
+        if (base.type == Type::errorType)
+            return place;
+        ClassDecl *baseClass = this->ClassOf(base.type);
+        if (baseClass != NULL)
+            var = DynCast<VarDecl>(baseClass->GetScope()->LookupMember(field->field->symbol));
+        if (var == NULL) {
+            ReportError::FieldNotFoundInBase(field->field, base.type);
+            return place;
+        }
+        if (this->cls == NULL || !this->hierarchy->IsSubclass(baseClass, this->cls)) {
+            ReportError::InaccessibleField(field->field, base.type);
+            return place;
+        }
+        object = base.reg;
+    }
+
+    place.type = var->type->GetCanonical();
+    if (this->locals.count(var) > 0) {
+        place.kind = Place::Local;
+        place.reg = this->locals[var];
+    } else if (this->globalIndex.count(var) > 0) {
+        place.kind = Place::Global;
+        place.index = this->globalIndex[var];
+    } else {
+        place.kind = Place::Field;
+        place.reg = object;
+        place.index = var->GetOffset();
+    }
+    return place;
+}
+
+/* Lowering::Load
+ * --------------
+ * A local is copied rather than used in place, since an assignment
+ * later in the same expression could change it before its value is used.
+ */
+LoweredValue Lowering::Load(const Place &place)
+{
+    switch (place.kind) {
+      case Place::Local:
+        return LoweredValue(this->Emit(OpMove, place.type, place.reg), place.type);
+      case Place::Global:
+        return LoweredValue(this->Emit(OpLoadGlobal, place.type, place.index), place.type);
+      case Place::Field:
+        return LoweredValue(this->Emit(OpLoadField, place.type, place.reg, place.index), place.type);
+      case Place::Element:
+        return LoweredValue(this->Emit(OpLoadElem, place.type, place.reg, place.index), place.type);
+      default:
+        return Error();
+    }
+}
+
+
+LoweredValue Lowering::VisitNode(Node *n)
+{
+    return LoweredValue(IRNone, Type::voidType);
+}
+
+/* Lowering::VisitStmtBlock
+ * ------------------------
+ * Each local gets its register as it is set to zero, at the top of the
+ * block, so it starts out zero every time the block is entered.
+ */
+LoweredValue Lowering::VisitStmtBlock(StmtBlock *s)
+{
+    for (int i = 0; i < s->decls->NumElements(); i++) {
+        VarDecl *var = s->decls->Nth(i);
+        this->locals[var] = this->Zero(var->type);
+    }
+    for (int i = 0; i < s->stmts->NumElements(); i++)
+        this->Visit(s->stmts->Nth(i));
+    return LoweredValue(IRNone, Type::voidType);
+}
+
+LoweredValue Lowering::VisitIfStmt(IfStmt *s)
+{
+    IRReg test = this->Condition(s->test);
+    IRBlock thenBlock = this->fn->NewBlock();
+    IRBlock elseBlock = (s->elseBody != NULL ? this->fn->NewBlock() : IRNone);
+    IRBlock after = this->fn->NewBlock();
+    this->fn->Emit(OpBranch, IRNone, test, thenBlock, (elseBlock != IRNone ? elseBlock : after));
+    this->fn->StartBlock(thenBlock);
+    this->Visit(s->body);
+    if (elseBlock != IRNone) {
+        if (!this->fn->IsBlockEnded())
+            this->fn->Emit(OpJump, IRNone, after);
+        this->fn->StartBlock(elseBlock);
+        this->Visit(s->elseBody);
+    }
+    this->fn->StartBlock(after);
+    return LoweredValue(IRNone, Type::voidType);
+}
+
+LoweredValue Lowering::VisitWhileStmt(WhileStmt *s)
+{
+    IRBlock test = this->fn->NewBlock();
+    IRBlock body = this->fn->NewBlock();
+    IRBlock exit = this->fn->NewBlock();
+    this->fn->StartBlock(test);
+    this->fn->Emit(OpBranch, IRNone, this->Condition(s->test), body, exit);
+    this->fn->StartBlock(body);
+    this->loopExits.push_back(exit);
+    this->Visit(s->body);
+    this->loopExits.pop_back();
+    if (!this->fn->IsBlockEnded())
+        this->fn->Emit(OpJump, IRNone, test);
+    this->fn->StartBlock(exit);
+    return LoweredValue(IRNone, Type::voidType);
+}
+
+LoweredValue Lowering::VisitForStmt(ForStmt *s)
+{
+    this->Visit(s->init);
+    IRBlock test = this->fn->NewBlock();
+    IRBlock body = this->fn->NewBlock();
+    IRBlock step = this->fn->NewBlock();
+    IRBlock exit = this->fn->NewBlock();
+    this->fn->StartBlock(test);
+    this->fn->Emit(OpBranch, IRNone, this->Condition(s->test), body, exit);
+    this->fn->StartBlock(body);
+    this->loopExits.push_back(exit);
+    this->Visit(s->body);
+    this->loopExits.pop_back();
+    this->fn->StartBlock(step);
+    this->Visit(s->step);
+    this->fn->Emit(OpJump, IRNone, test);
+    this->fn->StartBlock(exit);
+    return LoweredValue(IRNone, Type::voidType);
+}
+
+LoweredValue Lowering::VisitBreakStmt(BreakStmt *s)
+{
+    if (this->loopExits.empty())
+        ReportError::BreakOutsideLoop(s);
+    else
+        this->fn->Emit(OpJump, IRNone, this->loopExits.back());
+    return LoweredValue(IRNone, Type::voidType);
+}
+
+LoweredValue Lowering::VisitReturnStmt(ReturnStmt *s)
+{
+    LoweredValue value = this->Visit(s->expr);
+    Type *expected = this->fnDecl->returnType->GetCanonical();
+    if (!this->hierarchy->IsSubtype(value.type, expected))
+        ReportError::ReturnMismatch(s, value.type, expected);
+    this->fn->Emit(OpReturn, IRNone, value.reg);
+    return LoweredValue(IRNone, Type::voidType);
+}
+
+LoweredValue Lowering::VisitPrintStmt(PrintStmt *s)
+{
+    for (int i = 0; i < s->args->NumElements(); i++) {
+        Expr *arg = s->args->Nth(i);
+        LoweredValue value = this->Visit(arg);
+        Type *type = value.type->GetCanonical();
+        if (type == Type::intType)
+            this->fn->Emit(OpPrintInt, IRNone, value.reg);
+        else if (type == Type::boolType)
+            this->fn->Emit(OpPrintBool, IRNone, value.reg);
+        else if (type == Type::stringType)
+            this->fn->Emit(OpPrintString, IRNone, value.reg);
+        else if (type != Type::errorType)
+            ReportError::PrintArgMismatch(arg, i + 1, value.type);
+    }
+    return LoweredValue(IRNone, Type::voidType);
+}
+
+
+LoweredValue Lowering::VisitEmptyExpr(EmptyExpr *e)
+{
+    return LoweredValue(IRNone, Type::voidType);
+}
+
+LoweredValue Lowering::VisitIntConstant(IntConstant *e)
+{
+    return LoweredValue(this->Emit(OpConst, Type::intType, e->value), Type::intType);
+}
+
+LoweredValue Lowering::VisitDoubleConstant(DoubleConstant *e)
+{
+    return LoweredValue(this->Emit(OpDConst, Type::doubleType, this->ir->AddDouble(e->value)), Type::doubleType);
+}
+
+LoweredValue Lowering::VisitBoolConstant(BoolConstant *e)
+{
+    return LoweredValue(this->Emit(OpConst, Type::boolType, e->value ? 1 : 0), Type::boolType);
+}
+
+/* Lowering::VisitStringConstant
+ * -----------------------------
+ * The lexeme still has its quotes. A string can't have a quote in it,
+ * but it can have the escapes \n, \t and \\, which the string made for it
+ * has as the characters they stand for.
+ */
+LoweredValue Lowering::VisitStringConstant(StringConstant *e)
+{
+    std::string text;
+    const char *end = e->value.text + e->value.length - 1;
+    for (const char *p = e->value.text + 1; p < end; p++) {
+        if (*p == '\\' && p + 1 < end && strchr("nt\\", p[1]) != NULL) {
+            p++;
+            text += (*p == 'n' ? '\n' : *p == 't' ? '\t' : '\\');
+        } else {
+            text += *p;
+        }
+    }
+    return LoweredValue(this->Emit(OpSConst, Type::stringType, this->ir->AddString(text)), Type::stringType);
+}
+
+LoweredValue Lowering::VisitNullConstant(NullConstant *e)
+{
+    return LoweredValue(this->Emit(OpConst, Type::nullType, 0), Type::nullType);
+}
+
+/* Lowering::VisitArithmeticExpr
+ * -----------------------------
+ * Both operands are ints or both are doubles, and % is only for ints.
+ */
+LoweredValue Lowering::VisitArithmeticExpr(ArithmeticExpr *e)
+{
+    LoweredValue left = (e->left != NULL ? this->Visit(e->left) : LoweredValue());
+    LoweredValue right = this->Visit(e->right);
+    Type *type = right.type->GetCanonical();
+    if (type == Type::errorType || (left.type != NULL && left.type == Type::errorType))
+        return Error();
+    bool isDouble = (type == Type::doubleType);
+    if (e->left == NULL) {
+        if (type != Type::intType && !isDouble) {
+            ReportError::IncompatibleOperand(e->op, right.type);
+            return Error();
+        }
+        return LoweredValue(this->Emit(isDouble ? OpDNeg : OpNeg, type, right.reg), type);
+    }
+
+    const char *op = e->op->tokenString;
+    if (!left.type->IsEquivalentTo(type) || (type != Type::intType && !isDouble) ||
+        (isDouble && strcmp(op, "%") == 0)) {
+        ReportError::IncompatibleOperands(e->op, left.type, right.type);
+        return Error();
+    }
+    IROpcode opcode;
+    switch (op[0]) {
+      case '+': opcode = (isDouble ? OpDAdd : OpAdd); break;
+      case '-': opcode = (isDouble ? OpDSub : OpSub); break;
+      case '*': opcode = (isDouble ? OpDMul : OpMul); break;
+      case '/': opcode = (isDouble ? OpDDiv : OpDiv); break;
+      default:  opcode = OpMod; break;
+    }
+    return LoweredValue(this->Emit(opcode, type, left.reg, right.reg), type);
+}
+
+/* Lowering::VisitRelationalExpr
+ * -----------------------------
+ * There are only less than comparisons, so a greater than one compares
+ * its operands the other way around.
+ */
+LoweredValue Lowering::VisitRelationalExpr(RelationalExpr *e)
+{
+    LoweredValue left = this->Visit(e->left);
+    LoweredValue right = this->Visit(e->right);
+    Type *type = left.type->GetCanonical();
+    if (type == Type::errorType || right.type == Type::errorType)
+        return Error();
+    bool isDouble = (type == Type::doubleType);
+    if (!right.type->IsEquivalentTo(type) || (type != Type::intType && !isDouble)) {
+        ReportError::IncompatibleOperands(e->op, left.type, right.type);
+        return Error();
+    }
+    const char *op = e->op->tokenString;
+    bool orEqual = (op[1] == '=');
+    IROpcode opcode = (orEqual ? (isDouble ? OpDLe : OpLe) : (isDouble ? OpDLt : OpLt));
+    if (op[0] == '>')
+        return LoweredValue(this->Emit(opcode, Type::boolType, right.reg, left.reg), Type::boolType);
+    return LoweredValue(this->Emit(opcode, Type::boolType, left.reg, right.reg), Type::boolType);
+}
+
+/* Lowering::VisitEqualityExpr
+ * ---------------------------
+ * Either operand's type has to be compatible with the other's. Strings
+ * are compared by their characters, every other reference by identity.
+ */
+LoweredValue Lowering::VisitEqualityExpr(EqualityExpr *e)
+{
+    LoweredValue left = this->Visit(e->left);
+    LoweredValue right = this->Visit(e->right);
+    if (left.type == Type::errorType || right.type == Type::errorType)
+        return Error();
+    Type *type = left.type->GetCanonical();
+    if (type == Type::voidType ||
+        (!this->hierarchy->IsSubtype(left.type, right.type) && !this->hierarchy->IsSubtype(right.type, left.type))) {
+        ReportError::IncompatibleOperands(e->op, left.type, right.type);
+        return Error();
+    }
+    bool equal = (e->op->tokenString[0] == '=');
+    if (type == Type::stringType) {
+        IRReg same = this->Emit(OpSEq, Type::boolType, left.reg, right.reg);
+        return LoweredValue(equal ? same : this->Emit(OpNot, Type::boolType, same), Type::boolType);
+    }
+    IROpcode opcode = (equal ? OpEq : OpNe);
+    if (type == Type::doubleType)
+        opcode = (equal ? OpDEq : OpDNe);
+    return LoweredValue(this->Emit(opcode, Type::boolType, left.reg, right.reg), Type::boolType);
+}
+
+/* Lowering::VisitLogicalExpr
+ * --------------------------
+ * Decaf's && and || don't short-circuit, so both operands are computed.
+ */
+LoweredValue Lowering::VisitLogicalExpr(LogicalExpr *e)
+{
+    LoweredValue left = (e->left != NULL ? this->Visit(e->left) : LoweredValue());
+    LoweredValue right = this->Visit(e->right);
+    if (right.type == Type::errorType || (left.type != NULL && left.type == Type::errorType))
+        return Error();
+    if (e->left == NULL) {
+        if (!right.type->IsEquivalentTo(Type::boolType)) {
+            ReportError::IncompatibleOperand(e->op, right.type);
+            return Error();
+        }
+        return LoweredValue(this->Emit(OpNot, Type::boolType, right.reg), Type::boolType);
+    }
+    if (!left.type->IsEquivalentTo(Type::boolType) || !right.type->IsEquivalentTo(Type::boolType)) {
+        ReportError::IncompatibleOperands(e->op, left.type, right.type);
+        return Error();
+    }
+    IROpcode opcode = (e->op->tokenString[0] == '&' ? OpAnd : OpOr);
+    return LoweredValue(this->Emit(opcode, Type::boolType, left.reg, right.reg), Type::boolType);
+}
+
+LoweredValue Lowering::VisitAssignExpr(AssignExpr *e)
+{
+    Place place = this->PlaceOf(e->left);
+    LoweredValue value = this->Visit(e->right);
+    if (place.kind == Place::Nowhere || value.type == Type::errorType)
+        return Error();
+    if (!this->hierarchy->IsSubtype(value.type, place.type)) {
+        ReportError::IncompatibleOperands(e->op, place.type, value.type);
+        return Error();
+    }
+    switch (place.kind) {
+      case Place::Local:
+        this->fn->Emit(OpMove, place.reg, value.reg);
+        break;
+      case Place::Global:
+        this->fn->Emit(OpStoreGlobal, IRNone, place.index, value.reg);
+        break;
+      case Place::Field:
+        this->fn->Emit(OpStoreField, IRNone, place.reg, place.index, value.reg);
+        break;
+      default:
+        this->fn->Emit(OpStoreElem, IRNone, place.reg, place.index, value.reg);
+        break;
+    }
+    return LoweredValue(value.reg, place.type);
+}
+
+LoweredValue Lowering::VisitLValue(LValue *e)
+{
+    return this->Load(this->PlaceOf(e));
+}
+
+LoweredValue Lowering::VisitThis(This *e)
+{
+    if (this->cls == NULL) {
+        ReportError::ThisOutsideClassScope(e);
+        return Error();
+    }
+    return LoweredValue(this->thisReg, NamedType::Canonical(this->cls->id->symbol));
+}
+
+/* Lowering::VisitCall
+ * -------------------
+ * A call without a base is to a global function, or to a method of the
+ * object the current method runs for, which is passed first. A call on
+ * an array can only be to length. Otherwise the method is found in the
+ * class or interface the base's type names: a class's is called by its
+ * slot, an interface's by its selector.
+ */
+LoweredValue Lowering::VisitCall(Call *e)
+{
+    FnDecl *callee = NULL;
+    IROpcode opcode = OpCall;
+    std::vector<IRReg> actuals;
+    Symbol name = e->field->symbol;
+    if (e->base == NULL) {
+        callee = DynCast<FnDecl>(e->FindDecl(name));
+        if (callee == NULL) {
+            ReportError::IdentifierNotDeclared(e->field, LookingForFunction);
+            return Error();
+        }
+        if (DynCast<ClassDecl>(callee->GetParent()) != NULL) {
+            opcode = OpCallVirtual;
+            actuals.push_back(this->thisReg);
+        }
+    } else {
+        LoweredValue base = this->Visit(e->base);
+        if (base.type == Type::errorType)
+            return Error();
+        Type *type = base.type->GetCanonical();
+        NamedType *named = DynCast<NamedType>(type);
+        if (DynCast<ArrayType>(type) != NULL && strcmp(e->field->name, "length") == 0) {
+            if (e->actuals->NumElements() != 0) {
+                ReportError::NumArgsMismatch(e->field, 0, e->actuals->NumElements());
+                return Error();
+            }
+            return LoweredValue(this->Emit(OpLength, Type::intType, base.reg), Type::intType);
+        }
+        Decl *decl = (named != NULL ? this->globals->Lookup(named->id->symbol) : NULL);
+        if (DynCast<ClassDecl>(decl) != NULL) {
+            callee = DynCast<FnDecl>(decl->GetScope()->LookupMember(name));
+            opcode = OpCallVirtual;
+        } else if (DynCast<InterfaceDecl>(decl) != NULL) {
+            callee = DynCast<FnDecl>(static_cast<InterfaceDecl*>(decl)->GetMembers()->Lookup(name));
+            opcode = OpCallInterface;
+        }
+        if (callee == NULL) {
+            ReportError::FieldNotFoundInBase(e->field, base.type);
+            return Error();
+        }
+        actuals.push_back(base.reg);
+    }
+
+    int numFormals = callee->formals->NumElements();
+    if (e->actuals->NumElements() != numFormals) {
+        ReportError::NumArgsMismatch(e->field, numFormals, e->actuals->NumElements());
+        return Error();
+    }
+    bool ok = true;
+    for (int i = 0; i < numFormals; i++) {
+        Expr *arg = e->actuals->Nth(i);
+        LoweredValue value = this->Visit(arg);
+        Type *expected = callee->formals->Nth(i)->type;
+        if (!this->hierarchy->IsSubtype(value.type, expected)) {
+            ReportError::ArgMismatch(arg, i + 1, value.type, expected);
+            ok = false;
+        }
+        actuals.push_back(value.reg);
+    }
+    if (!ok)
+        return Error();
+
+    uint32_t target;
+    if (opcode == OpCall)
+        target = this->functionIndex[callee];
+    else if (opcode == OpCallVirtual)
+        target = callee->GetSlot();
+    else
+        target = this->ir->AddSelector(name);
+    Type *returnType = callee->returnType->GetCanonical();
+    IRKind kind = KindOf(returnType);
+    IRReg dest = (kind == IRVoid ? IRNone : this->fn->NewReg(kind));
+    this->fn->EmitCall(opcode, dest, target, actuals);
+    return LoweredValue(dest, returnType);
+}
+
+LoweredValue Lowering::VisitNewExpr(NewExpr *e)
+{
+    ClassDecl *c = this->ClassOf(e->cType);
+    if (c == NULL) {
+        ReportError::IdentifierNotDeclared(e->cType->id, LookingForClass);
+        return Error();
+    }
+    Type *type = e->cType->GetCanonical();
+    return LoweredValue(this->Emit(OpNew, type, this->classIndex[c]), type);
+}
+
+LoweredValue Lowering::VisitNewArrayExpr(NewArrayExpr *e)
+{
+    LoweredValue size = this->Visit(e->size);
+    if (!size.type->IsEquivalentTo(Type::intType)) {
+        if (size.type != Type::errorType)
+            ReportError::NewArraySizeNotInteger(e->size);
+        return Error();
+    }
+    Type *type = e->elemType->GetCanonical()->GetArrayOf();
+    return LoweredValue(this->Emit(OpNewArray, type, size.reg), type);
+}
+
+LoweredValue Lowering::VisitReadIntegerExpr(ReadIntegerExpr *e)
+{
+    return LoweredValue(this->Emit(OpReadInteger, Type::intType), Type::intType);
+}
+
+LoweredValue Lowering::VisitReadLineExpr(ReadLineExpr *e)
+{
+    return LoweredValue(this->Emit(OpReadLine, Type::stringType), Type::stringType);
+}
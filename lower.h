@@ -0,0 +1,129 @@
+/* File: lower.h
+ * -------------
+ * Lowering turns a checked program into IR (see ir.h): each function and
+ * method with a body into the blocks of an IRFunction, and each class
+ * into its method table. Statements become the blocks and jumps of their
+ * control flow: an if branches to its two arms, which both go on to the
+ * block after it, a loop tests its condition in a block of its own that
+ * the end of the body jumps back to, and a break jumps to the block after
+ * its loop. Expressions become the instructions that compute them, left
+ * to right, each result in a new register.
+ *
+ * A name is resolved to what it declares from the scope it is used in:
+ * a local variable or formal to its register, a global to its slot in
+ * the globals, and a field of the object a method is running for to a
+ * load from this. A method is called by its slot in the method table of
+ * the object it is called on, or through a selector (its name) if the
+ * object is only known by an interface it implements. Once every call is
+ * lowered, the selectors are colored, and each class given its interface
+ * table (see IRProgram).
+ *
+ * Which instruction an operator becomes depends on the types of its
+ * operands, so lowering works out the type of every expression as it
+ * goes, and reports whatever it finds that can't be computed: names that
+ * aren't declared, operands, arguments or values of the wrong type, a
+ * break outside a loop. Local variables start out zero (or null).
+ */
+
+#ifndef _H_lower
+#define _H_lower
+
+#include "ast_visitor.h"
+#include "ir.h"
+#include <unordered_map>
+#include <vector>
+
+/* Type: LoweredValue
+ * ------------------
+ * What an expression was lowered to: the register holding its value and
+ * its type. The register is IRNone for a void call, or after an error.
+ */
+struct LoweredValue
+{
+    IRReg reg;
+    Type *type;
+
+    LoweredValue() : reg(IRNone), type(NULL) {}
+    LoweredValue(IRReg r, Type *t) : reg(r), type(t) {}
+};
+
+class Lowering : public NodeVisitor<Lowering, LoweredValue>
+{
+  public:
+           // Returns the IR for program, which must have been checked
+           // without errors, or NULL if anything in it couldn't be
+           // lowered, once that has been reported
+    static IRProgram *Lower(Program *program);
+
+  private:
+    friend class NodeVisitor<Lowering, LoweredValue>;
+
+           // Where an assignment stores to
+    struct Place
+    {
+        enum { Local, Global, Field, Element, Nowhere } kind;
+        IRReg reg;           // the local, the object or the array
+        uint32_t index;      // the global, the field's offset or the subscript
+        Type *type;
+    };
+
+    Program *program;
+    Hashtable<Decl*> *globals;
+    ClassHierarchy *hierarchy;
+    IRProgram *ir;
+    std::unordered_map<FnDecl*, uint32_t> functionIndex;
+    std::unordered_map<ClassDecl*, uint32_t> classIndex;
+    std::unordered_map<VarDecl*, uint32_t> globalIndex;
+
+    FnDecl *fnDecl;                  // being lowered, and its code
+    IRFunction *fn;
+    ClassDecl *cls;                  // that it is a method of, if it is
+    IRReg thisReg;
+    std::unordered_map<VarDecl*, IRReg> locals;
+    std::vector<IRBlock> loopExits;  // innermost last
+
+    Lowering(Program *program);
+    void AddDecls(List<Decl*> *decls);
+    void AddClass(ClassDecl *c);
+    void LowerFunction(FnDecl *f, ClassDecl *c);
+    void ColorSelectors();
+
+    static IRKind KindOf(Type *type);
+    ClassDecl *ClassOf(Type *type);
+    IRReg Zero(Type *type);
+    IRReg Emit(IROpcode op, Type *type, uint32_t a = IRNone, uint32_t b = IRNone);
+    IRReg Condition(Expr *test);
+    Place PlaceOf(Expr *lvalue);
+    LoweredValue Load(const Place &place);
+    LoweredValue Error() { return LoweredValue(IRNone, Type::errorType); }
+
+    LoweredValue VisitNode(Node *n);
+    LoweredValue VisitStmtBlock(StmtBlock *s);
+    LoweredValue VisitIfStmt(IfStmt *s);
+    LoweredValue VisitWhileStmt(WhileStmt *s);
+    LoweredValue VisitForStmt(ForStmt *s);
+    LoweredValue VisitBreakStmt(BreakStmt *s);
+    LoweredValue VisitReturnStmt(ReturnStmt *s);
+    LoweredValue VisitPrintStmt(PrintStmt *s);
+
+    LoweredValue VisitEmptyExpr(EmptyExpr *e);
+    LoweredValue VisitIntConstant(IntConstant *e);
+    LoweredValue VisitDoubleConstant(DoubleConstant *e);
+    LoweredValue VisitBoolConstant(BoolConstant *e);
+    LoweredValue VisitStringConstant(StringConstant *e);
+    LoweredValue VisitNullConstant(NullConstant *e);
+    LoweredValue VisitArithmeticExpr(ArithmeticExpr *e);
+    LoweredValue VisitRelationalExpr(RelationalExpr *e);
+    LoweredValue VisitEqualityExpr(EqualityExpr *e);
+    LoweredValue VisitLogicalExpr(LogicalExpr *e);
+    LoweredValue VisitAssignExpr(AssignExpr *e);
+    LoweredValue VisitLValue(LValue *e);
+    LoweredValue VisitThis(This *e);
+    LoweredValue VisitCall(Call *e);
+    LoweredValue VisitNewExpr(NewExpr *e);
+    LoweredValue VisitNewArrayExpr(NewArrayExpr *e);
+    LoweredValue VisitReadIntegerExpr(ReadIntegerExpr *e);
+    LoweredValue VisitReadLineExpr(ReadLineExpr *e);
+};
+
+#endif
@@ -0,0 +1,508 @@
+/* File: lsp.cc
+ * ------------
+ * Implementation of the language server.
+ */
+
+#include "lsp.h"
+#include "context.h"
+#include "incremental.h"
+#include "utility.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int MethodNotFound = -32601;   // JSON-RPC error codes
+static const int InvalidRequest = -32600;
+
+
+/* Type: JsonValue
+ * ---------------
+ * A parsed JSON value. Messages are small and read once, so this is as
+ * plain as it can be: every kind of value has a field of its own.
+ */
+struct JsonValue
+{
+    enum Kind { Null, Bool, Number, String, Array, Object };
+    Kind kind;
+    bool boolean;
+    double number;
+    std::string string;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue> > members;
+
+    JsonValue() : kind(Null), boolean(false), number(0) {}
+
+    const JsonValue *Get(const char *name) const
+    {
+        for (size_t i = 0; kind == Object && i < members.size(); i++)
+            if (members[i].first == name)
+                return &members[i].second;
+        return NULL;
+    }
+    const std::string &GetString(const char *name) const
+    {
+        static const std::string none;
+        const JsonValue *v = Get(name);
+        return (v != NULL && v->kind == String ? v->string : none);
+    }
+    int GetInt(const char *name) const
+    {
+        const JsonValue *v = Get(name);
+        return (v != NULL && v->kind == Number ? (int)v->number : 0);
+    }
+};
+
+static void SkipSpace(const char **p, const char *end)
+{
+    while (*p < end && strchr(" \t\r\n", **p) != NULL)
+        (*p)++;
+}
+
+static bool ParseString(const char **p, const char *end, std::string *s)
+{
+    for ((*p)++; *p < end && **p != '"'; (*p)++) {
+        if (**p != '\\') {
+            s->push_back(**p);
+            continue;
+        }
+        if (++*p == end)
+            return false;
+        switch (**p) {
+          case 'b': s->push_back('\b'); break;
+          case 'f': s->push_back('\f'); break;
+          case 'n': s->push_back('\n'); break;
+          case 'r': s->push_back('\r'); break;
+          case 't': s->push_back('\t'); break;
+          case 'u': {
+            if (end - *p < 5)
+                return false;
+            unsigned c = strtoul(std::string(*p + 1, 4).c_str(), NULL, 16);
+            *p += 4;
+            if (c < 0x80) {             // anything else can't be in a program
+                s->push_back((char)c);
+            } else if (c < 0x800) {
+                s->push_back((char)(0xc0 | c >> 6));
+                s->push_back((char)(0x80 | (c & 0x3f)));
+            } else {
+                s->push_back((char)(0xe0 | c >> 12));
+                s->push_back((char)(0x80 | (c >> 6 & 0x3f)));
+                s->push_back((char)(0x80 | (c & 0x3f)));
+            }
+            break;
+          }
+          default: s->push_back(**p); break;
+        }
+    }
+    if (*p == end)
+        return false;
+    (*p)++;
+    return true;
+}
+
+/* Function: ParseJson
+ * -------------------
+ * Parses the value at *p, leaving *p just after it. Returns false if
+ * there isn't a well-formed one there.
+ */
+static bool ParseJson(const char **p, const char *end, JsonValue *value)
+{
+    SkipSpace(p, end);
+    if (*p == end)
+        return false;
+    if (**p == '{' || **p == '[') {
+        bool object = (**p == '{');
+        char close = (object ? '}' : ']');
+        value->kind = (object ? JsonValue::Object : JsonValue::Array);
+        (*p)++;
+        SkipSpace(p, end);
+        if (*p < end && **p == close) {
+            (*p)++;
+            return true;
+        }
+        for (;;) {
+            std::string name;
+            if (object) {
+                SkipSpace(p, end);
+                if (*p == end || **p != '"' || !ParseString(p, end, &name))
+                    return false;
+                SkipSpace(p, end);
+                if (*p == end || **p != ':')
+                    return false;
+                (*p)++;
+            }
+            JsonValue element;
+            if (!ParseJson(p, end, &element))
+                return false;
+            if (object)
+                value->members.push_back(std::make_pair(name, element));
+            else
+                value->elements.push_back(element);
+            SkipSpace(p, end);
+            if (*p < end && **p == ',') {
+                (*p)++;
+            } else if (*p < end && **p == close) {
+                (*p)++;
+                return true;
+            } else {
+                return false;
+            }
+        }
+    }
+    if (**p == '"') {
+        value->kind = JsonValue::String;
+        return ParseString(p, end, &value->string);
+    }
+    static const char *words[] = { "null", "true", "false" };
+    for (int i = 0; i < 3; i++) {
+        size_t n = strlen(words[i]);
+        if ((size_t)(end - *p) >= n && strncmp(*p, words[i], n) == 0) {
+            value->kind = (i == 0 ? JsonValue::Null : JsonValue::Bool);
+            value->boolean = (i == 1);
+            *p += n;
+            return true;
+        }
+    }
+    char *after;
+    std::string rest(*p, std::min<size_t>(end - *p, 32));
+    value->kind = JsonValue::Number;
+    value->number = strtod(rest.c_str(), &after);
+    if (after == rest.c_str())
+        return false;
+    *p += after - rest.c_str();
+    return true;
+}
+
+static std::string Quote(const std::string &s)
+{
+    std::string quoted = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') {
+            quoted.push_back('\\');
+            quoted.push_back(c);
+        } else if (c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted.push_back(c);
+        }
+    }
+    return quoted + "\"";
+}
+
+/* Function: WriteJson
+ * -------------------
+ * Returns the JSON text of a parsed value, for the ids of requests,
+ * which are echoed back as they came.
+ */
+static std::string WriteJson(const JsonValue &value)
+{
+    switch (value.kind) {
+      case JsonValue::Null:   return "null";
+      case JsonValue::Bool:   return (value.boolean ? "true" : "false");
+      case JsonValue::String: return Quote(value.string);
+      case JsonValue::Number: {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.17g", value.number);
+        return buf;
+      }
+      default: {
+        bool object = (value.kind == JsonValue::Object);
+        std::string s = (object ? "{" : "[");
+        size_t n = (object ? value.members.size() : value.elements.size());
+        for (size_t i = 0; i < n; i++) {
+            s += (i > 0 ? "," : "");
+            if (object)
+                s += Quote(value.members[i].first) + ":" + WriteJson(value.members[i].second);
+            else
+                s += WriteJson(value.elements[i]);
+        }
+        return s + (object ? "}" : "]");
+      }
+    }
+}
+
+
+/* Function: ReadMessage
+ * ---------------------
+ * Reads the headers of the next message, of which only Content-Length
+ * matters, and then its content. Returns false at the end of the input.
+ */
+static bool ReadMessage(std::string *content)
+{
+    char line[1024];
+    long length = -1;
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        if (strcmp(line, "\r\n") == 0 || strcmp(line, "\n") == 0) {
+            if (length < 0)
+                continue;   // no content to go with these headers
+            content->resize(length);
+            return length == 0 || fread(&(*content)[0], 1, length, stdin) == (size_t)length;
+        }
+        if (strncasecmp(line, "Content-Length:", 15) == 0)
+            length = strtol(line + 15, NULL, 10);
+    }
+    return false;
+}
+
+static void WriteMessage(const std::string &content)
+{
+    fprintf(stdout, "Content-Length: %lu\r\n\r\n", (unsigned long)content.size());
+    fwrite(content.data(), 1, content.size(), stdout);
+    fflush(stdout);
+}
+
+static void Respond(const JsonValue &id, const std::string &result)
+{
+    WriteMessage("{\"jsonrpc\":\"2.0\",\"id\":" + WriteJson(id) + ",\"result\":" + result + "}");
+}
+
+static void RespondError(const JsonValue &id, int code, const std::string &message)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%d", code);
+    WriteMessage("{\"jsonrpc\":\"2.0\",\"id\":" + WriteJson(id) + ",\"error\":{\"code\":" + buf +
+                 ",\"message\":" + Quote(message) + "}}");
+}
+
+static void Notify(const char *method, const std::string &params)
+{
+    WriteMessage(std::string("{\"jsonrpc\":\"2.0\",\"method\":\"") + method + "\",\"params\":" + params + "}");
+}
+
+
+/* Type: Document
+ * --------------
+ * An open document: its text as of the last change, and the session its
+ * versions are compiled in.
+ */
+struct Document
+{
+    std::string text;
+    int version;
+    IncrementalSession session;
+};
+
+static std::map<std::string, Document*> documents;
+
+/* Function: OffsetOf
+ * ------------------
+ * Returns the offset in text of a position, given as a line and a
+ * character in it, clamped to the text.
+ */
+static size_t OffsetOf(const std::string &text, const JsonValue *position)
+{
+    if (position == NULL)
+        return 0;
+    int line = position->GetInt("line"), character = position->GetInt("character");
+    size_t offset = 0;
+    for (int i = 0; i < line; i++) {
+        size_t newline = text.find('\n', offset);
+        if (newline == std::string::npos)
+            return text.size();
+        offset = newline + 1;
+    }
+    size_t end = text.find('\n', offset);
+    if (end == std::string::npos)
+        end = text.size();
+    return std::min(offset + std::max(character, 0), end);
+}
+
+/* Function: CharacterAt
+ * ---------------------
+ * Errors give columns as the scanner counts them, with tabs taken to the
+ * next tab stop (see SourceFile::ColumnForOffset). Returns the character
+ * in the line that a column falls on.
+ */
+static int CharacterAt(const std::string &line, int column)
+{
+    int col = 1;
+    for (size_t i = 0; i < line.size(); i++) {
+        if (col >= column)
+            return i;
+        col++;
+        if (line[i] == '\t')
+            col += TAB_SIZE - col%TAB_SIZE + 1;
+    }
+    return line.size();
+}
+
+static std::string Range(int line, int first, int last)
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "{\"start\":{\"line\":%d,\"character\":%d},"
+             "\"end\":{\"line\":%d,\"character\":%d}}", line, first, line, last);
+    return buf;
+}
+
+/* Function: Diagnose
+ * ------------------
+ * Turns the errors a compilation held, as ReportError words them, back
+ * into a list of diagnostics. An error with a line is followed by the
+ * line itself and a row of carets under where it is, unless the line is
+ * the empty one at the end, and then by the message.
+ */
+static std::string Diagnose(const std::string &errors)
+{
+    std::vector<std::string> lines;
+    for (size_t start = 0, end; start < errors.size(); start = end + 1) {
+        end = errors.find('\n', start);
+        if (end == std::string::npos)
+            end = errors.size();
+        lines.push_back(errors.substr(start, end - start));
+    }
+
+    std::string list;
+    for (size_t i = 0; i < lines.size(); i++) {
+        int lineNum = 0, first = 0, last = 0;
+        if (lines[i].compare(0, 15, "*** Error line ") == 0) {
+            lineNum = atoi(lines[i].c_str() + 15);
+            const std::string *carets = (i + 2 < lines.size() ? &lines[i+2] : NULL);
+            if (carets != NULL && carets->find('^') != std::string::npos &&
+                carets->find_first_not_of(" ^") == std::string::npos) {
+                first = CharacterAt(lines[i+1], carets->find('^') + 1);
+                last = CharacterAt(lines[i+1], carets->rfind('^') + 2);
+                i += 2;
+            }
+        } else if (lines[i] != "*** Error.") {
+            continue;
+        }
+        if (i + 1 >= lines.size() || lines[i+1].compare(0, 4, "*** ") != 0)
+            continue;
+        i++;
+        list += (list.empty() ? "" : ",");
+        list += "{\"range\":" + Range(std::max(lineNum - 1, 0), first, std::max(last, first)) +
+                ",\"severity\":1,\"source\":\"dcc\",\"message\":" + Quote(lines[i].substr(4)) + "}";
+    }
+    return "[" + list + "]";
+}
+
+static void Publish(const std::string &uri, Document *doc, const std::string &diagnostics)
+{
+    char version[32] = "";
+    if (doc != NULL)
+        snprintf(version, sizeof(version), ",\"version\":%d", doc->version);
+    Notify("textDocument/publishDiagnostics",
+           "{\"uri\":" + Quote(uri) + version + ",\"diagnostics\":" + diagnostics + "}");
+}
+
+/* Function: Compile
+ * -----------------
+ * Compiles the document as the next version in its session and
+ * publishes what errors it has now.
+ */
+static void Compile(const std::string &uri, Document *doc)
+{
+    std::string output;
+    UseDebugSettings(NULL, &output);
+    CompilationContext context(uri.c_str(), doc->text.data(), doc->text.size());
+    context.SetHoldErrors(true);
+    context.SetIncremental(&doc->session);
+    context.Compile();
+    UseDebugSettings(NULL, NULL);
+    if (!output.empty())
+        Notify("window/logMessage", "{\"type\":4,\"message\":" + Quote(output) + "}");
+    Publish(uri, doc, Diagnose(context.GetHeldErrors()));
+}
+
+static void DidOpen(const JsonValue *params)
+{
+    const JsonValue *item = params->Get("textDocument");
+    if (item == NULL)
+        return;
+    const std::string &uri = item->GetString("uri");
+    Document *&doc = documents[uri];
+    if (doc == NULL)
+        doc = new Document;
+    doc->text = item->GetString("text");
+    doc->version = item->GetInt("version");
+    Compile(uri, doc);
+}
+
+/* Function: DidChange
+ * -------------------
+ * The changes are applied in order, each one either the whole new text
+ * or a range of the old one and what replaces it.
+ */
+static void DidChange(const JsonValue *params)
+{
+    const JsonValue *item = params->Get("textDocument");
+    const JsonValue *changes = params->Get("contentChanges");
+    if (item == NULL || changes == NULL || documents.count(item->GetString("uri")) == 0)
+        return;
+    const std::string &uri = item->GetString("uri");
+    Document *doc = documents[uri];
+    doc->version = item->GetInt("version");
+    for (size_t i = 0; i < changes->elements.size(); i++) {
+        const JsonValue *change = &changes->elements[i];
+        const JsonValue *range = change->Get("range");
+        if (range == NULL) {
+            doc->text = change->GetString("text");
+            continue;
+        }
+        size_t start = OffsetOf(doc->text, range->Get("start"));
+        size_t end = std::max(start, OffsetOf(doc->text, range->Get("end")));
+        doc->text.replace(start, end - start, change->GetString("text"));
+    }
+    Compile(uri, doc);
+}
+
+static void DidClose(const JsonValue *params)
+{
+    const JsonValue *item = params->Get("textDocument");
+    if (item == NULL)
+        return;
+    const std::string &uri = item->GetString("uri");
+    std::map<std::string, Document*>::iterator found = documents.find(uri);
+    if (found == documents.end())
+        return;
+    delete found->second;
+    documents.erase(found);
+    Publish(uri, NULL, "[]");
+}
+
+int RunLanguageServer()
+{
+    bool shutDown = false;
+    std::string content;
+    while (ReadMessage(&content)) {
+        JsonValue message;
+        const char *p = content.data();
+        if (!ParseJson(&p, p + content.size(), &message) || message.kind != JsonValue::Object) {
+            RespondError(JsonValue(), InvalidRequest, "Invalid message");
+            continue;
+        }
+        const JsonValue *id = message.Get("id");
+        const JsonValue *params = message.Get("params");
+        static const JsonValue none;
+        if (params == NULL)
+            params = &none;
+        const std::string &method = message.GetString("method");
+
+        if (method == "exit") {
+            break;
+        } else if (id == NULL && (method == "initialize" || method == "shutdown")) {
+            continue;   // requests, sent without an id to answer to
+        } else if (method == "initialize") {
+            Respond(*id, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2}},"
+                    "\"serverInfo\":{\"name\":\"dcc\"}}");
+        } else if (method == "shutdown") {
+            shutDown = true;
+            Respond(*id, "null");
+        } else if (method == "textDocument/didOpen") {
+            DidOpen(params);
+        } else if (method == "textDocument/didChange") {
+            DidChange(params);
+        } else if (method == "textDocument/didClose") {
+            DidClose(params);
+        } else if (id != NULL && !method.empty()) {
+            RespondError(*id, MethodNotFound, "Unsupported method " + method);
+        }
+    }
+    return (shutDown ? 0 : 1);
+}
@@ -0,0 +1,26 @@
+/* File: lsp.h
+ * -----------
+ * With --lsp, dcc is a language server: an editor starts it and speaks
+ * the Language Server Protocol with it over standard input and output.
+ * Each document the editor opens is compiled in an incremental session
+ * of its own (see incremental.h) every time it changes, and its errors
+ * are published back to the editor as diagnostics.
+ *
+ * Only what that takes is supported: initialize, shutdown and exit, and
+ * the didOpen, didChange and didClose notifications, with changes sent
+ * either whole or as ranges. Decaf programs are ASCII, so a position's
+ * character is simply its byte in the line. Debug output, for the keys
+ * given after -d, goes back as log messages.
+ */
+
+#ifndef _H_lsp
+#define _H_lsp
+
+/* Function: RunLanguageServer
+ * ---------------------------
+ * Serves the editor until it asks the server to exit or closes its end,
+ * then returns the exit status: 0 if it was asked to shut down first.
+ */
+int RunLanguageServer();
+
+#endif
@@ -8,24 +8,110 @@
 #include <stdio.h>
 #include "utility.h"
 #include "errors.h"
-#include "parser.h"
+#include "context.h"
+#include "pool.h"
+#include "server.h"
+#include "lsp.h"
+#include "cache.h"
+#include "snapshot.h"
+
+
+/* Class: CompileTask
+ * ------------------
+ * A task that compiles one of the files on a worker thread.
+ */
+class CompileTask : public Task
+{
+  public:
+    CompileTask(CompilationContext *c) : context(c) {}
+    void Run() { this->context->Compile(); }
+
+  private:
+    CompilationContext *context;
+};
 
 
 /* Function: main()
  * ----------------
  * Entry point to the entire program.  We parse the command line and turn
  * on any debugging flags requested by the user when invoking the program.
- * InitScanner() is used to set up the scanner.
- * InitParser() is used to set up the parser. The call to yyparse() will
- * attempt to parse a complete program from the input. 
+ * Each file named on the command line (or standard input, if there are
+ * none) is compiled in a CompilationContext of its own, see context.h.
+ * With -j, a single program has its function bodies checked on a pool
+ * of that many worker threads, and several files are compiled side by
+ * side on it instead. With -s, each file is checked as it is parsed.
+ * With --cache, a file compiled before is not compiled again, see cache.h.
+ * With --use-decls, each file is compiled against the declarations of
+ * the modules in the snapshots given, and with --save-decls the file's
+ * own are saved to one, see snapshot.h. With -o, the file's x86-64
+ * code is written out, see x86.h, and with --run the program is run on
+ * the spot, see vm.h, and dcc exits with its status. The errors for
+ * several files are printed once they are all done, file by file in the
+ * order they were named. With --server, dcc compiles programs sent to it
+ * instead, see server.h, and with --lsp it serves an editor, see lsp.h.
  */
 int main(int argc, char *argv[])
 {
     ParseCommandLine(argc, argv);
-  
-    InitScanner();
-    InitParser();
-    yyparse();
-    return (ReportError::NumErrors() == 0? 0 : -1);
-}
+    if (ServerSocket() != NULL) {
+        RunServer(ServerSocket());
+        return 0;
+    }
+    if (LanguageServer())
+        return RunLanguageServer();
+
+    int numFiles = NumInputFiles();
+    WorkPool *pool = (NumJobs() > 1 ? new WorkPool(NumJobs()) : NULL);
+    CompileCache *cache = (CacheDir() != NULL ? new CompileCache(CacheDir()) : NULL);
+    std::vector<DeclSnapshot*> imports;
+    for (int i = 0; i < NumUseDecls(); i++)
+        imports.push_back(new DeclSnapshot(UseDecls(i)));
+    if (numFiles <= 1) {
+        CompilationContext context(numFiles == 1 ? InputFile(0) : NULL);
+        context.SetWorkPool(pool);
+        context.SetStreaming(Streaming());
+        context.SetCache(cache);
+        for (size_t i = 0; i < imports.size(); i++)
+            context.AddImport(imports[i]);
+        context.SetSavePath(SaveDecls());
+        context.SetOutputPath(OutputFile());
+        context.SetRunning(RunProgram());
+        context.Compile();
+        delete pool;
+        delete cache;
+        for (size_t i = 0; i < imports.size(); i++)
+            delete imports[i];
+        return (context.NumErrors() == 0? context.RunStatus() : -1);
+    }
 
+    CompilationContext **contexts = new CompilationContext*[numFiles];
+    for (int i = 0; i < numFiles; i++) {
+        contexts[i] = new CompilationContext(InputFile(i));
+        contexts[i]->SetHoldErrors(true);
+        contexts[i]->SetStreaming(Streaming());
+        contexts[i]->SetCache(cache);
+        for (size_t j = 0; j < imports.size(); j++)
+            contexts[i]->AddImport(imports[j]);
+        if (pool != NULL)
+            pool->Submit(new CompileTask(contexts[i]));
+        else
+            contexts[i]->Compile();
+    }
+    delete pool;
+    delete cache;
+    for (size_t i = 0; i < imports.size(); i++)
+        delete imports[i];
+
+    int status = 0;
+    for (int i = 0; i < numFiles; i++) {
+        if (contexts[i]->NumErrors() != 0) {
+            status = -1;
+            fflush(stdout);
+            fprintf(stderr, "\n*** In file %s:\n%s", contexts[i]->GetFilename(),
+                    contexts[i]->GetHeldErrors().c_str());
+        }
+        delete contexts[i];
+    }
+    delete[] contexts;
+    return status;
+}
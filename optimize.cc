@@ -0,0 +1,840 @@
+/* File: optimize.cc
+ * -----------------
+ * Implementation of the Optimizer.
+ */
+
+#include "optimize.h"
+#include "utility.h"
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+
+  // A site is an instruction, by its index, or a phi p, as -(p+1)
+static const int NoSite = INT_MIN;
+static inline int PhiSite(int p) { return -(p + 1); }
+static inline int PhiOfSite(int site) { return -site - 1; }
+
+
+Optimizer::Optimizer(IRProgram *p, IRFunction *f)
+{
+    this->program = p;
+    this->fn = f;
+    this->numBlocks = f->NumBlocks();
+}
+
+/* Optimizer::Optimize
+ * -------------------
+ * Functions are optimized one at a time, each on its own, since nothing
+ * is known of what the others compute.
+ */
+int Optimizer::Optimize(IRProgram *program)
+{
+    int total = 0;
+    for (int n = 0; n < program->NumFunctions(); n++) {
+        IRFunction *fn = program->GetFunction(n);
+        if (!fn->HasCode())
+            continue;
+        int before = fn->NumInstrs(), removed;
+        Optimizer optimizer(program, fn);
+        program->SetFunction(n, optimizer.Run(&removed));
+        PrintDebug("opt", "%s: %d of %d instructions removed", program->GetFunction(n)->GetName().c_str(),
+                   removed, before);
+        total += removed;
+    }
+    PrintDebug("opt", "%d instructions removed in all", total);
+    return total;
+}
+
+IRFunction *Optimizer::Run(int *numRemoved)
+{
+    this->BuildGraph();
+    this->ComputeDominators();
+    this->PlacePhis();
+    this->stacks.resize(this->kinds.size());
+    for (int p = 0; p < this->fn->NumParams(); p++)
+        this->stacks[p].push_back(p);
+    this->Rename(0);
+    this->Propagate();
+    this->RemoveDeadCode();
+    IRFunction *out = this->Rebuild();
+    *numRemoved = this->fn->NumInstrs() - out->NumInstrs();
+    return out;
+}
+
+/* Optimizer::OperandSlots
+ * -----------------------
+ * Gives where each register instruction i reads is kept, so it can be
+ * read or renamed in place. Operands that are IRNone (a return without
+ * a value) aren't registers read.
+ */
+void Optimizer::OperandSlots(IRInstr i, std::vector<uint32_t*> *slots)
+{
+    slots->clear();
+    const IROpcodeInfo *info = &IROpcodes[this->ops[i]];
+    uint32_t *fields[3] = { &this->as[i], &this->bs[i], &this->cs[i] };
+    for (int j = 0; j < 3; j++) {
+        if (info->operands[j] == OperandReg && *fields[j] != IRNone)
+            slots->push_back(fields[j]);
+        else if (info->operands[j] == OperandArgs)
+            for (uint32_t n = 0; n < this->cs[i]; n++)
+                slots->push_back(&this->args[this->bs[i] + n]);
+    }
+}
+
+/* Optimizer::HasEffects
+ * ---------------------
+ * Whether an instruction does something besides computing its value,
+ * including stopping the program with an error. An object that is made
+ * but never used can go, running out of memory not being counted.
+ */
+bool Optimizer::HasEffects(IROpcode op)
+{
+    switch (op) {
+      case OpConst: case OpDConst: case OpSConst: case OpMove:
+      case OpAdd: case OpSub: case OpMul: case OpNeg:
+      case OpDAdd: case OpDSub: case OpDMul: case OpDDiv: case OpDNeg:
+      case OpLt: case OpLe: case OpEq: case OpNe:
+      case OpDLt: case OpDLe: case OpDEq: case OpDNe: case OpSEq:
+      case OpAnd: case OpOr: case OpNot:
+      case OpLoadGlobal: case OpNew:
+        return false;
+      default:
+        return true;
+    }
+}
+
+/* Optimizer::BuildGraph
+ * ---------------------
+ * Copies the code to be rewritten, the arguments of each call copied to
+ * a run of their own, and finds each block's successors from the jump,
+ * branch or return it ends with. A branch to the same block both ways
+ * is one edge. Only blocks reachable from the entry are kept in order,
+ * and only they count as predecessors.
+ */
+void Optimizer::BuildGraph()
+{
+    int numInstrs = this->fn->NumInstrs();
+    this->ops.resize(numInstrs);
+    this->dests.resize(numInstrs);
+    this->as.resize(numInstrs);
+    this->bs.resize(numInstrs);
+    this->cs.resize(numInstrs);
+    this->blockOf.assign(numInstrs, IRNone);
+    for (IRInstr i = 0; i < (IRInstr)numInstrs; i++) {
+        this->ops[i] = this->fn->GetOp(i);
+        this->dests[i] = this->fn->GetDest(i);
+        this->as[i] = this->fn->GetA(i);
+        this->bs[i] = this->fn->GetB(i);
+        this->cs[i] = this->fn->GetC(i);
+        if (IROpcodes[this->ops[i]].operands[1] == OperandArgs) {
+            this->bs[i] = this->args.size();
+            for (uint32_t n = 0; n < this->cs[i]; n++)
+                this->args.push_back(this->fn->GetArg(i, n));
+        }
+    }
+    for (int r = 0; r < this->fn->NumRegs(); r++)
+        this->kinds.push_back(this->fn->GetRegKind(r));
+
+    this->succs.resize(this->numBlocks);
+    this->preds.resize(this->numBlocks);
+    for (IRBlock b = 0; b < (IRBlock)this->numBlocks; b++) {
+        if (this->fn->BlockStart(b) == IRNone)
+            continue;
+        for (IRInstr i = this->fn->BlockStart(b); i < this->fn->BlockEnd(b); i++)
+            this->blockOf[i] = b;
+        IRInstr last = this->fn->BlockEnd(b) - 1;
+        if (this->ops[last] == OpJump) {
+            this->succs[b].push_back(this->as[last]);
+        } else if (this->ops[last] == OpBranch) {
+            this->succs[b].push_back(this->bs[last]);
+            if (this->cs[last] != this->bs[last])
+                this->succs[b].push_back(this->cs[last]);
+        } else {
+            Assert(this->ops[last] == OpReturn);
+        }
+    }
+
+    // Depth-first from the entry, keeping a stack of the blocks being
+    // walked and how many of each one's successors have been
+    std::vector<IRBlock> postorder;
+    std::vector<bool> seen(this->numBlocks, false);
+    std::vector<std::pair<IRBlock, size_t> > walk;
+    walk.push_back(std::make_pair((IRBlock)0, (size_t)0));
+    seen[0] = true;
+    while (!walk.empty()) {
+        IRBlock b = walk.back().first;
+        if (walk.back().second < this->succs[b].size()) {
+            IRBlock s = this->succs[b][walk.back().second++];
+            if (!seen[s]) {
+                seen[s] = true;
+                walk.push_back(std::make_pair(s, (size_t)0));
+            }
+        } else {
+            postorder.push_back(b);
+            walk.pop_back();
+        }
+    }
+    this->order.assign(postorder.rbegin(), postorder.rend());
+    this->orderIndex.assign(this->numBlocks, -1);
+    for (size_t k = 0; k < this->order.size(); k++)
+        this->orderIndex[this->order[k]] = k;
+    for (size_t k = 0; k < this->order.size(); k++) {
+        IRBlock b = this->order[k];
+        for (size_t j = 0; j < this->succs[b].size(); j++)
+            this->preds[this->succs[b][j]].push_back(b);
+    }
+    Assert(this->preds[0].empty());
+}
+
+/* Optimizer::ComputeDominators
+ * ----------------------------
+ * The immediate dominators come from the iterative algorithm of Cooper,
+ * Harvey and Kennedy, over the blocks in reverse postorder, and each
+ * block's dominance frontier from walking up from each predecessor of
+ * a join to the join's immediate dominator.
+ */
+void Optimizer::ComputeDominators()
+{
+    this->idom.assign(this->numBlocks, IRNone);
+    this->idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t k = 1; k < this->order.size(); k++) {
+            IRBlock b = this->order[k];
+            IRBlock newIdom = IRNone;
+            for (size_t j = 0; j < this->preds[b].size(); j++) {
+                IRBlock p = this->preds[b][j];
+                if (this->idom[p] == IRNone)
+                    continue;
+                if (newIdom == IRNone) {
+                    newIdom = p;
+                    continue;
+                }
+                IRBlock x = p, y = newIdom;
+                while (x != y) {
+                    while (this->orderIndex[x] > this->orderIndex[y])
+                        x = this->idom[x];
+                    while (this->orderIndex[y] > this->orderIndex[x])
+                        y = this->idom[y];
+                }
+                newIdom = x;
+            }
+            if (this->idom[b] != newIdom) {
+                this->idom[b] = newIdom;
+                changed = true;
+            }
+        }
+    }
+
+    this->domChildren.resize(this->numBlocks);
+    this->frontier.resize(this->numBlocks);
+    for (size_t k = 1; k < this->order.size(); k++)
+        this->domChildren[this->idom[this->order[k]]].push_back(this->order[k]);
+    for (size_t k = 0; k < this->order.size(); k++) {
+        IRBlock b = this->order[k];
+        if (this->preds[b].size() < 2)
+            continue;
+        for (size_t j = 0; j < this->preds[b].size(); j++) {
+            for (IRBlock x = this->preds[b][j]; x != this->idom[b]; x = this->idom[x]) {
+                if (this->frontier[x].empty() || this->frontier[x].back() != b)
+                    this->frontier[x].push_back(b);
+            }
+        }
+    }
+}
+
+/* Optimizer::PlacePhis
+ * --------------------
+ * Only registers read in some block before it writes them (if it does)
+ * can need a phi, which leaves out the temporaries lowering makes for
+ * each value. Each of those gets one wherever it is in the iterated
+ * dominance frontier of the blocks that write it, the entry counting
+ * as writing the parameters.
+ */
+void Optimizer::PlacePhis()
+{
+    int numVars = this->kinds.size();
+    std::vector<bool> crossesBlocks(numVars, false);
+    std::vector<std::vector<IRBlock> > writtenIn(numVars);
+    std::vector<int> writtenHere(numVars, -1);
+    for (int p = 0; p < this->fn->NumParams(); p++)
+        writtenIn[p].push_back(0);
+    std::vector<uint32_t*> slots;
+    for (size_t k = 0; k < this->order.size(); k++) {
+        IRBlock b = this->order[k];
+        for (IRInstr i = this->fn->BlockStart(b); i < this->fn->BlockEnd(b); i++) {
+            this->OperandSlots(i, &slots);
+            for (size_t j = 0; j < slots.size(); j++) {
+                if (writtenHere[*slots[j]] != (int)b)
+                    crossesBlocks[*slots[j]] = true;
+            }
+            IRReg dest = this->dests[i];
+            if (dest == IRNone)
+                continue;
+            if (writtenHere[dest] != (int)b)
+                writtenIn[dest].push_back(b);
+            writtenHere[dest] = b;
+        }
+    }
+
+    this->blockPhis.resize(this->numBlocks);
+    std::vector<int> hasPhi(this->numBlocks, -1), queued(this->numBlocks, -1);
+    for (int var = 0; var < numVars; var++) {
+        if (!crossesBlocks[var])
+            continue;
+        std::vector<IRBlock> work = writtenIn[var];
+        for (size_t j = 0; j < work.size(); j++)
+            queued[work[j]] = var;
+        while (!work.empty()) {
+            IRBlock x = work.back();
+            work.pop_back();
+            for (size_t j = 0; j < this->frontier[x].size(); j++) {
+                IRBlock y = this->frontier[x][j];
+                if (hasPhi[y] == var)
+                    continue;
+                hasPhi[y] = var;
+                Phi phi;
+                phi.var = var;
+                phi.dest = IRNone;
+                phi.block = y;
+                phi.args.assign(this->preds[y].size(), IRNone);
+                this->blockPhis[y].push_back(this->phis.size());
+                this->phis.push_back(phi);
+                if (queued[y] != var) {
+                    queued[y] = var;
+                    work.push_back(y);
+                }
+            }
+        }
+    }
+}
+
+IRReg Optimizer::NewName(IRReg var)
+{
+    this->kinds.push_back(this->kinds[var]);
+    return this->kinds.size() - 1;
+}
+
+/* Optimizer::Rename
+ * -----------------
+ * Renames the registers of block b and the blocks it dominates: each
+ * write gets a register of its own, and each read the register of the
+ * write that reaches it, which is on top of the original register's
+ * stack. A read with nothing on the stack is of a register never
+ * written on the way there, and is left IRNone.
+ */
+void Optimizer::Rename(IRBlock b)
+{
+    std::vector<IRReg> pushed;
+    for (size_t k = 0; k < this->blockPhis[b].size(); k++) {
+        Phi *phi = &this->phis[this->blockPhis[b][k]];
+        phi->dest = this->NewName(phi->var);
+        this->stacks[phi->var].push_back(phi->dest);
+        pushed.push_back(phi->var);
+    }
+    std::vector<uint32_t*> slots;
+    for (IRInstr i = this->fn->BlockStart(b); i < this->fn->BlockEnd(b); i++) {
+        this->OperandSlots(i, &slots);
+        for (size_t j = 0; j < slots.size(); j++) {
+            std::vector<IRReg> *stack = &this->stacks[*slots[j]];
+            *slots[j] = (stack->empty() ? IRNone : stack->back());
+        }
+        IRReg var = this->dests[i];
+        if (var != IRNone) {
+            this->dests[i] = this->NewName(var);
+            this->stacks[var].push_back(this->dests[i]);
+            pushed.push_back(var);
+        }
+    }
+    for (size_t j = 0; j < this->succs[b].size(); j++) {
+        IRBlock s = this->succs[b][j];
+        size_t from = std::find(this->preds[s].begin(), this->preds[s].end(), b) - this->preds[s].begin();
+        for (size_t k = 0; k < this->blockPhis[s].size(); k++) {
+            Phi *phi = &this->phis[this->blockPhis[s][k]];
+            std::vector<IRReg> *stack = &this->stacks[phi->var];
+            phi->args[from] = (stack->empty() ? IRNone : stack->back());
+        }
+    }
+    for (size_t j = 0; j < this->domChildren[b].size(); j++)
+        this->Rename(this->domChildren[b][j]);
+    for (size_t j = pushed.size(); j > 0; j--)
+        this->stacks[pushed[j-1]].pop_back();
+}
+
+/* Optimizer::Propagate
+ * --------------------
+ * Sparse conditional constant propagation, as Wegman and Zadeck have
+ * it. A block is gone through the first time an edge into it is found
+ * to be taken, and only its phis again when another one is. After that,
+ * an instruction is looked at again only when what is known about one
+ * of the registers it reads changes, which it can only do twice.
+ */
+void Optimizer::Propagate()
+{
+    int numRegs = this->kinds.size();
+    this->defs.assign(numRegs, NoSite);
+    this->uses.assign(numRegs, std::vector<int>());
+    std::vector<uint32_t*> slots;
+    for (size_t k = 0; k < this->order.size(); k++) {
+        IRBlock b = this->order[k];
+        for (size_t j = 0; j < this->blockPhis[b].size(); j++) {
+            int p = this->blockPhis[b][j];
+            this->defs[this->phis[p].dest] = PhiSite(p);
+            for (size_t n = 0; n < this->phis[p].args.size(); n++) {
+                if (this->phis[p].args[n] != IRNone)
+                    this->uses[this->phis[p].args[n]].push_back(PhiSite(p));
+            }
+        }
+        for (IRInstr i = this->fn->BlockStart(b); i < this->fn->BlockEnd(b); i++) {
+            if (this->dests[i] != IRNone)
+                this->defs[this->dests[i]] = i;
+            this->OperandSlots(i, &slots);
+            for (size_t j = 0; j < slots.size(); j++) {
+                if (*slots[j] != IRNone)
+                    this->uses[*slots[j]].push_back(i);
+            }
+        }
+    }
+
+    Cell top = { Cell::Top, 0, 0 }, bottom = { Cell::Bottom, 0, 0 };
+    this->cells.assign(numRegs, top);
+    for (int p = 0; p < this->fn->NumParams(); p++)
+        this->cells[p] = bottom;
+    this->blockExecutable.assign(this->numBlocks, false);
+    this->edgeExecutable.resize(this->numBlocks);
+    for (int b = 0; b < this->numBlocks; b++)
+        this->edgeExecutable[b].assign(this->preds[b].size(), false);
+
+    std::vector<IRBlock> blocks;
+    std::vector<int> work;
+    this->blockExecutable[0] = true;
+    blocks.push_back(0);
+    while (!blocks.empty() || !work.empty()) {
+        int site;
+        if (!blocks.empty()) {
+            IRBlock b = blocks.back();
+            blocks.pop_back();
+            for (size_t j = 0; j < this->blockPhis[b].size(); j++)
+                work.push_back(PhiSite(this->blockPhis[b][j]));
+            for (IRInstr i = this->fn->BlockStart(b); i < this->fn->BlockEnd(b); i++)
+                work.push_back(i);
+            continue;
+        }
+        site = work.back();
+        work.pop_back();
+        if (site < 0) {
+            int p = PhiOfSite(site);
+            if (this->blockExecutable[this->phis[p].block])
+                this->SetCell(this->phis[p].dest, this->EvaluatePhi(p), &work);
+            continue;
+        }
+        IRInstr i = site;
+        IRBlock b = this->blockOf[i];
+        if (!this->blockExecutable[b])
+            continue;
+        if (this->ops[i] == OpJump) {
+            this->MarkEdge(b, this->as[i], &blocks, &work);
+        } else if (this->ops[i] == OpBranch) {
+            Cell test = this->Value(this->as[i]);
+            if (test.state != Cell::Bottom && test.state != Cell::Constant)
+                continue;
+            if (test.state == Cell::Bottom || test.i != 0)
+                this->MarkEdge(b, this->bs[i], &blocks, &work);
+            if (test.state == Cell::Bottom || test.i == 0)
+                this->MarkEdge(b, this->cs[i], &blocks, &work);
+        } else if (this->dests[i] != IRNone) {
+            this->SetCell(this->dests[i], this->Evaluate(i), &work);
+        }
+    }
+}
+
+/* Optimizer::MarkEdge
+ * -------------------
+ * Marks the edge taken, and what it leads to to be looked at: the whole
+ * block the first time it is reached, its phis after that.
+ */
+void Optimizer::MarkEdge(IRBlock from, IRBlock to, std::vector<IRBlock> *blocks, std::vector<int> *work)
+{
+    size_t j = std::find(this->preds[to].begin(), this->preds[to].end(), from) - this->preds[to].begin();
+    if (this->edgeExecutable[to][j])
+        return;
+    this->edgeExecutable[to][j] = true;
+    if (!this->blockExecutable[to]) {
+        this->blockExecutable[to] = true;
+        blocks->push_back(to);
+        return;
+    }
+    for (size_t k = 0; k < this->blockPhis[to].size(); k++)
+        work->push_back(PhiSite(this->blockPhis[to][k]));
+}
+
+/* Optimizer::SetCell
+ * ------------------
+ * What is known about a register only ever goes down, from nothing to a
+ * constant to anything, and each time it does, whatever reads it is
+ * looked at again.
+ */
+void Optimizer::SetCell(IRReg r, const Cell &value, std::vector<int> *work)
+{
+    Cell *cell = &this->cells[r];
+    if (value.state <= cell->state)
+        return;
+    *cell = value;
+    for (size_t j = 0; j < this->uses[r].size(); j++)
+        work->push_back(this->uses[r][j]);
+}
+
+Optimizer::Cell Optimizer::Value(IRReg r)
+{
+    if (r == IRNone) {
+        Cell bottom = { Cell::Bottom, 0, 0 };
+        return bottom;
+    }
+    return this->cells[r];
+}
+
+/* Optimizer::EvaluatePhi
+ * ----------------------
+ * Only the arguments along edges found to be taken count, and one that
+ * is never written on the way (IRNone) can be taken to be anything.
+ */
+Optimizer::Cell Optimizer::EvaluatePhi(int p)
+{
+    Phi *phi = &this->phis[p];
+    Cell result = { Cell::Top, 0, 0 };
+    for (size_t j = 0; j < phi->args.size(); j++) {
+        if (!this->edgeExecutable[phi->block][j] || phi->args[j] == IRNone)
+            continue;
+        Cell arg = this->cells[phi->args[j]];
+        if (arg.state == Cell::Top)
+            continue;
+        if (arg.state == Cell::Bottom || (result.state == Cell::Constant &&
+            (arg.i != result.i || memcmp(&arg.d, &result.d, sizeof(double)) != 0))) {
+            result.state = Cell::Bottom;
+            return result;
+        }
+        result = arg;
+    }
+    return result;
+}
+
+/* Optimizer::Evaluate
+ * -------------------
+ * Folds what instruction i computes if its operands are constants. Ints
+ * wrap around as they do when the program runs, and a division that
+ * would stop the program, by zero or of the smallest int by -1, isn't
+ * folded. An and with false or an or with true is known whatever the
+ * other operand is.
+ */
+Optimizer::Cell Optimizer::Evaluate(IRInstr i)
+{
+    Cell result = { Cell::Constant, 0, 0 };
+    IROpcode op = (IROpcode)this->ops[i];
+    switch (op) {
+      case OpConst:
+        result.i = (int32_t)this->as[i];
+        return result;
+      case OpDConst:
+        result.d = this->program->GetDouble(this->as[i]);
+        return result;
+      case OpMove:
+        return this->Value(this->as[i]);
+      default:
+        break;
+    }
+    const IROpcodeInfo *info = &IROpcodes[op];
+    if (info->operands[0] != OperandReg || info->operands[2] != OperandNone ||
+        (info->operands[1] != OperandReg && info->operands[1] != OperandNone) || op == OpLoadField ||
+        op == OpLoadElem || op == OpLength || op == OpNewArray || op == OpSEq) {
+        result.state = Cell::Bottom;
+        return result;
+    }
+
+    Cell x = this->Value(this->as[i]);
+    Cell y = (info->operands[1] == OperandReg ? this->Value(this->bs[i]) : x);
+    if (op == OpAnd && ((x.state == Cell::Constant && x.i == 0) || (y.state == Cell::Constant && y.i == 0)))
+        return result;
+    if (op == OpOr && ((x.state == Cell::Constant && x.i != 0) || (y.state == Cell::Constant && y.i != 0))) {
+        result.i = 1;
+        return result;
+    }
+    if (x.state != Cell::Constant || y.state != Cell::Constant) {
+        result.state = (x.state == Cell::Bottom || y.state == Cell::Bottom ? Cell::Bottom : Cell::Top);
+        return result;
+    }
+
+    uint32_t a = x.i, b = y.i;
+    switch (op) {
+      case OpAdd: result.i = (int32_t)(a + b); break;
+      case OpSub: result.i = (int32_t)(a - b); break;
+      case OpMul: result.i = (int32_t)(a * b); break;
+      case OpNeg: result.i = (int32_t)(0u - a); break;
+      case OpDiv:
+      case OpMod:
+        if (y.i == 0 || (x.i == INT_MIN && y.i == -1))
+            result.state = Cell::Bottom;
+        else
+            result.i = (op == OpDiv ? x.i / y.i : x.i % y.i);
+        break;
+      case OpDAdd: result.d = x.d + y.d; break;
+      case OpDSub: result.d = x.d - y.d; break;
+      case OpDMul: result.d = x.d * y.d; break;
+      case OpDDiv: result.d = x.d / y.d; break;
+      case OpDNeg: result.d = -x.d; break;
+      case OpLt:   result.i = (x.i < y.i); break;
+      case OpLe:   result.i = (x.i <= y.i); break;
+      case OpEq:   result.i = (x.i == y.i); break;
+      case OpNe:   result.i = (x.i != y.i); break;
+      case OpDLt:  result.i = (x.d < y.d); break;
+      case OpDLe:  result.i = (x.d <= y.d); break;
+      case OpDEq:  result.i = (x.d == y.d); break;
+      case OpDNe:  result.i = (x.d != y.d); break;
+      case OpAnd:  result.i = (x.i && y.i); break;
+      case OpOr:   result.i = (x.i || y.i); break;
+      case OpNot:  result.i = !x.i; break;
+      default:     result.state = Cell::Bottom; break;
+    }
+    return result;
+}
+
+/* Optimizer::RemoveDeadCode
+ * -------------------------
+ * Marks what has to stay, starting from what the blocks that can run do
+ * besides computing values, then going back through the registers that
+ * reads. An instruction or phi found to compute a constant reads nothing,
+ * since it will just load the constant, and neither does a branch on a
+ * constant, which will be a jump.
+ */
+void Optimizer::RemoveDeadCode()
+{
+    this->live.assign(this->ops.size(), false);
+    this->livePhi.assign(this->phis.size(), false);
+    std::vector<int> work;
+    for (size_t k = 0; k < this->order.size(); k++) {
+        IRBlock b = this->order[k];
+        if (!this->blockExecutable[b])
+            continue;
+        for (IRInstr i = this->fn->BlockStart(b); i < this->fn->BlockEnd(b); i++) {
+            IRReg dest = this->dests[i];
+            bool constant = (dest != IRNone && this->cells[dest].state == Cell::Constant);
+            if (HasEffects((IROpcode)this->ops[i]) && !constant) {
+                this->live[i] = true;
+                work.push_back(i);
+            }
+        }
+    }
+
+    std::vector<uint32_t*> slots;
+    std::vector<IRReg> reads;
+    while (!work.empty()) {
+        int site = work.back();
+        work.pop_back();
+        reads.clear();
+        if (site < 0) {
+            Phi *phi = &this->phis[PhiOfSite(site)];
+            if (this->cells[phi->dest].state == Cell::Constant)
+                continue;
+            for (size_t j = 0; j < phi->args.size(); j++) {
+                if (this->edgeExecutable[phi->block][j] && phi->args[j] != IRNone)
+                    reads.push_back(phi->args[j]);
+            }
+        } else {
+            IRInstr i = site;
+            IRReg dest = this->dests[i];
+            if (dest != IRNone && this->cells[dest].state == Cell::Constant)
+                continue;
+            if (this->ops[i] == OpBranch && this->cells[this->as[i]].state == Cell::Constant)
+                continue;
+            this->OperandSlots(i, &slots);
+            for (size_t j = 0; j < slots.size(); j++) {
+                if (*slots[j] != IRNone)
+                    reads.push_back(*slots[j]);
+            }
+        }
+        for (size_t j = 0; j < reads.size(); j++) {
+            int def = this->defs[reads[j]];
+            if (def == NoSite)
+                continue;
+            if (def < 0 && !this->livePhi[PhiOfSite(def)]) {
+                this->livePhi[PhiOfSite(def)] = true;
+                work.push_back(def);
+            } else if (def >= 0 && !this->live[def]) {
+                this->live[def] = true;
+                work.push_back(def);
+            }
+        }
+    }
+}
+
+/* Optimizer::JumpTarget
+ * ----------------------
+ * The block that b goes on to if all it will do is jump there, so that
+ * whatever jumps to b can jump there instead, or IRNone. A phi joined
+ * into one register with its arguments takes no code.
+ */
+IRBlock Optimizer::JumpTarget(IRBlock b)
+{
+    for (size_t j = 0; j < this->blockPhis[b].size(); j++) {
+        int p = this->blockPhis[b][j];
+        if (this->livePhi[p] && this->cells[this->phis[p].dest].state == Cell::Constant)
+            return IRNone;
+    }
+    IRInstr last = this->fn->BlockEnd(b) - 1;
+    for (IRInstr i = this->fn->BlockStart(b); i < last; i++) {
+        if (this->live[i])
+            return IRNone;
+    }
+    if (this->ops[last] == OpJump)
+        return this->as[last];
+    if (this->ops[last] == OpBranch && this->cells[this->as[last]].state == Cell::Constant)
+        return (this->cells[this->as[last]].i ? this->bs[last] : this->cs[last]);
+    return IRNone;
+}
+
+/* Function: Find
+ * --------------
+ * The representative of r's set, in a union-find forest kept as parents.
+ */
+static IRReg Find(std::vector<IRReg> *parent, IRReg r)
+{
+    while ((*parent)[r] != r) {
+        (*parent)[r] = (*parent)[(*parent)[r]];
+        r = (*parent)[r];
+    }
+    return r;
+}
+
+/* Optimizer::Rebuild
+ * ------------------
+ * Makes the optimized function, with the blocks that can run in the
+ * order they were laid out in, less those that would only jump on. A
+ * phi that stays joins its arguments into one register with itself (see
+ * optimize.h), unless it is a constant, which it gets by a load at the
+ * start of its block. The registers are numbered again, the parameters
+ * first as before, and a move from a register to itself is dropped.
+ */
+IRFunction *Optimizer::Rebuild()
+{
+    int numRegs = this->kinds.size();
+    std::vector<IRReg> parent(numRegs);
+    for (int r = 0; r < numRegs; r++)
+        parent[r] = r;
+    for (size_t p = 0; p < this->phis.size(); p++) {
+        Phi *phi = &this->phis[p];
+        if (!this->livePhi[p] || this->cells[phi->dest].state == Cell::Constant)
+            continue;
+        for (size_t j = 0; j < phi->args.size(); j++) {
+            if (this->edgeExecutable[phi->block][j] && phi->args[j] != IRNone)
+                parent[Find(&parent, phi->args[j])] = Find(&parent, phi->dest);
+        }
+    }
+    for (int p = 0; p < this->fn->NumParams(); p++) {   // params name their sets
+        IRReg root = Find(&parent, p);
+        parent[root] = p;
+        parent[p] = p;
+    }
+
+    IRFunction *out = new IRFunction(this->fn->GetName(), this->fn->NumParams(), this->fn->GetReturnKind());
+    std::vector<IRReg> regMap(numRegs, IRNone);
+    for (int p = 0; p < this->fn->NumParams(); p++)
+        regMap[p] = out->NewReg((IRKind)this->kinds[p]);
+
+    std::vector<std::pair<IRInstr, IRBlock> > layout;
+    for (size_t k = 0; k < this->order.size(); k++) {
+        if (this->blockExecutable[this->order[k]])
+            layout.push_back(std::make_pair(this->fn->BlockStart(this->order[k]), this->order[k]));
+    }
+    std::sort(layout.begin(), layout.end());
+    std::vector<IRBlock> forward(this->numBlocks, IRNone);   // of blocks that only jump
+    for (size_t k = 1; k < layout.size(); k++)
+        forward[layout[k].second] = this->JumpTarget(layout[k].second);
+    for (size_t k = 1; k < layout.size(); k++) {
+        IRBlock b = layout[k].second, target = b;
+        for (int steps = 0; forward[target] != IRNone && steps <= this->numBlocks; steps++)
+            target = forward[target];
+        if (forward[target] != IRNone)   // a loop that does nothing
+            forward[b] = IRNone;
+    }
+    std::vector<IRBlock> blockMap(this->numBlocks, IRNone);
+    for (size_t k = 0; k < layout.size(); k++) {
+        if (forward[layout[k].second] == IRNone)
+            blockMap[layout[k].second] = out->NewBlock();
+    }
+    for (size_t k = 0; k < layout.size(); k++) {
+        IRBlock target = layout[k].second;
+        while (forward[target] != IRNone)
+            target = forward[target];
+        blockMap[layout[k].second] = blockMap[target];
+    }
+
+    std::vector<IRReg> actuals;
+    for (size_t k = 0; k < layout.size(); k++) {
+        IRBlock b = layout[k].second;
+        if (forward[b] != IRNone)
+            continue;
+        out->StartBlock(blockMap[b]);
+        std::vector<std::pair<IRReg, IRInstr> > emitted;   // constant phis, then instructions
+        for (size_t j = 0; j < this->blockPhis[b].size(); j++) {
+            int p = this->blockPhis[b][j];
+            if (this->livePhi[p] && this->cells[this->phis[p].dest].state == Cell::Constant)
+                emitted.push_back(std::make_pair(this->phis[p].dest, IRNone));
+        }
+        for (IRInstr i = this->fn->BlockStart(b); i < this->fn->BlockEnd(b); i++) {
+            if (this->live[i])
+                emitted.push_back(std::make_pair(this->dests[i], i));
+        }
+        for (size_t j = 0; j < emitted.size(); j++) {
+            IRReg dest = emitted[j].first;
+            IRInstr i = emitted[j].second;
+            IRReg mapped = IRNone;
+            if (dest != IRNone) {
+                IRReg root = Find(&parent, dest);
+                if (regMap[root] == IRNone)
+                    regMap[root] = out->NewReg((IRKind)this->kinds[root]);
+                mapped = regMap[root];
+            }
+            Cell *cell = (dest != IRNone ? &this->cells[dest] : NULL);
+            if (cell != NULL && cell->state == Cell::Constant) {
+                if (this->kinds[dest] == IRDouble)
+                    out->Emit(OpDConst, mapped, this->program->AddDouble(cell->d));
+                else
+                    out->Emit(OpConst, mapped, (uint32_t)cell->i);
+                continue;
+            }
+
+            IROpcode op = (IROpcode)this->ops[i];
+            if (op == OpBranch && this->cells[this->as[i]].state == Cell::Constant) {
+                out->Emit(OpJump, IRNone, blockMap[this->cells[this->as[i]].i ? this->bs[i] : this->cs[i]]);
+                continue;
+            }
+            const IROpcodeInfo *info = &IROpcodes[op];
+            uint32_t fields[3] = { this->as[i], this->bs[i], this->cs[i] };
+            for (int n = 0; n < 3; n++) {
+                if (info->operands[n] == OperandBlock) {
+                    fields[n] = blockMap[fields[n]];
+                } else if (info->operands[n] == OperandReg && fields[n] != IRNone) {
+                    IRReg root = Find(&parent, fields[n]);
+                    if (regMap[root] == IRNone)
+                        regMap[root] = out->NewReg((IRKind)this->kinds[root]);
+                    fields[n] = regMap[root];
+                }
+            }
+            if (op == OpMove && fields[0] == mapped)
+                continue;
+            if (info->operands[1] == OperandArgs) {
+                actuals.clear();
+                for (uint32_t n = 0; n < this->cs[i]; n++) {
+                    IRReg root = Find(&parent, this->args[this->bs[i] + n]);
+                    if (regMap[root] == IRNone)
+                        regMap[root] = out->NewReg((IRKind)this->kinds[root]);
+                    actuals.push_back(regMap[root]);
+                }
+                out->EmitCall(op, mapped, fields[0], actuals);
+            } else {
+                out->Emit(op, mapped, fields[0], fields[1], fields[2]);
+            }
+        }
+    }
+    return out;
+}
@@ -0,0 +1,115 @@
+/* File: optimize.h
+ * ----------------
+ * The optimizer run on the IR (see ir.h) with -O1. Each function is put
+ * in SSA form, where every register is written exactly once: registers
+ * that are written more than once, the locals, are split into one
+ * register per write, joined by phis where control flow meets. The phis
+ * are only kept by the optimizer, so they never show up in the IR.
+ *
+ * Sparse conditional constant propagation then works out which
+ * registers hold a constant, folding int, double and bool arithmetic,
+ * comparisons and logic over the constants the program was lowered
+ * from, and which blocks can run at all, by following only the edges a
+ * branch on a constant can take. An instruction found to compute a
+ * constant becomes a load of that constant, a branch on a constant
+ * becomes a jump, and blocks that can't run are dropped. Dead-code
+ * elimination then drops every instruction whose value isn't used and
+ * that does nothing else. An instruction that can stop the program with
+ * an error, as a division by zero or a subscript out of bounds can,
+ * counts as doing something.
+ *
+ * The phis are taken out again by giving each register a phi joins the
+ * same register as the phi. Nothing in SSA form made straight from the
+ * function is live alongside another register the same phi joins, and
+ * the optimizer never moves one of them, so no copies are needed for it.
+ *
+ * How many instructions were removed is printed through the "opt" debug
+ * key, function by function.
+ */
+
+#ifndef _H_optimize
+#define _H_optimize
+
+#include "ir.h"
+#include <vector>
+
+class Optimizer
+{
+  public:
+           // Optimizes each function of program with code, replacing
+           // it, and returns how many instructions were removed in all
+    static int Optimize(IRProgram *program);
+
+  private:
+           // A phi for the register var at the start of a block, with
+           // one argument for each of its predecessors, in their order
+    struct Phi
+    {
+        IRReg var;
+        IRReg dest;
+        IRBlock block;
+        std::vector<IRReg> args;
+    };
+
+           // What constant propagation knows of a register: nothing yet,
+           // that it always holds value, or that it can hold more than one
+    struct Cell
+    {
+        enum { Top, Constant, Bottom } state;
+        int32_t i;          // the value, for an int or a reference (null)
+        double d;           // the value, for a double
+    };
+
+    IRProgram *program;
+    IRFunction *fn;
+    int numBlocks;
+
+    std::vector<uint8_t> ops;        // the function's code, being rewritten
+    std::vector<IRReg> dests;
+    std::vector<uint32_t> as, bs, cs;
+    std::vector<IRReg> args;
+    std::vector<uint8_t> kinds;      // of the registers, SSA ones included
+    std::vector<IRBlock> blockOf;    // of each instruction
+
+    std::vector<std::vector<IRBlock> > succs, preds;
+    std::vector<IRBlock> order;      // reachable blocks, in reverse postorder
+    std::vector<int> orderIndex;     // of each block in order, or -1
+    std::vector<IRBlock> idom;
+    std::vector<std::vector<IRBlock> > domChildren, frontier;
+
+    std::vector<Phi> phis;
+    std::vector<std::vector<int> > blockPhis;
+    std::vector<std::vector<IRReg> > stacks;   // renaming, by original register
+
+    std::vector<int> defs;                     // site defining each register
+    std::vector<std::vector<int> > uses;       // sites using it
+    std::vector<Cell> cells;
+    std::vector<std::vector<bool> > edgeExecutable;   // by predecessor index
+    std::vector<bool> blockExecutable;
+    std::vector<bool> live, livePhi;
+
+    Optimizer(IRProgram *program, IRFunction *fn);
+    IRFunction *Run(int *numRemoved);
+
+    void OperandSlots(IRInstr i, std::vector<uint32_t*> *slots);
+    static bool HasEffects(IROpcode op);
+
+    void BuildGraph();
+    void ComputeDominators();
+    void PlacePhis();
+    void Rename(IRBlock b);
+    IRReg NewName(IRReg var);
+
+    void Propagate();
+    Cell Evaluate(IRInstr i);
+    Cell EvaluatePhi(int p);
+    Cell Value(IRReg r);
+    void SetCell(IRReg r, const Cell &value, std::vector<int> *work);
+    void MarkEdge(IRBlock from, IRBlock to, std::vector<IRBlock> *blocks, std::vector<int> *work);
+
+    void RemoveDeadCode();
+    IRBlock JumpTarget(IRBlock b);
+    IRFunction *Rebuild();
+};
+
+#endif
@@ -28,11 +28,13 @@
 // we are compiling y.tab.c, which we use the YYBISON symbol for. 
 // Managing C headers can be such a mess! 
 
+class CompilationContext;    // the parser is handed one of these
+
 #ifndef YYBISON                 
 #include "y.tab.h"              
 #endif
 
-int yyparse();              // Defined in the generated y.tab.c file
+int yyparse(yyscan_t scanner, CompilationContext *context); // Defined in y.tab.c
 void InitParser();          // Defined in parser.y
 
 #endif
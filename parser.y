@@ -5,14 +5,36 @@
 
 %{
 
-#include "scanner.h" // for yylex
+#include "scanner.h" // for yyscan_t
 #include "parser.h"
 #include "errors.h"
-
-void yyerror(const char *msg); // standard error-handling routine
+#include "context.h"
+#include <mutex>
 
 %}
 
+
+/* Reentrancy
+ * ----------
+ * The parser is pure: yylval and yylloc are its own rather than globals,
+ * and it is handed the scanner to read from and the context of the
+ * compilation it is parsing for, so any number can run at once.
+ */
+%define api.pure full
+%locations
+%lex-param   {yyscan_t scanner}
+%parse-param {yyscan_t scanner}
+%parse-param {CompilationContext *context}
+
+%code {
+  // Defined in the generated lex.yy.c file
+int yylex(YYSTYPE *yylval, yyltype *yylloc, yyscan_t scanner);
+  // standard error-handling routine
+void yyerror(yyltype *loc, yyscan_t scanner, CompilationContext *context, const char *msg);
+  // makes the node for a type name, noting the name in the context
+static NamedType *TypeName(CompilationContext *context, yyltype loc, Symbol name);
+}
+
  
 /* yylval 
  * ------
@@ -20,9 +42,9 @@ void yyerror(const char *msg); // standard error-handling routine
 %union {
     int integerConstant;
     bool boolConstant;
-    char *stringConstant;
+    Lexeme stringConstant;          // views into the source text
     double doubleConstant;
-    char identifier[MaxIdentLen+1]; // +1 for terminating null
+    Symbol identifier;              // interned by the scanner
     Decl *decl;
     List<Decl*> *declList;
     Type *type;
@@ -65,7 +87,7 @@ void yyerror(const char *msg); // standard error-handling routine
 %type <cTypeList> OptImpl ImpList
 %type <decl>      ClassDecl Decl Field IntfDecl
 %type <fDecl>     FnDecl FnHeader
-%type <declList>  FieldList DeclList IntfList
+%type <declList>  FieldList IntfList
 %type <var>       Variable VarDecl
 %type <varList>   Formals FormalList VarDecls
 %type <exprList>  Actuals ExprList
@@ -95,18 +117,12 @@ void yyerror(const char *msg); // standard error-handling routine
  * -----
 	 
  */
-Program   :    DeclList            { 
-                                      @1; 
-                                      Program *program = new Program($1);
-                                      // if no errors, advance to next phase
-                                      if (ReportError::NumErrors() == 0) 
-                                          program->Check(); 
-                                    }
+Program   :    DeclList            { @1; }
           ;
 
 
-DeclList  :    DeclList Decl        { ($$=$1)->Append($2); }
-          |    Decl                 { ($$ = new List<Decl*>)->Append($1); }
+DeclList  :    DeclList Decl        { context->AddDecl($2, MakeSpan(@2)); }
+          |    Decl                 { context->AddDecl($1, MakeSpan(@1)); }
           ;
 
 Decl      :    ClassDecl
@@ -125,8 +141,8 @@ Type      :    T_Int                { $$ = Type::intType; }
           |    T_Bool               { $$ = Type::boolType; }
           |    T_String             { $$ = Type::stringType; }
           |    T_Double             { $$ = Type::doubleType; }
-          |    T_Identifier         { $$ = new NamedType(new Identifier(@1,$1)); }
-          |    Type T_Dims          { $$ = new ArrayType(Join(@1, @2), $1); }
+          |    T_Identifier         { $$ = TypeName(context, @1, $1); }
+          |    Type T_Dims          { $$ = ArrayType::Of(Join(@1, @2), $1); }
           ;
 
 IntfDecl  :    T_Interface T_Identifier '{' IntfList '}' 
@@ -143,7 +159,7 @@ ClassDecl :    T_Class T_Identifier OptExt OptImpl '{' FieldList '}'
           ; 
                 
 OptExt    :    T_Extends T_Identifier    
-                                    { $$ = new NamedType(new Identifier(@2, $2)); }
+                                    { $$ = TypeName(context, @2, $2); }
           |    /* empty */          { $$ = NULL; }
           ;
 
@@ -153,8 +169,8 @@ OptImpl   :    T_Implements ImpList
           ;
 
 ImpList   :    ImpList ',' T_Identifier    
-                                    { ($$=$1)->Append(new NamedType(new Identifier(@3, $3))); }
-          |    T_Identifier         { ($$=new List<NamedType*>)->Append(new NamedType(new Identifier(@1, $1))); }
+                                    { ($$=$1)->Append(TypeName(context, @3, $3)); }
+          |    T_Identifier         { ($$=new List<NamedType*>)->Append(TypeName(context, @1, $1)); }
           ;
 
 FieldList :    FieldList Field      { ($$=$1)->Append($2); }
@@ -181,7 +197,8 @@ FormalList:    FormalList ',' Variable
           |    Variable             { ($$ = new List<VarDecl*>)->Append($1); }
           ;
 
-FnDecl    :    FnHeader StmtBlock   { ($$=$1)->SetFunctionBody($2); }
+FnDecl    :    FnHeader             { context->StartBody(); }
+               StmtBlock            { ($$=$1)->SetFunctionBody($3, context->FinishBody()); }
           ;
 
 StmtBlock :    '{' VarDecls StmtList '}' 
@@ -255,7 +272,7 @@ Expr      :    LValue               { $$ = $1; }
                                     { $$ = new ReadIntegerExpr(Join(@1,@3)); }
           |    T_ReadLine '(' ')'   { $$ = new ReadLineExpr(Join(@1,@3)); }
           |    T_New '(' T_Identifier ')' 
-                                    { $$ = new NewExpr(Join(@1,@4),new NamedType(new Identifier(@3,$3))); }
+                                    { $$ = new NewExpr(Join(@1,@4), TypeName(context, @3, $3)); }
           |    T_NewArray '(' Expr ',' Type ')' 
                                     { $$ = new NewArrayExpr(Join(@1,@6),$3, $5); }
           |    T_This               { $$ = new This(@1); }
@@ -295,10 +312,25 @@ OptElse   :    T_Else Stmt          { $$ = $2; }
  * If set to false, no information is printed. Setting it to true will give
  * you a running trail that might be helpful when debugging your parser.
  * Please be sure the variable is set to false when submitting your final
- * version.
+ * version. The variable is shared by every parser, so only the first call
+ * sets it.
  */
 void InitParser()
 {
+   static std::once_flag initialized;
    PrintDebug("parser", "Initializing parser");
-   yydebug = false;
+   std::call_once(initialized, [] { yydebug = false; });
+}
+
+
+/* Function: TypeName
+ * ------------------
+ * Every type name goes through here, so that when declarations are
+ * checked as they are parsed (see stream.h), each one knows which names
+ * it has to wait for.
+ */
+static NamedType *TypeName(CompilationContext *context, yyltype loc, Symbol name)
+{
+   context->NoteTypeName(name);
+   return new NamedType(new Identifier(loc, name));
 }
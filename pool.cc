@@ -0,0 +1,105 @@
+/* File: pool.cc
+ * -------------
+ * Implementation of the WorkPool class.
+ */
+
+#include "pool.h"
+
+WorkPool::WorkPool(int n)
+{
+    Assert(n > 0);
+    numWorkers = n;
+    nextWorker = 0;
+    numQueued = numPending = 0;
+    stopping = false;
+    workers = new Worker[n];
+    for (int i = 0; i < n; i++)
+        workers[i].thread = std::thread(&WorkPool::Work, this, i);
+}
+
+WorkPool::~WorkPool()
+{
+    Wait();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (int i = 0; i < numWorkers; i++)
+        workers[i].thread.join();
+    delete[] workers;
+}
+
+void WorkPool::Submit(Task *task)
+{
+    Worker *w = &workers[nextWorker];
+    nextWorker = (nextWorker + 1) % numWorkers;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        numQueued++;
+        numPending++;
+    }
+    {
+        std::lock_guard<std::mutex> guard(w->lock);
+        w->tasks.push_back(task);
+    }
+    workReady.notify_one();
+}
+
+void WorkPool::Wait()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (numPending > 0)
+        allDone.wait(guard);
+}
+
+/* WorkPool::Take
+ * --------------
+ * Returns the newest task in worker w's own queue or, failing that, the
+ * oldest one in any other worker's queue. Returns NULL if all the queues
+ * are empty.
+ */
+Task *WorkPool::Take(int w)
+{
+    Task *task = NULL;
+    for (int i = 0; i < numWorkers && task == NULL; i++) {
+        Worker *victim = &workers[(w + i) % numWorkers];
+        std::lock_guard<std::mutex> guard(victim->lock);
+        if (victim->tasks.empty())
+            continue;
+        if (i == 0) {
+            task = victim->tasks.back();
+            victim->tasks.pop_back();
+        } else {
+            task = victim->tasks.front();
+            victim->tasks.pop_front();
+        }
+    }
+    return task;
+}
+
+void WorkPool::Work(int w)
+{
+    Arena::SetCurrent(&workers[w].arena);
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while (numQueued == 0 && !stopping)
+                workReady.wait(guard);
+            if (numQueued == 0)
+                return;    // stopping, and nothing left to do
+        }
+        Task *task = Take(w);
+        if (task == NULL)
+            continue;      // another worker got there first
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            numQueued--;
+        }
+        task->Run();
+        delete task;
+        std::lock_guard<std::mutex> guard(lock);
+        if (--numPending == 0)
+            allDone.notify_all();
+    }
+}
@@ -0,0 +1,70 @@
+/* File: pool.h
+ * ------------
+ * A fixed set of worker threads that run Tasks handed to them. Each
+ * worker has its own queue: new tasks are dealt out to the queues in
+ * turn, a worker takes the most recently added task from its own queue,
+ * and a worker whose queue is empty steals the oldest task from another
+ * worker's, so all the workers stay busy until the work runs out.
+ *
+ * Each worker also has its own arena, which is its current arena while
+ * its tasks run, so tasks can allocate without any locking. What tasks
+ * allocate stays valid until the pool is destroyed.
+ */
+
+#ifndef _H_pool
+#define _H_pool
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "arena.h"
+
+class Task
+{
+  public:
+    virtual ~Task() {}
+    virtual void Run() = 0;
+};
+
+class WorkPool
+{
+  public:
+           // Starts numWorkers threads, which wait for tasks
+    WorkPool(int numWorkers);
+
+           // Waits for the workers to finish what's queued, then stops
+           // them and releases their arenas
+    ~WorkPool();
+
+           // Queues the task to be run by some worker, which deletes it
+           // once it has run
+    void Submit(Task *task);
+
+           // Waits until every task submitted so far has run
+    void Wait();
+
+    int NumWorkers() { return numWorkers; }
+
+  private:
+    struct Worker {
+        std::mutex lock;       // guards tasks
+        std::deque<Task*> tasks;
+        std::thread thread;
+        Arena arena;
+    };
+
+    Worker *workers;
+    int numWorkers;
+    int nextWorker;            // the queue the next task is dealt to
+
+    std::mutex lock;           // guards the counts and stopping
+    std::condition_variable workReady, allDone;
+    int numQueued, numPending;
+    bool stopping;
+
+    void Work(int w);
+    Task *Take(int w);
+};
+
+#endif
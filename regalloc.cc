@@ -0,0 +1,232 @@
+/* File: regalloc.cc
+ * -----------------
+ * Implementation of the LinearScan register allocator.
+ */
+
+#include "regalloc.h"
+#include "utility.h"
+#include <limits.h>
+#include <algorithm>
+
+
+LinearScan::LinearScan(IRFunction *f, const MachineRegisters *m, const std::vector<bool> *u)
+{
+    this->fn = f;
+    this->machine = m;
+    this->unplaced = u;
+    this->numSlots = 0;
+    this->machineReg.assign(f->NumRegs(), -1);
+    this->slot.assign(f->NumRegs(), -1);
+    this->BuildIntervals();
+    this->Allocate(false);
+    this->Allocate(true);
+}
+
+/* LinearScan::BuildIntervals
+ * --------------------------
+ * Which registers are live into and out of each block comes from the
+ * usual backward dataflow, gone over until nothing changes. An interval
+ * then runs from the first to the last of the positions its register is
+ * written, read, or live into or out of a block at.
+ */
+void LinearScan::BuildIntervals()
+{
+    int numBlocks = this->fn->NumBlocks(), numRegs = this->fn->NumRegs();
+    std::vector<std::vector<IRBlock> > succs(numBlocks);
+    std::vector<std::vector<IRReg> > reads(numBlocks), writes(numBlocks);
+    std::vector<IRReg> operands;
+    std::vector<int> written(numRegs, -1), read(numRegs, -1);
+    for (IRBlock b = 0; b < (IRBlock)numBlocks; b++) {
+        if (this->fn->BlockStart(b) == IRNone)
+            continue;
+        for (IRInstr i = this->fn->BlockStart(b); i < this->fn->BlockEnd(b); i++) {
+            operands.clear();
+            this->fn->GetReads(i, &operands);
+            for (size_t j = 0; j < operands.size(); j++) {
+                if (written[operands[j]] != (int)b && read[operands[j]] != (int)b) {
+                    read[operands[j]] = b;
+                    reads[b].push_back(operands[j]);   // before any write here
+                }
+            }
+            IRReg dest = this->fn->GetDest(i);
+            if (dest != IRNone && written[dest] != (int)b) {
+                written[dest] = b;
+                writes[b].push_back(dest);
+            }
+        }
+        IRInstr last = this->fn->BlockEnd(b) - 1;
+        if (this->fn->GetOp(last) == OpJump) {
+            succs[b].push_back(this->fn->GetA(last));
+        } else if (this->fn->GetOp(last) == OpBranch) {
+            succs[b].push_back(this->fn->GetB(last));
+            succs[b].push_back(this->fn->GetC(last));
+        }
+    }
+
+    std::vector<std::vector<bool> > liveIn(numBlocks, std::vector<bool>(numRegs, false));
+    std::vector<std::vector<bool> > liveOut = liveIn;
+    std::vector<bool> killed(numRegs, false);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = numBlocks - 1; b >= 0; b--) {
+            if (this->fn->BlockStart(b) == IRNone)
+                continue;
+            for (size_t j = 0; j < succs[b].size(); j++) {
+                std::vector<bool> &in = liveIn[succs[b][j]];
+                for (int r = 0; r < numRegs; r++) {
+                    if (in[r] && !liveOut[b][r]) {
+                        liveOut[b][r] = true;
+                        changed = true;
+                    }
+                }
+            }
+            for (size_t j = 0; j < writes[b].size(); j++)
+                killed[writes[b][j]] = true;
+            for (int r = 0; r < numRegs; r++) {
+                if (liveOut[b][r] && !killed[r] && !liveIn[b][r]) {
+                    liveIn[b][r] = true;
+                    changed = true;
+                }
+            }
+            for (size_t j = 0; j < writes[b].size(); j++)
+                killed[writes[b][j]] = false;
+            for (size_t j = 0; j < reads[b].size(); j++) {
+                if (!liveIn[b][reads[b][j]]) {
+                    liveIn[b][reads[b][j]] = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    this->start.assign(numRegs, INT_MAX);
+    this->end.assign(numRegs, -1);
+    this->copyOf.assign(numRegs, IRNone);
+    for (IRBlock b = 0; b < (IRBlock)numBlocks; b++) {
+        if (this->fn->BlockStart(b) == IRNone)
+            continue;
+        int first = 2 * this->fn->BlockStart(b), last = 2 * (this->fn->BlockEnd(b) - 1) + 1;
+        for (int r = 0; r < numRegs; r++) {
+            if (liveIn[b][r]) {
+                this->start[r] = std::min(this->start[r], first);
+                this->end[r] = std::max(this->end[r], first);
+            }
+            if (liveOut[b][r]) {
+                this->start[r] = std::min(this->start[r], last);
+                this->end[r] = std::max(this->end[r], last);
+            }
+        }
+        for (IRInstr i = this->fn->BlockStart(b); i < this->fn->BlockEnd(b); i++) {
+            operands.clear();
+            this->fn->GetReads(i, &operands);
+            for (size_t j = 0; j < operands.size(); j++) {
+                this->start[operands[j]] = std::min(this->start[operands[j]], 2 * (int)i);
+                this->end[operands[j]] = std::max(this->end[operands[j]], 2 * (int)i);
+            }
+            IRReg dest = this->fn->GetDest(i);
+            if (this->fn->GetOp(i) == OpMove)
+                this->copyOf[dest] = this->fn->GetA(i);
+            if (dest != IRNone) {
+                this->start[dest] = std::min(this->start[dest], 2 * (int)i + 1);
+                this->end[dest] = std::max(this->end[dest], 2 * (int)i + 1);
+            }
+            if (this->machine->callsOut(this->fn->GetOp(i)))
+                this->calls.push_back(2 * i);
+        }
+    }
+    std::sort(this->calls.begin(), this->calls.end());
+    for (int p = 0; p < this->fn->NumParams(); p++) {   // written before the entry
+        if (this->end[p] >= 0)
+            this->start[p] = -1;
+    }
+}
+
+/* LinearScan::CrossesCall
+ * -----------------------
+ * Whether r holds a value from before some call to after it. The call's
+ * own operands are read before it, and its result is written after.
+ */
+bool LinearScan::CrossesCall(IRReg r)
+{
+    std::vector<int>::iterator call = std::lower_bound(this->calls.begin(), this->calls.end(), this->start[r]);
+    return call != this->calls.end() && *call < this->end[r];
+}
+
+/* LinearScan::Allocate
+ * --------------------
+ * Allocates the registers of one kind, taking the one a register is
+ * copied from if that's just become free, and otherwise one a call
+ * doesn't keep when it can, since those cost nothing to use. The intervals still
+ * holding a machine register are kept sorted by where they end, so the
+ * ones over by the time the next one starts are at the front.
+ */
+void LinearScan::Allocate(bool doubles)
+{
+    const std::vector<int> &calleeSaved = (doubles ? this->machine->doubleCalleeSaved
+                                                   : this->machine->intCalleeSaved);
+    const std::vector<int> &callerSaved = (doubles ? this->machine->doubleCallerSaved
+                                                   : this->machine->intCallerSaved);
+    std::vector<int> &used = (doubles ? this->usedDoubleCalleeSaved : this->usedIntCalleeSaved);
+    std::vector<std::pair<int, IRReg> > intervals;
+    for (IRReg r = 0; r < (IRReg)this->fn->NumRegs(); r++) {
+        if (this->end[r] >= 0 && (this->fn->GetRegKind(r) == IRDouble) == doubles &&
+            (this->unplaced == NULL || !(*this->unplaced)[r]))
+            intervals.push_back(std::make_pair(this->start[r], r));
+    }
+    std::sort(intervals.begin(), intervals.end());
+
+    std::vector<bool> isFree(32, true);
+    std::vector<IRReg> active;
+    for (size_t k = 0; k < intervals.size(); k++) {
+        IRReg r = intervals[k].second;
+        size_t expired = 0;
+        while (expired < active.size() && this->end[active[expired]] < this->start[r])
+            isFree[this->machineReg[active[expired++]]] = true;
+        active.erase(active.begin(), active.begin() + expired);
+
+        bool crosses = this->CrossesCall(r);
+        int reg = -1;
+        IRReg copied = this->copyOf[r];
+        if (copied != IRNone && this->machineReg[copied] >= 0 && isFree[this->machineReg[copied]] &&
+            (!crosses || std::find(calleeSaved.begin(), calleeSaved.end(), this->machineReg[copied]) != calleeSaved.end()))
+            reg = this->machineReg[copied];   // so the move is to itself
+        for (size_t j = 0; j < callerSaved.size() && reg < 0 && !crosses; j++) {
+            if (isFree[callerSaved[j]])
+                reg = callerSaved[j];
+        }
+        for (size_t j = 0; j < calleeSaved.size() && reg < 0; j++) {
+            if (isFree[calleeSaved[j]])
+                reg = calleeSaved[j];
+        }
+        if (reg < 0) {
+            IRReg victim = IRNone;   // the one going on longest it could take from
+            for (size_t j = 0; j < active.size(); j++) {
+                int held = this->machineReg[active[j]];
+                bool allowed = (std::find(calleeSaved.begin(), calleeSaved.end(), held) != calleeSaved.end() ||
+                                !crosses);
+                if (allowed && (victim == IRNone || this->end[active[j]] > this->end[victim]))
+                    victim = active[j];
+            }
+            if (victim == IRNone || this->end[victim] <= this->end[r]) {
+                if (r >= (IRReg)this->fn->NumParams())
+                    this->slot[r] = this->numSlots++;
+                continue;
+            }
+            reg = this->machineReg[victim];
+            this->machineReg[victim] = -1;
+            if (victim >= (IRReg)this->fn->NumParams())
+                this->slot[victim] = this->numSlots++;
+            active.erase(std::find(active.begin(), active.end(), victim));
+        }
+        this->machineReg[r] = reg;
+        isFree[reg] = false;
+        if (std::find(calleeSaved.begin(), calleeSaved.end(), reg) != calleeSaved.end() &&
+            std::find(used.begin(), used.end(), reg) == used.end())
+            used.push_back(reg);
+        size_t at = 0;
+        while (at < active.size() && this->end[active[at]] <= this->end[r])
+            at++;
+        active.insert(active.begin() + at, r);
+    }
+}
@@ -0,0 +1,82 @@
+/* File: regalloc.h
+ * ----------------
+ * Linear-scan register allocation, as Poletto and Sarkar have it, for a
+ * code generator to put the registers of an IRFunction (see ir.h) in the
+ * registers of a machine. Each IR register is live from its first write
+ * (or the start of the function, for a parameter) to its last read, as
+ * one interval over the instructions in the order they are laid out,
+ * stretched over every block it is live into or out of. The intervals
+ * are then gone through by where they start, each taking a machine
+ * register nothing live at that point has, and when there isn't one, the
+ * interval that goes on longest, this one or one holding a register it
+ * could have, is spilled to a slot in the frame.
+ *
+ * Ints and references go in one kind of machine register, doubles in
+ * another. A register that is live across an instruction that calls out
+ * only gets one a call keeps (callee-saved), so nothing is ever saved
+ * around calls. A parameter that is spilled gets no slot, since it
+ * already has one where the caller passed it.
+ */
+
+#ifndef _H_regalloc
+#define _H_regalloc
+
+#include "ir.h"
+#include <vector>
+
+/* Type: MachineRegisters
+ * ----------------------
+ * The registers of a machine that can be allocated, by their numbers in
+ * the machine's own encoding, preferred ones first, and which of its
+ * instructions call out.
+ */
+struct MachineRegisters
+{
+    std::vector<int> intCalleeSaved, intCallerSaved;
+    std::vector<int> doubleCalleeSaved, doubleCallerSaved;
+    bool (*callsOut)(IROpcode op);
+};
+
+class LinearScan
+{
+  public:
+           // The registers marked in unplaced (if given) are left out,
+           // as ones the code generator needs no place for
+    LinearScan(IRFunction *fn, const MachineRegisters *machine, const std::vector<bool> *unplaced = NULL);
+
+           // Where r was put: in a machine register, or else in a slot
+           // (a parameter in none, see above). A register never read or
+           // written is in neither.
+    bool InRegister(IRReg r)     { return machineReg[r] >= 0; }
+    int GetRegister(IRReg r)     { return machineReg[r]; }
+    int GetSlot(IRReg r)         { return slot[r]; }
+    int NumSlots()               { return numSlots; }
+
+           // Whether r is read after instruction i
+    bool IsLiveAfter(IRReg r, IRInstr i) { return end[r] > 2 * (int)i + 1; }
+
+           // The callee-saved registers of either kind given out, which
+           // the function has to save and restore
+    const std::vector<int> &UsedIntCalleeSaved()    { return usedIntCalleeSaved; }
+    const std::vector<int> &UsedDoubleCalleeSaved() { return usedDoubleCalleeSaved; }
+
+  private:
+    IRFunction *fn;
+    const MachineRegisters *machine;
+    const std::vector<bool> *unplaced;
+           // Positions are 2i where instruction i reads its operands and
+           // 2i+1 where it writes its result, so a register read last by
+           // an instruction can be given to the one it writes
+    std::vector<int> start, end;
+    std::vector<int> calls;          // positions of those that call out
+    std::vector<IRReg> copyOf;       // what a register is moved from, if it is
+    std::vector<int> machineReg, slot;
+    int numSlots;
+    std::vector<int> usedIntCalleeSaved, usedDoubleCalleeSaved;
+
+    void BuildIntervals();
+    bool CrossesCall(IRReg r);
+    void Allocate(bool doubles);
+};
+
+#endif
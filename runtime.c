@@ -0,0 +1,160 @@
+/* File: runtime.c
+ * ---------------
+ * The runtime that the code from the x86-64 code generator (see x86.h)
+ * is linked with: the built-in functions of Decaf, what objects and
+ * arrays are made with, and the C main that calls the program's main.
+ * It is plain C, compiled on its own:
+ *
+ *     dcc -o prog.o prog.decaf
+ *     cc -o prog prog.o runtime.c
+ *
+ * An object is its class's method table followed by its fields, and an
+ * array its length followed by its elements, one word each, all zero to
+ * start with. Nothing is ever freed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void Halt(const char *message)
+{
+    fflush(stdout);
+    fprintf(stderr, "Decaf runtime error: %s\n", message);
+    exit(1);
+}
+
+static void *Allocate(size_t size)
+{
+    void *memory = calloc(1, size);
+    if (memory == NULL)
+        Halt("Out of memory");
+    return memory;
+}
+
+void __PrintInt(int value)
+{
+    printf("%d", value);
+}
+
+void __PrintBool(int value)
+{
+    fputs(value ? "true" : "false", stdout);
+}
+
+void __PrintString(const char *s)
+{
+    if (s == NULL)
+        Halt("Null reference");
+    fputs(s, stdout);
+}
+
+/* Function: __ReadLine
+ * --------------------
+ * Reads a line from standard input, without its newline, or the empty
+ * string at the end of the input.
+ */
+char *__ReadLine(void)
+{
+    size_t length = 0, size = 64;
+    char *line = Allocate(size);
+    int c;
+    fflush(stdout);
+    while ((c = getchar()) != EOF && c != '\n') {
+        if (length + 1 == size)
+            line = realloc(line, size *= 2);
+        line[length++] = c;
+    }
+    line[length] = '\0';
+    return line;
+}
+
+/* Function: __ReadInteger
+ * -----------------------
+ * Reads a line and returns the integer it starts with, or 0.
+ */
+int __ReadInteger(void)
+{
+    char *line = __ReadLine();
+    int value = atoi(line);
+    free(line);
+    return value;
+}
+
+int __StringEqual(const char *a, const char *b)
+{
+    if (a == NULL || b == NULL)
+        Halt("Null reference");
+    return strcmp(a, b) == 0;
+}
+
+void *__New(int size, void **methods)
+{
+    void **object = Allocate(size);
+    object[0] = methods;
+    return object;
+}
+
+void *__NewArray(int length)
+{
+    long *array;
+    if (length <= 0)
+        Halt("Array size is <= 0");
+    array = Allocate((length + 1) * sizeof(long));
+    array[0] = length;
+    return array + 1;
+}
+
+void __OutOfBounds(void)
+{
+    Halt("Array subscript out of bounds");
+}
+
+void __NullReference(void)
+{
+    Halt("Null reference");
+}
+
+void __DivisionByZero(void)
+{
+    Halt("Division by zero");
+}
+
+/* Function: __Lookup
+ * ------------------
+ * Finds the method of object's class for a selector by its name, in the
+ * run of selector and method pairs, ended by a zero, that the word
+ * before the class's interface table points at. A selector is the
+ * address of the common symbol __Selector.<name>, which is the same in
+ * every module, where its color in the interface table isn't.
+ */
+void *__Lookup(void ***object, const char *selector)
+{
+    void **interfaceTable = (void **)(*object)[-1];
+    void **entry = (void **)interfaceTable[-1];
+    while (entry[0] != selector) {
+        if (entry[0] == NULL)
+            Halt("Method not found for interface call");
+        entry += 2;
+    }
+    return entry[1];
+}
+
+/* Function: __NoMethod
+ * --------------------
+ * Fills the places in a class's interface table for selectors it has no
+ * method for, which a checked program never calls.
+ */
+void __NoMethod(void)
+{
+    Halt("Method not found for interface call");
+}
+
+extern void _main(void);
+
+int main(void)
+{
+    _main();
+    fflush(stdout);
+    return 0;
+}
@@ -2,24 +2,47 @@
  * ---------------
  * You should not need to modify this file. It declare a few constants,
  * types, variables,and functions that are used and/or exported by
- * the lex-generated scanner.
+ * the lex-generated scanner. The scanner is reentrant: each parse has a
+ * scanner object of its own, so any number can run at once.
  */
 
 #ifndef _H_scanner
 #define _H_scanner
 
 #include <stdio.h>
+#include "location.h"
+#include "source.h"
 
 #define MaxIdentLen 31    // Maximum length for identifiers
 
-extern char *yytext;      // Text of lexeme just scanned
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;   // Opaque scanner object, as in lex.yy.c
+#endif
+
+
+class TokenReader;
+
+/* Type: ScanMode
+ * --------------
+ * What the scanner is in the middle of at a line boundary: nothing, or
+ * a block comment. No other token runs on past the end of a line, so
+ * that is all it takes to scan a line on its own (see lexcache.h).
+ */
+enum ScanMode { ScanNormal, ScanComment };
 
 
-int yylex();              // Defined in the generated lex.yy.c file
-void yyrestart(FILE *fp); // ditto
+yyscan_t InitScanner(SourceFile *src, int start = 0, int end = -1); // Defined in scanner.l
+void FreeScanner(yyscan_t scanner);    // ditto
 
+           // A scanner that starts on line number lineNum in the given
+           // mode and stops at each newline, returning '\n' for it,
+           // which is never a token of the grammar
+yyscan_t InitLineScanner(SourceFile *src, int start, int end, int lineNum, ScanMode mode);
+ScanMode GetScanMode(yyscan_t scanner);
 
-void InitScanner();                 // Defined in scanner.l user subroutines
-const char *GetLineNumbered(int n); // ditto
+           // A scanner that hands the parser the tokens the reader
+           // gives it rather than scanning the source itself
+yyscan_t InitScanner(TokenReader *reader);
  
 #endif
@@ -0,0 +1,90 @@
+/* File: scope.cc
+ * --------------
+ * Implementation of the Scope class.
+ */
+
+#include "scope.h"
+#include "ast.h"
+
+Scope::Scope(Node *n, Hashtable<Decl*> *t)
+{
+    Assert(n != NULL && t != NULL);
+    owner = n;
+    table = t;
+    outer = NULL;
+    inherited = NULL;
+    chain = NULL;
+    depth = numMemberTables = 0;
+}
+
+void Scope::SetInherited(Scope *super)
+{
+    Assert(chain == NULL);
+    inherited = super;
+}
+
+/* Scope::Resolve
+ * --------------
+ * Links to the enclosing scope and builds the flattened chain of tables.
+ * This can't be done when the scope is created, since during a bottom-up
+ * parse the owner doesn't have its parent yet, so it is done the first
+ * time the scope is needed, once the tree is complete.
+ */
+void Scope::Resolve()
+{
+    Node *p = owner->GetParent();
+    outer = (p != NULL ? p->GetScope() : NULL);
+    if (outer != NULL && outer->chain == NULL)
+        outer->Resolve();
+    if (inherited != NULL && inherited->chain == NULL)
+        inherited->Resolve();
+
+    int numInherited = (inherited != NULL ? inherited->numMemberTables : 0);
+    int numOuter = (outer != NULL ? outer->depth : 0);
+    chain = (Hashtable<Decl*> **)Arena::Current()->Alloc((1 + numInherited + numOuter) * sizeof(chain[0]));
+    depth = 0;
+    chain[depth++] = table;
+    for (int i = 0; i < numInherited; i++)
+        chain[depth++] = inherited->chain[i];
+    numMemberTables = depth;
+    for (int i = 0; i < numOuter; i++)
+        chain[depth++] = outer->chain[i];
+}
+
+Scope *Scope::GetOuter()
+{
+    if (chain == NULL)
+        Resolve();
+    return outer;
+}
+
+Decl *Scope::Lookup(Symbol name)
+{
+    if (chain == NULL)
+        Resolve();
+    for (int i = 0; i < depth; i++) {
+        Decl *result = chain[i]->Lookup(name);
+        if (result != NULL)
+            return result;
+    }
+    return NULL;
+}
+
+Decl *Scope::LookupGlobal(Symbol name)
+{
+    if (chain == NULL)
+        Resolve();
+    return chain[depth-1]->Lookup(name);
+}
+
+Decl *Scope::LookupMember(Symbol name)
+{
+    if (chain == NULL)
+        Resolve();
+    for (int i = 0; i < numMemberTables; i++) {
+        Decl *result = chain[i]->Lookup(name);
+        if (result != NULL)
+            return result;
+    }
+    return NULL;
+}
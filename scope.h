@@ -0,0 +1,78 @@
+/* File: scope.h
+ * -------------
+ * A Scope is one level of the lexical nesting of declarations: the
+ * program's globals, a class or interface's members, a function's
+ * formals or a block's locals. Each node that opens a scope creates one
+ * for its symbol table, and every other node simply links to the scope
+ * of its nearest enclosing such node (see Node::GetScope), so finding
+ * the scope for an identifier never walks through unrelated nodes.
+ *
+ * A class's scope also inherits the member scope of its superclass, so
+ * inherited members are found by searching the superclass's own table
+ * rather than copying its entries into every subclass.
+ *
+ * The first time a scope is searched, it flattens the chain of tables
+ * from itself out to the global scope into a small array: its own table,
+ * then those of the scopes it inherits from, then those of the enclosing
+ * scopes. A lookup is then just a probe into each table in turn with no
+ * pointer chasing between them.
+ */
+
+#ifndef _H_scope
+#define _H_scope
+
+#include "hashtable.h"
+#include "symbol.h"
+
+class Node;
+class Decl;
+
+class Scope
+{
+  public:
+           // Creates the scope for the node owner, whose declarations
+           // are entered into table
+    Scope(Node *owner, Hashtable<Decl*> *table);
+
+           // Returns the innermost declaration for name visible in this
+           // scope, or NULL if there is none
+    Decl *Lookup(Symbol name);
+
+           // Like Lookup, but only searches this scope and those it
+           // inherits from, not the enclosing ones
+    Decl *LookupMember(Symbol name);
+
+           // Like Lookup, but only searches the outermost (global) scope
+    Decl *LookupGlobal(Symbol name);
+
+           // Links the scope to those around it now rather than on the
+           // first search, after which it (and they) can be searched by
+           // several threads at once
+    void Freeze() { if (chain == NULL) Resolve(); }
+
+           // Makes the members of the scope super visible in this one,
+           // behind its own. Must be done before the scope is searched.
+    void SetInherited(Scope *super);
+
+    Hashtable<Decl*> *GetTable() { return table; }
+    Node *GetOwner()             { return owner; }
+    Scope *GetOuter();
+
+           // Scopes live in the current arena
+    static void *operator new(size_t size)
+        { return Arena::Current()->Alloc(size); }
+    static void operator delete(void *) {}
+
+  private:
+    Node *owner;
+    Hashtable<Decl*> *table;
+    Scope *outer;
+    Scope *inherited;
+    Hashtable<Decl*> **chain;  // table, then each inherited and outer one's
+    int depth;
+    int numMemberTables;       // how many of chain are this and inherited
+
+    void Resolve();
+};
+
+#endif
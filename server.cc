@@ -0,0 +1,223 @@
+/* File: server.cc
+ * ---------------
+ * Implementation of the compile server.
+ */
+
+#include "server.h"
+#include "context.h"
+#include "incremental.h"
+#include "pool.h"
+#include "list.h"
+#include "utility.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static const size_t MaxHeaderLength = 4096;
+
+/* Type: Session
+ * -------------
+ * An incremental session, along with the lock that keeps its requests
+ * from being compiled at the same time.
+ */
+struct Session
+{
+    std::mutex lock;
+    IncrementalSession incremental;
+};
+
+static std::mutex sessionsLock;
+static std::map<std::string, Session*> sessions;
+
+static Session *FindSession(const std::string &name)
+{
+    std::lock_guard<std::mutex> guard(sessionsLock);
+    Session *&session = sessions[name];
+    if (session == NULL)
+        session = new Session;
+    return session;
+}
+
+static bool WriteFully(int fd, const char *buf, size_t n)
+{
+    while (n > 0) {
+        ssize_t written = write(fd, buf, n);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        buf += written;
+        n -= written;
+    }
+    return true;
+}
+
+/* Function: ReadRequest
+ * ---------------------
+ * Reads the header line and then the program text it announces.
+ * Returns false if the client doesn't send a well-formed request.
+ */
+static bool ReadRequest(int fd, std::string *header, std::string *text)
+{
+    char buf[4096];
+    std::string data;
+    size_t newline;
+    while ((newline = data.find('\n')) == std::string::npos) {
+        if (data.size() > MaxHeaderLength)
+            return false;
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data.append(buf, n);
+    }
+    header->assign(data, 0, newline);
+    text->assign(data, newline + 1, std::string::npos);
+
+    char *end;
+    long length = strtol(header->c_str(), &end, 10);
+    if (end == header->c_str() || length < 0 || (size_t)length < text->size())
+        return false;
+    while (text->size() < (size_t)length) {
+        size_t want = (size_t)length - text->size();
+        ssize_t n = read(fd, buf, want < sizeof(buf) ? want : sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        text->append(buf, n);
+    }
+    return true;
+}
+
+/* Function: ParseFlags
+ * --------------------
+ * Picks the session and the debug keys out of the header, after the
+ * length. The keys point into the header, which is cut up to do so.
+ */
+static bool ParseFlags(std::string *header, std::string *session, List<const char*> *keys,
+                       std::string *errors)
+{
+    char *save, *word = strtok_r(&(*header)[0], " \t", &save); // the length
+    word = strtok_r(NULL, " \t", &save);
+    if (word != NULL && strcmp(word, "-i") == 0) {
+        word = strtok_r(NULL, " \t", &save);
+        if (word == NULL) {
+            errors->append("Missing session name in request\n");
+            return false;
+        }
+        session->assign(word);
+        word = strtok_r(NULL, " \t", &save);
+    }
+    if (word == NULL)
+        return true;
+    if (strcmp(word, "-d") != 0) {
+        errors->append("Unknown flag in request: ").append(word).append("\n");
+        return false;
+    }
+    while ((word = strtok_r(NULL, " \t", &save)) != NULL)
+        keys->Append(word);
+    return true;
+}
+
+/* Function: ServeRequest
+ * ----------------------
+ * Compiles the program from one connection and sends back the results.
+ * Each thread keeps an arena for its requests, which is reset after
+ * each one so the memory is already at hand for the next.
+ */
+static void ServeRequest(int fd)
+{
+    static thread_local Arena *requestArena = NULL;
+    if (requestArena == NULL)
+        requestArena = new Arena;
+
+    std::string header, text, errors, output, sessionName;
+    if (!ReadRequest(fd, &header, &text)) {
+        close(fd);
+        return;
+    }
+
+    Arena *saved = Arena::Current();
+    Arena::SetCurrent(requestArena);
+    int status = 2; // as for a bad command line
+    List<const char*> *keys = new List<const char*>;
+    if (ParseFlags(&header, &sessionName, keys, &errors)) {
+        Session *session = (sessionName.empty() ? NULL : FindSession(sessionName));
+        std::unique_lock<std::mutex> sessionGuard;
+        if (session != NULL)
+            sessionGuard = std::unique_lock<std::mutex>(session->lock);
+        UseDebugSettings(keys, &output);
+        CompilationContext context("<request>", text.data(), text.size(), requestArena);
+        context.SetHoldErrors(true);
+        context.SetStreaming(Streaming());
+        context.SetIncremental(session != NULL ? &session->incremental : NULL);
+        context.Compile();
+        errors = context.GetHeldErrors();
+        status = (context.NumErrors() == 0 ? 0 : 255);
+        UseDebugSettings(NULL, NULL);
+    }
+    Arena::SetCurrent(saved);
+    requestArena->Reset();
+
+    char reply[64];
+    int len = snprintf(reply, sizeof(reply), "%d %lu %lu\n", status,
+                       (unsigned long)errors.size(), (unsigned long)output.size());
+    if (WriteFully(fd, reply, len) && WriteFully(fd, errors.data(), errors.size()))
+        WriteFully(fd, output.data(), output.size());
+    close(fd);
+}
+
+/* Class: ServeTask
+ * ----------------
+ * A task that serves one connection on a worker thread.
+ */
+class ServeTask : public Task
+{
+  public:
+    ServeTask(int f) : fd(f) {}
+    void Run() { ServeRequest(this->fd); }
+
+  private:
+    int fd;
+};
+
+
+void RunServer(const char *path)
+{
+    signal(SIGPIPE, SIG_IGN); // a client going away mustn't take the server along
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        Failure("Socket path too long: %s", path);
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || listen(sock, SOMAXCONN) < 0)
+        Failure("Unable to listen on %s: %s", path, strerror(errno));
+
+    WorkPool *pool = (NumJobs() > 1 ? new WorkPool(NumJobs()) : NULL);
+    for (;;) {
+        int fd = accept(sock, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            Failure("Unable to accept on %s: %s", path, strerror(errno));
+        }
+        if (pool != NULL)
+            pool->Submit(new ServeTask(fd));
+        else
+            ServeRequest(fd);
+    }
+}
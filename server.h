@@ -0,0 +1,41 @@
+/* File: server.h
+ * --------------
+ * With --server, dcc stays running and compiles the programs sent to it
+ * over a Unix domain socket, so a test run that compiles thousands of
+ * small programs doesn't pay for starting the compiler for each one.
+ * What outlives a single compilation stays warm from one request to
+ * the next: the interned names, the canonical types, the workers and
+ * the arenas, which are reset rather than released.
+ *
+ * A client connects and sends one request, a header line giving the
+ * length of the program and any debug flags, then the program text:
+ *
+ *     <length> [-i <session>] [-d <debug-key> ...]\n<program text>
+ *
+ * A request that names a session has its program compiled as the next
+ * version of the one last sent in the same session, see incremental.h,
+ * so an editor can send the whole buffer after every edit. Requests in
+ * one session are compiled one at a time, and a session lasts as long
+ * as the server does.
+ *
+ * The server answers with a line giving what dcc's exit status would
+ * have been for that program and the lengths of the two parts that
+ * follow, the error messages and the debug output, then closes the
+ * connection:
+ *
+ *     <status> <error length> <output length>\n<errors><output>
+ *
+ * With -j, that many requests are compiled at once.
+ */
+
+#ifndef _H_server
+#define _H_server
+
+/* Function: RunServer
+ * -------------------
+ * Listens on a socket at the given path, replacing anything already
+ * there, and serves requests until the process is killed.
+ */
+void RunServer(const char *socketPath);
+
+#endif
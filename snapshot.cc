@@ -0,0 +1,556 @@
+/* File: snapshot.cc
+ * -----------------
+ * Implementation of the DeclSnapshot class.
+ */
+
+#include "snapshot.h"
+#include "ast_decl.h"
+#include "ast_type.h"
+#include "ast_stmt.h"
+#include "utility.h"
+#include <string>
+#include <unordered_map>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+  // "DCCS" in the byte order of a little-endian machine. The version
+  // changes whenever the format does.
+static const uint32_t Magic = 0x53434344;
+static const uint32_t Version = 2;
+
+static const uint32_t None = 0xffffffff;
+
+enum { TypeBuiltIn, TypeNamed, TypeArray };
+enum { DeclClass, DeclInterface, DeclFn, DeclVar };
+
+struct DeclSnapshot::Header
+{
+    uint32_t magic, version;
+    uint32_t size;             // of the whole file
+    uint32_t numTopLevel;      // the first of the decls
+    uint32_t module;           // a name
+    uint32_t namesOffset, numNames;
+    uint32_t typesOffset, numTypes;
+    uint32_t declsOffset, numDecls;
+    uint32_t listsOffset, numLists;
+    uint32_t depsOffset, numDeps;
+    uint32_t poolOffset, poolSize;
+};
+
+struct DeclSnapshot::TypeRecord
+{
+    uint32_t kind;
+    uint32_t arg;              // a built-in's number, a name, or a type
+};
+
+struct DeclSnapshot::DeclRecord
+{
+    uint32_t kind;
+    uint32_t name;
+    uint32_t type;             // for a function or a variable
+    uint32_t extends;          // a name, or None
+    uint32_t first, count;     // the members or formals, in decls
+    uint32_t firstList, numList;   // the interfaces implemented, in lists
+};
+
+struct DeclSnapshot::DepRecord
+{
+    uint32_t module;           // a name
+    uint32_t hashLow, hashHigh;
+};
+
+static const int NumBuiltIns = 7;
+
+static Type *BuiltIn(int n)
+{
+    Type *builtIns[NumBuiltIns] = { Type::intType, Type::doubleType, Type::boolType, Type::voidType,
+                                    Type::nullType, Type::stringType, Type::errorType };
+    return builtIns[n];
+}
+
+static bool WriteFully(int fd, const char *buf, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = write(fd, buf, size);
+        if (n <= 0)
+            return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+  // Whether the file at path holds just the bytes of image
+static bool SameContents(const char *path, const std::string &image)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    std::string contents;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size == image.size()) {
+        contents.resize(image.size());
+        size_t done = 0;
+        ssize_t n;
+        while (done < contents.size() && (n = read(fd, &contents[done], contents.size() - done)) > 0)
+            done += n;
+        contents.resize(done);
+    }
+    close(fd);
+    return contents == image;
+}
+
+  // The name of the module a snapshot at path is of: the file's name,
+  // less any directory or extension
+static Symbol ModuleName(const char *path)
+{
+    const char *start = strrchr(path, '/');
+    start = (start != NULL ? start + 1 : path);
+    const char *end = strrchr(start, '.');
+    if (end == NULL || end == start)
+        end = start + strlen(start);
+    return Intern(start, end - start);
+}
+
+
+/* Class: DeclSnapshot::Writer
+ * ---------------------------
+ * Builds up the tables of a snapshot. Each name and each type is
+ * recorded once, however many declarations use it.
+ */
+class DeclSnapshot::Writer
+{
+  public:
+    uint32_t Reserve(int count);
+    void Fill(uint32_t index, Decl *decl);
+    void AddDependency(const char *module, uint64_t hash);
+    std::string Image(Symbol module, uint32_t numTopLevel);
+
+  private:
+    std::vector<uint32_t> names;
+    std::string pool;
+    std::vector<TypeRecord> types;
+    std::vector<DeclRecord> decls;
+    std::vector<uint32_t> lists;
+    std::vector<DepRecord> deps;
+    std::unordered_map<Symbol, uint32_t> nameIndex;
+    std::unordered_map<Type*, uint32_t> typeIndex;
+
+    uint32_t Name(Symbol name);
+    uint32_t TypeOf(Type *type);
+    uint32_t Members(List<Decl*> *members);
+};
+
+/* DeclSnapshot::Writer::Reserve
+ * -----------------------------
+ * Returns the index of the first of count records added for declarations
+ * to be filled in later.
+ */
+uint32_t DeclSnapshot::Writer::Reserve(int count)
+{
+    uint32_t first = this->decls.size();
+    this->decls.resize(first + count);
+    return first;
+}
+
+uint32_t DeclSnapshot::Writer::Name(Symbol name)
+{
+    std::unordered_map<Symbol, uint32_t>::iterator found = this->nameIndex.find(name);
+    if (found != this->nameIndex.end())
+        return found->second;
+    uint32_t index = this->names.size();
+    this->names.push_back(this->pool.size());
+    this->pool.append(SymbolName(name));
+    this->pool.push_back('\0');
+    this->nameIndex[name] = index;
+    return index;
+}
+
+/* DeclSnapshot::Writer::TypeOf
+ * ----------------------------
+ * Types are recorded by their canonical objects, an array's element type
+ * before the array.
+ */
+uint32_t DeclSnapshot::Writer::TypeOf(Type *type)
+{
+    type = type->GetCanonical();
+    std::unordered_map<Type*, uint32_t>::iterator found = this->typeIndex.find(type);
+    if (found != this->typeIndex.end())
+        return found->second;
+    TypeRecord r = { TypeBuiltIn, 0 };
+    if (ArrayType *array = DynCast<ArrayType>(type))
+    {
+        r.kind = TypeArray;
+        r.arg = this->TypeOf(array->elemType);
+    }
+    else if (NamedType *named = DynCast<NamedType>(type))
+    {
+        r.kind = TypeNamed;
+        r.arg = this->Name(named->id->symbol);
+    }
+    else
+    {
+        while (r.arg < NumBuiltIns - 1 && BuiltIn(r.arg) != type)
+            r.arg++;
+    }
+    uint32_t index = this->types.size();
+    this->types.push_back(r);
+    this->typeIndex[type] = index;
+    return index;
+}
+
+/* DeclSnapshot::Writer::Fill
+ * --------------------------
+ * Fills in the record at index for decl, adding records for its members
+ * (or formals) after all those there are so far. The records can move as
+ * they are added, so the one at index is only written at the end.
+ */
+void DeclSnapshot::Writer::Fill(uint32_t index, Decl *decl)
+{
+    DeclRecord r = { DeclVar, this->Name(decl->id->symbol), None, None, 0, 0, 0, 0 };
+    if (VarDecl *var = DynCast<VarDecl>(decl))
+    {
+        r.type = this->TypeOf(var->type);
+    }
+    else if (FnDecl *fn = DynCast<FnDecl>(decl))
+    {
+        r.kind = DeclFn;
+        r.type = this->TypeOf(fn->returnType);
+        r.count = fn->formals->NumElements();
+        r.first = this->Reserve(r.count);
+        for (uint32_t i = 0; i < r.count; i++)
+            this->Fill(r.first + i, fn->formals->Nth(i));
+    }
+    else if (InterfaceDecl *intf = DynCast<InterfaceDecl>(decl))
+    {
+        r.kind = DeclInterface;
+        r.count = intf->members->NumElements();
+        r.first = this->Members(intf->members);
+    }
+    else if (ClassDecl *cls = DynCast<ClassDecl>(decl))
+    {
+        r.kind = DeclClass;
+        if (cls->extends != NULL)
+            r.extends = this->Name(cls->extends->id->symbol);
+        r.firstList = this->lists.size();
+        r.numList = cls->implements->NumElements();
+        for (uint32_t i = 0; i < r.numList; i++)
+            this->lists.push_back(this->Name(cls->implements->Nth(i)->id->symbol));
+        r.count = cls->members->NumElements();
+        r.first = this->Members(cls->members);
+    }
+    this->decls[index] = r;
+}
+
+uint32_t DeclSnapshot::Writer::Members(List<Decl*> *members)
+{
+    uint32_t first = this->Reserve(members->NumElements());
+    for (int i = 0; i < members->NumElements(); i++)
+        this->Fill(first + i, members->Nth(i));
+    return first;
+}
+
+void DeclSnapshot::Writer::AddDependency(const char *module, uint64_t hash)
+{
+    DepRecord d = { this->Name(Intern(module)), (uint32_t)hash, (uint32_t)(hash >> 32) };
+    this->deps.push_back(d);
+}
+
+/* DeclSnapshot::Writer::Image
+ * ---------------------------
+ * Lays the tables out one after the other behind the header. Every
+ * record is a whole number of 32-bit words, so each table is aligned
+ * for reading in place.
+ */
+std::string DeclSnapshot::Writer::Image(Symbol module, uint32_t numTopLevel)
+{
+    Header h;
+    h.magic = Magic;
+    h.version = Version;
+    h.numTopLevel = numTopLevel;
+    h.module = this->Name(module);
+    h.namesOffset = sizeof(Header);
+    h.numNames = this->names.size();
+    h.typesOffset = h.namesOffset + h.numNames * sizeof(uint32_t);
+    h.numTypes = this->types.size();
+    h.declsOffset = h.typesOffset + h.numTypes * sizeof(TypeRecord);
+    h.numDecls = this->decls.size();
+    h.listsOffset = h.declsOffset + h.numDecls * sizeof(DeclRecord);
+    h.numLists = this->lists.size();
+    h.depsOffset = h.listsOffset + h.numLists * sizeof(uint32_t);
+    h.numDeps = this->deps.size();
+    h.poolOffset = h.depsOffset + h.numDeps * sizeof(DepRecord);
+    h.poolSize = this->pool.size();
+    h.size = h.poolOffset + h.poolSize;
+
+    std::string image;
+    image.reserve(h.size);
+    image.append((const char *)&h, sizeof(h));
+    image.append((const char *)this->names.data(), h.numNames * sizeof(uint32_t));
+    image.append((const char *)this->types.data(), h.numTypes * sizeof(TypeRecord));
+    image.append((const char *)this->decls.data(), h.numDecls * sizeof(DeclRecord));
+    image.append((const char *)this->lists.data(), h.numLists * sizeof(uint32_t));
+    image.append((const char *)this->deps.data(), h.numDeps * sizeof(DepRecord));
+    image.append(this->pool);
+    return image;
+}
+
+
+/* DeclSnapshot::Write
+ * -------------------
+ * Only the program's own declarations that made it into the global scope
+ * are written. Unless it is just like the one there, the snapshot is
+ * written to a temporary file and renamed into place, so a compilation
+ * using it never sees half of one. It is made readable to all, like any
+ * other build output.
+ */
+bool DeclSnapshot::Write(const char *path, Program *program,
+                         const std::vector<DeclSnapshot*> &imports)
+{
+    Hashtable<Decl*> *globals = program->GetScope()->GetTable();
+    std::vector<Decl*> top;
+    for (int i = 0; i < program->decls->NumElements(); i++)
+    {
+        Decl *d = program->decls->Nth(i);
+        if (globals->Lookup(d->id->symbol) == d)
+            top.push_back(d);
+    }
+
+    Writer writer;
+    uint32_t first = writer.Reserve(top.size());
+    for (size_t i = 0; i < top.size(); i++)
+        writer.Fill(first + i, top[i]);
+    for (size_t i = 0; i < imports.size(); i++)
+        writer.AddDependency(imports[i]->GetModule(), imports[i]->GetHash());
+    std::string image = writer.Image(ModuleName(path), top.size());
+    if (SameContents(path, image))
+        return true;
+
+    std::string temp = std::string(path) + ".XXXXXX";
+    int fd = mkstemp(&temp[0]);
+    if (fd < 0)
+        return false;
+    bool written = fchmod(fd, 0644) == 0 && WriteFully(fd, image.data(), image.size());
+    if (close(fd) != 0 || !written || rename(temp.c_str(), path) != 0) {
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+DeclSnapshot::DeclSnapshot(const char *p)
+  : path(p), image(NULL), size(0), valid(false), hash(0),
+    header(NULL), typeRecords(NULL), declRecords(NULL), lists(NULL), deps(NULL)
+{
+    int fd = open(p, O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(Header)) {
+        void *addr = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            image = (const char *)addr;
+            size = info.st_size;
+        }
+    }
+    close(fd);
+    if (image == NULL)
+        return;
+    hash = MixHash(Hash(image, size));
+    valid = Validate();
+}
+
+DeclSnapshot::~DeclSnapshot()
+{
+    if (image != NULL)
+        munmap((void *)image, size);
+}
+
+  // Whether a table of count records of recordSize bytes at offset is
+  // aligned and lies within an image of size bytes
+static bool InImage(size_t size, uint32_t offset, uint32_t count, size_t recordSize)
+{
+    return offset % sizeof(uint32_t) == 0 && offset <= size && count <= (size - offset) / recordSize;
+}
+
+/* DeclSnapshot::Validate
+ * ----------------------
+ * Checks that every offset and index in the image leads somewhere it
+ * should, interning the names and making the types as it goes. The
+ * records a declaration's members are in come after its own, so making
+ * the declarations always comes to an end.
+ */
+bool DeclSnapshot::Validate()
+{
+    const Header *h = this->header = (const Header *)this->image;
+    if (h->magic != Magic || h->version != Version || h->size != this->size ||
+        !InImage(this->size, h->namesOffset, h->numNames, sizeof(uint32_t)) ||
+        !InImage(this->size, h->typesOffset, h->numTypes, sizeof(TypeRecord)) ||
+        !InImage(this->size, h->declsOffset, h->numDecls, sizeof(DeclRecord)) ||
+        !InImage(this->size, h->listsOffset, h->numLists, sizeof(uint32_t)) ||
+        !InImage(this->size, h->depsOffset, h->numDeps, sizeof(DepRecord)) ||
+        h->poolOffset > this->size || h->poolSize > this->size - h->poolOffset ||
+        h->numTopLevel > h->numDecls)
+        return false;
+
+    const char *pool = this->image + h->poolOffset;
+    const uint32_t *names = (const uint32_t *)(this->image + h->namesOffset);
+    if (h->numNames > 0 && pool[h->poolSize - 1] != '\0')
+        return false;
+    for (uint32_t i = 0; i < h->numNames; i++)
+    {
+        if (names[i] >= h->poolSize)
+            return false;
+        this->symbols.push_back(Intern(pool + names[i]));
+    }
+    if (h->module >= h->numNames)
+        return false;
+    this->deps = (const DepRecord *)(this->image + h->depsOffset);
+    for (uint32_t i = 0; i < h->numDeps; i++)
+    {
+        if (this->deps[i].module >= h->numNames)
+            return false;
+    }
+
+    this->typeRecords = (const TypeRecord *)(this->image + h->typesOffset);
+    for (uint32_t i = 0; i < h->numTypes; i++)
+    {
+        const TypeRecord *t = &this->typeRecords[i];
+        if (t->kind == TypeBuiltIn && t->arg < NumBuiltIns)
+            this->types.push_back(BuiltIn(t->arg));
+        else if (t->kind == TypeNamed && t->arg < h->numNames)
+            this->types.push_back(NamedType::Canonical(this->symbols[t->arg]));
+        else if (t->kind == TypeArray && t->arg < i)
+            this->types.push_back(this->types[t->arg]->GetArrayOf());
+        else
+            return false;
+    }
+
+    this->lists = (const uint32_t *)(this->image + h->listsOffset);
+    for (uint32_t i = 0; i < h->numLists; i++)
+    {
+        if (this->lists[i] >= h->numNames)
+            return false;
+    }
+
+    this->declRecords = (const DeclRecord *)(this->image + h->declsOffset);
+    for (uint32_t i = 0; i < h->numDecls; i++)
+    {
+        const DeclRecord *r = &this->declRecords[i];
+        bool hasType = (r->kind == DeclFn || r->kind == DeclVar);
+        if (r->kind > DeclVar || r->name >= h->numNames ||
+            (hasType ? r->type >= h->numTypes : r->type != None) ||
+            (r->kind == DeclClass ? r->extends != None && r->extends >= h->numNames : r->extends != None) ||
+            (r->kind == DeclClass ? r->firstList > h->numLists || r->numList > h->numLists - r->firstList
+                                  : r->numList != 0) ||
+            (r->kind == DeclVar ? r->count != 0
+                                : r->first <= i || r->first > h->numDecls || r->count > h->numDecls - r->first))
+            return false;
+        for (uint32_t j = r->first; j < r->first + r->count; j++)
+        {
+            uint32_t member = this->declRecords[j].kind;
+            if (r->kind == DeclFn ? member != DeclVar :
+                r->kind == DeclInterface ? member != DeclFn : member != DeclVar && member != DeclFn)
+                return false;
+        }
+    }
+    return true;
+}
+
+const char *DeclSnapshot::GetModule()
+{
+    return SymbolName(this->symbols[this->header->module]);
+}
+
+int DeclSnapshot::NumDependencies()
+{
+    return this->header->numDeps;
+}
+
+const char *DeclSnapshot::GetDependency(int n)
+{
+    return SymbolName(this->symbols[this->deps[n].module]);
+}
+
+uint64_t DeclSnapshot::GetDependencyHash(int n)
+{
+    return this->deps[n].hashLow | (uint64_t)this->deps[n].hashHigh << 32;
+}
+
+int DeclSnapshot::NumDecls()
+{
+    return this->header->numTopLevel;
+}
+
+Symbol DeclSnapshot::GetDeclName(int n)
+{
+    return this->symbols[this->declRecords[n].name];
+}
+
+List<Decl*> *DeclSnapshot::MakeDecls()
+{
+    Assert(this->valid);
+    List<Decl*> *decls = new List<Decl*>;
+    for (uint32_t i = 0; i < this->header->numTopLevel; i++)
+        decls->Append(this->MakeDecl(i));
+    return decls;
+}
+
+/* DeclSnapshot::MakeDecl
+ * ----------------------
+ * The nodes are made as if they had been parsed, without a location,
+ * then declared and checked, only straight from the records: a class or
+ * interface's members, and a function's formals, are entered in its own
+ * scope, and all of it is marked checked. The types are the canonical
+ * ones, so nothing about them is ever checked again.
+ */
+Decl *DeclSnapshot::MakeDecl(uint32_t index)
+{
+    const DeclRecord *r = &this->declRecords[index];
+    Identifier *id = new Identifier(NoSpan(), this->symbols[r->name]);
+    if (r->kind == DeclVar)
+    {
+        VarDecl *var = new VarDecl(id, this->types[r->type]);
+        var->SkipCheck();
+        return var;
+    }
+
+    List<Decl*> *members = new List<Decl*>;
+    for (uint32_t i = 0; i < r->count; i++)
+        members->Append(this->MakeDecl(r->first + i));
+    Decl *decl;
+    if (r->kind == DeclFn)
+    {
+        List<VarDecl*> *formals = new List<VarDecl*>;
+        for (uint32_t i = 0; i < r->count; i++)
+            formals->Append(static_cast<VarDecl*>(members->Nth(i)));
+        FnDecl *fn = new FnDecl(id, this->types[r->type], formals);
+        fn->checked = true;
+        decl = fn;
+    }
+    else if (r->kind == DeclInterface)
+    {
+        InterfaceDecl *intf = new InterfaceDecl(id, members);
+        intf->checked = true;
+        decl = intf;
+    }
+    else
+    {
+        NamedType *extends = (r->extends != None ? NamedType::Canonical(this->symbols[r->extends]) : NULL);
+        List<NamedType*> *implements = new List<NamedType*>;
+        for (uint32_t i = 0; i < r->numList; i++)
+            implements->Append(NamedType::Canonical(this->symbols[this->lists[r->firstList + i]]));
+        ClassDecl *cls = new ClassDecl(id, extends, implements, members);
+        cls->checked = true;
+        decl = cls;
+    }
+    Hashtable<Decl*> *table = decl->GetScope()->GetTable();
+    for (int i = 0; i < members->NumElements(); i++)
+        table->Enter(members->Nth(i)->id->symbol, members->Nth(i));
+    return decl;
+}
@@ -0,0 +1,123 @@
+/* File: snapshot.h
+ * ----------------
+ * This file defines the DeclSnapshot class, a binary image of the checked
+ * declarations of a program that other programs can be compiled against
+ * without its source being scanned, parsed or checked again. This is how
+ * a program is built from separate modules: each is a file compiled on
+ * its own, and its snapshot is its interface to the modules that use it.
+ *
+ * With --save-decls, once a module has compiled without errors, all it
+ * declares globally is written out: its classes with their members, its
+ * interfaces with their methods, the headers of its functions and the
+ * types of its variables. The bodies of functions are left out, and so
+ * is whatever it imported. With --use-decls, which can be given once for
+ * each module used, the snapshot is mapped into memory, and the program
+ * compiled against it is given nodes for those declarations, declared
+ * ahead of its own (see Program::Import).
+ *
+ * A module's declarations can mention those of the modules it imported,
+ * so its snapshot names each of them, along with the hash of the very
+ * snapshot it was compiled against. A program using it has to import
+ * those as well, in the same versions, or it isn't compiled. A snapshot
+ * that comes out just like the one already at its path is not written
+ * again, so a build tool can see that the modules using it needn't be
+ * compiled again when only the bodies of its functions changed.
+ *
+ * The file holds no pointers, only indexes and offsets from its start,
+ * so it is used in place wherever it is mapped. After the header, which
+ * names the module (after the file, less its extension), come five
+ * tables of 32-bit records, then a pool of null-terminated names:
+ *
+ *   names   the offset of each name in the pool
+ *   types   each a built-in type, a named type, or an array of a type
+ *           that comes before it in the table
+ *   decls   each a class, interface, function or variable, with its
+ *           name, type (the return type, for a function), superclass,
+ *           and the run of records after it holding its members (the
+ *           formals, for a function). The top-level ones come first.
+ *   lists   the names of the interfaces each class implements
+ *   deps    the name of each module imported, and its snapshot's hash
+ *
+ * Numbers are in the byte order of the machine that wrote them, which
+ * the magic number at the start tells apart. A file that isn't a whole
+ * and well-formed snapshot is refused when it is opened.
+ *
+ * The names are interned and the types made canonical just once, when
+ * the snapshot is opened, so giving a compilation its declarations only
+ * takes allocating the nodes. Any number of compilations can do that at
+ * once.
+ */
+
+#ifndef _H_snapshot
+#define _H_snapshot
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "list.h"
+#include "symbol.h"
+
+class Decl;
+class Type;
+class Program;
+
+class DeclSnapshot
+{
+  public:
+           // Maps the snapshot in the file at path, see IsValid
+    DeclSnapshot(const char *path);
+    ~DeclSnapshot();
+
+           // Returns whether the file could be read and is a snapshot
+    bool IsValid() { return valid; }
+    const char *GetPath() { return path; }
+
+           // A hash of the whole image, which tells snapshots apart
+    uint64_t GetHash() { return hash; }
+
+           // The module the snapshot is of, and those it imported. Only
+           // for a valid snapshot.
+    const char *GetModule();
+    int NumDependencies();
+    const char *GetDependency(int n);
+    uint64_t GetDependencyHash(int n);
+
+           // The names of the top-level declarations, in order
+    int NumDecls();
+    Symbol GetDeclName(int n);
+
+           // Returns new nodes in the current arena for the top-level
+           // declarations in the snapshot, already checked
+    List<Decl*> *MakeDecls();
+
+           // Writes the global declarations of program, which must have
+           // been checked without errors against the snapshots imports,
+           // to a snapshot at path, and returns whether it could
+    static bool Write(const char *path, Program *program,
+                      const std::vector<DeclSnapshot*> &imports);
+
+  private:
+    struct Header;
+    struct TypeRecord;
+    struct DeclRecord;
+    struct DepRecord;
+    class Writer;
+
+    const char *path;
+    const char *image;
+    size_t size;
+    bool valid;
+    uint64_t hash;
+    const Header *header;
+    const TypeRecord *typeRecords;
+    const DeclRecord *declRecords;
+    const uint32_t *lists;
+    const DepRecord *deps;
+    std::vector<Symbol> symbols;     // for each name
+    std::vector<Type*> types;        // canonical, for each type
+
+    bool Validate();
+    Decl *MakeDecl(uint32_t index);
+};
+
+#endif
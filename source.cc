@@ -0,0 +1,160 @@
+/* File: source.cc
+ * ---------------
+ * Implementation of the SourceFile class.
+ */
+
+#include "source.h"
+#include "arena.h"
+#include "utility.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+SourceFile::SourceFile(int fd)
+{
+    struct stat st;
+    text = NULL;
+    length = 0;
+    mapped = false;
+    allocated = false;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        length = st.st_size;
+        if (length == 0) {
+            text = "";
+            return;
+        }
+        void *addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            text = (const char *)addr;
+            mapped = true;
+            return;
+        }
+    }
+
+    // Pipes and terminals can't be mapped, so fall back to reading
+    size_t capacity = 64*1024, size = 0;
+    char *buf = (char *)malloc(capacity);
+    ssize_t n;
+    while (buf && (n = read(fd, buf + size, capacity - size)) != 0) {
+        if (n < 0)
+            Failure("Unable to read source input");
+        size += n;
+        if (size == capacity)
+            buf = (char *)realloc(buf, capacity *= 2);
+    }
+    if (buf == NULL)
+        Failure("Out of memory reading source input");
+    text = buf;
+    length = size;
+    allocated = true;
+}
+
+SourceFile::SourceFile(const char *txt, int len)
+{
+    mapped = false;
+    allocated = false;
+    length = len;
+    if (length == 0) {
+        text = "";
+        return;
+    }
+    char *buf = (char *)malloc(length);
+    if (buf == NULL)
+        Failure("Out of memory copying source input");
+    memcpy(buf, txt, length);
+    text = buf;
+    allocated = true;
+}
+
+SourceFile::~SourceFile()
+{
+    if (mapped)
+        munmap((void *)text, length);
+    else if (allocated)
+        free((void *)text);
+}
+
+Lexeme SourceFile::GetLexeme(int offset, int len) const
+{
+    Lexeme lexeme = {text + offset, len};
+    return lexeme;
+}
+
+/* SourceFile::BuildLineIndex
+ * --------------------------
+ * Records the offset at which each line begins. Nothing needs this
+ * unless an error is reported, so it is done lazily, just once even if
+ * errors are being reported from several threads at the same time.
+ */
+void SourceFile::BuildLineIndex()
+{
+    std::call_once(lineIndexBuilt, [this] {
+        lineStarts.push_back(0);
+        for (const char *p = text; (p = (const char *)memchr(p, '\n', text + length - p)) != NULL; p++)
+            lineStarts.push_back(p - text + 1);
+    });
+}
+
+const char *SourceFile::GetLineNumbered(int num)
+{
+    BuildLineIndex();
+    if (num <= 0 || num > (int)lineStarts.size()) return NULL;
+    int start = lineStarts[num-1];
+    if (start == length) return NULL; // nothing after the last newline
+    const char *end = (const char *)memchr(text + start, '\n', length - start);
+    return Arena::Current()->StrNDup(text + start, (end ? end : text + length) - (text + start));
+}
+
+/* SourceFile::LineForOffset
+ * -------------------------
+ * Binary searches the line index for the line containing offset.
+ */
+int SourceFile::LineForOffset(int offset)
+{
+    int lo = 0, hi = lineStarts.size() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1)/2;
+        if (lineStarts[mid] <= offset) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo + 1;
+}
+
+/* SourceFile::ColumnForOffset
+ * ---------------------------
+ * Returns the column of the character at offset, advancing over tabs
+ * the same way the scanner's tab rule does.
+ */
+int SourceFile::ColumnForOffset(int lineNum, int offset)
+{
+    int col = 1;
+    for (int i = lineStarts[lineNum-1]; i < offset; i++) {
+        col++;
+        if (text[i] == '\t')
+            col += TAB_SIZE - col%TAB_SIZE + 1;
+    }
+    return col;
+}
+
+/* SourceFile::GetLocation
+ * -----------------------
+ * Decodes the packed span kept by an ast node into the full line and
+ * column form used for reporting errors.
+ */
+yyltype SourceFile::GetLocation(SourceSpan span)
+{
+    yyltype loc;
+    int last = span.offset + (span.length > 0 ? span.length - 1 : 0);
+    BuildLineIndex();
+    loc.timestamp = 0;
+    loc.text = NULL;
+    loc.first_line = LineForOffset(span.offset);
+    loc.first_column = ColumnForOffset(loc.first_line, span.offset);
+    loc.last_line = LineForOffset(last);
+    loc.last_column = ColumnForOffset(loc.last_line, last);
+    loc.offset = span.offset;
+    loc.length = span.length;
+    return loc;
+}
@@ -0,0 +1,74 @@
+/* File: source.h
+ * --------------
+ * This file defines the SourceFile class which holds the text of the
+ * program being compiled. When the input is a regular file the text is
+ * memory-mapped rather than read, so the compiler never makes its own
+ * copy of it. The scanner hands out lexemes as views into this text
+ * rather than copying them, and the lines needed to print the context
+ * of an error are found by a line index that is only built the first
+ * time one is asked for.
+ */
+
+#ifndef _H_source
+#define _H_source
+
+#include <stddef.h>
+#include <vector>
+#include <mutex>
+#include "location.h"
+
+#define TAB_SIZE 8
+
+
+/* Type: Lexeme
+ * ------------
+ * A view of the characters of a token in the source text. The characters
+ * are not null-terminated, they stay valid as long as the SourceFile.
+ */
+struct Lexeme
+{
+    const char *text;
+    int length;
+};
+
+
+class SourceFile
+{
+  public:
+           // Maps (or if it's not a regular file, reads) the entire
+           // contents of the open file descriptor
+    SourceFile(int fd);
+
+           // Copies the length characters of text, for a program that is
+           // already in memory
+    SourceFile(const char *text, int length);
+    ~SourceFile();
+
+    const char *GetText() const { return text; }
+    int GetLength() const       { return length; }
+
+           // Returns a view of the length characters at offset
+    Lexeme GetLexeme(int offset, int length) const;
+
+           // Returns the contents of line number n (without the newline)
+           // as a null-terminated string in the current arena, or NULL
+           // if there is no such line
+    const char *GetLineNumbered(int n);
+
+           // Decodes a packed span into its lines and columns
+    yyltype GetLocation(SourceSpan span);
+
+  private:
+    const char *text;
+    int length;
+    bool mapped;                     // text is mmap'ed, or else
+    bool allocated;                  // malloc'ed, or else a literal
+    std::vector<int> lineStarts;     // built on first use
+    std::once_flag lineIndexBuilt;   // errors may be reported from several threads
+
+    void BuildLineIndex();
+    int LineForOffset(int offset);
+    int ColumnForOffset(int lineNum, int offset);
+};
+
+#endif
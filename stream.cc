@@ -0,0 +1,199 @@
+/* File: stream.cc
+ * ---------------
+ * Implementation of the DeclStream class.
+ */
+
+#include "stream.h"
+#include "ast_decl.h"
+#include "ast_stmt.h"
+#include "ast_type.h"
+#include "context.h"
+#include "errors.h"
+#include "pool.h"
+#include <algorithm>
+
+/* DeclStream::DeclStream
+ * ----------------------
+ * The errors of declaring come before those of checking, so each gets a
+ * place of its own in the ordered errors to report into next: declaring
+ * into a segment before the one checking reports into. Whatever the
+ * program imports is declared before anything is parsed.
+ */
+DeclStream::DeclStream(Program *p)
+{
+    CompilationContext *context = CompilationContext::Current();
+    this->program = p;
+    this->globals = p->GetScope()->GetTable();
+    p->DeclareImported();
+    this->workPool = context->GetWorkPool();
+    context->SetWorkPool(NULL);
+    this->byName = new Hashtable<PendingDecl*>;
+    ReportError::BeginOrdered();
+    this->declareErrors = ReportError::Defer();
+    this->checkErrors = ReportError::FinishSegment();
+}
+
+DeclStream::~DeclStream()
+{
+    CompilationContext::Current()->SetWorkPool(this->workPool);
+}
+
+void DeclStream::NoteTypeName(Symbol name)
+{
+    this->names.push_back(name);
+}
+
+/* DeclStream::Add
+ * ---------------
+ * Declarations are declared in order, so each is declared right away:
+ * the type names it checks as it's declared are looked up among those
+ * declared before it, which is just what it would see after the parse.
+ * Anything that can be checked right away reports straight into the
+ * check segment, since nothing after it has reserved a place yet.
+ */
+void DeclStream::Add(Decl *decl)
+{
+    this->decls.push_back(PendingDecl());
+    PendingDecl *p = &this->decls.back();
+    p->decl = decl;
+    p->names.swap(this->names);
+    std::sort(p->names.begin(), p->names.end());
+    p->names.erase(std::unique(p->names.begin(), p->names.end()), p->names.end());
+    p->checked = false;
+    p->checkErrors = NULL;
+    if (this->byName->Lookup(decl->id->symbol) == NULL)
+        this->byName->Enter(decl->id->symbol, p);
+
+    ReportError::StartSegment(this->declareErrors);
+    decl->Declare(this->globals);
+    this->declareErrors = ReportError::FinishSegment();
+
+    if (!this->IsType(p) && this->NamesDeclared(p))
+    {
+        ReportError::StartSegment(this->checkErrors);
+        decl->Check();
+        this->checkErrors = ReportError::FinishSegment();
+        p->checked = true;
+        p->names.clear();
+        return;
+    }
+
+    ReportError::StartSegment(this->checkErrors);
+    p->checkErrors = ReportError::Defer();
+    this->checkErrors = ReportError::FinishSegment();
+    this->waiting.push_back(p);
+
+    // Only a new class or interface can let what's waiting go ahead
+    if (this->IsType(p))
+        this->TryWaiting();
+}
+
+/* DeclStream::Finish
+ * ------------------
+ * With the whole program declared, the class hierarchy can be built and
+ * everything still waiting checked, in order and on the pool if there
+ * is one, exactly as Program::Check would have done.
+ */
+void DeclStream::Finish()
+{
+    this->program->BuildHierarchy();
+    CompilationContext::Current()->SetWorkPool(this->workPool);
+
+    for (size_t i = 0; i < this->waiting.size(); i++)
+    {
+        this->Check(this->waiting[i]);
+    }
+    this->waiting.clear();
+
+    if (this->workPool != NULL)
+        this->workPool->Wait();
+    ReportError::EndOrdered();
+}
+
+bool DeclStream::IsType(PendingDecl *p)
+{
+    return IsA<ClassDecl>(p->decl) || IsA<InterfaceDecl>(p->decl);
+}
+
+/* DeclStream::NamesDeclared
+ * -------------------------
+ * Once a name has been entered, what it refers to never changes, so a
+ * check made from then on has the same outcome as one made after the
+ * parse.
+ */
+bool DeclStream::NamesDeclared(PendingDecl *p)
+{
+    for (size_t i = 0; i < p->names.size(); i++)
+    {
+        if (this->globals->Lookup(p->names[i]) == NULL)
+            return false;
+    }
+    return true;
+}
+
+/* DeclStream::TypeReady
+ * ---------------------
+ * A class can be checked once the names in it are declared, along with
+ * those in the interfaces it implements and in its superclass and so on
+ * up, since checking it checks all of those that haven't been already.
+ * A class whose extends clauses form a cycle waits for Finish.
+ */
+bool DeclStream::TypeReady(PendingDecl *p)
+{
+    for (size_t steps = 0; p != NULL && !p->checked; steps++)
+    {
+        if (steps > this->decls.size() || !this->NamesDeclared(p))
+            return false;
+        ClassDecl *cls = DynCast<ClassDecl>(p->decl);
+        if (cls == NULL)
+            return true;
+        for (int i = 0; i < cls->implements->NumElements(); i++)
+        {
+            PendingDecl *intf = this->byName->Lookup(cls->implements->Nth(i)->id->symbol);
+            if (intf != NULL && IsA<InterfaceDecl>(intf->decl) && !this->NamesDeclared(intf))
+                return false;
+        }
+        p = (cls->extends != NULL ? this->byName->Lookup(cls->extends->id->symbol) : NULL);
+        if (p != NULL && !IsA<ClassDecl>(p->decl))
+            return true;
+    }
+    return true;
+}
+
+void DeclStream::Check(PendingDecl *p)
+{
+    ReportError::StartSegment(p->checkErrors);
+    p->decl->Check();
+    ReportError::FinishSegment();
+    p->checked = true;
+    p->names.clear();
+}
+
+/* DeclStream::TryWaiting
+ * ----------------------
+ * Goes through what's waiting in order, handling whatever can be now.
+ * Classes and interfaces are only checked after all those before them.
+ */
+void DeclStream::TryWaiting()
+{
+    bool typesWaiting = false;
+    size_t kept = 0;
+    for (size_t i = 0; i < this->waiting.size(); i++)
+    {
+        PendingDecl *p = this->waiting[i];
+        if (this->IsType(p))
+        {
+            if (!typesWaiting && this->TypeReady(p))
+                this->Check(p);
+            else
+                typesWaiting = true;
+        }
+        else if (this->NamesDeclared(p))
+        {
+            this->Check(p);
+        }
+        if (!p->checked)
+            this->waiting[kept++] = p;
+    }
+    this->waiting.resize(kept);
+}
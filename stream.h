@@ -0,0 +1,82 @@
+/* File: stream.h
+ * --------------
+ * This file defines the DeclStream class, which checks a program while
+ * it is still being parsed. Otherwise the parser builds the whole list
+ * of top-level declarations before anything is checked, so the tree of
+ * every function body in the file is alive at once. While streaming, the
+ * parser hands over each top-level declaration as soon as it is reduced.
+ * It is declared right away, and checked as soon as every type name it
+ * mentions has been declared. The body of a function is built in an
+ * arena of its own, which is recycled once the body has been checked
+ * (see FnDecl::CheckBody), so only the bodies still waiting on a later
+ * declaration are kept.
+ *
+ * The errors come out exactly as if the program had been checked after
+ * the parse. Each declaration that can't be checked when it arrives
+ * reserves a segment for its errors (see ReportError::Defer) and reports
+ * into it whenever it is. Classes and interfaces are checked in the
+ * order they were declared, since checking one can check its superclass
+ * and interfaces along with it. Functions and globals are checked in any
+ * order. Function bodies are all checked on the parsing thread until the
+ * parse is done, since the global scope is still being filled in.
+ */
+
+#ifndef _H_stream
+#define _H_stream
+
+#include <deque>
+#include <vector>
+#include "hashtable.h"
+#include "symbol.h"
+
+class Decl;
+class Program;
+class WorkPool;
+struct ErrorSegment;
+
+class DeclStream
+{
+  public:
+           // Starts holding errors back to order them, and holds on to
+           // the context's work pool until the parse is done
+    DeclStream(Program *program);
+    ~DeclStream();
+
+           // Called by the parser with each type name it reduces, which
+           // is in the declaration it adds next
+    void NoteTypeName(Symbol name);
+
+           // Called by the parser with each top-level declaration
+    void Add(Decl *decl);
+
+           // Called once the whole program has parsed without errors.
+           // Checks whatever is still waiting, in order, then prints
+           // the errors.
+    void Finish();
+
+  private:
+    struct PendingDecl {
+        Decl *decl;
+        std::vector<Symbol> names;    // the type names it mentions
+        bool checked;
+        ErrorSegment *checkErrors;    // reserved if it couldn't be checked
+    };
+
+    Program *program;
+    Hashtable<Decl*> *globals;
+    WorkPool *workPool;
+    std::vector<Symbol> names;         // noted since the last Add
+    std::deque<PendingDecl> decls;     // one for each Add
+    Hashtable<PendingDecl*> *byName;   // the first of each name
+    std::vector<PendingDecl*> waiting; // not yet checked, in order
+    ErrorSegment *declareErrors;       // where declaring reports next
+    ErrorSegment *checkErrors;         // where checking reports next
+
+    bool NamesDeclared(PendingDecl *p);
+    bool TypeReady(PendingDecl *p);
+    bool IsType(PendingDecl *p);
+    void Check(PendingDecl *p);
+    void TryWaiting();
+};
+
+#endif
@@ -0,0 +1,91 @@
+/* File: symbol.cc
+ * ---------------
+ * Implementation of the identifier intern table. Names are kept in an
+ * arena of their own that is never released, and found through an
+ * open-addressed table of symbols keyed by a hash of the name. Files
+ * compiled in parallel share the table, so it is guarded by a lock.
+ */
+
+#include "symbol.h"
+#include "arena.h"
+#include "utility.h"
+#include <string.h>
+#include <vector>
+#include <mutex>
+
+struct SymbolEntry {
+    const char *name;
+    int length;
+    unsigned int hash;
+};
+
+static std::vector<SymbolEntry> symbols;  // indexed by Symbol
+static std::vector<Symbol> buckets;       // NoSymbol marks an empty slot
+static std::mutex internLock;             // guards symbols and buckets
+
+static Arena *NameArena()
+{
+    static Arena *names = new Arena;
+    return names;
+}
+
+static unsigned int HashName(const char *name, int length)
+{
+    unsigned int hash = 2166136261u;      // FNV-1a
+    for (int i = 0; i < length; i++)
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    return hash;
+}
+
+static void Rehash(size_t size)
+{
+    buckets.assign(size, NoSymbol);
+    for (size_t i = 0; i < symbols.size(); i++) {
+        size_t b = symbols[i].hash & (size - 1);
+        while (buckets[b] != NoSymbol)
+            b = (b + 1) & (size - 1);
+        buckets[b] = i;
+    }
+}
+
+Symbol Intern(const char *name, int length)
+{
+    std::lock_guard<std::mutex> guard(internLock);
+    if (buckets.empty())
+        Rehash(1024);
+
+    unsigned int hash = HashName(name, length);
+    size_t mask = buckets.size() - 1;
+    size_t b = hash & mask;
+    for (; buckets[b] != NoSymbol; b = (b + 1) & mask) {
+        SymbolEntry& e = symbols[buckets[b]];
+        if (e.hash == hash && e.length == length && memcmp(e.name, name, length) == 0)
+            return buckets[b];
+    }
+
+    SymbolEntry e = {NameArena()->StrNDup(name, length), length, hash};
+    Symbol sym = symbols.size();
+    symbols.push_back(e);
+    buckets[b] = sym;
+    if (symbols.size() * 2 > buckets.size())
+        Rehash(buckets.size() * 2);
+    return sym;
+}
+
+Symbol Intern(const char *name)
+{
+    return Intern(name, strlen(name));
+}
+
+const char *SymbolName(Symbol sym)
+{
+    std::lock_guard<std::mutex> guard(internLock);
+    Assert(sym >= 0 && sym < (int)symbols.size());
+    return symbols[sym].name;
+}
+
+int NumSymbols()
+{
+    std::lock_guard<std::mutex> guard(internLock);
+    return symbols.size();
+}
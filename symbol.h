@@ -0,0 +1,46 @@
+/* File: symbol.h
+ * --------------
+ * Identifiers are interned as they are scanned: every distinct name is
+ * stored once in a process-wide table and given a small integer id, its
+ * Symbol. Two identifiers have the same name exactly when they have the
+ * same Symbol, so the symbol tables and the type comparisons work on ints
+ * rather than comparing strings. Symbols are never removed, the table
+ * lasts for the life of the process.
+ */
+
+#ifndef _H_symbol
+#define _H_symbol
+
+typedef int Symbol;
+
+const Symbol NoSymbol = -1;
+
+
+/* Function: Intern()
+ * Usage: Symbol s = Intern(yytext, yyleng);
+ * -----------------------------------------
+ * Returns the symbol for the first length characters of name, entering
+ * it into the table the first time it is seen. The name need not be
+ * null-terminated. A second form takes a null-terminated string.
+ */
+Symbol Intern(const char *name, int length);
+Symbol Intern(const char *name);
+
+
+/* Function: SymbolName()
+ * Usage: printf("%s", SymbolName(s));
+ * -----------------------------------
+ * Returns the null-terminated name for a symbol. The string is owned
+ * by the intern table and stays valid for the life of the process.
+ */
+const char *SymbolName(Symbol sym);
+
+
+/* Function: NumSymbols()
+ * ----------------------
+ * Returns the number of distinct symbols interned so far. Symbols are
+ * numbered densely from 0, so this is also one more than the largest.
+ */
+int NumSymbols();
+
+#endif
@@ -8,8 +8,25 @@
 #include <stdarg.h>
 #include "list.h"
 #include <string.h>
+#include <string>
 
 static List<const char*> debugKeys;
+static List<const char*> inputFiles;
+static int numJobs = 1;
+static bool streaming = false;
+static int optimizationLevel = 0;
+static const char *cacheDir = NULL;
+static List<const char*> useDecls;
+static const char *saveDecls = NULL;
+static const char *outputFile = NULL;
+static bool runProgram = false;
+static const char *serverSocket = NULL;
+static bool languageServer = false;
+
+  // a thread's own settings, see UseDebugSettings
+static thread_local List<const char*> *threadKeys = NULL;
+static thread_local std::string *threadOutput = NULL;
+static thread_local std::string *threadCopy = NULL;
 static const int BufferSize = 2048;
 
 void Failure(const char *format, ...)
@@ -29,8 +46,9 @@ void Failure(const char *format, ...)
 
 int IndexOf(const char *key)
 {
-   for (int i = 0; i < debugKeys.NumElements(); i++)
-      if (!strcmp(debugKeys.Nth(i), key)) return i;
+   List<const char*> *keys = (threadKeys != NULL ? threadKeys : &debugKeys);
+   for (int i = 0; i < keys->NumElements(); i++)
+      if (!strcmp(keys->Nth(i), key)) return i;
    return -1;
 }
 
@@ -62,21 +80,226 @@ void PrintDebug(const char *key, const char *format, ...)
   va_start(args, format);
   vsprintf(buf, format, args);
   va_end(args);
-  printf("+++ (%s): %s%s", key, buf, buf[strlen(buf)-1] != '\n'? "\n" : "");
+  const char *end = (buf[strlen(buf)-1] != '\n'? "\n" : "");
+  std::string line = std::string("+++ (") + key + "): " + buf + end;
+  if (threadCopy != NULL)
+    threadCopy->append(line);
+  PrintDebugOutput(line);
+}
+
+void PrintDebugOutput(const std::string &text)
+{
+  if (threadOutput != NULL)
+    threadOutput->append(text);
+  else
+    fputs(text.c_str(), stdout);
+}
+
+void CopyDebugOutput(std::string *copy)
+{
+  threadCopy = copy;
+}
+
+std::string DebugKeyList()
+{
+  List<const char*> *keys = (threadKeys != NULL ? threadKeys : &debugKeys);
+  std::string list;
+  for (int i = 0; i < keys->NumElements(); i++)
+    list.append(i > 0 ? " " : "").append(keys->Nth(i));
+  return list;
+}
+
+uint64_t Hash(const char *data, size_t length, uint64_t h)
+{
+  for (size_t i = 0; i < length; i++)
+    h = (h ^ (unsigned char)data[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+uint64_t MixHash(uint64_t h)
+{
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+  // Texts are compared this many bytes at a time, then byte by byte
+static const int CompareBlock = 256;
+
+int CommonPrefix(const char *a, const char *b, int limit)
+{
+  int n = 0;
+  while (n + CompareBlock <= limit && memcmp(a + n, b + n, CompareBlock) == 0)
+    n += CompareBlock;
+  while (n < limit && a[n] == b[n])
+    n++;
+  return n;
 }
 
+int CommonSuffix(const char *aEnd, const char *bEnd, int limit)
+{
+  int n = 0;
+  while (n + CompareBlock <= limit &&
+         memcmp(aEnd - n - CompareBlock, bEnd - n - CompareBlock, CompareBlock) == 0)
+    n += CompareBlock;
+  while (n < limit && aEnd[-n-1] == bEnd[-n-1])
+    n++;
+  return n;
+}
+
+
+void UseDebugSettings(List<const char*> *keys, std::string *output)
+{
+  threadKeys = keys;
+  threadOutput = output;
+}
+
+
+static void Usage()
+{
+  printf("Usage:   [-j <threads>] [-s] [-O<level>] [--cache <dir>] [--use-decls <snapshot> ...] [--save-decls <snapshot>]\n");
+  printf("         [-o <output>] [--run] [<file> ...] [-d <debug-key-1> ...] \n");
+  printf("         --server <socket> [-j <threads>] [-s] [-d <debug-key-1> ...] \n");
+  printf("         --lsp [-d <debug-key-1> ...] \n");
+  exit(2);
+}
 
 void ParseCommandLine(int argc, char *argv[])
 {
-  if (argc == 1)
+  int i = 1;
+  if (i < argc && strcmp(argv[i], "--server") == 0) {
+    if (i + 1 == argc)
+      Usage();
+    serverSocket = argv[i+1];
+    i += 2;
+  } else if (i < argc && strcmp(argv[i], "--lsp") == 0) {
+    languageServer = true;
+    i++;
+  }
+  if (i < argc && strcmp(argv[i], "-j") == 0) {
+    if (i + 1 == argc || (numJobs = atoi(argv[i+1])) < 1)
+      Usage();
+    i += 2;
+  }
+  if (i < argc && strcmp(argv[i], "-s") == 0) {
+    streaming = true;
+    i++;
+  }
+  if (i < argc && strncmp(argv[i], "-O", 2) == 0) {
+    if (strlen(argv[i]) != 3 || argv[i][2] < '0' || argv[i][2] > '1')
+      Usage();
+    optimizationLevel = argv[i][2] - '0';
+    i++;
+  }
+  if (i < argc && strcmp(argv[i], "--cache") == 0) {
+    if (i + 1 == argc || serverSocket || languageServer)
+      Usage();
+    cacheDir = argv[i+1];
+    i += 2;
+  }
+  while (i < argc && strcmp(argv[i], "--use-decls") == 0) {
+    if (i + 1 == argc || serverSocket || languageServer)
+      Usage();
+    useDecls.Append(argv[i+1]);
+    i += 2;
+  }
+  if (i < argc && strcmp(argv[i], "--save-decls") == 0) {
+    if (i + 1 == argc || serverSocket || languageServer)
+      Usage();
+    saveDecls = argv[i+1];
+    i += 2;
+  }
+  if (i < argc && strcmp(argv[i], "-o") == 0) {
+    if (i + 1 == argc || serverSocket || languageServer)
+      Usage();
+    outputFile = argv[i+1];
+    i += 2;
+  }
+  if (i < argc && strcmp(argv[i], "--run") == 0) {
+    if (serverSocket || languageServer)
+      Usage();
+    runProgram = true;
+    i++;
+  }
+  for (; i < argc && strcmp(argv[i], "-d") != 0; i++) {
+    if (argv[i][0] == '-' || serverSocket || languageServer) // an option we don't
+      Usage();                     // know, or files for a server
+    inputFiles.Append(argv[i]);
+  }
+  if ((saveDecls || outputFile || runProgram) && inputFiles.NumElements() > 1) // one program's, at most
+    Usage();
+  if (i == argc)
     return;
   
-  if (strcmp(argv[1], "-d") != 0) { // first arg is not -d
-    printf("Usage:   -d <debug-key-1> <debug-key-2> ... \n");
-    exit(2);
-  }
+  if (strcmp(argv[i], "-d") != 0) // remaining args don't start with -d
+    Usage();
 
-  for (int i = 2; i < argc; i++)
+  for (i++; i < argc; i++)
     SetDebugForKey(argv[i], true);
 }
 
+int NumJobs()
+{
+  return numJobs;
+}
+
+bool Streaming()
+{
+  return streaming;
+}
+
+int OptimizationLevel()
+{
+  return optimizationLevel;
+}
+
+const char *CacheDir()
+{
+  return cacheDir;
+}
+
+int NumUseDecls()
+{
+  return useDecls.NumElements();
+}
+
+const char *UseDecls(int n)
+{
+  return useDecls.Nth(n);
+}
+
+const char *SaveDecls()
+{
+  return saveDecls;
+}
+
+const char *OutputFile()
+{
+  return outputFile;
+}
+
+bool RunProgram()
+{
+  return runProgram;
+}
+
+int NumInputFiles()
+{
+  return inputFiles.NumElements();
+}
+
+const char *InputFile(int n)
+{
+  return inputFiles.Nth(n);
+}
+
+const char *ServerSocket()
+{
+  return serverSocket;
+}
+
+bool LanguageServer()
+{
+  return languageServer;
+}
+
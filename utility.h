@@ -9,6 +9,10 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+template <class Element> class List;
 
 
 /* Function: Failure()
@@ -71,13 +75,155 @@ void SetDebugForKey(const char *key, bool val);
 bool IsDebugOn(const char *key);
 
 
+/* Function: UseDebugSettings()
+ * Usage: UseDebugSettings(keys, &output);
+ * ---------------------------------------
+ * Gives the calling thread a list of debug keys of its own in place of
+ * the ones turned on from the command line, and collects the messages
+ * it prints in output rather than printing them. Calling it with NULLs
+ * goes back to the shared settings. The compile server (see server.h)
+ * uses this to give each request its own flags.
+ */
+void UseDebugSettings(List<const char*> *keys, std::string *output);
+
+
+/* Function: CopyDebugOutput(), PrintDebugOutput(), DebugKeyList()
+ * ----------------------------------------------------------------
+ * While a copy is given, PrintDebug also appends what the calling thread
+ * prints to it. PrintDebugOutput prints text that PrintDebug printed
+ * before, and DebugKeyList returns the keys that are on, separated by
+ * spaces. The compilation cache (see cache.h) uses these to keep and
+ * replay the debug output of a compilation.
+ */
+void CopyDebugOutput(std::string *copy);
+void PrintDebugOutput(const std::string &text);
+std::string DebugKeyList();
+
+
+/* Function: Hash(), MixHash()
+ * Usage: uint64_t h = MixHash(Hash(text, length));
+ * ------------------------------------------------
+ * Hash is FNV-1a over the length bytes of data, continuing from h so a
+ * hash can be built up over several pieces. MixHash then scrambles the
+ * result so every bit of it depends on every bit of the input, which
+ * FNV alone doesn't manage for the last few bytes.
+ */
+const uint64_t HashStart = 0xcbf29ce484222325ULL;
+uint64_t Hash(const char *data, size_t length, uint64_t h = HashStart);
+uint64_t MixHash(uint64_t h);
+
+
+
+/* Function: CommonPrefix(), CommonSuffix()
+ * Usage: int n = CommonPrefix(oldText, newText, limit);
+ * -----------------------------------------------------
+ * Return how many characters, up to limit, two texts start with or end
+ * with alike. CommonSuffix is given the ends of the texts. Editing tools
+ * (see incremental.h) use these to find what an edit changed.
+ */
+int CommonPrefix(const char *a, const char *b, int limit);
+int CommonSuffix(const char *aEnd, const char *bEnd, int limit);
+
 
 /* Function: ParseCommandLine
  * --------------------------
- * Turn on the debugging flags from the command line.  Verifies that
- * first argument is -d, and then interpret all the arguments that follow
- * as being flags to turn on.
+ * Turn on the debugging flags from the command line.  An optional
+ * --server <socket> or --lsp may come first, then an optional -j <threads>,
+ * then an optional -s, then an optional -O<level>, then an optional --cache
+ * <dir>, then any number of --use-decls <snapshot> and an optional
+ * --save-decls <snapshot>, then an optional -o <output>, then an
+ * optional --run, then the names of the files to compile (none of these
+ * last six for a server, and only one file with --save-decls, -o or
+ * --run), then if there are more arguments, verifies that the next is
+ * -d, and then interpret all the arguments that follow as being flags to
+ * turn on.
  */
 void ParseCommandLine(int argc, char *argv[]);
+
+
+/* Function: NumJobs
+ * -----------------
+ * Returns the number of threads asked for with -j, which is 1 if it
+ * wasn't given.
+ */
+int NumJobs();
+
+
+/* Function: Streaming
+ * -------------------
+ * Returns whether -s was given, asking for declarations to be checked
+ * while the rest of the file is still being parsed (see stream.h).
+ */
+bool Streaming();
+
+
+/* Function: OptimizationLevel
+ * ---------------------------
+ * Returns the level given with -O, which is 0 if it wasn't given. At 1
+ * the program is lowered to the IR and optimized (see optimize.h).
+ */
+int OptimizationLevel();
+
+
+/* Function: CacheDir
+ * ------------------
+ * Returns the directory given with --cache to keep the results of
+ * compilations in (see cache.h), or NULL if there isn't to be a cache.
+ */
+const char *CacheDir();
+
+
+/* Function: NumUseDecls, UseDecls, SaveDecls
+ * -------------------------------------------
+ * Return the snapshots of declarations given with --use-decls to compile
+ * against, in the order they were given, and the one given with
+ * --save-decls to write the program's declarations to (see snapshot.h),
+ * or NULL if it wasn't given.
+ */
+int NumUseDecls();
+const char *UseDecls(int n);
+const char *SaveDecls();
+
+
+/* Function: OutputFile
+ * --------------------
+ * Returns the file given with -o to write the program's x86-64 code to
+ * (see x86.h), as assembly or as an object if its name ends in .o, or
+ * NULL if it wasn't given.
+ */
+const char *OutputFile();
+
+
+/* Function: RunProgram
+ * --------------------
+ * Returns whether --run was given, asking for the program to be compiled
+ * to bytecode and run on the spot (see vm.h).
+ */
+bool RunProgram();
+
+
+/* Function: NumInputFiles, InputFile
+ * ----------------------------------
+ * The files named on the command line, in the order they were given.
+ * There are none if the program is to be read from standard input.
+ */
+int NumInputFiles();
+const char *InputFile(int n);
+
+
+/* Function: ServerSocket
+ * ----------------------
+ * Returns the path of the socket given with --server, or NULL if dcc is
+ * to compile rather than serve.
+ */
+const char *ServerSocket();
+
+
+/* Function: LanguageServer
+ * ------------------------
+ * Returns whether --lsp was given, asking dcc to serve an editor as a
+ * language server on its standard input and output (see lsp.h).
+ */
+bool LanguageServer();
      
 #endif
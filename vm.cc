@@ -0,0 +1,340 @@
+/* File: vm.cc
+ * -----------
+ * Implementation of the VM.
+ */
+
+#include "vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+  // What the code for each opcode uses: its operands as registers and
+  // as immediates, and the way on to the next instruction, length words
+  // on, or to a jump's target
+#define R(n)          regs[pc[n]]
+#define IMM(n)        ((int32_t)pc[n])
+#define DISPATCH()    goto *dispatch[*pc]
+#define NEXT(length)  do { pc += (length); DISPATCH(); } while (0)
+#define JUMP(n)       do { pc = code + pc[n]; DISPATCH(); } while (0)
+#define HALT(text)    do { message = (text); goto halt; } while (0)
+
+  // Ints wrap around as they do on the machine
+#define WRAP(x, op, y) ((int32_t)((uint32_t)(x) op (uint32_t)(y)))
+
+static const char *const NullReference = "Null reference";
+
+
+VM::VM(BytecodeProgram *p)
+{
+    this->program = p;
+    this->stack = new Value[StackSize];   // only touched as it's used
+    this->globals = this->Allocate(p->NumGlobals() + 1);
+    this->frames.reserve(256);
+}
+
+VM::~VM()
+{
+    delete[] this->stack;
+    for (size_t n = 0; n < this->allocations.size(); n++)
+        free(this->allocations[n]);
+}
+
+int VM::Run(BytecodeProgram *program)
+{
+    VM vm(program);
+    int status = vm.Execute();
+    fflush(stdout);
+    return status;
+}
+
+/* VM::Allocate
+ * ------------
+ * Room for some values, all zero to start with, or NULL if there isn't
+ * any.
+ */
+Value *VM::Allocate(size_t numValues)
+{
+    Value *memory = (Value *)calloc(numValues, sizeof(Value));
+    if (memory != NULL)
+        this->allocations.push_back(memory);
+    return memory;
+}
+
+/* VM::ReadLine
+ * ------------
+ * Reads a line from standard input, without its newline, or the empty
+ * string at the end of the input.
+ */
+char *VM::ReadLine()
+{
+    std::string line;
+    int c;
+    fflush(stdout);
+    while ((c = getchar()) != EOF && c != '\n')
+        line += (char)c;
+    char *copy = (char *)this->Allocate(line.size() / sizeof(Value) + 1);
+    if (copy != NULL)
+        memcpy(copy, line.c_str(), line.size());
+    return copy;
+}
+
+/* VM::Execute
+ * -----------
+ * Runs the program until its main returns or it stops with an error.
+ * The function being run, its code, its registers and the instruction
+ * being done are kept in locals, so the compiler can keep them in
+ * machine registers, and saved in a frame across calls.
+ */
+int VM::Execute()
+{
+#define BC_LABEL(name, text, n) &&Do##name,
+    static void *const dispatch[NumBcOpcodes] = { BC_OPCODE_TABLE(BC_LABEL) };
+#undef BC_LABEL
+
+    BytecodeFunction *functions = this->program->GetFunction(0);
+    const Value *pool = this->program->GetPool();
+    Value *globals = this->globals;
+    Value *stackEnd = this->stack + StackSize;
+    BytecodeFunction *fn = NULL, *callee;
+    Value *regs = this->stack;
+    const uint32_t *code = NULL, *pc = NULL;
+    Value result;
+    const char *message;
+    char text[256];
+
+    if (globals == NULL)
+        HALT("Out of memory");
+    callee = functions + this->program->GetMain();
+    goto enter;
+
+  DoMove:
+    R(1) = R(2);
+    NEXT(3);
+  DoLoadInt:
+    R(1).p = NULL;
+    R(1).i = IMM(2);
+    NEXT(3);
+  DoLoadConst:
+    R(1) = pool[pc[2]];
+    NEXT(3);
+
+  DoAdd:  R(1).i = WRAP(R(2).i, +, R(3).i);  NEXT(4);
+  DoSub:  R(1).i = WRAP(R(2).i, -, R(3).i);  NEXT(4);
+  DoMul:  R(1).i = WRAP(R(2).i, *, R(3).i);  NEXT(4);
+  DoAddI: R(1).i = WRAP(R(2).i, +, IMM(3));  NEXT(4);
+  DoSubI: R(1).i = WRAP(R(2).i, -, IMM(3));  NEXT(4);
+  DoMulI: R(1).i = WRAP(R(2).i, *, IMM(3));  NEXT(4);
+  DoNeg:  R(1).i = WRAP(0, -, R(2).i);       NEXT(3);
+  DoDiv:
+  DoMod: {
+      int32_t x = R(2).i, y = R(3).i;
+      if (y == 0)
+          HALT("Division by zero");
+      bool overflows = (y == -1 && x == INT32_MIN);   // which wraps
+      if (*pc == BcDiv)
+          R(1).i = (overflows ? x : x / y);
+      else
+          R(1).i = (overflows ? 0 : x % y);
+      NEXT(4);
+  }
+
+  DoDAdd: R(1).d = R(2).d + R(3).d;  NEXT(4);
+  DoDSub: R(1).d = R(2).d - R(3).d;  NEXT(4);
+  DoDMul: R(1).d = R(2).d * R(3).d;  NEXT(4);
+  DoDDiv: R(1).d = R(2).d / R(3).d;  NEXT(4);
+  DoDNeg: R(1).d = -R(2).d;          NEXT(3);
+
+  DoLt:    R(1).i = (R(2).i < R(3).i);    NEXT(4);
+  DoLe:    R(1).i = (R(2).i <= R(3).i);   NEXT(4);
+  DoEq:    R(1).i = (R(2).i == R(3).i);   NEXT(4);
+  DoNe:    R(1).i = (R(2).i != R(3).i);   NEXT(4);
+  DoRefEq: R(1).i = (R(2).p == R(3).p);   NEXT(4);
+  DoRefNe: R(1).i = (R(2).p != R(3).p);   NEXT(4);
+  DoDLt:   R(1).i = (R(2).d < R(3).d);    NEXT(4);
+  DoDLe:   R(1).i = (R(2).d <= R(3).d);   NEXT(4);
+  DoDEq:   R(1).i = (R(2).d == R(3).d);   NEXT(4);
+  DoDNe:   R(1).i = (R(2).d != R(3).d);   NEXT(4);
+  DoSEq:
+    if (R(2).s == NULL || R(3).s == NULL)
+        HALT(NullReference);
+    R(1).i = (strcmp(R(2).s, R(3).s) == 0);
+    NEXT(4);
+  DoAnd:   R(1).i = (R(2).i & R(3).i);    NEXT(4);
+  DoOr:    R(1).i = (R(2).i | R(3).i);    NEXT(4);
+  DoNot:   R(1).i = (R(2).i ^ 1);         NEXT(3);
+
+  DoLoadField:
+    if (R(2).p == NULL)
+        HALT(NullReference);
+    R(1) = ((Value *)R(2).p)[pc[3]];
+    NEXT(4);
+  DoLoadFieldAdd:
+    if (R(2).p == NULL)
+        HALT(NullReference);
+    R(1).i = WRAP(((Value *)R(2).p)[pc[3]].i, +, R(4).i);
+    NEXT(5);
+  DoLoadFieldAddI:
+    if (R(2).p == NULL)
+        HALT(NullReference);
+    R(1).i = WRAP(((Value *)R(2).p)[pc[3]].i, +, IMM(4));
+    NEXT(5);
+  DoStoreField:
+    if (R(1).p == NULL)
+        HALT(NullReference);
+    ((Value *)R(1).p)[pc[2]] = R(3);
+    NEXT(4);
+  DoLoadElem: {
+      Value *array = (Value *)R(2).p;
+      if (array == NULL)
+          HALT(NullReference);
+      if ((uint32_t)R(3).i >= (uint32_t)array[-1].i)
+          HALT("Array subscript out of bounds");
+      R(1) = array[R(3).i];
+      NEXT(4);
+  }
+  DoStoreElem: {
+      Value *array = (Value *)R(1).p;
+      if (array == NULL)
+          HALT(NullReference);
+      if ((uint32_t)R(2).i >= (uint32_t)array[-1].i)
+          HALT("Array subscript out of bounds");
+      array[R(2).i] = R(3);
+      NEXT(4);
+  }
+  DoLength:
+    if (R(2).p == NULL)
+        HALT(NullReference);
+    R(1).i = ((Value *)R(2).p)[-1].i;
+    NEXT(3);
+  DoLoadGlobal:
+    R(1) = globals[pc[2]];
+    NEXT(3);
+  DoStoreGlobal:
+    globals[pc[1]] = R(2);
+    NEXT(3);
+
+  DoNew: {
+      BytecodeClass *cls = this->program->GetClass(pc[2]);
+      Value *object = this->Allocate(cls->numWords);
+      if (object == NULL)
+          HALT("Out of memory");
+      object[0].p = cls;
+      R(1).p = object;
+      NEXT(3);
+  }
+  DoNewArray: {
+      int32_t length = R(2).i;
+      if (length <= 0)
+          HALT("Array size is <= 0");
+      Value *array = this->Allocate((size_t)length + 1);
+      if (array == NULL)
+          HALT("Out of memory");
+      array[0].i = length;
+      R(1).p = array + 1;
+      NEXT(3);
+  }
+
+  DoCall:
+    callee = functions + pc[2];
+    goto call;
+  DoCallVirtual:
+    if (R(4).p == NULL)
+        HALT(NullReference);
+    callee = functions + ((BytecodeClass *)((Value *)R(4).p)[0].p)->methods[pc[2]];
+    goto call;
+  DoCallInterface: {
+      if (R(4).p == NULL)
+          HALT(NullReference);
+      uint32_t method = ((BytecodeClass *)((Value *)R(4).p)[0].p)->interfaceMethods[pc[2]];
+      if (method == IRNone)
+          HALT("Method not found for interface call");
+      callee = functions + method;
+      goto call;
+  }
+  call: {
+      Value *calleeRegs = regs + fn->numRegs;
+      if (calleeRegs + callee->numRegs > stackEnd)
+          HALT("Stack overflow");
+      for (uint32_t k = 0; k < pc[3]; k++)
+          calleeRegs[k] = regs[pc[4 + k]];
+      Frame frame = { fn, regs, pc };
+      this->frames.push_back(frame);
+      regs = calleeRegs;
+  }
+  enter:
+    if (callee->code.empty()) {
+        snprintf(text, sizeof(text), "%s is defined in another module", callee->name.c_str());
+        HALT(text);
+    }
+    fn = callee;
+    code = pc = &fn->code[0];
+    DISPATCH();
+
+  DoReturn:
+    result = R(1);
+    goto ret;
+  DoReturnVoid:
+    result.p = NULL;
+  ret:
+    if (this->frames.empty())
+        return 0;
+    fn = this->frames.back().fn;
+    regs = this->frames.back().regs;
+    pc = this->frames.back().call;
+    this->frames.pop_back();
+    code = &fn->code[0];
+    if (pc[1] != IRNone)
+        R(1) = result;
+    NEXT(4 + pc[3]);
+
+  DoPrintInt:
+    printf("%d", R(1).i);
+    NEXT(2);
+  DoPrintBool:
+    fputs(R(1).i ? "true" : "false", stdout);
+    NEXT(2);
+  DoPrintString:
+    if (R(1).s == NULL)
+        HALT(NullReference);
+    fputs(R(1).s, stdout);
+    NEXT(2);
+  DoReadInteger: {
+      char *line = this->ReadLine();
+      if (line == NULL)
+          HALT("Out of memory");
+      if (pc[1] != IRNone)
+          R(1).i = atoi(line);
+      NEXT(2);
+  }
+  DoReadLine: {
+      char *line = this->ReadLine();
+      if (line == NULL)
+          HALT("Out of memory");
+      if (pc[1] != IRNone)
+          R(1).s = line;
+      NEXT(2);
+  }
+
+  DoJump:
+    JUMP(1);
+  DoJumpIfTrue:   if (R(1).i)               JUMP(2);  NEXT(3);
+  DoJumpIfFalse:  if (!R(1).i)              JUMP(2);  NEXT(3);
+  DoJumpLt:       if (R(1).i < R(2).i)      JUMP(3);  NEXT(4);
+  DoJumpLe:       if (R(1).i <= R(2).i)     JUMP(3);  NEXT(4);
+  DoJumpGt:       if (R(1).i > R(2).i)      JUMP(3);  NEXT(4);
+  DoJumpGe:       if (R(1).i >= R(2).i)     JUMP(3);  NEXT(4);
+  DoJumpEq:       if (R(1).i == R(2).i)     JUMP(3);  NEXT(4);
+  DoJumpNe:       if (R(1).i != R(2).i)     JUMP(3);  NEXT(4);
+  DoJumpLtI:      if (R(1).i < IMM(2))      JUMP(3);  NEXT(4);
+  DoJumpLeI:      if (R(1).i <= IMM(2))     JUMP(3);  NEXT(4);
+  DoJumpGtI:      if (R(1).i > IMM(2))      JUMP(3);  NEXT(4);
+  DoJumpGeI:      if (R(1).i >= IMM(2))     JUMP(3);  NEXT(4);
+  DoJumpEqI:      if (R(1).i == IMM(2))     JUMP(3);  NEXT(4);
+  DoJumpNeI:      if (R(1).i != IMM(2))     JUMP(3);  NEXT(4);
+
+  halt:
+    fflush(stdout);
+    fprintf(stderr, "Decaf runtime error: %s\n", message);
+    return 1;
+}
@@ -0,0 +1,57 @@
+/* File: vm.h
+ * ----------
+ * The virtual machine that dcc --run runs a program's bytecode (see
+ * bytecode.h) on, straight after compiling it, with nothing written out
+ * or linked. It does what the runtime in runtime.c does for the code of
+ * the x86-64 code generator, and stops with the same errors.
+ *
+ * Dispatch is threaded: each instruction ends by jumping through a table
+ * of the addresses of the code for each opcode straight to the code for
+ * the next one, using the labels-as-values extension of GCC and Clang,
+ * so there is no loop or switch to go back through, and each opcode's
+ * jump is predicted on its own.
+ *
+ * Each call's registers are a frame on a stack of values, right after
+ * its caller's, and the arguments are copied into the first of them.
+ * Calls and returns don't recurse in C, so a program can go as deep as
+ * the stack has room for. Nothing is freed until the program ends.
+ */
+
+#ifndef _H_vm
+#define _H_vm
+
+#include "bytecode.h"
+#include <vector>
+
+class VM
+{
+  public:
+           // Runs program from its main, and returns the status it
+           // exits with: 0, or 1 if it stopped with a runtime error
+    static int Run(BytecodeProgram *program);
+
+  private:
+    struct Frame
+    {
+        BytecodeFunction *fn;
+        Value *regs;
+        const uint32_t *call;        // the instruction to go back to
+    };
+
+    static const size_t StackSize = 1 << 20;   // values
+
+    BytecodeProgram *program;
+    Value *stack;
+    Value *globals;
+    std::vector<Frame> frames;
+    std::vector<void*> allocations;
+
+    VM(BytecodeProgram *program);
+    ~VM();
+
+    int Execute();
+    Value *Allocate(size_t numValues);
+    char *ReadLine();
+};
+
+#endif
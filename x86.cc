@@ -0,0 +1,748 @@
+/* File: x86.cc
+ * ------------
+ * Implementation of the X86Generator.
+ */
+
+#include "x86.h"
+#include "utility.h"
+#include <stdarg.h>
+#include <string.h>
+#include <set>
+
+  // the general registers, by their numbers in the instruction encoding
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+static const char *const Names64[] = { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+                                       "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" };
+static const char *const Names32[] = { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+                                       "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d" };
+
+  // %rax, %rdx, %rsi, %rdi and %r11 are left for the code to work in,
+  // as are %xmm0 and %xmm1, and the SSE registers are all caller-saved
+static const int IntCalleeSaved[] = { RBX, R12, R13, R14, R15 };
+static const int IntCallerSaved[] = { RCX, R8, R9, R10 };
+static const int DoubleCallerSaved[] = { 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+const MachineRegisters X86Generator::machine = {
+    std::vector<int>(IntCalleeSaved, IntCalleeSaved + sizeof(IntCalleeSaved) / sizeof(int)),
+    std::vector<int>(IntCallerSaved, IntCallerSaved + sizeof(IntCallerSaved) / sizeof(int)),
+    std::vector<int>(),
+    std::vector<int>(DoubleCallerSaved, DoubleCallerSaved + sizeof(DoubleCallerSaved) / sizeof(int)),
+    X86Generator::CallsOut
+};
+
+
+X86Generator::X86Generator(IRProgram *p)
+{
+    this->program = p;
+    this->fn = NULL;
+    this->regs = NULL;
+}
+
+/* X86Generator::Generate
+ * ----------------------
+ * The assembly is all made in memory first, then written out, or piped
+ * through as for an object.
+ */
+bool X86Generator::Generate(IRProgram *program, const char *path)
+{
+    X86Generator generator(program);
+    generator.Emit(".text");
+    for (int n = 0; n < program->NumFunctions(); n++) {
+        if (program->GetFunction(n)->HasCode())
+            generator.GenerateFunction(n);
+    }
+    generator.GenerateData();
+
+    size_t length = strlen(path);
+    bool object = (length > 2 && strcmp(path + length - 2, ".o") == 0);
+    FILE *out;
+    if (object) {
+        std::string command = std::string("as -o '") + path + "' -";
+        out = popen(command.c_str(), "w");
+    } else {
+        out = fopen(path, "w");
+    }
+    if (out == NULL)
+        return false;
+    bool ok = (fwrite(generator.text.data(), 1, generator.text.size(), out) == generator.text.size());
+    if (object)
+        return (pclose(out) == 0 && ok);
+    return (fclose(out) == 0 && ok);
+}
+
+/* X86Generator::CallsOut
+ * ----------------------
+ * What calls a function, of the program or the runtime, and so takes
+ * the caller-saved registers. Comparing strings is done by the runtime.
+ * A subscript out of bounds, a null reference or a division by zero
+ * calls it too, but never comes back.
+ */
+bool X86Generator::CallsOut(IROpcode op)
+{
+    switch (op) {
+      case OpCall: case OpCallVirtual: case OpCallInterface:
+      case OpPrintInt: case OpPrintBool: case OpPrintString:
+      case OpReadInteger: case OpReadLine:
+      case OpNew: case OpNewArray: case OpSEq:
+        return true;
+      default:
+        return false;
+    }
+}
+
+void X86Generator::Emit(const char *format, ...)
+{
+    char line[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    size_t length = strlen(line);
+    if (length == 0 || line[length - 1] != ':')   // labels aren't indented
+        this->text += '\t';
+    this->text += line;
+    this->text += '\n';
+}
+
+std::string X86Generator::Register(int machineReg, IRKind kind)
+{
+    char name[8];
+    if (kind == IRDouble)
+        snprintf(name, sizeof(name), "%%xmm%d", machineReg);
+    else
+        snprintf(name, sizeof(name), "%%%s", (kind == IRInt ? Names32 : Names64)[machineReg]);
+    return name;
+}
+
+/* X86Generator::Location
+ * ----------------------
+ * Where r is, as an operand: the constant itself if it is one, its
+ * register, or its slot below the saved registers, or for a parameter not
+ * in a register, where it was passed.
+ */
+std::string X86Generator::Location(IRReg r)
+{
+    char operand[32];
+    if (this->immediate[r]) {
+        snprintf(operand, sizeof(operand), "$%d", (int32_t)this->fn->GetA(this->definition[r]));
+        return operand;
+    }
+    if (this->regs->InRegister(r))
+        return this->Register(this->regs->GetRegister(r), this->fn->GetRegKind(r));
+    if ((int)r < this->fn->NumParams())
+        snprintf(operand, sizeof(operand), "%d(%%rbp)", 16 + 8 * (int)r);
+    else
+        snprintf(operand, sizeof(operand), "%d(%%rbp)", -8 * (this->numSaved + this->regs->GetSlot(r) + 1));
+    return operand;
+}
+
+std::string X86Generator::Label(IRBlock b)
+{
+    char label[32];
+    snprintf(label, sizeof(label), ".L%d_%u", this->fnIndex, b);
+    return label;
+}
+
+/* X86Generator::Move
+ * ------------------
+ * Moves a value of the given kind between two operands, by way of %r11
+ * or %xmm1 if both are in memory.
+ */
+void X86Generator::Move(IRKind kind, const std::string &from, const std::string &to)
+{
+    if (from == to)
+        return;
+    const char *mov = (kind == IRDouble ? "movsd" : kind == IRInt ? "movl" : "movq");
+    if (from[0] != '%' && to[0] != '%') {
+        std::string scratch = (kind == IRDouble ? "%xmm1" : kind == IRInt ? "%r11d" : "%r11");
+        this->Emit("%s %s, %s", mov, from.c_str(), scratch.c_str());
+        this->Emit("%s %s, %s", mov, scratch.c_str(), to.c_str());
+    } else {
+        this->Emit("%s %s, %s", mov, from.c_str(), to.c_str());
+    }
+}
+
+/* X86Generator::IntoRegister
+ * --------------------------
+ * The general register holding r, an int or a reference, loading it
+ * into scratch if it isn't in one.
+ */
+int X86Generator::IntoRegister(IRReg r, int scratch)
+{
+    if (this->regs->InRegister(r))
+        return this->regs->GetRegister(r);
+    IRKind kind = this->fn->GetRegKind(r);
+    this->Move(kind, this->Location(r), this->Register(scratch, kind));
+    return scratch;
+}
+
+/* X86Generator::CheckNull
+ * -----------------------
+ * Stops the program with a null reference error if the general register
+ * holds null.
+ */
+void X86Generator::CheckNull(int machineReg)
+{
+    this->Emit("testq %%%s, %%%s", Names64[machineReg], Names64[machineReg]);
+    this->Emit("je .L%d_null", this->fnIndex);
+    this->checksNull = true;
+}
+
+/* X86Generator::Jump
+ * ------------------
+ * Jumps to b, unless b is laid out right after instruction after.
+ */
+void X86Generator::Jump(IRBlock b, IRInstr after)
+{
+    if (after + 1 >= (IRInstr)this->fn->NumInstrs() || this->blockAt[after + 1] != b)
+        this->Emit("jmp %s", this->Label(b).c_str());
+}
+
+void X86Generator::Epilogue()
+{
+    if (this->numSaved == 0) {
+        this->Emit("leave");
+    } else {
+        this->Emit("leaq %d(%%rbp), %%rsp", -8 * this->numSaved);
+        const std::vector<int> &saved = this->regs->UsedIntCalleeSaved();
+        for (int j = saved.size() - 1; j >= 0; j--)
+            this->Emit("popq %%%s", Names64[saved[j]]);
+        this->Emit("popq %%rbp");
+    }
+    this->Emit("ret");
+}
+
+/* X86Generator::FindImmediates
+ * -----------------------------
+ * A register written only once, with a constant, is used as that
+ * constant wherever it is read, and needs no place of its own.
+ */
+void X86Generator::FindImmediates()
+{
+    int numRegs = this->fn->NumRegs();
+    std::vector<int> numWrites(numRegs, 0);
+    this->definition.assign(numRegs, IRNone);
+    for (IRInstr i = 0; i < (IRInstr)this->fn->NumInstrs(); i++) {
+        IRReg dest = this->fn->GetDest(i);
+        if (dest != IRNone) {
+            numWrites[dest]++;
+            this->definition[dest] = i;
+        }
+    }
+    this->immediate.assign(numRegs, false);
+    for (IRReg r = this->fn->NumParams(); r < (IRReg)numRegs; r++)
+        this->immediate[r] = (numWrites[r] == 1 && this->fn->GetOp(this->definition[r]) == OpConst);
+}
+
+/* X86Generator::GenerateFunction
+ * ------------------------------
+ * The frame is %rbp, then the callee-saved registers used, then the
+ * spill slots, padded to keep the stack aligned. Parameters given
+ * registers are loaded into them on the way in.
+ */
+void X86Generator::GenerateFunction(int n)
+{
+    this->fn = this->program->GetFunction(n);
+    this->fnIndex = n;
+    this->FindImmediates();
+    this->regs = new LinearScan(this->fn, &machine, &this->immediate);
+    this->numSaved = this->regs->UsedIntCalleeSaved().size();
+    this->checksBounds = false;
+    this->checksNull = false;
+    this->checksDivision = false;
+    this->blockAt.assign(this->fn->NumInstrs(), IRNone);
+    for (IRBlock b = 0; b < (IRBlock)this->fn->NumBlocks(); b++) {
+        if (this->fn->BlockStart(b) != IRNone)
+            this->blockAt[this->fn->BlockStart(b)] = b;
+    }
+
+    const char *name = this->fn->GetName().c_str();
+    this->Emit(".globl _%s", name);
+    this->Emit(".type _%s, @function", name);
+    this->Emit("_%s:", name);
+    this->Emit("pushq %%rbp");
+    this->Emit("movq %%rsp, %%rbp");
+    const std::vector<int> &saved = this->regs->UsedIntCalleeSaved();
+    for (size_t j = 0; j < saved.size(); j++)
+        this->Emit("pushq %%%s", Names64[saved[j]]);
+    int frame = 8 * this->regs->NumSlots();
+    if ((this->numSaved + this->regs->NumSlots()) % 2 != 0)
+        frame += 8;
+    if (frame > 0)
+        this->Emit("subq $%d, %%rsp", frame);
+    for (IRReg p = 0; p < (IRReg)this->fn->NumParams(); p++) {
+        if (this->regs->InRegister(p)) {
+            char home[32];
+            snprintf(home, sizeof(home), "%d(%%rbp)", 16 + 8 * (int)p);
+            this->Move(this->fn->GetRegKind(p), home, this->Location(p));
+        }
+    }
+
+    for (IRInstr i = 0; i < (IRInstr)this->fn->NumInstrs(); i++) {
+        if (this->blockAt[i] != IRNone)
+            this->Emit("%s:", this->Label(this->blockAt[i]).c_str());
+        if (this->GenerateCompareAndBranch(i))
+            i++;
+        else
+            this->GenerateInstr(i);
+    }
+    if (this->checksBounds) {
+        this->Emit(".L%d_bounds:", n);
+        this->Emit("call __OutOfBounds");
+    }
+    if (this->checksNull) {
+        this->Emit(".L%d_null:", n);
+        this->Emit("call __NullReference");
+    }
+    if (this->checksDivision) {
+        this->Emit(".L%d_divzero:", n);
+        this->Emit("call __DivisionByZero");
+    }
+    this->Emit(".size _%s, .-_%s", name, name);
+    delete this->regs;
+    this->regs = NULL;
+}
+
+/* X86Generator::GenerateCompareAndBranch
+ * --------------------------------------
+ * An int comparison whose result is only tested by the branch right
+ * after it becomes a compare and a conditional jump, without the result
+ * ever being made. Returns whether instruction i was one.
+ */
+bool X86Generator::GenerateCompareAndBranch(IRInstr i)
+{
+    IROpcode op = this->fn->GetOp(i);
+    if ((op != OpLt && op != OpLe && op != OpEq && op != OpNe) || i + 1 >= (IRInstr)this->fn->NumInstrs())
+        return false;
+    IRReg dest = this->fn->GetDest(i);
+    if (this->fn->GetOp(i + 1) != OpBranch || this->fn->GetA(i + 1) != dest || this->regs->IsLiveAfter(dest, i + 1))
+        return false;
+
+    IRReg a = this->fn->GetA(i), b = this->fn->GetB(i);
+    IRKind kind = this->fn->GetRegKind(a);
+    std::string x = this->Location(a), y = this->Location(b);
+    if (x[0] == '$' || (x[0] != '%' && y[0] != '%'))
+        x = this->Register(this->IntoRegister(a, RAX), kind);
+    this->Emit("cmp%c %s, %s", (kind == IRInt ? 'l' : 'q'), y.c_str(), x.c_str());
+    const char *jump = (op == OpLt ? "jl" : op == OpLe ? "jle" : op == OpEq ? "je" : "jne");
+    const char *inverse = (op == OpLt ? "jge" : op == OpLe ? "jg" : op == OpEq ? "jne" : "je");
+    IRBlock taken = this->fn->GetB(i + 1), notTaken = this->fn->GetC(i + 1);
+    if (i + 2 < (IRInstr)this->fn->NumInstrs() && this->blockAt[i + 2] == taken) {
+        this->Emit("%s %s", inverse, this->Label(notTaken).c_str());
+    } else {
+        this->Emit("%s %s", jump, this->Label(taken).c_str());
+        this->Jump(notTaken, i + 1);
+    }
+    return true;
+}
+
+/* X86Generator::GenerateInstr
+ * ---------------------------
+ * An operation is done in the register its result goes in when that's
+ * a register and doesn't hold the second operand, and in %eax (or
+ * %xmm0) otherwise. Whatever is in memory is used from there where the
+ * instruction allows it.
+ */
+void X86Generator::GenerateInstr(IRInstr i)
+{
+    IROpcode op = this->fn->GetOp(i);
+    IRReg dest = this->fn->GetDest(i), a = this->fn->GetA(i), b = this->fn->GetB(i);
+    std::string d = (dest != IRNone ? this->Location(dest) : "");
+    IRKind kind = (dest != IRNone ? this->fn->GetRegKind(dest) : IRVoid);
+    std::string x = (IROpcodes[op].operands[0] == OperandReg && a != IRNone ? this->Location(a) : "");
+    std::string y = (IROpcodes[op].operands[1] == OperandReg ? this->Location(b) : "");
+    bool inPlace = (dest != IRNone && this->regs->InRegister(dest) && d != y);
+    std::string t = (inPlace ? d : kind == IRDouble ? "%xmm0" : "%eax");
+    char operand[64];
+
+    switch (op) {
+      case OpConst:
+        if (this->immediate[dest])
+            break;
+        if (d[0] == '%' && a == 0)
+            this->Emit("xorl %s, %s", this->Register(this->regs->GetRegister(dest), IRInt).c_str(),
+                       this->Register(this->regs->GetRegister(dest), IRInt).c_str());
+        else
+            this->Emit("mov%c $%d, %s", (kind == IRRef ? 'q' : 'l'), (int32_t)a, d.c_str());
+        break;
+      case OpDConst:
+        snprintf(operand, sizeof(operand), ".LD%u(%%rip)", a);
+        this->Move(IRDouble, operand, d);
+        break;
+      case OpSConst:
+        snprintf(operand, sizeof(operand), ".LS%u(%%rip)", a);
+        this->Emit("leaq %s, %s", operand, (d[0] == '%' ? d.c_str() : "%rax"));
+        if (d[0] != '%')
+            this->Move(IRRef, "%rax", d);
+        break;
+      case OpMove:
+        this->Move(kind, x, d);
+        break;
+
+      case OpAdd: case OpSub: case OpMul: case OpAnd: case OpOr: {
+        const char *name = (op == OpAdd ? "addl" : op == OpSub ? "subl" : op == OpMul ? "imull" :
+                            op == OpAnd ? "andl" : "orl");
+        if (!inPlace && op != OpSub && dest != IRNone && this->regs->InRegister(dest)) {
+            this->Emit("%s %s, %s", name, x.c_str(), d.c_str());   // d is y, and op commutes
+            break;
+        }
+        this->Move(IRInt, x, t);
+        this->Emit("%s %s, %s", name, y.c_str(), t.c_str());
+        this->Move(IRInt, t, d);
+        break;
+      }
+      case OpDiv: case OpMod:
+        this->GenerateDivision(i);
+        break;
+      case OpNeg: case OpNot:
+        this->Move(IRInt, x, t);
+        this->Emit(op == OpNeg ? "negl %s" : "xorl $1, %s", t.c_str());
+        this->Move(IRInt, t, d);
+        break;
+
+      case OpDAdd: case OpDSub: case OpDMul: case OpDDiv: {
+        const char *name = (op == OpDAdd ? "addsd" : op == OpDSub ? "subsd" : op == OpDMul ? "mulsd" : "divsd");
+        this->Move(IRDouble, x, t);
+        this->Emit("%s %s, %s", name, y.c_str(), t.c_str());
+        this->Move(IRDouble, t, d);
+        break;
+      }
+      case OpDNeg:
+        this->Emit("movq %s, %%rax", x.c_str());
+        this->Emit("btcq $63, %%rax");
+        this->Emit("movq %%rax, %s", d.c_str());
+        break;
+
+      case OpLt: case OpLe: case OpEq: case OpNe: {
+        IRKind operands = this->fn->GetRegKind(a);
+        if (x[0] == '$' || (x[0] != '%' && y[0] != '%'))
+            x = this->Register(this->IntoRegister(a, RAX), operands);
+        this->Emit("cmp%c %s, %s", (operands == IRInt ? 'l' : 'q'), y.c_str(), x.c_str());
+        this->Emit("%s %%al", (op == OpLt ? "setl" : op == OpLe ? "setle" : op == OpEq ? "sete" : "setne"));
+        this->Emit("movzbl %%al, %%eax");
+        this->Move(IRInt, "%eax", d);
+        break;
+      }
+      case OpDLt: case OpDLe:      // b > a, or b >= a, is false if either is NaN
+        this->Move(IRDouble, y, "%xmm0");
+        this->Emit("ucomisd %s, %%xmm0", x.c_str());
+        this->Emit("%s %%al", (op == OpDLt ? "seta" : "setae"));
+        this->Emit("movzbl %%al, %%eax");
+        this->Move(IRInt, "%eax", d);
+        break;
+      case OpDEq: case OpDNe:      // which a NaN compares unordered for
+        this->Move(IRDouble, x, "%xmm0");
+        this->Emit("ucomisd %s, %%xmm0", y.c_str());
+        this->Emit(op == OpDEq ? "sete %%al" : "setne %%al");
+        this->Emit(op == OpDEq ? "setnp %%dl" : "setp %%dl");
+        this->Emit(op == OpDEq ? "andb %%dl, %%al" : "orb %%dl, %%al");
+        this->Emit("movzbl %%al, %%eax");
+        this->Move(IRInt, "%eax", d);
+        break;
+      case OpSEq:
+        this->Move(IRRef, x, "%rdi");
+        this->Move(IRRef, y, "%rsi");
+        this->Emit("call __StringEqual");
+        this->Move(IRInt, "%eax", d);
+        break;
+
+      case OpLoadField: case OpStoreField: {
+        int base = this->IntoRegister(a, RAX);
+        this->CheckNull(base);
+        snprintf(operand, sizeof(operand), "%d(%%%s)", (int)b, Names64[base]);
+        if (op == OpLoadField)
+            this->Move(kind, operand, d);
+        else
+            this->Move(this->fn->GetRegKind(this->fn->GetC(i)), this->Location(this->fn->GetC(i)), operand);
+        break;
+      }
+      case OpLoadElem: case OpStoreElem: {
+        int base = this->IntoRegister(a, RAX), index = this->IntoRegister(b, RDX);
+        this->CheckNull(base);
+        this->Emit("cmpl -8(%%%s), %%%s", Names64[base], Names32[index]);
+        this->Emit("jae .L%d_bounds", this->fnIndex);
+        this->checksBounds = true;
+        snprintf(operand, sizeof(operand), "(%%%s,%%%s,8)", Names64[base], Names64[index]);
+        if (op == OpLoadElem)
+            this->Move(kind, operand, d);
+        else
+            this->Move(this->fn->GetRegKind(this->fn->GetC(i)), this->Location(this->fn->GetC(i)), operand);
+        break;
+      }
+      case OpLength: {
+        int base = this->IntoRegister(a, RAX);
+        this->CheckNull(base);
+        snprintf(operand, sizeof(operand), "-8(%%%s)", Names64[base]);
+        this->Move(IRInt, operand, d);
+        break;
+      }
+      case OpLoadGlobal: case OpStoreGlobal: {
+        IRGlobal *global = this->program->GetGlobal(a);
+        snprintf(operand, sizeof(operand), "_%s(%%rip)", SymbolName(global->name));
+        if (op == OpLoadGlobal)
+            this->Move(kind, operand, d);
+        else
+            this->Move(global->kind, y, operand);
+        break;
+      }
+      case OpNew:
+        this->Emit("movl $%d, %%edi", this->program->GetClass(a)->objectSize);
+        this->Emit("leaq .LVT%u(%%rip), %%rsi", a);
+        this->Emit("call __New");
+        this->Move(IRRef, "%rax", d);
+        break;
+      case OpNewArray:
+        this->Move(IRInt, x, "%edi");
+        this->Emit("call __NewArray");
+        this->Move(IRRef, "%rax", d);
+        break;
+
+      case OpCall: case OpCallVirtual: case OpCallInterface:
+        this->GenerateCall(i);
+        break;
+      case OpPrintInt: case OpPrintBool:
+        this->Move(IRInt, x, "%edi");
+        this->Emit(op == OpPrintInt ? "call __PrintInt" : "call __PrintBool");
+        break;
+      case OpPrintString:
+        this->Move(IRRef, x, "%rdi");
+        this->Emit("call __PrintString");
+        break;
+      case OpReadInteger:
+        this->Emit("call __ReadInteger");
+        this->Move(IRInt, "%eax", d);
+        break;
+      case OpReadLine:
+        this->Emit("call __ReadLine");
+        this->Move(IRRef, "%rax", d);
+        break;
+
+      case OpJump:
+        this->Jump(a, i);
+        break;
+      case OpBranch:
+        if (x[0] == '$') {
+            this->Jump(strcmp(x.c_str(), "$0") != 0 ? b : this->fn->GetC(i), i);
+            break;
+        }
+        if (x[0] == '%')
+            this->Emit("testl %s, %s", x.c_str(), x.c_str());
+        else
+            this->Emit("cmpl $0, %s", x.c_str());
+        if (i + 1 < (IRInstr)this->fn->NumInstrs() && this->blockAt[i + 1] == b) {
+            this->Emit("je %s", this->Label(this->fn->GetC(i)).c_str());
+        } else {
+            this->Emit("jne %s", this->Label(b).c_str());
+            this->Jump(this->fn->GetC(i), i);
+        }
+        break;
+      case OpReturn:
+        if (a != IRNone) {
+            IRKind returns = this->fn->GetRegKind(a);
+            if (returns == IRDouble)
+                this->Emit("movq %s, %%rax", x.c_str());
+            else
+                this->Move(returns, x, this->Register(RAX, returns));
+        }
+        this->Epilogue();
+        break;
+      default:
+        Failure("Unexpected IR opcode %d in X86Generator::GenerateInstr", (int)op);
+    }
+}
+
+/* X86Generator::GenerateCall
+ * --------------------------
+ * The arguments are pushed last to first, after a pad if there is an odd
+ * number of them, so the receiver of a method ends up on top. A method
+ * is called through its slot in the receiver's method table, and one
+ * called through an interface through its selector's place in the
+ * interface table the word before the method table points at. Colors
+ * are only this module's, though, and an object made in another module
+ * has that module's tables, so the interface table is only used if the
+ * word before its name table is this module's tag. Otherwise the
+ * runtime's __Lookup finds the method by name.
+ */
+void X86Generator::GenerateCall(IRInstr i)
+{
+    IROpcode op = this->fn->GetOp(i);
+    IRReg dest = this->fn->GetDest(i);
+    int count = this->fn->GetC(i);
+    if (count % 2 != 0)
+        this->Emit("subq $8, %%rsp");
+    for (int n = count - 1; n >= 0; n--) {
+        IRReg arg = this->fn->GetArg(i, n);
+        std::string from = this->Location(arg);
+        if (from[0] != '%') {
+            this->Emit("pushq %s", from.c_str());
+        } else if (this->fn->GetRegKind(arg) == IRDouble) {
+            this->Emit("subq $8, %%rsp");
+            this->Emit("movsd %s, (%%rsp)", from.c_str());
+        } else {
+            this->Emit("pushq %%%s", Names64[this->regs->GetRegister(arg)]);
+        }
+    }
+
+    uint32_t callee = this->fn->GetA(i);
+    if (op == OpCall) {
+        this->Emit("call _%s", this->program->GetFunction(callee)->GetName().c_str());
+    } else if (op == OpCallVirtual) {
+        this->Emit("movq (%%rsp), %%rax");
+        this->CheckNull(RAX);
+        this->Emit("movq (%%rax), %%rax");
+        this->Emit("call *%d(%%rax)", 8 * (int)callee);
+    } else {
+        this->Emit("movq (%%rsp), %%rdi");
+        this->CheckNull(RDI);
+        this->Emit("movq (%%rdi), %%rax");
+        this->Emit("movq -8(%%rax), %%rax");
+        this->Emit("leaq .LModule(%%rip), %%rdx");
+        this->Emit("cmpq %%rdx, -16(%%rax)");
+        this->Emit("jne 1f");
+        this->Emit("movq %d(%%rax), %%rax", 8 * (int)this->program->GetSelectorColor(callee));
+        this->Emit("jmp 2f");
+        this->Emit("1:");
+        this->Emit("leaq __Selector.%s(%%rip), %%rsi", SymbolName(this->program->GetSelector(callee)));
+        this->Emit("call __Lookup");
+        this->Emit("2:");
+        this->Emit("call *%%rax");
+    }
+    int popped = 8 * (count + count % 2);
+    if (popped > 0)
+        this->Emit("addq $%d, %%rsp", popped);
+
+    if (dest == IRNone)
+        return;
+    IRKind kind = this->fn->GetRegKind(dest);
+    if (kind == IRDouble)
+        this->Emit("movq %%rax, %s", this->Location(dest).c_str());
+    else
+        this->Move(kind, this->Register(RAX, kind), this->Location(dest));
+}
+
+/* X86Generator::GenerateDivision
+ * ------------------------------
+ * idiv faults on a zero divisor, and on the quotient of the most
+ * negative int by -1, which doesn't fit. The first stops the program
+ * as the VM does, and the second wraps as it does: dividing by -1 is
+ * negating, and the remainder is 0. A divisor that's a constant other
+ * than those needs neither check.
+ */
+void X86Generator::GenerateDivision(IRInstr i)
+{
+    IROpcode op = this->fn->GetOp(i);
+    IRReg dest = this->fn->GetDest(i);
+    std::string x = this->Location(this->fn->GetA(i)), y = this->Location(this->fn->GetB(i));
+    const char *result = (op == OpDiv ? "%eax" : "%edx");
+    bool constant = (y[0] == '$');
+    if (constant && y != "$0" && y != "$-1") {
+        this->Move(IRInt, y, "%r11d");   // idiv takes no immediate
+        this->Move(IRInt, x, "%eax");
+        this->Emit("cltd");
+        this->Emit("idivl %%r11d");
+    } else if (y == "$-1") {
+        this->Move(IRInt, x, "%eax");
+        this->Emit(op == OpDiv ? "negl %%eax" : "xorl %%edx, %%edx");
+    } else {
+        if (constant) {
+            this->Move(IRInt, y, "%r11d");
+            y = "%r11d";
+        }
+        if (y[0] == '%')
+            this->Emit("testl %s, %s", y.c_str(), y.c_str());
+        else
+            this->Emit("cmpl $0, %s", y.c_str());
+        this->Emit("je .L%d_divzero", this->fnIndex);
+        this->checksDivision = true;
+        this->Move(IRInt, x, "%eax");
+        this->Emit("cmpl $-1, %s", y.c_str());
+        this->Emit("jne 1f");
+        this->Emit(op == OpDiv ? "negl %%eax" : "xorl %%edx, %%edx");
+        this->Emit("jmp 2f");
+        this->Emit("1:");
+        this->Emit("cltd");
+        this->Emit("idivl %s", y.c_str());
+        this->Emit("2:");
+    }
+    if (dest != IRNone)
+        this->Move(IRInt, result, this->Location(dest));
+}
+
+/* X86Generator::GenerateData
+ * --------------------------
+ * The constants, then for each class its name table, pairing the common
+ * symbol of each of its methods' names with the method, its interface
+ * table, with the runtime's __NoMethod at the colors of the selectors it
+ * has no method for, and its method table. A pointer to each table is
+ * in the word before the next one, and the word before that pointer to
+ * the name table is the module's tag, .LModule, which is there only for
+ * its address.
+ */
+void X86Generator::GenerateData()
+{
+    this->Emit(".section .rodata");
+    for (int n = 0; n < this->program->NumStrings(); n++) {
+        const std::string &s = this->program->GetString(n);
+        std::string escaped;
+        for (size_t j = 0; j < s.size(); j++) {
+            unsigned char c = s[j];
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if (c < ' ' || c > '~') {
+                char octal[8];
+                snprintf(octal, sizeof(octal), "\\%03o", c);
+                escaped += octal;
+            } else {
+                escaped += c;
+            }
+        }
+        this->Emit(".LS%d:", n);
+        this->text += "\t.string \"" + escaped + "\"\n";   // can be longer than Emit takes
+    }
+    this->Emit(".align 8");
+    for (int n = 0; n < this->program->NumDoubles(); n++) {
+        double d = this->program->GetDouble(n);
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        this->Emit(".LD%d:", n);
+        this->Emit(".quad 0x%llx", (unsigned long long)bits);
+    }
+
+    this->Emit(".data");
+    this->Emit(".align 8");
+    this->Emit(".LModule:");
+    this->Emit(".quad 0");
+    std::set<Symbol> selectors;
+    for (int n = 0; n < this->program->NumClasses(); n++) {
+        IRClass *cls = this->program->GetClass(n);
+        this->Emit(".LNT%d:", n);
+        for (size_t slot = 0; slot < cls->methods.size(); slot++) {
+            this->Emit(".quad __Selector.%s", SymbolName(cls->methodNames[slot]));
+            this->Emit(".quad _%s", this->program->GetFunction(cls->methods[slot])->GetName().c_str());
+            selectors.insert(cls->methodNames[slot]);
+        }
+        this->Emit(".quad 0");
+        this->Emit(".quad .LModule");
+        this->Emit(".quad .LNT%d", n);
+        this->Emit(".LIT%d:", n);
+        for (size_t color = 0; color < cls->interfaceMethods.size(); color++) {
+            if (cls->interfaceMethods[color] == IRNone)
+                this->Emit(".quad __NoMethod");
+            else
+                this->Emit(".quad _%s", this->program->GetFunction(cls->interfaceMethods[color])->GetName().c_str());
+        }
+        this->Emit(".quad .LIT%d", n);
+        this->Emit(".LVT%d:", n);
+        for (size_t slot = 0; slot < cls->methods.size(); slot++)
+            this->Emit(".quad _%s", this->program->GetFunction(cls->methods[slot])->GetName().c_str());
+    }
+    for (int n = 0; n < this->program->NumGlobals(); n++)
+        this->Emit(".comm _%s, 8, 8", SymbolName(this->program->GetGlobal(n)->name));
+    for (int n = 0; n < this->program->NumSelectors(); n++)
+        selectors.insert(this->program->GetSelector(n));
+    for (std::set<Symbol>::iterator s = selectors.begin(); s != selectors.end(); ++s)
+        this->Emit(".comm __Selector.%s, 1, 1", SymbolName(*s));
+    this->Emit(".section .note.GNU-stack,\"\",@progbits");
+}
@@ -0,0 +1,85 @@
+/* File: x86.h
+ * -----------
+ * The x86-64 code generator, which turns the IR of a program (see ir.h)
+ * into assembly for the GNU assembler, or through it into an ELF object,
+ * to be linked with the runtime in runtime.c.
+ *
+ * Each IR register is put in a machine register or a slot in the frame
+ * by linear scan (see regalloc.h), so locals and formals live in
+ * registers, and a constant is used as an immediate operand. Ints and
+ * bools are 32 bits, references 64, and doubles go in the SSE registers.
+ * Arguments are pushed on the stack, the first nearest the top, and a
+ * result comes back in %rax (a double's bits too); the callee keeps
+ * %rbx, %rbp and %r12-%r15 as C code does, and the stack is kept aligned
+ * to 16 bytes at each call, so the runtime's functions are called the C
+ * way.
+ *
+ * An object starts with its class's method table (see layout.h), and the
+ * word before that table points at the class's interface table, where a
+ * method called through an interface is at its selector's color (see
+ * ir.h). Colors are per module, so a call only uses the table if it was
+ * made by the calling module, and otherwise the runtime looks the method
+ * up by name. An array starts after a word holding its length, and a
+ * subscript is checked against that before it's used. A reference is
+ * checked for null before it's used, and a divisor for zero, and each
+ * stops the program with the runtime's error, as the VM does.
+ *
+ * Symbols are the program's names with an underscore in front, which
+ * can't be mistaken for the runtime's, all of which start with two.
+ * Global variables are common symbols, so modules compiled separately
+ * (see snapshot.h) share the ones they both declare.
+ */
+
+#ifndef _H_x86
+#define _H_x86
+
+#include "ir.h"
+#include "regalloc.h"
+#include <string>
+
+class X86Generator
+{
+  public:
+           // Writes program to path as assembly, or as an ELF object if
+           // path ends in .o, and returns whether it could be written
+    static bool Generate(IRProgram *program, const char *path);
+
+  private:
+    IRProgram *program;
+    std::string text;                // the assembly
+    IRFunction *fn;                  // being generated
+    int fnIndex;
+    LinearScan *regs;
+    int numSaved;                    // callee-saved registers pushed
+    std::vector<IRBlock> blockAt;    // starting at each instruction, or IRNone
+    std::vector<bool> immediate;     // registers used as constants, see FindImmediates
+    std::vector<IRInstr> definition; // of each register written once
+    bool checksBounds;               // whether the function jumps to each
+    bool checksNull;                 // of its labels for runtime errors
+    bool checksDivision;
+
+    X86Generator(IRProgram *program);
+
+    void Emit(const char *format, ...);
+    void FindImmediates();
+    void GenerateFunction(int n);
+    void GenerateInstr(IRInstr i);
+    void GenerateCall(IRInstr i);
+    void GenerateDivision(IRInstr i);
+    bool GenerateCompareAndBranch(IRInstr i);
+    void GenerateData();
+
+    std::string Location(IRReg r);
+    std::string Register(int machineReg, IRKind kind);
+    std::string Label(IRBlock b);
+    int IntoRegister(IRReg r, int scratch);
+    void CheckNull(int machineReg);
+    void Move(IRKind kind, const std::string &from, const std::string &to);
+    void Jump(IRBlock b, IRInstr after);
+    void Epilogue();
+
+    static bool CallsOut(IROpcode op);
+    static const MachineRegisters machine;
+};
+
+#endif